@@ -296,6 +296,26 @@ diffuse_pde(read_only image2d_t HF, read_only image2d_t LF,
   write_imagef(output, (int2)(x, y), out);
 }
 
+kernel void
+diffuse_reconstruct(read_only image2d_t HF, read_only image2d_t LF,
+                    read_only image2d_t mask, const int has_mask,
+                    write_only image2d_t output,
+                    const int width, const int height)
+{
+  // diffuse_pde with a zero update
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const char opacity = (has_mask) ? read_imageui(mask, sampleri, (int2)(x, y)).x : 1;
+  const float4 hf = read_imagef(HF, samplerA, (int2)(x, y));
+  const float4 lf = read_imagef(LF, samplerA, (int2)(x, y));
+  const float4 out = (opacity) ? fmax(hf + lf, 0.f) : hf + lf;
+
+  write_imagef(output, (int2)(x, y), out);
+}
+
 kernel void
 build_mask(read_only image2d_t in, write_only image2d_t mask,
            const float threshold, const int width, const int height)
@@ -333,3 +333,103 @@ kernel void guided_filter_generate_result(const int width,
   const float res_ = guide_weight * (a_r_ + a_g_ + a_b_)+ b_;
   write_imagef(res, (int2)(x, y), fmin(maxval, fmax(minval, res_)));
 }
+
+
+// box downsampling of guide and input for the fast guided filter, the blocks at the
+// right and lower border might be smaller
+kernel void guided_filter_downsample(const int width,
+                                     const int height,
+                                     const int s,
+                                     const int ds_width,
+                                     const int ds_height,
+                                     read_only image2d_t guide,
+                                     read_only image2d_t in,
+                                     write_only image2d_t ds_guide,
+                                     write_only image2d_t ds_in)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= ds_width || y >= ds_height) return;
+
+  const int xmax = min(width, (x + 1) * s);
+  const int ymax = min(height, (y + 1) * s);
+  float4 sum = (float4)0.0f;
+  float sum_in = 0.0f;
+  for(int j = y * s; j < ymax; j++)
+  {
+    for(int i = x * s; i < xmax; i++)
+    {
+      sum += read_imagef(guide, sampleri, (int2)(i, j));
+      sum_in += read_imagef(in, sampleri, (int2)(i, j)).x;
+    }
+  }
+  const float norm = 1.0f / ((ymax - y * s) * (xmax - x * s));
+  sum.w = 0.0f;
+  write_imagef(ds_guide, (int2)(x, y), sum * norm);
+  write_imagef(ds_in, (int2)(x, y), sum_in * norm);
+}
+
+
+// collect the box filtered coefficients of rows first.. of a tile into rows dest.. of coeffs
+kernel void guided_filter_pack_coefficients(const int width,
+                                            const int height,
+                                            const int first,
+                                            const int dest,
+                                            read_only image2d_t a_r,
+                                            read_only image2d_t a_g,
+                                            read_only image2d_t a_b,
+                                            read_only image2d_t b,
+                                            write_only image2d_t coeffs)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const int2 p = (int2)(x, y + first);
+  const float4 ab = { read_imagef(a_r, sampleri, p).x,
+                      read_imagef(a_g, sampleri, p).x,
+                      read_imagef(a_b, sampleri, p).x,
+                      read_imagef(b,   sampleri, p).x };
+  write_imagef(coeffs, (int2)(x, y + dest), ab);
+}
+
+
+// bilinear upsampling of the downsampled coefficients, the centre of a block is the
+// location of its coefficients
+kernel void guided_filter_generate_result_upsampled(const int width,
+                                                    const int height,
+                                                    const int s,
+                                                    const int ds_width,
+                                                    const int ds_height,
+                                                    read_only image2d_t guide,
+                                                    read_only image2d_t coeffs,
+                                                    write_only image2d_t res,
+                                                    const float guide_weight,
+                                                    const float minval,
+                                                    const float maxval)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if(x >= width || y >= height) return;
+
+  const float fy = clamp((y + 0.5f) / s - 0.5f, 0.0f, (float)(ds_height - 1));
+  const int y0 = min((int)fy, ds_height - 1);
+  const int y1 = min(y0 + 1, ds_height - 1);
+  const float wy = fy - y0;
+  const float fx = clamp((x + 0.5f) / s - 0.5f, 0.0f, (float)(ds_width - 1));
+  const int x0 = min((int)fx, ds_width - 1);
+  const int x1 = min(x0 + 1, ds_width - 1);
+  const float wx = fx - x0;
+
+  const float4 c00 = read_imagef(coeffs, sampleri, (int2)(x0, y0));
+  const float4 c01 = read_imagef(coeffs, sampleri, (int2)(x1, y0));
+  const float4 c10 = read_imagef(coeffs, sampleri, (int2)(x0, y1));
+  const float4 c11 = read_imagef(coeffs, sampleri, (int2)(x1, y1));
+  const float4 top = c00 + wx * (c01 - c00);
+  const float4 bottom = c10 + wx * (c11 - c10);
+  const float4 ab = top + wy * (bottom - top);
+
+  const float4 pixel = fmin(100.0f, fmax(0.0f, read_imagef(guide, sampleri, (int2)(x, y))));
+  const float res_ = guide_weight * (ab.x * pixel.x + ab.y * pixel.y + ab.z * pixel.z) + ab.w;
+  write_imagef(res, (int2)(x, y), fmin(maxval, fmax(minval, res_)));
+}
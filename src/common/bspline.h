@@ -149,25 +149,30 @@ static inline void blur_2D_Bspline(const float *const restrict in,
                                    const gboolean clip_negatives)
 {
   // À-trous B-spline interpolation/blur shifted by mult
-  DT_OMP_FOR()
-  for(size_t row = 0; row < height; row++)
+  // the rows are processed in bands of cache-sized stripes, one per thread, so that the rows 'mult' and
+  // '2 mult' above and below a row are shared by the neighbouring rows of the stripe (see dwt_stripe_rows())
+  const size_t band = (size_t)dwt_stripe_rows(width, 4) * dt_get_num_threads();
+  for(size_t start = 0; start < height; start += band)
   {
-    // get a thread-private one-row temporary buffer
-    float *restrict const temp = dt_get_perthread(tempbuf, padded_size);
-    // interleave the order in which we process the rows so that we minimize cache misses
-    const size_t i = dwt_interleave_rows(row, height, mult);
-    // Convolve B-spline filter over columns: for each pixel in the current row, compute vertical blur
-    _bspline_vertical_pass(in, temp, i, width, height, mult, clip_negatives);
-    // Convolve B-spline filter horizontally over current row
-    for(size_t j = 0; j < width; j++)
+    const size_t end = MIN(start + band, height);
+    DT_OMP_FOR()
+    for(size_t i = start; i < end; i++)
     {
+      // get a thread-private one-row temporary buffer
+      float *restrict const temp = dt_get_perthread(tempbuf, padded_size);
+      // Convolve B-spline filter over columns: for each pixel in the current row, compute vertical blur
+      _bspline_vertical_pass(in, temp, i, width, height, mult, clip_negatives);
+      // Convolve B-spline filter horizontally over current row
+      for(size_t j = 0; j < width; j++)
+      {
 #if USE_NONTEMPORAL
-      dt_aligned_pixel_t blur;
-      _bspline_horizontal(temp, blur, j, width, mult, clip_negatives);
-      copy_pixel_nontemporal(out + (i * width + j) * 4, blur);
+        dt_aligned_pixel_t blur;
+        _bspline_horizontal(temp, blur, j, width, mult, clip_negatives);
+        copy_pixel_nontemporal(out + (i * width + j) * 4, blur);
 #else
-      _bspline_horizontal(temp, out + (i * width + j) * 4, j, width, mult, clip_negatives);
+        _bspline_horizontal(temp, out + (i * width + j) * 4, j, width, mult, clip_negatives);
 #endif
+      }
     }
   }
 #if USE_NONTEMPORAL
@@ -185,33 +190,36 @@ inline static void decompose_2D_Bspline(const float *const in,
                                         float *const tempbuf,
                                         const size_t padded_size)
 {
-  // Blur and compute the decimated wavelet at once
-  DT_OMP_FOR()
-  for(size_t row = 0; row < height; row++)
+  // Blur and compute the decimated wavelet at once, in bands of cache-sized stripes as in blur_2D_Bspline()
+  const size_t band = (size_t)dwt_stripe_rows(width, 4) * dt_get_num_threads();
+  for(size_t start = 0; start < height; start += band)
   {
-    // get a thread-private one-row temporary buffer
-    float *restrict const temp = dt_get_perthread(tempbuf, padded_size);
-    // interleave the order in which we process the rows so that we minimize cache misses
-    const size_t i = dwt_interleave_rows(row, height, mult);
-    // Convolve B-spline filter over columns: for each pixel in the current row, compute vertical blur
-    _bspline_vertical_pass(in, temp, i, width, height, mult, TRUE); // always clip negatives
-    // Convolve B-spline filter horizontally over current row
-    for(size_t j = 0; j < width; j++)
+    const size_t end = MIN(start + band, height);
+    DT_OMP_FOR()
+    for(size_t i = start; i < end; i++)
     {
-      const size_t index = 4U * (i * width + j);
+      // get a thread-private one-row temporary buffer
+      float *restrict const temp = dt_get_perthread(tempbuf, padded_size);
+      // Convolve B-spline filter over columns: for each pixel in the current row, compute vertical blur
+      _bspline_vertical_pass(in, temp, i, width, height, mult, TRUE); // always clip negatives
+      // Convolve B-spline filter horizontally over current row
+      for(size_t j = 0; j < width; j++)
+      {
+        const size_t index = 4U * (i * width + j);
 #if USE_NONTEMPORAL
-      dt_aligned_pixel_t blur;
-      _bspline_horizontal(temp, blur, j, width, mult, TRUE); // always clip negatives
-      copy_pixel_nontemporal(LF + index, blur);
-      // compute the HF component by subtracting the LF from the original input
-      for_four_channels(c)
-        HF[index + c] = in[index + c] - blur[c];
+        dt_aligned_pixel_t blur;
+        _bspline_horizontal(temp, blur, j, width, mult, TRUE); // always clip negatives
+        copy_pixel_nontemporal(LF + index, blur);
+        // compute the HF component by subtracting the LF from the original input
+        for_four_channels(c)
+          HF[index + c] = in[index + c] - blur[c];
 #else
-      _bspline_horizontal(temp, LF + index, j, width, mult, TRUE); // always clip negatives
-      // compute the HF component by subtracting the LF from the original input
-      for_four_channels(c)
-        HF[index + c] = in[index + c] - LF[index + c];
+        _bspline_horizontal(temp, LF + index, j, width, mult, TRUE); // always clip negatives
+        // compute the HF component by subtracting the LF from the original input
+        for_four_channels(c)
+          HF[index + c] = in[index + c] - LF[index + c];
 #endif
+      }
     }
   }
 #if USE_NONTEMPORAL
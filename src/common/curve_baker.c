@@ -0,0 +1,140 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/curve_baker.h"
+
+#include <float.h>
+#include <math.h>
+
+// cells per octave are 2^bits, we start coarse and refine until the tolerance is met
+#define BAKER_MIN_BITS 4
+#define BAKER_MAX_BITS 12
+// error is checked at these fractions of each cell
+#define BAKER_CHECKS 3
+
+static inline uint32_t _bits(const float x)
+{
+  union { float f; uint32_t i; } u = { .f = x };
+  return u.i;
+}
+
+static inline float _float(const uint32_t i)
+{
+  union { float f; uint32_t i; } u = { .i = i };
+  return u.f;
+}
+
+static float _sample(dt_baked_curve_t *curve,
+                     const uint32_t end,
+                     const int bits)
+{
+  curve->shift = 23 - bits;
+  const size_t cells = (end - curve->base) >> curve->shift;
+  curve->table = dt_alloc_align_float(cells + 2);
+  if(!curve->table) return INFINITY;
+
+  gboolean finite = TRUE;
+  for(size_t k = 0; k <= cells; k++)
+  {
+    curve->table[k] = curve->func(_float(curve->base + (uint32_t)(k << curve->shift)), curve->data);
+    finite = finite && isfinite(curve->table[k]);
+  }
+  curve->table[cells + 1] = curve->table[cells];
+  if(!finite) return INFINITY;
+
+  float max_error = 0.0f;
+  DT_OMP_FOR(reduction(max: max_error))
+  for(size_t k = 0; k < cells; k++)
+  {
+    for(int c = 1; c <= BAKER_CHECKS; c++)
+    {
+      const uint32_t offset = (uint32_t)((c << curve->shift) / (BAKER_CHECKS + 1));
+      const float x = _float(curve->base + (uint32_t)(k << curve->shift) + offset);
+      max_error = fmaxf(max_error, fabsf(dt_baked_curve_eval(curve, x) - curve->func(x, curve->data)));
+    }
+  }
+  return max_error;
+}
+
+gboolean dt_baked_curve_init(dt_baked_curve_t *curve,
+                             dt_curve_baker_func_t func,
+                             const void *const data,
+                             const float xmin,
+                             const float xmax,
+                             const float tolerance)
+{
+  const double start = dt_get_debug_wtime();
+  memset(curve, 0, sizeof(dt_baked_curve_t));
+  if(!(xmin >= FLT_MIN && xmax > xmin && isfinite(xmax))) return FALSE;
+
+  curve->func = func;
+  curve->data = data;
+  curve->base = _bits(xmin) & 0x7f800000u;
+  const uint32_t end = (_bits(xmax) & 0x007fffffu)
+                       ? (_bits(xmax) & 0x7f800000u) + 0x00800000u
+                       : _bits(xmax);
+  curve->xmin = _float(curve->base);
+  curve->xmax = _float(end);
+
+  // the segment down to zero can't be refined
+  curve->y0 = func(0.0f, data);
+  curve->slope0 = (func(curve->xmin, data) - curve->y0) / curve->xmin;
+  float max_error = 0.0f;
+  for(int c = 1; c < 8; c++)
+  {
+    const float x = curve->xmin * c / 8.0f;
+    max_error = fmaxf(max_error, fabsf(curve->y0 + x * curve->slope0 - func(x, data)));
+  }
+
+  int bits = BAKER_MIN_BITS;
+  float error = 0.0f;
+  if(max_error <= tolerance)
+  {
+    for(; bits <= BAKER_MAX_BITS; bits++)
+    {
+      error = _sample(curve, end, bits);
+      if(error <= tolerance) break;
+      dt_free_align(curve->table);
+      curve->table = NULL;
+    }
+  }
+  curve->max_error = max_error = fmaxf(max_error, error);
+
+  dt_print(DT_DEBUG_PERF,
+           "[curve baker] %s, [%g, %g] with %d cells per EV, max error %g, took %0.04f sec",
+           curve->table ? "baked" : "FAILED", curve->xmin, curve->xmax, 1 << MIN(bits, BAKER_MAX_BITS),
+           max_error, dt_get_debug_wtime() - start);
+
+  return curve->table != NULL;
+}
+
+void dt_baked_curve_cleanup(dt_baked_curve_t *curve)
+{
+  dt_free_align(curve->table);
+  curve->table = NULL;
+}
+
+#undef BAKER_MIN_BITS
+#undef BAKER_MAX_BITS
+#undef BAKER_CHECKS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
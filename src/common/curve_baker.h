@@ -0,0 +1,95 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+G_BEGIN_DECLS
+
+/* Tabulated per channel transfer functions of scene-referred values, like
+   the curves of the tone mappers that are constant per pipe run.
+
+   The grid is log-spaced, each octave in [xmin, xmax] holds the same number
+   of cells. Cells are found from the float bits so evaluating needs neither
+   logs nor powers, within a cell the function is interpolated linearly.
+   [0, xmin) is a single linear segment from f(0), values outside of [0, xmax]
+   and NaN are passed to the function itself.
+
+   The density is raised until the interpolation error measured against the
+   function is below the requested tolerance. Linear interpolation keeps
+   monotonic functions monotonic.
+*/
+
+// default tolerance for display-referred output, below a 16 bit step
+#define DT_CURVE_BAKER_TOLERANCE 1e-5f
+
+typedef float (*dt_curve_baker_func_t)(const float x, const void *const data);
+
+typedef struct dt_baked_curve_t
+{
+  float *table;               // samples at the cell borders
+  uint32_t base;              // float bits of xmin
+  int shift;                  // bits of the mantissa below the cell index
+  float xmin, xmax;           // powers of 2
+  float y0, slope0;           // the segment in [0, xmin)
+  float max_error;            // largest measured deviation from func
+  dt_curve_baker_func_t func; // used outside of [0, xmax]
+  const void *data;
+} dt_baked_curve_t;
+
+// tabulate func over [xmin, xmax], both rounded to powers of 2. data must stay
+// valid as long as the curve is used. Returns FALSE if the tolerance could not
+// be met or on allocation failures, curve->table is NULL then.
+gboolean dt_baked_curve_init(dt_baked_curve_t *curve,
+                             dt_curve_baker_func_t func,
+                             const void *const data,
+                             const float xmin,
+                             const float xmax,
+                             const float tolerance);
+
+void dt_baked_curve_cleanup(dt_baked_curve_t *curve);
+
+static inline gboolean dt_baked_curve_valid(const dt_baked_curve_t *const curve)
+{
+  return curve->table != NULL;
+}
+
+static inline float dt_baked_curve_eval(const dt_baked_curve_t *const curve,
+                                        const float x)
+{
+  // also catches NaN
+  if(!(x >= 0.0f && x <= curve->xmax))
+    return curve->func(x, curve->data);
+  if(x < curve->xmin)
+    return curve->y0 + x * curve->slope0;
+
+  union { float f; uint32_t i; } u = { .f = x };
+  const uint32_t d = u.i - curve->base;
+  const uint32_t i = d >> curve->shift;
+  const float t = (float)(d & ((1u << curve->shift) - 1u)) / (float)(1u << curve->shift);
+  return curve->table[i] + t * (curve->table[i + 1] - curve->table[i]);
+}
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
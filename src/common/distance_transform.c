@@ -22,6 +22,7 @@
    - omp support
    - reduced alloc/free using dt_alloc_align variants for better debug support
    - tuned for performance in collaboration with Ingo Weyrich (heckflosse67@gmx.de) from rawtherapee
+   - cache blocked column pass
 
   The original code is from:
 
@@ -49,6 +50,8 @@
       - use DT_DISTANCE_TRANSFORM_MASK, in this case data found in src is checked vs clip, dt_image_distance_transform
         will fill in the zeros / DT_DISTANCE_TRANSFORM_MAX
    The returned float of this function is the maximum calculated distance
+
+  Rows and columns are processed in parallel, the column pass works on tiles of transposed columns.
 */
 
 #include <math.h>
@@ -56,6 +59,10 @@
 #include "common/distance_transform.h"
 #include "common/imagebuf.h"
 
+// the column pass gathers this many neighbouring columns into a transposed tile, so the image
+// is read and written one cache line per row instead of one float per row
+#define DT_DISTANCE_TRANSFORM_TILE 16
+
 static void _image_distance_transform(const float *f,
                                       float *z,
                                       float *d,
@@ -114,24 +121,35 @@ float dt_image_distance_transform(float *const src,
   }
 
   const size_t maxdim = MAX(width, height);
+  const size_t tiles = (width + DT_DISTANCE_TRANSFORM_TILE - 1) / DT_DISTANCE_TRANSFORM_TILE;
+  const size_t tilesize = DT_DISTANCE_TRANSFORM_TILE * height;
   float max_distance = 0.0f;
   DT_OMP_PRAGMA(parallel reduction(max : max_distance)
-                dt_omp_firstprivate(out, maxdim, width, height))
+                dt_omp_firstprivate(out, maxdim, tiles, tilesize, width, height))
   {
-    float *f = dt_alloc_align_float(maxdim);
+    float *ftile = dt_alloc_align_float(tilesize);
+    float *dtile = dt_alloc_align_float(tilesize);
     float *z = dt_alloc_align_float(maxdim + 1);
     float *d = dt_alloc_align_float(maxdim);
     int *v = dt_alloc_align_int(maxdim);
 
-    // transform along columns
+    // transform along columns, a tile of neighbouring columns is transposed so the 1-d
+    // transforms work on contiguous data
     DT_OMP_PRAGMA(for schedule (static))
-    for(size_t x = 0; x < width; x++)
+    for(size_t t = 0; t < tiles; t++)
     {
+      const size_t x0 = t * DT_DISTANCE_TRANSFORM_TILE;
+      const size_t cols = MIN(DT_DISTANCE_TRANSFORM_TILE, width - x0);
       for(size_t y = 0; y < height; y++)
-        f[y] = out[y*width + x];
-      _image_distance_transform(f, z, d, v, height);
+        for(size_t c = 0; c < cols; c++)
+          ftile[c*height + y] = out[y*width + x0 + c];
+
+      for(size_t c = 0; c < cols; c++)
+        _image_distance_transform(&ftile[c*height], z, &dtile[c*height], v, height);
+
       for(size_t y = 0; y < height; y++)
-        out[y*width + x] = d[y];
+        for(size_t c = 0; c < cols; c++)
+          out[y*width + x0 + c] = dtile[c*height + y];
     }
     // implicit barrier :-)
     // transform along rows
@@ -146,7 +164,8 @@ float dt_image_distance_transform(float *const src,
         max_distance = fmaxf(max_distance, val);
       }
     }
-    dt_free_align(f);
+    dt_free_align(ftile);
+    dt_free_align(dtile);
     dt_free_align(d);
     dt_free_align(z);
     dt_free_align(v);
@@ -109,96 +109,115 @@ static void dwt_get_image_layer(float *const layer, dwt_params_t *const p)
     dt_iop_image_copy_by_size(p->image, layer, p->width, p->height, p->ch);
 }
 
-// first, "vertical" pass of wavelet decomposition
-static void dwt_decompose_vert(float *const restrict out, const float *const restrict in,
-                               const size_t height, const size_t width, const size_t lev)
+// "vertical" part of the wavelet decomposition for a single row: perform a weighted sum of the current pixel
+// row with the rows 'scale' pixels above and below and store it in the thread-private row buffer.
+// if either of those is beyond the edge of the image, we use reflection to get a value for averaging,
+// i.e. we move as many rows in from the edge as we would have been beyond the edge
+// for the top edge, this means we can simply use the absolute value of row-vscale; for the bottom edge,
+//   we need to reflect around height
+static inline void _dwt_decompose_vert_row(float *const restrict temprow,
+                                           const float *const restrict in,
+                                           const size_t row,
+                                           const size_t height,
+                                           const size_t width,
+                                           const size_t vscale)
 {
-  const size_t vscale = MIN(1 << lev, height-1);
-  DT_OMP_FOR()
-  for(int rowid = 0; rowid < height ; rowid++)
+  const size_t above_row = (row > vscale) ? row - vscale : vscale - row;
+  const size_t below_row = (row + vscale < height) ? (row + vscale) : 2*(height-1) - (row + vscale);
+  const float* const restrict center = in + 4 * row * width;
+  const float* const restrict above = in + 4 * above_row * width;
+  const float* const restrict below = in + 4 * below_row * width;
+  for(size_t col = 0; col < 4*width; col += 4)
   {
-    const size_t row = dwt_interleave_rows(rowid,height,vscale);
-    // perform a weighted sum of the current pixel row with the rows 'scale' pixels above and below
-    // if either of those is beyond the edge of the image, we use reflection to get a value for averaging,
-    // i.e. we move as many rows in from the edge as we would have been beyond the edge
-    // for the top edge, this means we can simply use the absolute value of row-vscale; for the bottom edge,
-    //   we need to reflect around height
-    const size_t rowstart = (size_t)4 * row * width;
-    const size_t above_row = (row > vscale) ? row - vscale : vscale - row;
-    const size_t below_row = (row + vscale < height) ? (row + vscale) : 2*(height-1) - (row + vscale);
-    const float* const restrict center = in + rowstart;
-    const float* const restrict above = in + 4 * above_row * width;
-    const float* const restrict below = in + 4 * below_row * width;
-    float* const restrict temprow = out + rowstart;
-    for(size_t col = 0; col < 4*width; col += 4)
+    for_each_channel(c,aligned(center, above, below, temprow : 16))
     {
-      for_each_channel(c,aligned(center, above, below, temprow : 16))
-      {
-        temprow[col + c] = 2.f * center[col+c] + above[col+c] + below[col+c];
-      }
+      temprow[col + c] = 2.f * center[col+c] + above[col+c] + below[col+c];
     }
   }
 }
 
-// second, horizontal pass of wavelet decomposition; generates 'coarse' into the output buffer and overwrites
-//   the input buffer with 'details'
-static void dwt_decompose_horiz(
-    float *const restrict out,
-    float *const restrict in,
-    float *const temp,
-    size_t padded_size,
-    const size_t height,
-    const size_t width,
-    const size_t lev)
+// "horizontal" part of the wavelet decomposition for a single row: perform a weighted sum of the current
+// pixel with the ones 'scale' pixels to the left and right, using reflection to get a value if either of
+// those positions is out of bounds, and rescale the final sum to get the 'coarse' result of the row
+static inline void _dwt_decompose_horiz_row(float *const restrict coarse,
+                                            const float *const restrict temprow,
+                                            const int width,
+                                            const int hscale)
 {
+  for(int col = 0; col < width - hscale; col++)
+  {
+    const size_t leftpos = (size_t)4*abs(col-hscale);	// the abs() handles reflection at the left edge
+    const size_t rightpos = (size_t)4*(col+hscale);
+    for_each_channel(c,aligned(temprow, coarse : 16))
+    {
+      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
+      coarse[4*col+c] = (2.f * temprow[4*col+c] + temprow[leftpos+c] + temprow[rightpos+c]) / 16.f;
+    }
+  }
+  // handle reflection at right edge
+  for(int col = MAX(width - hscale, 0); col < width; col++)
+  {
+    const size_t leftpos = (size_t)4 * abs(col-hscale); // still need to handle reflection, if hscale>=width/2
+    const size_t rightpos = (size_t)4 * (2*width - 2 - (col+hscale));
+    for_each_channel(c,aligned(temprow, coarse : 16))
+    {
+      coarse[4*col+c] = (2.f * temprow[4*col+c] + temprow[leftpos+c] + temprow[rightpos+c]) / 16.f;
+    }
+  }
+}
+
+// split the already processed rows first..last-1 into 'details' (put back into the input buffer) and
+// 'coarse' (left in the output buffer)
+static inline void _dwt_decompose_commit_rows(float *const restrict in,
+                                              const float *const restrict out,
+                                              const size_t first,
+                                              const size_t last,
+                                              const size_t width)
+{
+  DT_OMP_FOR_SIMD(aligned(in, out : 64))
+  for(size_t k = 4 * first * width; k < 4 * last * width; k++)
+    in[k] -= out[k];
+}
+
+// single pass of wavelet decomposition; generates 'coarse' into the output buffer and overwrites the input
+//   buffer with 'details'.
+//
+// Rather than running a full-image vertical pass followed by a full-image horizontal pass, the rows are
+// processed in bands of cache-sized stripes (see dwt_stripe_rows()).  Each thread blurs a row vertically into
+// its private row buffer and immediately blurs that horizontally into the output, so the intermediate result
+// never leaves the cache.  As the vertical blur of row r reads input rows r-scale..r+scale, the input rows
+// can only be replaced by their details once every row within 'scale' of them has been blurred; that update
+// therefore trails the band being processed by 'scale' rows.  The arithmetic is the same as for the
+// separate passes, so the result is bit-identical.
+static void _dwt_decompose_stripes(float *const restrict out,
+                                   float *const restrict in,
+                                   float *const temp,
+                                   const size_t padded_size,
+                                   const size_t height,
+                                   const size_t width,
+                                   const size_t lev)
+{
+  const size_t vscale = MIN(1 << lev, height-1);
   const int hscale = MIN(1 << lev, width);  //(int because we need a signed difference below)
-  DT_OMP_FOR()
-  for(int row = 0; row < height ; row++)
+  const size_t band = dwt_stripe_rows(width, 4) * dt_get_num_threads();
+  size_t done = 0;
+  for(size_t start = 0; start < height; start += band)
   {
-    // perform a weighted sum of the current pixel with the ones 'scale' pixels to the left and right, using
-    // reflection to get a value if either of those positions is out of bounds, i.e. we move as many columns
-    // in from the edge as we would have been beyond the edge to avoid an additional pass, we also rescale the
-    // final sum and split the original input into 'coarse' and 'details' by subtracting the scaled sum from
-    // the original input.
-    const size_t rowindex = (size_t)4 * (row * width);
-    float* const restrict temprow = dt_get_perthread(temp,padded_size);
-    float* const restrict details = in + rowindex;
-    float* const restrict coarse = out + rowindex;
-
-    for(int col = 0; col < width - hscale; col++)
+    const size_t end = MIN(start + band, height);
+    DT_OMP_FOR()
+    for(size_t row = start; row < end; row++)
     {
-      const size_t leftpos = (size_t)4*abs(col-hscale);	// the abs() handles reflection at the left edge
-      const size_t rightpos = (size_t)4*(col+hscale);
-      for_each_channel(c,aligned(temprow, details, coarse : 16))
-      {
-        const float left = coarse[leftpos+c];
-        const float right = coarse[rightpos+c];
-        // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-        const float hat = (2.f * coarse[4*col+c] + left + right) / 16.f;
-        // the normalized value is our 'coarse' result; 'details' is the difference between original input and 'coarse'
-        temprow[4*col+c] = hat;
-        details[4*col+c] -= hat;
-      }
+      float* const restrict temprow = dt_get_perthread(temp,padded_size);
+      _dwt_decompose_vert_row(temprow, in, row, height, width, vscale);
+      _dwt_decompose_horiz_row(out + 4 * row * width, temprow, width, hscale);
     }
-    // handle reflection at right edge
-    for(int col = width - hscale; col < width; col++)
+    // input rows above end-vscale are not read by any of the following bands any more
+    const size_t safe = (end == height) ? height : (end > vscale ? end - vscale : 0);
+    if(safe > done)
     {
-      const size_t leftpos = (size_t)4 * abs(col-hscale); // still need to handle reflection, if hscale>=width/2
-      const size_t rightpos = (size_t)4 * (2*width - 2 - (col+hscale));
-      for_each_channel(c,aligned(temprow, details, coarse : 16))
-      {
-        const float left = coarse[leftpos+c];
-        const float right = coarse[rightpos+c];
-        // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-        const float hat = (2.f * coarse[4*col+c] + left + right) / 16.f;
-        // the normalized value is our 'coarse' result; 'details' is the difference between original input and 'coarse'
-        temprow[4*col+c] = hat;
-        details[4*col+c] -= hat;
-      }
+      _dwt_decompose_commit_rows(in, out, done, safe, width);
+      done = safe;
     }
-    // now that we're done with the row of pixels, we can overwrite the intermediate result from the
-    // first pass with the final decomposition
-    memcpy(coarse, temprow, sizeof(float) * 4 * width);
   }
 }
 
@@ -211,9 +230,7 @@ static void dwt_decompose_layer(
     const int lev,
     const dwt_params_t *const p)
 {
-  dwt_decompose_vert(out, in, p->height, p->width, lev);
-  dwt_decompose_horiz(out, in, temp, padded_size, p->height, p->width, lev);
-  return;
+  _dwt_decompose_stripes(out, in, temp, padded_size, p->height, p->width, lev);
 }
 
 /* actual decomposing algorithm */
@@ -374,112 +391,110 @@ void dwt_decompose(dwt_params_t *p, _dwt_layer_func layer_func)
   dwt_wavelet_decompose(p->image, p, layer_func);
 }
 
-// first, "vertical" pass of wavelet decomposition
-static void dwt_denoise_vert_1ch(
-    float *const restrict out,
-    const float *const restrict in,
-    const size_t height,
-    const size_t width,
-    const size_t lev)
+// "vertical" part of the single-channel denoising decomposition for one row, averages pixels with those
+// 'scale' rows above and below and puts the result into the thread-private row buffer
+static inline void _dwt_denoise_vert_row_1ch(float *const restrict outrow,
+                                             const float *const restrict in,
+                                             const int row,
+                                             const int height,
+                                             const size_t width,
+                                             const int vscale)
 {
-  const int vscale = MIN(1 << lev, height);
-  DT_OMP_FOR()
-  for(int rowid = 0; rowid < height ; rowid++)
+  // if either of the rows is beyond the edge of the image, we use reflection to get a value for averaging,
+  // i.e. we move as many rows in from the edge as we would have been beyond the edge
+  // for the top edge, this means we can simply use the absolute value of row-vscale; for the bottom edge,
+  //   we need to reflect around height
+  const size_t below_row = (row + vscale < height) ? (row + vscale) : 2*(height-1) - (row + vscale);
+  const float *const restrict center = in + (size_t)row * width;
+  const float *const restrict above =  in + abs(row - vscale) * width;
+  const float *const restrict below = in + below_row * width;
+  DT_OMP_SIMD()
+  for(int col= 0; col < width; col++)
   {
-    const int row = dwt_interleave_rows(rowid,height,vscale);
-    // perform a weighted sum of the current pixel row with the rows 'scale' pixels above and below
-    // if either of those is beyond the edge of the image, we use reflection to get a value for averaging,
-    // i.e. we move as many rows in from the edge as we would have been beyond the edge
-    // for the top edge, this means we can simply use the absolute value of row-vscale; for the bottom edge,
-    //   we need to reflect around height
-    const size_t rowstart = (size_t)row * width;
-    const size_t below_row = (row + vscale < height) ? (row + vscale) : 2*(height-1) - (row + vscale);
-    const float *const restrict center = in + rowstart;
-    const float *const restrict above =  in + abs(row - vscale) * width;
-    const float *const restrict below = in + below_row * width;
-    float* const restrict outrow = out + rowstart;
-    DT_OMP_SIMD()
-    for(int col= 0; col < width; col++)
-    {
-      outrow[col] = 2.f * center[col] + above[col] + below[col];
-    }
+    outrow[col] = 2.f * center[col] + above[col] + below[col];
   }
 }
 
-// second, horizontal pass of wavelet decomposition; generates 'coarse' into the output buffer and overwrites
-//   the input buffer with 'details'
-static void dwt_denoise_horiz_1ch(
-    float *const restrict out,
-    float *const restrict in,
-    float *const restrict accum,
-    const size_t height,
-    const size_t width,
-    const size_t lev,
-    const float thold,
-    const int last)
+// "horizontal" part of the single-channel denoising decomposition for one row, averages pixels of the
+// vertically filtered row with those 'scale' columns to the left and right and stores 'coarse'
+static inline void _dwt_denoise_horiz_row_1ch(float *const restrict coarse,
+                                              const float *const restrict vert,
+                                              const int width,
+                                              const int hscale)
+{
+  // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
+  // handle reflection at left edge
+  DT_OMP_SIMD()
+  for(int col = 0; col < hscale; col++)
+    coarse[col] = (2.f * vert[col] + vert[hscale-col] + vert[col+hscale]) / 16.f;
+  DT_OMP_SIMD()
+  for(int col = hscale; col < width - hscale; col++)
+    coarse[col] = (2.f * vert[col] + vert[col-hscale] + vert[col+hscale]) / 16.f;
+  // handle reflection at right edge
+  DT_OMP_SIMD()
+  for(int col = width - hscale; col < width; col++)
+    coarse[col] = (2.f * vert[col] + vert[col-hscale] + vert[2*width - 2 - (col+hscale)]) / 16.f;
+}
+
+// replace the input rows first..last-1 by 'coarse' and accumulate the portion of the difference between
+// original input and 'coarse' which exceeds the noise threshold; on the last scale the accumulated details
+// are added to the residue to create the final denoised result
+static inline void _dwt_denoise_commit_rows_1ch(float *const restrict img,
+                                                const float *const restrict coarse,
+                                                float *const restrict accum,
+                                                const size_t first,
+                                                const size_t last,
+                                                const size_t width,
+                                                const float thold,
+                                                const int final)
+{
+  DT_OMP_FOR_SIMD()
+  for(size_t k = first * width; k < last * width; k++)
+  {
+    // 'diff' would ordinarily be stored as the details scale, but we don't need it any further
+    const float diff = img[k] - coarse[k];
+    // GCC8 won't vectorize if we use the following line, but it turns out that just adding the two conditional
+    // alternatives produces exactly the same result, and *that* does get vectorized
+    //const float excess = diff < 0.0 ? MIN(diff + thold, 0.0f) : MAX(diff - thold, 0.0f);
+    accum[k] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
+    img[k] = final ? coarse[k] + accum[k] : coarse[k];
+  }
+}
+
+// one scale of the single-channel denoising decomposition, processed in bands of cache-sized stripes the
+// same way as _dwt_decompose_stripes(): 'interm' receives 'coarse', the input rows are overwritten once no
+// later row needs them for its vertical filter any more
+static void _dwt_denoise_stripes_1ch(float *const restrict interm,
+                                     float *const restrict img,
+                                     float *const restrict accum,
+                                     float *const temp,
+                                     const size_t padded_size,
+                                     const int height,
+                                     const int width,
+                                     const int lev,
+                                     const float thold,
+                                     const int last)
 {
+  const int vscale = MIN(1 << lev, height);
   const int hscale = MIN(1 << lev, width);
-  DT_OMP_FOR()
-  for(int row = 0; row < height ; row++)
+  const int band = dwt_stripe_rows(width, 1) * dt_get_num_threads();
+  int done = 0;
+  for(int start = 0; start < height; start += band)
   {
-    // perform a weighted sum of the current pixel with the ones 'scale' pixels to the left and right, using
-    // reflection to get a value if either of those positions is out of bounds, i.e. we move as many columns
-    // in from the edge as we would have been beyond the edge to avoid an additional pass, we also rescale the
-    // final sum and split the original input into 'coarse' and 'details' by subtracting the scaled sum from
-    // the original input.
-    const size_t rowindex = (size_t)row * width;
-    float *const restrict details = in + rowindex;
-    float *const restrict coarse = out + rowindex;
-    float *const restrict accum_row = accum + rowindex;
-    // handle reflection at left edge
-    DT_OMP_SIMD()
-    for(int col = 0; col < hscale; col++)
+    const int end = MIN(start + band, height);
+    DT_OMP_FOR()
+    for(int row = start; row < end; row++)
     {
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[hscale-col] + coarse[col+hscale]) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original input and 'coarse'
-      // (which would ordinarily be stored as the details scale, but we don't need it any further)
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      // GCC8 won't vectorize if we use the following line, but it turns out that just adding the two conditional
-      // alternatives produces exactly the same result, and *that* does get vectorized
-      //const float excess = diff < 0.0 ? MIN(diff + thold, 0.0f) : MAX(diff - thold, 0.0f);
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
+      float *const restrict vert = dt_get_perthread(temp, padded_size);
+      _dwt_denoise_vert_row_1ch(vert, img, row, height, width, vscale);
+      _dwt_denoise_horiz_row_1ch(interm + (size_t)row * width, vert, width, hscale);
     }
-    DT_OMP_SIMD()
-    for(int col = hscale; col < width - hscale; col++)
+    // input rows above end-vscale are not read by any of the following bands any more
+    const int safe = (end == height) ? height : MAX(end - vscale, 0);
+    if(safe > done)
     {
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[col-hscale] + coarse[col+hscale]) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original input and 'coarse'
-      // (which would ordinarily be stored as the details scale, but we don't need it any further)
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      // GCC8 won't vectorize if we use the following line, but it turns out that just adding the two conditional
-      // alternatives produces exactly the same result, and *that* does get vectorized
-      //const float excess = diff < 0.0 ? MIN(diff + thold, 0.0f) : MAX(diff - thold, 0.0f);
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    // handle reflection at right edge
-    DT_OMP_SIMD()
-    for(int col = width - hscale; col < width; col++)
-    {
-      const float right = coarse[2*width - 2 - (col+hscale)];
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[col-hscale] + right) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original input and 'coarse'
-      // (which would ordinarily be stored as the details scale, but we don't need it any further)
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    if(last)
-    {
-      // add the details to the residue to create the final denoised result
-      for(int col = 0; col < width; col++)
-      {
-        details[col] += accum_row[col];
-      }
+      _dwt_denoise_commit_rows_1ch(img, interm, accum, done, safe, width, thold, last);
+      done = safe;
     }
   }
 }
@@ -495,9 +510,13 @@ void dwt_denoise(float *const img,
                  const float *const noise)
 {
   float *const details = dt_alloc_align_float((size_t)2 * width * height);
-  if(!details)
+  size_t padded_size;
+  float *const temp = dt_alloc_perthread_float(width, &padded_size);
+  if(!details || !temp)
   {
     dt_print(DT_DEBUG_ALWAYS,"[dwt_denoise] unable to alloc working memory, skipping denoise");
+    dt_free_align(details);
+    dt_free_align(temp);
     return;
   }
   float *const interm = details + width * height;	// temporary storage for use during each pass
@@ -509,16 +528,13 @@ void dwt_denoise(float *const img,
   {
     const int last = (lev+1) == bands;
 
-    // "vertical" pass, averages pixels with those 'scale' rows above
-    // and below and puts result in 'interm'
-    dwt_denoise_vert_1ch(interm, img, height, width, lev);
-    // horizontal filtering pass, averages pixels in 'interm' with
-    // those 'scale' rows to the left and right
-    // accumulates the portion of the detail scale that is above the
-    // noise threshold into 'details'; this will be added to the
-    // residue left in 'img' on the last iteration
-    dwt_denoise_horiz_1ch(interm, img, details, height, width, lev, noise[lev], last);
+    // averages pixels with those 'scale' rows above/below and to the left/right, putting the
+    // result in 'interm'; accumulates the portion of the detail scale that is above the
+    // noise threshold into 'details'; this will be added to the residue left in 'img' on
+    // the last iteration
+    _dwt_denoise_stripes_1ch(interm, img, details, temp, padded_size, height, width, lev, noise[lev], last);
   }
+  dt_free_align(temp);
   dt_free_align(details);
 }
 
@@ -97,6 +97,20 @@ static inline int dwt_interleave_rows(const int rowid, const int height, const i
   return long_passes + (rowid2 / (per_pass-1)) + stride * (rowid2 % (per_pass-1));
 }
 
+// size in bytes of the stripe of rows each thread works on when a wavelet scale is processed in stripes,
+// chosen to keep a stripe plus the rows it reads above and below within a typical per-core L2 cache
+#define DT_DWT_STRIPE_BYTES (256 * 1024)
+
+/*
+ * given an image width and the number of floats per pixel, return the number of rows making up
+ * one cache-sized stripe (at least 4 so that the per-band parallelization overhead stays small)
+ */
+static inline int dwt_stripe_rows(const int width, const int ch)
+{
+  const size_t rowsize = sizeof(float) * ch * MAX(width, 1);
+  return MAX(4, (int)(DT_DWT_STRIPE_BYTES / rowsize));
+}
+
 
 
 #ifdef HAVE_OPENCL
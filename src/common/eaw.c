@@ -19,7 +19,7 @@
 #include "common/eaw.h"
 #include "common/math.h"
 #include "control/control.h"     // needed by dwt.h
-#include "common/dwt.h"          // for dwt_interleave_rows
+#include "common/dwt.h"          // for dwt_stripe_rows
 
 static inline void weight(const dt_aligned_pixel_t c1,
                               const dt_aligned_pixel_t c2,
@@ -130,75 +130,81 @@ void eaw_decompose_and_synthesize(float *const restrict out,
   const int boundary = 2 * mult;
   const dt_aligned_pixel_t vsharpen = { -0.5f * sharpen, -sharpen, -sharpen, 0.0f };
 
-  DT_OMP_FOR()
-  for(size_t rowid = 0; rowid < height; rowid++)
+  // process the rows in bands of cache-sized stripes, one per thread, so that the rows 'mult' above and
+  // below the ones being filtered are shared by the neighbouring rows of the stripe (see dwt_stripe_rows())
+  const size_t band = (size_t)dwt_stripe_rows(width, 4) * dt_get_num_threads();
+  for(size_t start = 0; start < height; start += band)
   {
-    const size_t j = dwt_interleave_rows(rowid, height, mult);
-    const float *px = ((float *)in) + (size_t)4 * j * width;
-    const float *px2;
-    float *pdetail = accum + (size_t)4 * j * width;
-    float *pcoarse = out + (size_t)4 * j * width;
-
-    // for the first and last 'boundary' rows, we have to perform boundary tests for the entire row;
-    //   for the central bulk, we only need to use those slower versions on the leftmost and rightmost pixels
-    const size_t lbound = (j < boundary || j >= height - boundary) ? width-boundary : boundary;
-
-    /* The first "2*mult" pixels need a boundary check because we might try to access past the left edge,
-     * which requires nearest pixel interpolation */
-    size_t i;
-    for(i = 0; i < lbound; i++)
+    const size_t end = MIN(start + band, height);
+    DT_OMP_FOR()
+    for(size_t j = start; j < end; j++)
     {
-      SUM_PIXEL_PROLOGUE;
-      for(ssize_t jj = 0; jj < 5; jj++)
+      const float *px = ((float *)in) + (size_t)4 * j * width;
+      const float *px2;
+      float *pdetail = accum + (size_t)4 * j * width;
+      float *pcoarse = out + (size_t)4 * j * width;
+
+      // for the first and last 'boundary' rows, we have to perform boundary tests for the entire row;
+      //   for the central bulk, we only need to use those slower versions on the leftmost and rightmost pixels
+      const size_t lbound = (j < boundary || j >= height - boundary) ? width-boundary : boundary;
+
+      /* The first "2*mult" pixels need a boundary check because we might try to access past the left edge,
+       * which requires nearest pixel interpolation */
+      size_t i;
+      for(i = 0; i < lbound; i++)
       {
-        const ssize_t y = j + mult * (jj-2);
-        const ssize_t clamp_y = CLAMP(y,0,height-1);
-        for(ssize_t ii = 0; ii < 5; ii++)
+        SUM_PIXEL_PROLOGUE;
+        for(ssize_t jj = 0; jj < 5; jj++)
         {
-          ssize_t x = i + mult * ((ii)-2);
-          if(x < 0) x = 0;			// we might be looking past the left edge
-          px2 = ((float *)in) + 4 * x + (size_t)4 * clamp_y * width;
-          SUM_PIXEL_CONTRIBUTION;
+          const ssize_t y = j + mult * (jj-2);
+          const ssize_t clamp_y = CLAMP(y,0,height-1);
+          for(ssize_t ii = 0; ii < 5; ii++)
+          {
+            ssize_t x = i + mult * ((ii)-2);
+            if(x < 0) x = 0;			// we might be looking past the left edge
+            px2 = ((float *)in) + 4 * x + (size_t)4 * clamp_y * width;
+            SUM_PIXEL_CONTRIBUTION;
+          }
         }
+        SUM_PIXEL_EPILOGUE;
       }
-      SUM_PIXEL_EPILOGUE;
-    }
 
-    /* For pixels [2*mult, width-2*mult], we don't need to do any boundary checks */
-    for( ; i < width - boundary; i++)
-    {
-      SUM_PIXEL_PROLOGUE;
-      px2 = ((float *)in) + (size_t)4 * (i - 2 * mult + (size_t)(j - 2 * mult) * width);
-      for(ssize_t jj = 0; jj < 5; jj++)
+      /* For pixels [2*mult, width-2*mult], we don't need to do any boundary checks */
+      for( ; i < width - boundary; i++)
       {
-        for(ssize_t ii = 0; ii < 5; ii++)
+        SUM_PIXEL_PROLOGUE;
+        px2 = ((float *)in) + (size_t)4 * (i - 2 * mult + (size_t)(j - 2 * mult) * width);
+        for(ssize_t jj = 0; jj < 5; jj++)
         {
-          SUM_PIXEL_CONTRIBUTION;
-          px2 += (size_t)4 * mult;
+          for(ssize_t ii = 0; ii < 5; ii++)
+          {
+            SUM_PIXEL_CONTRIBUTION;
+            px2 += (size_t)4 * mult;
+          }
+          px2 += (size_t)4 * (width - 5) * mult;
         }
-        px2 += (size_t)4 * (width - 5) * mult;
+        SUM_PIXEL_EPILOGUE;
       }
-      SUM_PIXEL_EPILOGUE;
-    }
 
-    /* Last 2*mult pixels in the row require the boundary check again */
-    for( ; i < width; i++)
-    {
-      SUM_PIXEL_PROLOGUE;
-      for(ssize_t jj = 0; jj < 5; jj++)
+      /* Last 2*mult pixels in the row require the boundary check again */
+      for( ; i < width; i++)
       {
-        const ssize_t y = j + mult * (jj-2);
-        const ssize_t clamp_y = CLAMP(y,0,height-1);
-        for(ssize_t ii = 0; ii < 5; ii++)
+        SUM_PIXEL_PROLOGUE;
+        for(ssize_t jj = 0; jj < 5; jj++)
         {
-          const ssize_t x = i + mult * ((ii)-2);
-          // ensure that we don't look past either edge (left edge is possible at higher scales on small images)
-          const ssize_t clamp_x = CLAMP(x, 0, width - 1);
-          px2 = ((float *)in) + 4 * clamp_x + (size_t)4 * clamp_y * width;
-          SUM_PIXEL_CONTRIBUTION;
+          const ssize_t y = j + mult * (jj-2);
+          const ssize_t clamp_y = CLAMP(y,0,height-1);
+          for(ssize_t ii = 0; ii < 5; ii++)
+          {
+            const ssize_t x = i + mult * ((ii)-2);
+            // ensure that we don't look past either edge (left edge is possible at higher scales on small images)
+            const ssize_t clamp_x = CLAMP(x, 0, width - 1);
+            px2 = ((float *)in) + 4 * clamp_x + (size_t)4 * clamp_y * width;
+            SUM_PIXEL_CONTRIBUTION;
+          }
         }
+        SUM_PIXEL_EPILOGUE;
       }
-      SUM_PIXEL_EPILOGUE;
     }
   }
 }
@@ -253,9 +259,33 @@ static inline float dn_weight(const float *c1, const float *c2, const float inv_
     }                                                                                                        \
   } while(0)
 
+// the detail of the previous scale is the difference between its input, which
+// is about to be overwritten by the coarse image of this scale, and its coarse
+// image, which is the input of this scale
+static inline void dn_synthesize(float *const restrict accum,
+                                 const float *const restrict fine,
+                                 const float *const restrict coarse,
+                                 const dt_aligned_pixel_t thresh,
+                                 const dt_aligned_pixel_t boostval,
+                                 const gboolean init)
+{
+  dt_aligned_pixel_t acc = { 0.0f, 0.0f, 0.0f, 0.0f };
+  if(!init) copy_pixel(acc, accum);
+  dt_aligned_pixel_t det;
+  for_each_channel(c)
+    det[c] = fine[c] - coarse[c];
+  accumulate(acc, det, thresh, boostval);
+  copy_pixel(accum, acc);
+}
+
 #undef SUM_PIXEL_EPILOGUE
 #define SUM_PIXEL_EPILOGUE                                                                                   \
   dt_aligned_pixel_t det;									             \
+  if(accum)                                                                                                  \
+  {                                                                                                          \
+    dn_synthesize(paccum, pcoarse, px, thresh, boostval, scale == 1);                                        \
+    paccum += 4;                                                                                             \
+  }                                                                                                          \
   for_each_channel(c)      										     \
   {													     \
     sum[c] /= wgt[c];                                                   				     \
@@ -263,14 +293,25 @@ static inline float dn_weight(const float *c1, const float *c2, const float inv_
     det[c] = (px[c] - sum[c]);									             \
     sum_sq[c] += (det[c]*det[c]);					                                     \
   }                                                                       				     \
-  copy_pixel_nontemporal(pdetail, det);                                                                      \
+  if(detail)                                                                                                 \
+  {                                                                                                          \
+    copy_pixel_nontemporal(pdetail, det);                                                                    \
+    pdetail += 4;                                                                                            \
+  }                                                                                                          \
   px += 4;                                                                                                   \
-  pdetail += 4;                                                                                              \
   pcoarse += 4;
 
-void eaw_dn_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
-                      dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
-                      const int32_t width, const int32_t height)
+static inline void dn_decompose(float *const restrict out,
+                                const float *const restrict in,
+                                float *const restrict detail,
+                                float *const restrict accum,
+                                const float *const restrict threshold,
+                                const float *const restrict boost,
+                                dt_aligned_pixel_t sum_squared,
+                                const int scale,
+                                const float inv_sigma2,
+                                const int32_t width,
+                                const int32_t height)
 {
   const int mult = 1u << scale;
   static const float filter[25] =
@@ -282,86 +323,131 @@ void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
       1.0f / 256.0f,  4.0f / 256.0f,  6.0f / 256.0f,  4.0f / 256.0f, 1.0f / 256.0f
     };
   const int boundary = 2 * mult;
+  const dt_aligned_pixel_t thresh = { threshold[0], threshold[1], threshold[2], threshold[3] };
+  const dt_aligned_pixel_t boostval = { boost[0], boost[1], boost[2], boost[3] };
 
   dt_aligned_pixel_t sum_sq = { 0.0f, 0.0f, 0.0f, 0.0f };
 
+  // process the rows in bands of cache-sized stripes as in eaw_decompose_and_synthesize()
+  const size_t band = (size_t)dwt_stripe_rows(width, 4) * dt_get_num_threads();
+  for(size_t start = 0; start < height; start += band)
+  {
+    const size_t end = MIN(start + band, height);
 #if !(defined(__apple_build_version__) && __apple_build_version__ < 11030000) //makes Xcode 11.3.1 compiler crash
-  DT_OMP_FOR(reduction(+: sum_sq[0:4]))
+    DT_OMP_FOR(reduction(+: sum_sq[0:4]))
 #endif
-  for(int rowid = 0; rowid < height; rowid++)
-  {
-    const size_t j = dwt_interleave_rows(rowid, height, mult);
-    const float *px = ((float *)in) + (size_t)4 * j * width;
-    const float *px2;
-    float *pdetail = detail + (size_t)4 * j * width;
-    float *pcoarse = out + (size_t)4 * j * width;
-
-    // for the first and last 'boundary' rows, we have to perform boundary tests for the entire row;
-    //   for the central bulk, we only need to use those slower versions on the leftmost and rightmost pixels
-    const int lbound = (j < boundary || j >= height - boundary) ? width-boundary : boundary;
-
-    /* The first "2*mult" pixels need a boundary check because we might try to access past the left edge,
-     * which requires nearest pixel interpolation */
-    int i;
-    for(i = 0; i < lbound; i++)
+    for(size_t j = start; j < end; j++)
     {
-      SUM_PIXEL_PROLOGUE;
-      for(int jj = 0; jj < 5; jj++)
+      const float *px = ((float *)in) + (size_t)4 * j * width;
+      const float *px2;
+      float *pdetail = detail ? detail + (size_t)4 * j * width : NULL;
+      float *paccum = accum ? accum + (size_t)4 * j * width : NULL;
+      float *pcoarse = out + (size_t)4 * j * width;
+
+      // for the first and last 'boundary' rows, we have to perform boundary tests for the entire row;
+      //   for the central bulk, we only need to use those slower versions on the leftmost and rightmost pixels
+      const int lbound = (j < boundary || j >= height - boundary) ? width-boundary : boundary;
+
+      /* The first "2*mult" pixels need a boundary check because we might try to access past the left edge,
+       * which requires nearest pixel interpolation */
+      int i;
+      for(i = 0; i < lbound; i++)
       {
-        const int y = j + mult * (jj-2);
-        const int clamp_y = CLAMP(y,0,height-1);
-        for(int ii = 0; ii < 5; ii++)
+        SUM_PIXEL_PROLOGUE;
+        for(int jj = 0; jj < 5; jj++)
         {
-          int x = i + mult * ((ii)-2);
-          if(x < 0) x = 0;			// we might be looking past the left edge
-          px2 = ((float *)in) + 4 * x + (size_t)4 * clamp_y * width;
-          SUM_PIXEL_CONTRIBUTION;
+          const int y = j + mult * (jj-2);
+          const int clamp_y = CLAMP(y,0,height-1);
+          for(int ii = 0; ii < 5; ii++)
+          {
+            int x = i + mult * ((ii)-2);
+            if(x < 0) x = 0;			// we might be looking past the left edge
+            px2 = ((float *)in) + 4 * x + (size_t)4 * clamp_y * width;
+            SUM_PIXEL_CONTRIBUTION;
+          }
         }
+        SUM_PIXEL_EPILOGUE;
       }
-      SUM_PIXEL_EPILOGUE;
-    }
 
-    /* For pixels [2*mult, width-2*mult], we don't need to do any boundary checks */
-    for( ; i < width - boundary; i++)
-    {
-      SUM_PIXEL_PROLOGUE;
-      px2 = ((float *)in) + (size_t)4 * (i - 2 * mult + (size_t)(j - 2 * mult) * width);
-      for(int jj = 0; jj < 5; jj++)
+      /* For pixels [2*mult, width-2*mult], we don't need to do any boundary checks */
+      for( ; i < width - boundary; i++)
       {
-        for(int ii = 0; ii < 5; ii++)
+        SUM_PIXEL_PROLOGUE;
+        px2 = ((float *)in) + (size_t)4 * (i - 2 * mult + (size_t)(j - 2 * mult) * width);
+        for(int jj = 0; jj < 5; jj++)
         {
-          SUM_PIXEL_CONTRIBUTION;
-          px2 += (size_t)4 * mult;
+          for(int ii = 0; ii < 5; ii++)
+          {
+            SUM_PIXEL_CONTRIBUTION;
+            px2 += (size_t)4 * mult;
+          }
+          px2 += (size_t)4 * (width - 5) * mult;
         }
-        px2 += (size_t)4 * (width - 5) * mult;
+        SUM_PIXEL_EPILOGUE;
       }
-      SUM_PIXEL_EPILOGUE;
-    }
 
-    /* Last 2*mult pixels in the row require the boundary check again */
-    for( ; i < width; i++)
-    {
-      SUM_PIXEL_PROLOGUE;
-      for(int jj = 0; jj < 5; jj++)
+      /* Last 2*mult pixels in the row require the boundary check again */
+      for( ; i < width; i++)
       {
-        const int y = j + mult * (jj-2);
-        const int clamp_y = CLAMP(y,0,height-1);
-        for(int ii = 0; ii < 5; ii++)
+        SUM_PIXEL_PROLOGUE;
+        for(int jj = 0; jj < 5; jj++)
         {
-          const int x = i + mult * ((ii)-2);
-          // ensure that we don't look past either edge (left edge is possible at higher scales on small images)
-          const int clamp_x = CLAMP(x, 0, width-1);
-          px2 = ((float *)in) + 4 * clamp_x + (size_t)4 * clamp_y * width;
-          SUM_PIXEL_CONTRIBUTION;
+          const int y = j + mult * (jj-2);
+          const int clamp_y = CLAMP(y,0,height-1);
+          for(int ii = 0; ii < 5; ii++)
+          {
+            const int x = i + mult * ((ii)-2);
+            // ensure that we don't look past either edge (left edge is possible at higher scales on small images)
+            const int clamp_x = CLAMP(x, 0, width-1);
+            px2 = ((float *)in) + 4 * clamp_x + (size_t)4 * clamp_y * width;
+            SUM_PIXEL_CONTRIBUTION;
+          }
         }
+        SUM_PIXEL_EPILOGUE;
       }
-      SUM_PIXEL_EPILOGUE;
     }
   }
   for_each_channel(c)
     sum_squared[c] = sum_sq[c];
 }
 
+void eaw_dn_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                      dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
+                      const int32_t width, const int32_t height)
+{
+  static const dt_aligned_pixel_t none = { 0.0f, 0.0f, 0.0f, 0.0f };
+  dn_decompose(out, in, detail, NULL, none, none, sum_squared, scale, inv_sigma2, width, height);
+}
+
+void eaw_dn_decompose_and_synthesize(float *const restrict out, const float *const restrict in,
+                                     float *const restrict accum, const float *const restrict threshold,
+                                     const float *const restrict boost, dt_aligned_pixel_t sum_squared,
+                                     const int scale, const float inv_sigma2,
+                                     const int32_t width, const int32_t height)
+{
+  // there's no detail band before the first scale
+  dn_decompose(out, in, NULL, scale > 0 ? accum : NULL, threshold, boost, sum_squared, scale, inv_sigma2,
+               width, height);
+}
+
+void eaw_dn_synthesize_residue(float *const restrict accum, const float *const restrict fine,
+                               const float *const restrict coarse, const float *const restrict threshold,
+                               const float *const restrict boost, const int scale,
+                               const int32_t width, const int32_t height)
+{
+  const dt_aligned_pixel_t thresh = { threshold[0], threshold[1], threshold[2], threshold[3] };
+  const dt_aligned_pixel_t boostval = { boost[0], boost[1], boost[2], boost[3] };
+  const size_t npixels = (size_t)width * height;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+  {
+    dn_synthesize(accum + 4*k, fine + 4*k, coarse + 4*k, thresh, boostval, scale == 0);
+    for_each_channel(c)
+      accum[4*k+c] += coarse[4*k+c];
+  }
+}
+
 #undef SUM_PIXEL_CONTRIBUTION
 #undef SUM_PIXEL_PROLOGUE
 #undef SUM_PIXEL_EPILOGUE
@@ -54,6 +54,30 @@ void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
                       dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
                       const int32_t width, const int32_t height);
 
+// eaw_dn_decompose() without a stored detail band: on entry out holds the input
+// of the previous scale, whose detail against in is shrunk by threshold and added
+// to accum before out is overwritten by the coarse image of this scale. The
+// detail of scale 0 initializes accum.
+typedef void((*eaw_dn_decompose_and_synthesize_t)(float *const restrict out, const float *const restrict in,
+                                                  float *const restrict accum,
+                                                  const float *const restrict threshold,
+                                                  const float *const restrict boost,
+                                                  dt_aligned_pixel_t sum_squared, const int scale,
+                                                  const float inv_sigma2,
+                                                  const int32_t width, const int32_t height));
+
+void eaw_dn_decompose_and_synthesize(float *const restrict out, const float *const restrict in,
+                                     float *const restrict accum, const float *const restrict threshold,
+                                     const float *const restrict boost, dt_aligned_pixel_t sum_squared,
+                                     const int scale, const float inv_sigma2,
+                                     const int32_t width, const int32_t height);
+
+// adds the detail of the last scale, fine - coarse, and the residue coarse to accum
+void eaw_dn_synthesize_residue(float *const restrict accum, const float *const restrict fine,
+                               const float *const restrict coarse, const float *const restrict threshold,
+                               const float *const restrict boost, const int scale,
+                               const int32_t width, const int32_t height);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
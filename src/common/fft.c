@@ -0,0 +1,203 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Iterative radix-2 decimation in time on planar data. The butterflies of the
+   column pass work on full rows so they vectorize, the row pass is done as a
+   column pass between two transpositions.
+   Tiles are small (128x128 complex is 128KiB) so they stay in L2 while being
+   transformed.
+*/
+
+#include "common/fft.h"
+
+#include <math.h>
+
+dt_fft_t *dt_fft_new(const int n)
+{
+  if(n < 2 || (n & (n - 1))) return NULL;
+
+  dt_fft_t *fft = calloc(1, sizeof(dt_fft_t));
+  if(!fft) return NULL;
+
+  fft->n = n;
+  fft->twiddle = dt_alloc_align_float(n);
+  fft->bitrev = dt_alloc_aligned(sizeof(int) * n);
+  if(!fft->twiddle || !fft->bitrev)
+  {
+    dt_fft_free(fft);
+    return NULL;
+  }
+
+  for(int k = 0; k < n / 2; k++)
+  {
+    const double phi = -2.0 * M_PI * k / n;
+    fft->twiddle[2 * k] = cos(phi);
+    fft->twiddle[2 * k + 1] = sin(phi);
+  }
+
+  int bits = 0;
+  while((1 << bits) < n) bits++;
+  for(int k = 0; k < n; k++)
+  {
+    int r = 0;
+    for(int b = 0; b < bits; b++)
+      if(k & (1 << b)) r |= 1 << (bits - 1 - b);
+    fft->bitrev[k] = r;
+  }
+  return fft;
+}
+
+void dt_fft_free(dt_fft_t *fft)
+{
+  if(!fft) return;
+  dt_free_align(fft->twiddle);
+  dt_free_align(fft->bitrev);
+  free(fft);
+}
+
+static inline void _swap_rows(float *const restrict a,
+                              float *const restrict b,
+                              const int n)
+{
+  for(int k = 0; k < n; k++)
+  {
+    const float t = a[k];
+    a[k] = b[k];
+    b[k] = t;
+  }
+}
+
+// transform all columns at once
+static void _fft_columns(const dt_fft_t *const fft,
+                         float *const restrict re,
+                         float *const restrict im,
+                         const gboolean inverse)
+{
+  const int n = fft->n;
+  for(int k = 0; k < n; k++)
+  {
+    const int r = fft->bitrev[k];
+    if(r > k)
+    {
+      _swap_rows(re + (size_t)k * n, re + (size_t)r * n, n);
+      _swap_rows(im + (size_t)k * n, im + (size_t)r * n, n);
+    }
+  }
+
+  const float sign = inverse ? -1.0f : 1.0f;
+  for(int len = 2; len <= n; len <<= 1)
+  {
+    const int half = len / 2;
+    const int step = n / len;
+    for(int start = 0; start < n; start += len)
+    {
+      for(int k = 0; k < half; k++)
+      {
+        const float wr = fft->twiddle[2 * k * step];
+        const float wi = sign * fft->twiddle[2 * k * step + 1];
+        float *const restrict ar = re + (size_t)(start + k) * n;
+        float *const restrict ai = im + (size_t)(start + k) * n;
+        float *const restrict br = re + (size_t)(start + k + half) * n;
+        float *const restrict bi = im + (size_t)(start + k + half) * n;
+        DT_OMP_SIMD()
+        for(int col = 0; col < n; col++)
+        {
+          const float tr = br[col] * wr - bi[col] * wi;
+          const float ti = br[col] * wi + bi[col] * wr;
+          br[col] = ar[col] - tr;
+          bi[col] = ai[col] - ti;
+          ar[col] += tr;
+          ai[col] += ti;
+        }
+      }
+    }
+  }
+}
+
+#define FFT_BLOCK 16
+
+static void _transpose(float *const restrict d,
+                       const int n)
+{
+  const int block = MIN(n, FFT_BLOCK);
+  for(int r0 = 0; r0 < n; r0 += block)
+  {
+    for(int c0 = r0; c0 < n; c0 += block)
+    {
+      for(int row = r0; row < r0 + block; row++)
+      {
+        for(int col = MAX(c0, row + 1); col < c0 + block; col++)
+        {
+          const float t = d[(size_t)row * n + col];
+          d[(size_t)row * n + col] = d[(size_t)col * n + row];
+          d[(size_t)col * n + row] = t;
+        }
+      }
+    }
+  }
+}
+
+#undef FFT_BLOCK
+
+void dt_fft_2d(const dt_fft_t *const fft,
+               float *const data,
+               const gboolean inverse)
+{
+  const int n = fft->n;
+  float *const re = data;
+  float *const im = data + (size_t)n * n;
+  _fft_columns(fft, re, im, inverse);
+  _transpose(re, n);
+  _transpose(im, n);
+  _fft_columns(fft, re, im, inverse);
+  _transpose(re, n);
+  _transpose(im, n);
+
+  if(inverse)
+  {
+    const float scale = 1.0f / ((float)n * n);
+    DT_OMP_SIMD()
+    for(size_t k = 0; k < 2 * (size_t)n * n; k++)
+      data[k] *= scale;
+  }
+}
+
+void dt_fft_symmetric_kernel(const dt_fft_t *const fft,
+                             const float *const coeffs,
+                             const int radius,
+                             const int stride,
+                             float *const spectrum,
+                             float *const scratch)
+{
+  const int n = fft->n;
+  memset(scratch, 0, sizeof(float) * 2 * n * n);
+  // wrapped around the origin, so the circular convolution is centred
+  for(int y = -radius; y <= radius; y++)
+    for(int x = -radius; x <= radius; x++)
+      scratch[(size_t)((y + n) % n) * n + (x + n) % n] = coeffs[ABS(y) * stride + ABS(x)];
+
+  dt_fft_2d(fft, scratch, FALSE);
+  // the imaginary part is zero apart from rounding
+  memcpy(spectrum, scratch, sizeof(float) * n * n);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
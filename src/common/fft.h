@@ -0,0 +1,65 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+G_BEGIN_DECLS
+
+/* A small radix-2 FFT for square tiles, meant for convolutions with small
+   even-symmetric kernels in overlap-save schemes.
+
+   - data is n x n complex in planar layout, the real parts followed by the
+     imaginary parts. It's transformed in place and single threaded so callers
+     can run one tile per thread.
+   - the spectrum of an even-symmetric kernel is real, so it's kept as n x n floats.
+   - as those spectra are real two real tiles can be convolved by a single
+     complex transform, one in the real and one in the imaginary part.
+*/
+typedef struct dt_fft_t
+{
+  int n;          // transform size per axis, a power of 2
+  float *twiddle; // n/2 complex roots of unity
+  int *bitrev;    // n bit reversed indices
+} dt_fft_t;
+
+dt_fft_t *dt_fft_new(const int n);
+void dt_fft_free(dt_fft_t *fft);
+
+// in place transform of 2 * n * n floats, the inverse is scaled by 1/n^2
+void dt_fft_2d(const dt_fft_t *const fft,
+               float *const data,
+               const gboolean inverse);
+
+// real spectrum of the even-symmetric kernel k(x, y) = coeffs[|y| * stride + |x|]
+// for |x|, |y| <= radius, scratch must hold 2 * n * n floats
+void dt_fft_symmetric_kernel(const dt_fft_t *const fft,
+                             const float *const coeffs,
+                             const int radius,
+                             const int stride,
+                             float *const spectrum,
+                             float *const scratch);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
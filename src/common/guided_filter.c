@@ -83,6 +83,8 @@ static inline float *_get_color_pixel(color_image img, size_t i)
 // for computational efficiency, we'll pack them into a four-channel image and a 9-channel image
 // image instead of running 13 separate box filters: guide+input, R/G/B/R-R/R-G/R-B/G-G/G-B/B-B.
 // make sure the tiles are always aligned for 16 floats
+// if coeffs is given the box filtered coefficients a_r, a_g, a_b and b are written there
+// instead of the filtered image
 static void _guided_filter_tiling(color_image imgg,
                                   gray_image img,
                                   gray_image img_out,
@@ -91,7 +93,8 @@ static void _guided_filter_tiling(color_image imgg,
                                   const float eps,
                                   const float guide_weight,
                                   const float min,
-                                  const float max)
+                                  const float max,
+                                  color_image *coeffs)
 {
   const int overlap = dt_round_size(3 * w, 16);
   const tile source = { MAX(target.left - overlap, 0),  MIN(target.right + overlap, imgg.width),
@@ -218,6 +221,19 @@ static void _guided_filter_tiling(color_image imgg,
 
   dt_box_mean(a_b.data, a_b.height, a_b.width, a_b.stride|BOXFILTER_KAHAN_SUM, w, 1);
 
+  if(coeffs)
+  {
+    DT_OMP_FOR(shared(target, a_b, coeffs) dt_omp_sharedconst(source))
+    for(int j_imgg = target.lower; j_imgg < target.upper; j_imgg++)
+    {
+      const size_t k = (target.left - source.left) + (size_t)(j_imgg - source.lower) * width;
+      memcpy(_get_color_pixel(*coeffs, target.left + (size_t)j_imgg * coeffs->width),
+             _get_color_pixel(a_b, k), sizeof(float) * 4 * (target.right - target.left));
+    }
+    _free_color_image(&mean);
+    return;
+  }
+
   DT_OMP_FOR(shared(target, imgg, a_b, img_out) dt_omp_sharedconst(source))
   for(int j_imgg = target.lower; j_imgg < target.upper; j_imgg++)
   {
@@ -266,11 +282,131 @@ void guided_filter(const float *const guide,
     {
       tile target = { i, MIN(i + tile_dim, width),
                       j, MIN(j + tile_dim, height) };
-      _guided_filter_tiling(img_guide, img_in, img_out, target, w, eps, guide_weight, min, max);
+      _guided_filter_tiling(img_guide, img_in, img_out, target, w, eps, guide_weight, min, max, NULL);
     }
   }
 }
 
+/*
+    Fast guided filter as described in
+
+    "Fast Guided Filter" by Kaiming He and Jian Sun, arXiv:1505.00996, 2015
+
+    The guide and the input are box-downsampled by subsample, the coefficients are computed
+    at that scale with a correspondingly smaller window and bilinearly upsampled. The result
+    is generated from the full resolution guide so edges are preserved as with the regular
+    filter.
+*/
+void fast_guided_filter(const float *const guide,
+                        const float *const in,
+                        float *const out,
+                        const int width,
+                        const int height,
+                        const int ch,
+                        const int w,
+                        const float sqrt_eps,
+                        const float guide_weight,
+                        const float min,
+                        const float max,
+                        const int subsample)
+{
+  assert(ch >= 3);
+  assert(w >= 1);
+
+  const int s = MAX(1, subsample);
+  if(s == 1)
+  {
+    guided_filter(guide, in, out, width, height, ch, w, sqrt_eps, guide_weight, min, max);
+    return;
+  }
+
+  const int ds_width = (width + s - 1) / s;
+  const int ds_height = (height + s - 1) / s;
+  const int ds_w = MAX(1, (w + s / 2) / s);
+  color_image ds_guide = _new_color_image(ds_width, ds_height, 4);
+  gray_image ds_in = new_gray_image(ds_width, ds_height);
+  color_image coeffs = _new_color_image(ds_width, ds_height, 4);
+  if(!ds_guide.data || !ds_in.data || !coeffs.data)
+  {
+    _free_color_image(&ds_guide);
+    free_gray_image(&ds_in);
+    _free_color_image(&coeffs);
+    guided_filter(guide, in, out, width, height, ch, w, sqrt_eps, guide_weight, min, max);
+    return;
+  }
+
+  // box downsampling, the blocks at the right and lower border might be smaller
+  DT_OMP_FOR(collapse(2))
+  for(int j = 0; j < ds_height; j++)
+  {
+    for(int i = 0; i < ds_width; i++)
+    {
+      dt_aligned_pixel_t sum = { 0.f, 0.f, 0.f, 0.f };
+      float sum_in = 0.f;
+      const int ymax = MIN(height, (j + 1) * s);
+      const int xmax = MIN(width, (i + 1) * s);
+      for(int y = j * s; y < ymax; y++)
+        for(int x = i * s; x < xmax; x++)
+        {
+          const size_t k = (size_t)y * width + x;
+          for_three_channels(c) sum[c] += guide[k * ch + c];
+          sum_in += in[k];
+        }
+      const float norm = 1.f / ((ymax - j * s) * (xmax - i * s));
+      float *px = _get_color_pixel(ds_guide, (size_t)j * ds_width + i);
+      for_three_channels(c) px[c] = sum[c] * norm;
+      px[3] = 0.f;
+      ds_in.data[(size_t)j * ds_width + i] = sum_in * norm;
+    }
+  }
+
+  const int tile_dim = MAX(dt_round_size(3 * ds_w, 16), GF_TILE_SIZE);
+  const float eps = sqrt_eps * sqrt_eps;
+  for(int j = 0; j < ds_height; j += tile_dim)
+  {
+    for(int i = 0; i < ds_width; i += tile_dim)
+    {
+      tile target = { i, MIN(i + tile_dim, ds_width),
+                      j, MIN(j + tile_dim, ds_height) };
+      _guided_filter_tiling(ds_guide, ds_in, ds_in, target, ds_w, eps, guide_weight, min, max, &coeffs);
+    }
+  }
+  _free_color_image(&ds_guide);
+  free_gray_image(&ds_in);
+
+  // bilinear upsampling of the coefficients, the centre of a block is the location of its
+  // coefficients
+  DT_OMP_FOR()
+  for(int y = 0; y < height; y++)
+  {
+    const float fy = CLAMP((y + 0.5f) / s - 0.5f, 0.f, (float)(ds_height - 1));
+    const int y0 = MIN((int)fy, ds_height - 1);
+    const int y1 = MIN(y0 + 1, ds_height - 1);
+    const float wy = fy - y0;
+    const float *row0 = _get_color_pixel(coeffs, (size_t)y0 * ds_width);
+    const float *row1 = _get_color_pixel(coeffs, (size_t)y1 * ds_width);
+    for(int x = 0; x < width; x++)
+    {
+      const float fx = CLAMP((x + 0.5f) / s - 0.5f, 0.f, (float)(ds_width - 1));
+      const int x0 = MIN((int)fx, ds_width - 1);
+      const int x1 = MIN(x0 + 1, ds_width - 1);
+      const float wx = fx - x0;
+      dt_aligned_pixel_t ab;
+      for_four_channels(c)
+      {
+        const float top = row0[4 * x0 + c] + wx * (row0[4 * x1 + c] - row0[4 * x0 + c]);
+        const float bottom = row1[4 * x0 + c] + wx * (row1[4 * x1 + c] - row1[4 * x0 + c]);
+        ab[c] = top + wy * (bottom - top);
+      }
+      const size_t k = (size_t)y * width + x;
+      const float *pixel = guide + k * ch;
+      const float res = guide_weight * (ab[0] * pixel[0] + ab[1] * pixel[1] + ab[2] * pixel[2]) + ab[3];
+      out[k] = CLAMP(res, min, max);
+    }
+  }
+  _free_color_image(&coeffs);
+}
+
 #ifdef HAVE_OPENCL
 
 dt_guided_filter_cl_global_t *dt_guided_filter_init_cl_global()
@@ -285,6 +421,10 @@ dt_guided_filter_cl_global_t *dt_guided_filter_init_cl_global()
   g->kernel_guided_filter_update_covariance = dt_opencl_create_kernel(program, "guided_filter_update_covariance");
   g->kernel_guided_filter_solve = dt_opencl_create_kernel(program, "guided_filter_solve");
   g->kernel_guided_filter_generate_result = dt_opencl_create_kernel(program, "guided_filter_generate_result");
+  g->kernel_guided_filter_downsample = dt_opencl_create_kernel(program, "guided_filter_downsample");
+  g->kernel_guided_filter_pack_coefficients = dt_opencl_create_kernel(program, "guided_filter_pack_coefficients");
+  g->kernel_guided_filter_generate_result_upsampled =
+    dt_opencl_create_kernel(program, "guided_filter_generate_result_upsampled");
   return g;
 }
 
@@ -301,6 +441,9 @@ void dt_guided_filter_free_cl_global(dt_guided_filter_cl_global_t *g)
   dt_opencl_free_kernel(g->kernel_guided_filter_update_covariance);
   dt_opencl_free_kernel(g->kernel_guided_filter_solve);
   dt_opencl_free_kernel(g->kernel_guided_filter_generate_result);
+  dt_opencl_free_kernel(g->kernel_guided_filter_downsample);
+  dt_opencl_free_kernel(g->kernel_guided_filter_pack_coefficients);
+  dt_opencl_free_kernel(g->kernel_guided_filter_generate_result_upsampled);
   free(g);
 }
 
@@ -459,6 +602,67 @@ static int _cl_generate_result(const int devid,
 }
 
 
+static int _cl_downsample(const int devid,
+                          const int width,
+                          const int height,
+                          const int s,
+                          const int ds_width,
+                          const int ds_height,
+                          cl_mem guide,
+                          cl_mem in,
+                          cl_mem ds_guide,
+                          cl_mem ds_in)
+{
+  const int kernel = darktable.opencl->guided_filter->kernel_guided_filter_downsample;
+  return dt_opencl_enqueue_kernel_2d_args(devid, kernel, ds_width, ds_height,
+                                          CLARG(width), CLARG(height), CLARG(s),
+                                          CLARG(ds_width), CLARG(ds_height),
+                                          CLARG(guide), CLARG(in), CLARG(ds_guide), CLARG(ds_in));
+}
+
+
+static int _cl_pack_coefficients(const int devid,
+                                 const int width,
+                                 const int height,
+                                 const int first,
+                                 const int dest,
+                                 cl_mem a_r,
+                                 cl_mem a_g,
+                                 cl_mem a_b,
+                                 cl_mem b,
+                                 cl_mem coeffs)
+{
+  const int kernel = darktable.opencl->guided_filter->kernel_guided_filter_pack_coefficients;
+  return dt_opencl_enqueue_kernel_2d_args(devid, kernel, width, height,
+                                          CLARG(width), CLARG(height), CLARG(first), CLARG(dest),
+                                          CLARG(a_r), CLARG(a_g), CLARG(a_b), CLARG(b), CLARG(coeffs));
+}
+
+
+static int _cl_generate_result_upsampled(const int devid,
+                                         const int width,
+                                         const int height,
+                                         const int s,
+                                         const int ds_width,
+                                         const int ds_height,
+                                         cl_mem guide,
+                                         cl_mem coeffs,
+                                         cl_mem out,
+                                         const float guide_weight,
+                                         const float min,
+                                         const float max)
+{
+  const int kernel = darktable.opencl->guided_filter->kernel_guided_filter_generate_result_upsampled;
+  return dt_opencl_enqueue_kernel_2d_args(devid, kernel, width, height,
+                                          CLARG(width), CLARG(height), CLARG(s),
+                                          CLARG(ds_width), CLARG(ds_height),
+                                          CLARG(guide), CLARG(coeffs), CLARG(out),
+                                          CLARG(guide_weight), CLARG(min), CLARG(max));
+}
+
+
+// if coeffs is given the box filtered coefficients a_r, a_g, a_b and b are written there
+// as a four channel image instead of the filtered image to dev_out
 static int _guided_filter_cl_impl(int devid,
                                   cl_mem guide,
                                   cl_mem dev_in,
@@ -469,7 +673,8 @@ static int _guided_filter_cl_impl(int devid,
                                   const float sqrt_eps,     // regularization parameter
                                   const float guide_weight, // to balance the amplitudes in the guiding and input image
                                   const float min,
-                                  const float max)
+                                  const float max,
+                                  cl_mem coeffs)
 {
   const float eps = sqrt_eps * sqrt_eps; // this is the regularization parameter of the original papers
 
@@ -502,7 +707,7 @@ static int _guided_filter_cl_impl(int devid,
   const int g_height = tiling ? tile_height : iheight;
 
   cl_mem in = tiling ? dt_opencl_alloc_device(devid, width, g_height, sizeof(float)) : dev_in;
-  cl_mem out = tiling ? dt_opencl_alloc_device(devid, width, g_height,  sizeof(float)) : dev_out;
+  cl_mem out = coeffs ? NULL : (tiling ? dt_opencl_alloc_device(devid, width, g_height,  sizeof(float)) : dev_out);
 
   cl_mem temp1 = dt_opencl_alloc_device(devid, width, g_height, sizeof(float));
   cl_mem temp2 = dt_opencl_alloc_device(devid, width, g_height, sizeof(float));
@@ -531,7 +736,7 @@ static int _guided_filter_cl_impl(int devid,
       || !var_imgg_rr || !var_imgg_gg || !var_imgg_bb
       || !var_imgg_rg || !var_imgg_rb || !var_imgg_gb
       || !a_r || !a_g || !a_b || !b
-      || !out || !in)
+      || (!out && !coeffs) || !in)
   {
     err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
     goto final;
@@ -610,9 +815,13 @@ static int _guided_filter_cl_impl(int devid,
       if(err == CL_SUCCESS) err = _cl_box_mean(devid, width, t_height, w, a_g, a_g, temp1);
       if(err == CL_SUCCESS) err = _cl_box_mean(devid, width, t_height, w, a_b, a_b, temp1);
       if(err == CL_SUCCESS) err = _cl_box_mean(devid, width, t_height, w, b, b, temp1);
-      if(err == CL_SUCCESS) err = _cl_generate_result(devid, width, t_height, first_in, guide, a_r, a_g, a_b, b, out, guide_weight, min, max);
+      if(coeffs)
+      {
+        if(err == CL_SUCCESS) err = _cl_pack_coefficients(devid, width, out_height, first_out, group, a_r, a_g, a_b, b, coeffs);
+      }
+      else if(err == CL_SUCCESS) err = _cl_generate_result(devid, width, t_height, first_in, guide, a_r, a_g, a_b, b, out, guide_weight, min, max);
 
-      if(err == CL_SUCCESS && tiling)
+      if(err == CL_SUCCESS && tiling && !coeffs)
       {
         size_t tsrc[]   = { 0, first_out, 0 };
         size_t odest[]  = { 0, group, 0 };
@@ -665,7 +874,8 @@ static int _guided_filter_cl_fallback(int devid,
                                       const float guide_weight, // to balance the amplitudes in the guiding image
                                                                 // and the input// image
                                       const float min,
-                                      const float max)
+                                      const float max,
+                                      const int subsample)
 {
   cl_int err = DT_OPENCL_SYSMEM_ALLOCATION;
   float *guide_host = dt_alloc_align_float(width * height * ch);
@@ -680,7 +890,8 @@ static int _guided_filter_cl_fallback(int devid,
   err = dt_opencl_copy_device_to_host(devid, in_host, in, width, height, sizeof(float));
   if(err != CL_SUCCESS) goto error;
 
-  guided_filter(guide_host, in_host, out_host, width, height, ch, w, sqrt_eps, guide_weight, min, max);
+  fast_guided_filter(guide_host, in_host, out_host, width, height, ch, w, sqrt_eps, guide_weight, min, max,
+                     subsample);
   err = dt_opencl_write_host_to_device(devid, out_host, out, width, height, sizeof(float));
 
 error:
@@ -708,10 +919,84 @@ int guided_filter_cl(int devid,
   assert(ch >= 3);
   assert(w >= 1);
 
-  cl_int err = _guided_filter_cl_impl(devid, guide, in, out, width, height, w, sqrt_eps, guide_weight, min, max);
+  cl_int err = _guided_filter_cl_impl(devid, guide, in, out, width, height, w, sqrt_eps, guide_weight, min, max, NULL);
+
+  if(err != CL_SUCCESS)
+    err = _guided_filter_cl_fallback(devid, guide, in, out, width, height, ch, w, sqrt_eps, guide_weight, min, max, 1);
+
+  return err;
+}
+
+// the steps of fast_guided_filter(), the coefficients are calculated by the regular
+// filter on the downsampled images
+static int _fast_guided_filter_cl_impl(int devid,
+                                       cl_mem guide,
+                                       cl_mem dev_in,
+                                       cl_mem dev_out,
+                                       const int width,
+                                       const int height,
+                                       const int w,
+                                       const float sqrt_eps,
+                                       const float guide_weight,
+                                       const float min,
+                                       const float max,
+                                       const int s)
+{
+  const int ds_width = (width + s - 1) / s;
+  const int ds_height = (height + s - 1) / s;
+  const int ds_w = MAX(1, (w + s / 2) / s);
+
+  cl_mem ds_guide = dt_opencl_alloc_device(devid, ds_width, ds_height, 4 * sizeof(float));
+  cl_mem ds_in = dt_opencl_alloc_device(devid, ds_width, ds_height, sizeof(float));
+  cl_mem coeffs = dt_opencl_alloc_device(devid, ds_width, ds_height, 4 * sizeof(float));
+
+  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+  if(!ds_guide || !ds_in || !coeffs) goto final;
+
+  err = _cl_downsample(devid, width, height, s, ds_width, ds_height, guide, dev_in, ds_guide, ds_in);
+  if(err == CL_SUCCESS)
+    err = _guided_filter_cl_impl(devid, ds_guide, ds_in, NULL, ds_width, ds_height, ds_w, sqrt_eps, guide_weight,
+                                 min, max, coeffs);
+  if(err == CL_SUCCESS)
+    err = _cl_generate_result_upsampled(devid, width, height, s, ds_width, ds_height, guide, coeffs, dev_out,
+                                        guide_weight, min, max);
+
+final:
+  if(err != CL_SUCCESS)
+    dt_print(DT_DEBUG_PIPE | DT_DEBUG_OPENCL, "[fast guided CL_%d filter] error %s", devid, cl_errstr(err));
+  dt_opencl_release_mem_object(ds_guide);
+  dt_opencl_release_mem_object(ds_in);
+  dt_opencl_release_mem_object(coeffs);
+  return err;
+}
+
+int fast_guided_filter_cl(int devid,
+                          cl_mem guide,
+                          cl_mem in,
+                          cl_mem out,
+                          const int width,
+                          const int height,
+                          const int ch,
+                          const int w,
+                          const float sqrt_eps,
+                          const float guide_weight,
+                          const float min,
+                          const float max,
+                          const int subsample)
+{
+  assert(ch >= 3);
+  assert(w >= 1);
+
+  const int s = MAX(1, subsample);
+  if(s == 1)
+    return guided_filter_cl(devid, guide, in, out, width, height, ch, w, sqrt_eps, guide_weight, min, max);
+
+  cl_int err = _fast_guided_filter_cl_impl(devid, guide, in, out, width, height, w, sqrt_eps, guide_weight,
+                                           min, max, s);
 
+  // the CPU code gives the same result, so no difference if we can't do it here
   if(err != CL_SUCCESS)
-    err = _guided_filter_cl_fallback(devid, guide, in, out, width, height, ch, w, sqrt_eps, guide_weight, min, max);
+    err = _guided_filter_cl_fallback(devid, guide, in, out, width, height, ch, w, sqrt_eps, guide_weight, min, max, s);
 
   return err;
 }
@@ -55,6 +55,11 @@ static inline void copy_gray_image(gray_image img1, gray_image img2)
 void guided_filter(const float *guide, const float *in, float *out, int width, int height, int ch, int w,
                    float sqrt_eps, float guide_weight, float min, float max);
 
+// same as guided_filter() but the coefficients are computed on a version of guide and in
+// downsampled by subsample, for large windows this is much faster and visually equivalent
+void fast_guided_filter(const float *guide, const float *in, float *out, int width, int height, int ch, int w,
+                        float sqrt_eps, float guide_weight, float min, float max, int subsample);
+
 #ifdef HAVE_OPENCL
 
 typedef struct dt_guided_filter_cl_global_t
@@ -67,6 +72,9 @@ typedef struct dt_guided_filter_cl_global_t
   int kernel_guided_filter_update_covariance;
   int kernel_guided_filter_solve;
   int kernel_guided_filter_generate_result;
+  int kernel_guided_filter_downsample;
+  int kernel_guided_filter_pack_coefficients;
+  int kernel_guided_filter_generate_result_upsampled;
 } dt_guided_filter_cl_global_t;
 
 
@@ -77,6 +85,10 @@ void dt_guided_filter_free_cl_global(dt_guided_filter_cl_global_t *g);
 int guided_filter_cl(int devid, cl_mem guide, cl_mem in, cl_mem out, int width, int height, int ch, int w,
                       float sqrt_eps, float guide_weight, float min, float max);
 
+// the OpenCL version of fast_guided_filter(), same results up to rounding
+int fast_guided_filter_cl(int devid, cl_mem guide, cl_mem in, cl_mem out, int width, int height, int ch, int w,
+                          float sqrt_eps, float guide_weight, float min, float max, int subsample);
+
 #endif
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
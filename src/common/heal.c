@@ -35,8 +35,9 @@
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
  * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * As an alternative, a multigrid solver runs V-cycles with red/black
+ * Gauss-Seidel smoothing, which converges in a few dozen cycles where
+ * the SOR loop needs thousands of iterations on large areas.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -331,34 +332,317 @@ static void _heal_laplace_loop(float *const restrict red_pixels, float *const re
   const float err_exit = epsilon * epsilon * w * w;
 
   /* Gauss-Seidel with successive over-relaxation */
-  for(int iter = 0; iter < max_iter; iter++)
+  double start = dt_get_wtime();
+  float err = 0.0f;
+  int iter = 0;
+  for(; iter < max_iter; iter++)
   {
     // process red/black cells separately
-    float err = _heal_laplace_iteration(black_pixels, red_pixels, height, subwidth, black_runs, num_black, 1, w);
+    err = _heal_laplace_iteration(black_pixels, red_pixels, height, subwidth, black_runs, num_black, 1, w);
     err += _heal_laplace_iteration(red_pixels, black_pixels, height, subwidth, red_runs, num_red, 0, w);
 
     if(err < err_exit) break;
   }
 
+  dt_print(DT_DEBUG_PERF,
+           "[heal] SOR %zux%zu, %d iterations, residual %g, took %0.04f sec",
+           width, height, iter, err / (w * w), dt_get_wtime() - start);
+
 cleanup:
   if(red_runs) dt_free_align(red_runs);
   if(black_runs) dt_free_align(black_runs);
 }
 
 
+// number of red/black Gauss-Seidel sweeps before and after the coarse grid correction
+#define HEAL_MG_SMOOTH 2
+// levels with a side smaller than this are solved by relaxation only
+#define HEAL_MG_COARSEST 16
+// sweeps used on the coarsest level
+#define HEAL_MG_COARSE_SWEEPS 64
+
+/* one level of the multigrid hierarchy, the finest level holds the difference
+ * image, the coarser ones the correction of the next finer level. pixels
+ * outside of the mask are Dirichlet boundary values and never change, the
+ * image borders are handled like in the SOR loop by dropping the missing
+ * neighbors.
+ */
+typedef struct _heal_level_t
+{
+  size_t width, height;
+  float *u;       // solution (finest level) or correction (coarser levels)
+  float *f;       // right hand side, NULL for zero
+  uint8_t *mask;  // unknowns of the equation
+} _heal_level_t;
+
+// sum of the four neighbors of pixel x,y and the number of them inside of the image
+static inline float _heal_mg_neighbors(const _heal_level_t *const lv,
+                                       const size_t x, const size_t y,
+                                       dt_aligned_pixel_t sum)
+{
+  const float *const u = lv->u;
+  const size_t width = lv->width;
+  const size_t k = 4 * (y * width + x);
+  float a = 0.0f;
+  for_each_channel(c) sum[c] = 0.0f;
+  if(x > 0)
+  {
+    for_each_channel(c) sum[c] += u[k - 4 + c];
+    a += 1.0f;
+  }
+  if(x + 1 < width)
+  {
+    for_each_channel(c) sum[c] += u[k + 4 + c];
+    a += 1.0f;
+  }
+  if(y > 0)
+  {
+    for_each_channel(c) sum[c] += u[k - 4 * width + c];
+    a += 1.0f;
+  }
+  if(y + 1 < lv->height)
+  {
+    for_each_channel(c) sum[c] += u[k + 4 * width + c];
+    a += 1.0f;
+  }
+  return a;
+}
+
+// one red/black Gauss-Seidel sweep over the unknowns of a level
+static void _heal_mg_relax(const _heal_level_t *const lv)
+{
+  for(int color = 0; color < 2; color++)
+  {
+    DT_OMP_FOR()
+    for(size_t y = 0; y < lv->height; y++)
+    {
+      for(size_t x = (y + color) & 1; x < lv->width; x += 2)
+      {
+        const size_t i = y * lv->width + x;
+        if(!lv->mask[i]) continue;
+        dt_aligned_pixel_t sum;
+        const float a = _heal_mg_neighbors(lv, x, y, sum);
+        if(lv->f)
+          for_each_channel(c) lv->u[4 * i + c] = (sum[c] + lv->f[4 * i + c]) / a;
+        else
+          for_each_channel(c) lv->u[4 * i + c] = sum[c] / a;
+      }
+    }
+  }
+}
+
+// residual f - Au at pixel x,y
+static inline void _heal_mg_residual_px(const _heal_level_t *const lv,
+                                        const size_t x, const size_t y,
+                                        dt_aligned_pixel_t r)
+{
+  const size_t i = y * lv->width + x;
+  dt_aligned_pixel_t sum;
+  const float a = _heal_mg_neighbors(lv, x, y, sum);
+  for_each_channel(c)
+    r[c] = (lv->f ? lv->f[4 * i + c] : 0.0f) - (a * lv->u[4 * i + c] - sum[c]);
+}
+
+// sum of the squared residuals, same measure as the error of the SOR loop
+static float _heal_mg_residual(const _heal_level_t *const lv)
+{
+  float err = 0.0f;
+  DT_OMP_FOR(reduction(+ : err))
+  for(size_t y = 0; y < lv->height; y++)
+  {
+    for(size_t x = 0; x < lv->width; x++)
+    {
+      if(!lv->mask[y * lv->width + x]) continue;
+      dt_aligned_pixel_t r;
+      _heal_mg_residual_px(lv, x, y, r);
+      err += r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+    }
+  }
+  return err;
+}
+
+// restrict the residual of the fine level into the right hand side of the coarse one.
+// a coarse pixel is unknown only if all of its fine pixels are, a coarse grid reaching
+// over the boundary overestimates the correction and makes the cycles diverge. the
+// coarse operator works on a grid spacing twice as large, so the residuals are summed
+// up instead of averaged.
+static void _heal_mg_restrict(const _heal_level_t *const fine, _heal_level_t *const coarse)
+{
+  DT_OMP_FOR()
+  for(size_t cy = 0; cy < coarse->height; cy++)
+  {
+    for(size_t cx = 0; cx < coarse->width; cx++)
+    {
+      const size_t ci = cy * coarse->width + cx;
+      dt_aligned_pixel_t f = { 0.0f, 0.0f, 0.0f, 0.0f };
+      uint8_t m = 1;
+      for(size_t y = 2 * cy; y < MIN(2 * cy + 2, fine->height); y++)
+        for(size_t x = 2 * cx; x < MIN(2 * cx + 2, fine->width); x++)
+        {
+          if(!fine->mask[y * fine->width + x])
+          {
+            m = 0;
+            continue;
+          }
+          dt_aligned_pixel_t r;
+          _heal_mg_residual_px(fine, x, y, r);
+          for_each_channel(c) f[c] += r[c];
+        }
+      copy_pixel(coarse->f + 4 * ci, f);
+      for_each_channel(c) coarse->u[4 * ci + c] = 0.0f;
+      coarse->mask[ci] = m;
+    }
+  }
+}
+
+// add the bilinear interpolated correction of the coarse level to the fine unknowns
+static void _heal_mg_prolong(const _heal_level_t *const coarse, const _heal_level_t *const fine)
+{
+  DT_OMP_FOR()
+  for(size_t y = 0; y < fine->height; y++)
+  {
+    const size_t cy = y / 2;
+    const size_t cy2 = (y & 1) ? MIN(cy + 1, coarse->height - 1) : (cy > 0 ? cy - 1 : 0);
+    for(size_t x = 0; x < fine->width; x++)
+    {
+      const size_t i = y * fine->width + x;
+      if(!fine->mask[i]) continue;
+      const size_t cx = x / 2;
+      const size_t cx2 = (x & 1) ? MIN(cx + 1, coarse->width - 1) : (cx > 0 ? cx - 1 : 0);
+      const float *const c00 = coarse->u + 4 * (cy * coarse->width + cx);
+      const float *const c01 = coarse->u + 4 * (cy * coarse->width + cx2);
+      const float *const c10 = coarse->u + 4 * (cy2 * coarse->width + cx);
+      const float *const c11 = coarse->u + 4 * (cy2 * coarse->width + cx2);
+      for_each_channel(c)
+        fine->u[4 * i + c] += (9.0f * c00[c] + 3.0f * (c01[c] + c10[c]) + c11[c]) / 16.0f;
+    }
+  }
+}
+
+static void _heal_mg_vcycle(_heal_level_t *const levels, const int l, const int nlevels)
+{
+  _heal_level_t *const lv = levels + l;
+  if(l == nlevels - 1)
+  {
+    for(int k = 0; k < HEAL_MG_COARSE_SWEEPS; k++) _heal_mg_relax(lv);
+    return;
+  }
+  for(int k = 0; k < HEAL_MG_SMOOTH; k++) _heal_mg_relax(lv);
+  _heal_mg_restrict(lv, levels + l + 1);
+  _heal_mg_vcycle(levels, l + 1, nlevels);
+  _heal_mg_prolong(levels + l + 1, lv);
+  for(int k = 0; k < HEAL_MG_SMOOTH; k++) _heal_mg_relax(lv);
+}
+
+// Solve the laplace equation for the 4 channel difference image with multigrid V-cycles, in-place.
+static void _heal_multigrid(float *const restrict pixels, const size_t width, const size_t height,
+                            const float *const restrict mask, const int max_iter)
+{
+  if(width * height < 2) return;
+
+  _heal_level_t levels[32] = { { 0 } };
+  int nlevels = 0;
+  size_t w = width, h = height;
+  gboolean ok = TRUE;
+  while(nlevels < 32)
+  {
+    _heal_level_t *const lv = levels + nlevels;
+    lv->width = w;
+    lv->height = h;
+    lv->mask = dt_alloc_align_type(uint8_t, w * h);
+    lv->u = nlevels ? dt_alloc_align_float(4 * w * h) : pixels;
+    lv->f = nlevels ? dt_alloc_align_float(4 * w * h) : NULL;
+    nlevels++;
+    if(!lv->mask || !lv->u || (nlevels > 1 && !lv->f))
+    {
+      ok = FALSE;
+      break;
+    }
+    if(MIN(w, h) < 2 * HEAL_MG_COARSEST) break;
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+  }
+
+  if(!ok)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "_heal_multigrid: error allocating memory for healing");
+    goto cleanup;
+  }
+
+  size_t nmask = 0;
+  DT_OMP_FOR_SIMD(reduction(+ : nmask))
+  for(size_t k = 0; k < width * height; k++)
+  {
+    levels[0].mask[k] = mask[k] != 0.0f;
+    nmask += mask[k] != 0.0f;
+  }
+  if(nmask == 0) goto cleanup;
+
+  // same convergence criterion as the SOR loop
+  const float epsilon = (0.1 / 255);
+  const float err_exit = epsilon * epsilon;
+
+  double start = dt_get_wtime();
+  float err = _heal_mg_residual(levels);
+  int iter = 0;
+  for(; iter < max_iter && err >= err_exit; iter++)
+  {
+    _heal_mg_vcycle(levels, 0, nlevels);
+    err = _heal_mg_residual(levels);
+  }
+
+  dt_print(DT_DEBUG_PERF,
+           "[heal] multigrid %zux%zu, %d levels, %d V-cycles, residual %g, took %0.04f sec",
+           width, height, nlevels, iter, err, dt_get_wtime() - start);
+
+cleanup:
+  for(int l = 0; l < nlevels; l++)
+  {
+    dt_free_align(levels[l].mask);
+    if(l) dt_free_align(levels[l].u);
+    dt_free_align(levels[l].f);
+  }
+}
+
 /* Original Algorithm Design:
  *
  * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
  * http://www.tgeorgiev.net/Photoshop_Healing.pdf
  */
 void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
-             const int height, const int ch, const int max_iter)
+             const int height, const int ch, const int max_iter, const dt_heal_solver_t solver)
 {
   if(ch != 4)
   {
     dt_print(DT_DEBUG_ALWAYS, "dt_heal: full-color image required");
     return;
   }
+
+  if(solver == DT_HEAL_SOLVER_MULTIGRID)
+  {
+    const size_t npixels = (size_t)width * height;
+    float *const restrict diff_buffer = dt_alloc_align_float(4 * npixels);
+    if(diff_buffer == NULL)
+    {
+      dt_print(DT_DEBUG_ALWAYS, "dt_heal: error allocating memory for healing");
+      return;
+    }
+
+    /* subtract pattern from image, solve and add the solution back */
+    DT_OMP_FOR_SIMD()
+    for(size_t k = 0; k < 4 * npixels; k++)
+      diff_buffer[k] = dest_buffer[k] - src_buffer[k];
+
+    _heal_multigrid(diff_buffer, width, height, mask_buffer, max_iter);
+
+    DT_OMP_FOR_SIMD()
+    for(size_t k = 0; k < 4 * npixels; k++)
+      dest_buffer[k] = diff_buffer[k] + src_buffer[k];
+
+    dt_free_align(diff_buffer);
+    return;
+  }
+
   const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
   float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
   float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
@@ -420,7 +704,7 @@ void dt_heal_free_cl(heal_params_cl_t *p)
 }
 
 cl_int dt_heal_cl(heal_params_cl_t *p, cl_mem dev_src, cl_mem dev_dest, const float *const mask_buffer,
-                  const int width, const int height, const int max_iter)
+                  const int width, const int height, const int max_iter, const dt_heal_solver_t solver)
 {
   cl_int err = DT_OPENCL_SYSMEM_ALLOCATION;
 
@@ -444,7 +728,7 @@ cl_int dt_heal_cl(heal_params_cl_t *p, cl_mem dev_src, cl_mem dev_dest, const fl
   if(err != CL_SUCCESS) goto cleanup;
 
   // I couldn't make it run fast on opencl (the reduction takes forever), so just call the cpu version
-  dt_heal(src_buffer, dest_buffer, mask_buffer, width, height, ch, max_iter);
+  dt_heal(src_buffer, dest_buffer, mask_buffer, width, height, ch, max_iter, solver);
 
   err = dt_opencl_write_buffer_to_device(p->devid, dest_buffer, dev_dest, 0, sizeof(float) * width * height * ch, CL_TRUE);
 
@@ -19,11 +19,18 @@
 #ifndef DT_DEVELOP_HEAL_H
 #define DT_DEVELOP_HEAL_H
 
+/* solver for the laplace equation of the healed area */
+typedef enum dt_heal_solver_t
+{
+  DT_HEAL_SOLVER_SOR = 0,       // red/black successive over-relaxation, max_iter iterations
+  DT_HEAL_SOLVER_MULTIGRID = 1  // multigrid, max_iter V-cycles
+} dt_heal_solver_t;
+
 /* heals dest_buffer using src_buffer as a reference and mask_buffer to define the area to be healed
  * the 3 buffers must have the same size, but mask_buffer is 1 channel and is tested for != 0.f
  */
 void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
-             const int height, const int ch, const int max_iter);
+             const int height, const int ch, const int max_iter, const dt_heal_solver_t solver);
 
 #ifdef HAVE_OPENCL
 
@@ -45,7 +52,7 @@ heal_params_cl_t *dt_heal_init_cl(const int devid);
 void dt_heal_free_cl(heal_params_cl_t *p);
 
 cl_int dt_heal_cl(heal_params_cl_t *p, cl_mem dev_src, cl_mem dev_dest, const float *const mask_buffer,
-                  const int width, const int height, const int max_iter);
+                  const int width, const int height, const int max_iter, const dt_heal_solver_t solver);
 
 #endif
 #endif
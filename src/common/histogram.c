@@ -30,22 +30,53 @@ typedef void((*_histogram_worker)(const dt_dev_histogram_collection_params_t *co
                                   const void *const restrict pixel,
                                   uint32_t *const restrict histogram,
                                   const int j,
+                                  const int col_offset,
                                   const dt_iop_order_iccprofile_info_t *const profile));
 
-static inline void _clamp_bin(const dt_aligned_pixel_t vals,
-                              uint32_t *const restrict histogram,
-                              const float max_bin)
+// number of pixels whose bins are computed in one go before they are
+// scattered into the histogram, small enough to stay in L1 cache
+#define HISTOGRAM_CHUNK 64
+
+// cheap integer hash used to pick the sampled pixel inside each cell
+// of sample_step x sample_step pixels, so that sampling does not alias
+// with regular image structures but stays reproducible
+static inline int _sample_jitter(const uint32_t v, const int step)
+{
+  if(step <= 1) return 0;
+  uint32_t h = v * 0x9E3779B1u;
+  h ^= h >> 15;
+  h *= 0x85EBCA77u;
+  h ^= h >> 13;
+  return h % step;
+}
+
+// first and number of pixels to sample in row j, and the distance between them
+static inline int _sample_row(const dt_dev_histogram_collection_params_t *const params,
+                              const int col_offset,
+                              int *first,
+                              int *step)
+{
+  const dt_histogram_roi_t *roi = params->roi;
+  const int width = roi->width - roi->crop_right - roi->crop_x;
+  *step = MAX(1, params->sample_step);
+  *first = roi->crop_x + MIN(col_offset, MAX(width - 1, 0));
+  return width > col_offset ? (width - col_offset + *step - 1) / *step : 0;
+}
+
+// the bins have been computed for a chunk of pixels (vectorized),
+// now increment them. channels are interleaved so that consecutive
+// increments do not hit the same cache line for the common case of
+// similar values in all channels.
+static inline void _scatter_bins(const uint32_t *const restrict bins,
+                                 const int n,
+                                 uint32_t *const restrict histogram)
 {
-  DT_ALIGNED_PIXEL size_t bin[4];
-  for_each_channel(k,aligned(vals,bin:16))
+  for(int i = 0; i < n; i++)
   {
-    // must be signed before clamping as value may be negative
-    bin[k] = CLAMP(vals[k], 0.0f, max_bin);
+    histogram[bins[4*i]*4]++;
+    histogram[bins[4*i+1]*4+1]++;
+    histogram[bins[4*i+2]*4+2]++;
   }
-
-  histogram[bin[0]*4]++;
-  histogram[bin[1]*4+1]++;
-  histogram[bin[2]*4+2]++;
 }
 
 //------------------------------------------------------------------------------
@@ -54,17 +85,20 @@ static inline void _bin_raw(const dt_dev_histogram_collection_params_t *const pa
                             const void *pixel,
                             uint32_t *histogram,
                             const int j,
+                            const int col_offset,
                             const dt_iop_order_iccprofile_info_t *const profile)
 {
   const dt_histogram_roi_t *roi = params->roi;
-  uint16_t *in = (uint16_t *)pixel + roi->width * j + roi->crop_x;
+  int first, step;
+  const int n = _sample_row(params, col_offset, &first, &step);
+  const uint16_t *in = (uint16_t *)pixel + (size_t)roi->width * j + first;
   const size_t max_bin = params->bins_count - 1;
 
-  for(int i = 0; i < roi->width - roi->crop_right - roi->crop_x; i++)
+  for(int i = 0; i < n; i++)
   {
     // WARNING: you must ensure that bins_count is big enough
     // e.g. 2^16 if you expect 16 bit raw files
-    histogram[MIN(in[i], max_bin)]++;
+    histogram[MIN(in[(size_t)i * step], max_bin)]++;
   }
 }
 
@@ -74,18 +108,28 @@ static inline void _bin_rgb(const dt_dev_histogram_collection_params_t *const pa
                             const void *const restrict pixel,
                             uint32_t *const restrict histogram,
                             const int j,
+                            const int col_offset,
                             const dt_iop_order_iccprofile_info_t *const profile)
 {
   const dt_histogram_roi_t *roi = params->roi;
-  float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
+  int first, step;
+  const int n = _sample_row(params, col_offset, &first, &step);
+  const float *const in = (float *)pixel + 4 * ((size_t)roi->width * j + first);
   const float max_bin = params->bins_count - 1;
 
-  for(int i = 0; i < roi->width - roi->crop_right - roi->crop_x; i++)
+  for(int c0 = 0; c0 < n; c0 += HISTOGRAM_CHUNK)
   {
-    dt_aligned_pixel_t b;
-    for_each_channel(k,aligned(in,b:16))
-      b[k] = max_bin * in[i*4+k];
-    _clamp_bin(b, histogram, max_bin);
+    const int cnt = MIN(HISTOGRAM_CHUNK, n - c0);
+    uint32_t DT_ALIGNED_ARRAY bins[4 * HISTOGRAM_CHUNK];
+    DT_OMP_SIMD(aligned(bins:64))
+    for(int i = 0; i < cnt; i++)
+    {
+      const float *px = in + (size_t)4 * step * (c0 + i);
+      for(int k = 0; k < 4; k++)
+        // must be signed before clamping as value may be negative
+        bins[4*i+k] = CLAMP(max_bin * px[k], 0.0f, max_bin);
+    }
+    _scatter_bins(bins, cnt, histogram);
   }
 }
 
@@ -94,18 +138,29 @@ static inline void _bin_rgb_compensated
    const void *const pixel,
    uint32_t *const restrict histogram,
    const int j,
+   const int col_offset,
    const dt_iop_order_iccprofile_info_t *const profile)
 {
   const dt_histogram_roi_t *roi = params->roi;
-  float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
+  int first, step;
+  const int n = _sample_row(params, col_offset, &first, &step);
+  const float *const in = (float *)pixel + 4 * ((size_t)roi->width * j + first);
   const float max_bin = params->bins_count - 1;
 
-  for(int i = 0; i < roi->width - roi->crop_right - roi->crop_x; i++)
+  for(int c0 = 0; c0 < n; c0 += HISTOGRAM_CHUNK)
   {
-    dt_aligned_pixel_t b;
-    for_each_channel(k,aligned(in,b:16))
-      b[k] = max_bin * dt_ioppr_compensate_middle_grey(in[i*4+k], profile);
-    _clamp_bin(b, histogram, max_bin);
+    const int cnt = MIN(HISTOGRAM_CHUNK, n - c0);
+    uint32_t DT_ALIGNED_ARRAY bins[4 * HISTOGRAM_CHUNK];
+    for(int i = 0; i < cnt; i++)
+    {
+      const float *px = in + (size_t)4 * step * (c0 + i);
+      dt_aligned_pixel_t b;
+      for_each_channel(k,aligned(b:16))
+        b[k] = max_bin * dt_ioppr_compensate_middle_grey(px[k], profile);
+      for_each_channel(k,aligned(b:16))
+        bins[4*i+k] = CLAMP(b[k], 0.0f, max_bin);
+    }
+    _scatter_bins(bins, cnt, histogram);
   }
 }
 
@@ -115,22 +170,31 @@ static inline void _bin_Lab(const dt_dev_histogram_collection_params_t *const pa
                             const void *const restrict pixel,
                             uint32_t *const restrict histogram,
                             const int j,
+                            const int col_offset,
                             const dt_iop_order_iccprofile_info_t *const profile)
 {
   const dt_histogram_roi_t *roi = params->roi;
-  float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
+  int first, step;
+  const int n = _sample_row(params, col_offset, &first, &step);
+  const float *const in = (float *)pixel + 4 * ((size_t)roi->width * j + first);
   const float max_bin = params->bins_count - 1;
   const dt_aligned_pixel_t scale = { max_bin / 100.0f,
                                      max_bin / 256.0f,
                                      max_bin / 256.0f, 0.0f };
   const dt_aligned_pixel_t shift = { 0.0f, 128.0f, 128.0f, 0.0f };
 
-  for(int i = 0; i < roi->width - roi->crop_right - roi->crop_x; i++)
+  for(int c0 = 0; c0 < n; c0 += HISTOGRAM_CHUNK)
   {
-    dt_aligned_pixel_t b;
-    for_each_channel(k,aligned(in,b,scale,shift:16))
-      b[k] = scale[k] * (in[i*4+k] + shift[k]);
-    _clamp_bin(b, histogram, max_bin);
+    const int cnt = MIN(HISTOGRAM_CHUNK, n - c0);
+    uint32_t DT_ALIGNED_ARRAY bins[4 * HISTOGRAM_CHUNK];
+    DT_OMP_SIMD(aligned(bins:64))
+    for(int i = 0; i < cnt; i++)
+    {
+      const float *px = in + (size_t)4 * step * (c0 + i);
+      for(int k = 0; k < 4; k++)
+        bins[4*i+k] = CLAMP(scale[k] * (px[k] + shift[k]), 0.0f, max_bin);
+    }
+    _scatter_bins(bins, cnt, histogram);
   }
 }
 
@@ -138,23 +202,30 @@ static inline void _bin_Lab_LCh(const dt_dev_histogram_collection_params_t *cons
                                 const void *const restrict pixel,
                                 uint32_t *const restrict histogram,
                                 const int j,
+                                const int col_offset,
                                 const dt_iop_order_iccprofile_info_t *const profile)
 {
   const dt_histogram_roi_t *roi = params->roi;
-  float *in = (float *)pixel + 4 * (roi->width * j + roi->crop_x);
+  int first, step;
+  const int n = _sample_row(params, col_offset, &first, &step);
+  const float *const in = (float *)pixel + 4 * ((size_t)roi->width * j + first);
   const float max_bin = params->bins_count - 1;
   const dt_aligned_pixel_t scale = { max_bin / 100.0f,
                                      max_bin / (128.0f * sqrtf(2.0f)),
                                      max_bin, 0.0f };
 
-  for(int i = 0; i < roi->width - roi->crop_right - roi->crop_x; i++)
+  for(int c0 = 0; c0 < n; c0 += HISTOGRAM_CHUNK)
   {
-    dt_aligned_pixel_t LCh = { 0.0f, 0.0f, 0.0f };
-    dt_aligned_pixel_t b;
-    dt_Lab_2_LCH(in + i*4, LCh);
-    for_each_channel(k,aligned(LCh,b,scale:16))
-      b[k] = scale[k] * LCh[k];
-    _clamp_bin(b, histogram, max_bin);
+    const int cnt = MIN(HISTOGRAM_CHUNK, n - c0);
+    uint32_t DT_ALIGNED_ARRAY bins[4 * HISTOGRAM_CHUNK];
+    for(int i = 0; i < cnt; i++)
+    {
+      dt_aligned_pixel_t LCh = { 0.0f, 0.0f, 0.0f };
+      dt_Lab_2_LCH(in + (size_t)4 * step * (c0 + i), LCh);
+      for_each_channel(k,aligned(LCh,scale:16))
+        bins[4*i+k] = CLAMP(scale[k] * LCh[k], 0.0f, max_bin);
+    }
+    _scatter_bins(bins, cnt, histogram);
   }
 }
 
@@ -180,21 +251,61 @@ void _hist_worker(dt_dev_histogram_collection_params_t *const histogram_params,
     if(!*histogram) return;
     histogram_stats->buf_size = buf_size;
   }
-  // hack to make reduction clause work
-  uint32_t DT_ALIGNED_PIXEL *working_hist = *histogram;
+  uint32_t *const restrict working_hist = *histogram;
   memset(working_hist, 0, buf_size);
 
+  // every thread bins into its own sub-histogram, they are merged at
+  // the end. this avoids the per-thread copies of an OpenMP array
+  // reduction on the stack which are far too large for the 65536 bins
+  // of raw histograms
+  size_t padded_size;
+  const size_t nthreads = dt_get_num_threads();
+  uint32_t *const partial = dt_alloc_perthread(bins_total, sizeof(uint32_t), &padded_size);
+  if(!partial) return;
+  memset(partial, 0, padded_size * nthreads * sizeof(uint32_t));
+
   const dt_histogram_roi_t *const roi = histogram_params->roi;
+  const int step = MAX(1, histogram_params->sample_step);
+  const int height = MAX(0, roi->height - roi->crop_bottom - roi->crop_y);
+  const int cells = (height + step - 1) / step;
 
-  DT_OMP_FOR(reduction(+:working_hist[:bins_total]))
-  for(int j = roi->crop_y; j < roi->height - roi->crop_bottom; j++)
+  DT_OMP_FOR()
+  for(int cell = 0; cell < cells; cell++)
   {
-    Worker(histogram_params, pixel, working_hist, j, profile_info);
+    // in sampling mode take one row of each band of 'step' rows, and
+    // one pixel of every 'step' pixels in that row
+    const int j = roi->crop_y + MIN(cell * step + _sample_jitter(2 * cell, step), height - 1);
+    const int col_offset = _sample_jitter(2 * cell + 1, step);
+    uint32_t *const restrict hist = dt_get_perthread(partial, padded_size);
+    Worker(histogram_params, pixel, hist, j, col_offset, profile_info);
   }
 
+  DT_OMP_FOR()
+  for(size_t k = 0; k < bins_total; k++)
+  {
+    uint32_t sum = 0;
+    for(size_t t = 0; t < nthreads; t++)
+      sum += partial[t * padded_size + k];
+    working_hist[k] = sum;
+  }
+  dt_free_align(partial);
+
   histogram_stats->bins_count = histogram_params->bins_count;
-  histogram_stats->pixels = (roi->width - roi->crop_right - roi->crop_x)
-                            * (roi->height - roi->crop_bottom - roi->crop_y);
+  histogram_stats->pixels = 0;
+  for(size_t k = 0; k < histogram_params->bins_count; k++)
+    histogram_stats->pixels += working_hist[k * (histogram_stats->ch == 1 ? 1 : 4)];
+}
+
+int dt_histogram_sample_step(const int width,
+                             const int height)
+{
+  // sampling error of a bin's relative frequency is at most
+  // 1/(2*sqrt(samples)), see histogram.h
+  const size_t pixels = (size_t)MAX(width, 0) * MAX(height, 0);
+  int step = 1;
+  while(pixels / ((size_t)(step + 1) * (step + 1)) >= DT_HISTOGRAM_MIN_SAMPLES)
+    step++;
+  return step;
 }
 
 //------------------------------------------------------------------------------
@@ -287,10 +398,10 @@ void dt_histogram_helper(dt_dev_histogram_collection_params_t *histogram_params,
 
   dt_print(DT_DEBUG_PERF,
             "histogram calculation %u bins %d -> %d"
-            " compensate %d %u channels %u pixels took %.3f secs (%.3f CPU)",
+            " compensate %d %u channels %u pixels (step %d) took %.3f secs (%.3f CPU)",
             histogram_params->bins_count, cst, cst_to,
             compensate_middle_grey && profile_info, histogram_stats->ch,
-            histogram_stats->pixels,
+            histogram_stats->pixels, MAX(1, histogram_params->sample_step),
             dt_get_lap_time(&start_time.clock), dt_get_lap_utime(&start_time.user));
 }
 
@@ -36,6 +36,23 @@ typedef struct dt_histogram_roi_t
   int width, height, crop_x, crop_y, crop_right, crop_bottom;
 } dt_histogram_roi_t;
 
+// minimum number of pixels binned when sampling a histogram, see
+// dt_histogram_sample_step()
+#define DT_HISTOGRAM_MIN_SAMPLES (1 << 18)
+
+// returns the sample_step to use in dt_dev_histogram_collection_params_t
+// for a histogram roi of the given size, so that at least
+// DT_HISTOGRAM_MIN_SAMPLES pixels are binned (1 for smaller images).
+//
+// one pixel at a pseudo-random but reproducible position is taken out
+// of each sample_step x sample_step cell (stratified sampling), so the
+// standard error of the relative frequency of any bin is bounded by
+// that of random sampling, 1 / (2 * sqrt(samples)), i.e. below 0.1% of
+// all pixels. this is meant for histograms only displayed in the GUI,
+// not for histograms statistics are derived from in the export pipe.
+int dt_histogram_sample_step(const int width,
+                             const int height);
+
 // allocates an aligned histogram buffer if needed, callers
 // (pixelpipe, exposure, global histogram) must garbage collect this
 // buffer via dt_free_align()
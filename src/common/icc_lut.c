@@ -0,0 +1,371 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/icc_lut.h"
+#include "common/colorspaces.h"
+#include "common/file_location.h"
+#include "common/math.h"
+#include "develop/imageop.h"
+
+#include <glib/gstdio.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* NOTES
+ *
+ * lcms runs LUT based profiles (print profiles, Lab based output profiles)
+ * through its generic pipeline which is slow. As we always go from Lab into
+ * the same profile with the same intent we sample that pipeline once into
+ * a 3D grid and interpolate inside of it. The grid is kept on disk so the
+ * sampling is done once per profile and intent.
+ *
+ * The accuracy is measured at the centers of a coarser set of cells, where
+ * the interpolation error is largest, by converting both the lcms and the
+ * interpolated result back to Lab.
+ */
+
+// bump if the sampling or the file layout change
+#define DT_ICC_LUT_VERSION 1
+// check points per axis for the accuracy report
+#define DT_ICC_LUT_CHECK 16
+
+typedef struct dt_icc_lut_header_t
+{
+  char magic[8];
+  int32_t version;
+  int32_t size;
+  float dE_mean;
+  float dE_max;
+} dt_icc_lut_header_t;
+
+dt_hash_t dt_icc_lut_hash(cmsHPROFILE profile, const int intent, const int size)
+{
+  cmsUInt32Number len = 0;
+  if(!cmsSaveProfileToMem(profile, NULL, &len) || len == 0) return DT_INVALID_HASH;
+
+  void *buf = g_malloc(len);
+  dt_hash_t hash = DT_INVALID_HASH;
+  if(cmsSaveProfileToMem(profile, buf, &len))
+  {
+    // another lcms may sample the profile differently
+    const int32_t key[4] = { DT_ICC_LUT_VERSION, LCMS_VERSION, intent, size };
+    hash = dt_hash(DT_INITHASH, buf, len);
+    hash = dt_hash(hash, key, sizeof(key));
+  }
+  g_free(buf);
+  return hash;
+}
+
+static void _lut_filename(const dt_hash_t hash, char *filename, const size_t len)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  snprintf(filename, len, "%s" G_DIR_SEPARATOR_S "icc_luts" G_DIR_SEPARATOR_S "%016" PRIx64 ".lut",
+           cachedir, hash);
+}
+
+static gboolean _lut_read(dt_icc_lut_t *lut, const dt_hash_t hash)
+{
+  char filename[PATH_MAX] = { 0 };
+  _lut_filename(hash, filename, sizeof(filename));
+
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return FALSE;
+
+  const size_t entries = (size_t)4 * lut->size * lut->size * lut->size;
+  dt_icc_lut_header_t header;
+  const gboolean ok = fread(&header, sizeof(header), 1, f) == 1
+    && !memcmp(header.magic, "dticclut", sizeof(header.magic))
+    && header.version == DT_ICC_LUT_VERSION
+    && header.size == lut->size
+    && fread(lut->clut, sizeof(float), entries, f) == entries;
+  fclose(f);
+
+  if(ok)
+  {
+    lut->dE_mean = header.dE_mean;
+    lut->dE_max = header.dE_max;
+  }
+  return ok;
+}
+
+static void _lut_write(const dt_icc_lut_t *lut, const dt_hash_t hash)
+{
+  char filename[PATH_MAX] = { 0 };
+  _lut_filename(hash, filename, sizeof(filename));
+
+  gchar *dirname = g_path_get_dirname(filename);
+  const int mkd = g_mkdir_with_parents(dirname, 0750);
+  g_free(dirname);
+  if(mkd) return;
+
+  FILE *f = g_fopen(filename, "wb");
+  if(!f) return;
+
+  const size_t entries = (size_t)4 * lut->size * lut->size * lut->size;
+  dt_icc_lut_header_t header = { .version = DT_ICC_LUT_VERSION, .size = lut->size,
+                                 .dE_mean = lut->dE_mean, .dE_max = lut->dE_max };
+  memcpy(header.magic, "dticclut", sizeof(header.magic));
+  const gboolean ok = fwrite(&header, sizeof(header), 1, f) == 1
+    && fwrite(lut->clut, sizeof(float), entries, f) == entries;
+  fclose(f);
+
+  // don't leave a truncated file behind
+  if(!ok)
+  {
+    g_unlink(filename);
+    dt_print(DT_DEBUG_ALWAYS, "[icc_lut] failed to write `%s'", filename);
+  }
+}
+
+// run the transform on npixels LabA pixels, lcms is serial per call so split in chunks
+static void _transform(cmsHTRANSFORM xform,
+                       const float *const in,
+                       float *const out,
+                       const size_t npixels)
+{
+  const size_t chunksize = dt_cacheline_chunks(npixels, dt_get_num_threads());
+  DT_OMP_FOR()
+  for(size_t chunkstart = 0; chunkstart < npixels; chunkstart += chunksize)
+  {
+    const size_t count = MIN(chunkstart + chunksize, npixels) - chunkstart;
+    cmsDoTransform(xform, in + 4 * chunkstart, out + 4 * chunkstart, count);
+  }
+}
+
+static void _sample(dt_icc_lut_t *lut, cmsHTRANSFORM xform, float *const Lab)
+{
+  const int size = lut->size;
+  const size_t entries = (size_t)size * size * size;
+  const float step = 1.0f / (size - 1);
+
+  DT_OMP_FOR(collapse(2))
+  for(int b = 0; b < size; b++)
+    for(int a = 0; a < size; a++)
+      for(int l = 0; l < size; l++)
+      {
+        float *const px = Lab + 4 * (((size_t)b * size + a) * size + l);
+        px[0] = 100.0f * l * step;
+        px[1] = -128.0f + 256.0f * a * step;
+        px[2] = -128.0f + 256.0f * b * step;
+        px[3] = 0.0f;
+      }
+
+  _transform(xform, Lab, lut->clut, entries);
+}
+
+// interpolate inside the cell of the lut, x is along L, y along a and z along b
+static inline void _tetrahedral(const float *const clut,
+                                const int size,
+                                const float x,
+                                const float y,
+                                const float z,
+                                dt_aligned_pixel_t out)
+{
+  const int x0 = MIN((int)x, size - 2);
+  const int y0 = MIN((int)y, size - 2);
+  const int z0 = MIN((int)z, size - 2);
+  const float fx = x - x0;
+  const float fy = y - y0;
+  const float fz = z - z0;
+
+  const size_t sx = 4;
+  const size_t sy = 4 * (size_t)size;
+  const size_t sz = 4 * (size_t)size * size;
+  const float *const c000 = clut + x0 * sx + y0 * sy + z0 * sz;
+  const float *const c111 = c000 + sx + sy + sz;
+
+  // the cell is split into 6 tetrahedra along its diagonal, each one has
+  // c000 and c111 plus two corners given by the order of the fractions
+  const float *c1, *c2;
+  float w0, w1, w2, w3;
+  if(fx > fy)
+  {
+    if(fy > fz)
+    {
+      c1 = c000 + sx;      c2 = c000 + sx + sy;
+      w0 = 1.0f - fx;      w1 = fx - fy;        w2 = fy - fz;  w3 = fz;
+    }
+    else if(fx > fz)
+    {
+      c1 = c000 + sx;      c2 = c000 + sx + sz;
+      w0 = 1.0f - fx;      w1 = fx - fz;        w2 = fz - fy;  w3 = fy;
+    }
+    else
+    {
+      c1 = c000 + sz;      c2 = c000 + sx + sz;
+      w0 = 1.0f - fz;      w1 = fz - fx;        w2 = fx - fy;  w3 = fy;
+    }
+  }
+  else
+  {
+    if(fz > fy)
+    {
+      c1 = c000 + sz;      c2 = c000 + sy + sz;
+      w0 = 1.0f - fz;      w1 = fz - fy;        w2 = fy - fx;  w3 = fx;
+    }
+    else if(fz > fx)
+    {
+      c1 = c000 + sy;      c2 = c000 + sy + sz;
+      w0 = 1.0f - fy;      w1 = fy - fz;        w2 = fz - fx;  w3 = fx;
+    }
+    else
+    {
+      c1 = c000 + sy;      c2 = c000 + sx + sy;
+      w0 = 1.0f - fy;      w1 = fy - fx;        w2 = fx - fz;  w3 = fz;
+    }
+  }
+
+  for_four_channels(c)
+    out[c] = w0 * c000[c] + w1 * c1[c] + w2 * c2[c] + w3 * c111[c];
+}
+
+void dt_icc_lut_apply_Lab(const dt_icc_lut_t *const lut,
+                          const float *const in,
+                          float *const out,
+                          const size_t npixels)
+{
+  const float *const clut = lut->clut;
+  const int size = lut->size;
+  const float max = size - 1;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+  {
+    const float *const px = in + 4 * k;
+    const float x = CLAMP(px[0] / 100.0f, 0.0f, 1.0f) * max;
+    const float y = CLAMP((px[1] + 128.0f) / 256.0f, 0.0f, 1.0f) * max;
+    const float z = CLAMP((px[2] + 128.0f) / 256.0f, 0.0f, 1.0f) * max;
+
+    dt_aligned_pixel_t rgb;
+    _tetrahedral(clut, size, x, y, z, rgb);
+    rgb[3] = px[3];
+    copy_pixel_nontemporal(out + 4 * k, rgb);
+  }
+  dt_omploop_sfence();
+}
+
+// dE76 between lcms and the lut at the centers of a coarse set of cells
+static void _measure(dt_icc_lut_t *lut, cmsHTRANSFORM xform, cmsHPROFILE profile)
+{
+  lut->dE_mean = lut->dE_max = -1.0f;
+
+  const cmsHPROFILE Lab_profile =
+    dt_colorspaces_get_profile(DT_COLORSPACE_LAB, "", DT_PROFILE_DIRECTION_ANY)->profile;
+  cmsHTRANSFORM back = cmsCreateTransform(profile, TYPE_RGBA_FLT, Lab_profile, TYPE_LabA_FLT,
+                                          INTENT_RELATIVE_COLORIMETRIC, 0);
+  if(!back) return;
+
+  const int n = DT_ICC_LUT_CHECK;
+  const size_t npixels = (size_t)n * n * n;
+  float *const Lab = dt_alloc_align_float(4 * npixels);
+  float *const ref = dt_alloc_align_float(4 * npixels);
+  float *const res = dt_alloc_align_float(4 * npixels);
+  if(Lab && ref && res)
+  {
+    for(int b = 0; b < n; b++)
+      for(int a = 0; a < n; a++)
+        for(int l = 0; l < n; l++)
+        {
+          float *const px = Lab + 4 * (((size_t)b * n + a) * n + l);
+          px[0] = 100.0f * (l + 0.5f) / n;
+          px[1] = -128.0f + 256.0f * (a + 0.5f) / n;
+          px[2] = -128.0f + 256.0f * (b + 0.5f) / n;
+          px[3] = 0.0f;
+        }
+
+    _transform(xform, Lab, ref, npixels);
+    dt_icc_lut_apply_Lab(lut, Lab, res, npixels);
+    _transform(back, ref, ref, npixels);
+    _transform(back, res, res, npixels);
+
+    double sum = 0.0;
+    float dE_max = 0.0f;
+    for(size_t k = 0; k < npixels; k++)
+    {
+      const float dE = sqrtf(sqf(ref[4 * k] - res[4 * k])
+                             + sqf(ref[4 * k + 1] - res[4 * k + 1])
+                             + sqf(ref[4 * k + 2] - res[4 * k + 2]));
+      sum += dE;
+      dE_max = fmaxf(dE_max, dE);
+    }
+    lut->dE_mean = sum / npixels;
+    lut->dE_max = dE_max;
+  }
+
+  dt_free_align(Lab);
+  dt_free_align(ref);
+  dt_free_align(res);
+  cmsDeleteTransform(back);
+}
+
+dt_icc_lut_t *dt_icc_lut_new(cmsHTRANSFORM xform,
+                             cmsHPROFILE profile,
+                             const dt_hash_t hash,
+                             const int size)
+{
+  if(!xform || size < 2) return NULL;
+
+  const double start = dt_get_debug_wtime();
+  dt_icc_lut_t *lut = malloc(sizeof(dt_icc_lut_t));
+  if(!lut) return NULL;
+  lut->size = size;
+  lut->clut = dt_alloc_align_float((size_t)4 * size * size * size);
+  lut->dE_mean = lut->dE_max = -1.0f;
+  if(!lut->clut)
+  {
+    free(lut);
+    return NULL;
+  }
+
+  const gboolean cached = hash != DT_INVALID_HASH && _lut_read(lut, hash);
+  if(!cached)
+  {
+    float *const Lab = dt_alloc_align_float((size_t)4 * size * size * size);
+    if(!Lab)
+    {
+      dt_icc_lut_free(lut);
+      return NULL;
+    }
+    _sample(lut, xform, Lab);
+    dt_free_align(Lab);
+
+    if(profile) _measure(lut, xform, profile);
+    if(hash != DT_INVALID_HASH) _lut_write(lut, hash);
+  }
+
+  dt_print(DT_DEBUG_PERF,
+           "[icc_lut] %s %d^3 lut, dE mean %.3f max %.3f, took %0.04f sec",
+           cached ? "loaded" : "sampled", size, lut->dE_mean, lut->dE_max,
+           dt_get_debug_wtime() - start);
+  return lut;
+}
+
+void dt_icc_lut_free(dt_icc_lut_t *lut)
+{
+  if(!lut) return;
+  dt_free_align(lut->clut);
+  free(lut);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
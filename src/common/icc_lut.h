@@ -0,0 +1,67 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+#include <lcms2.h>
+
+G_BEGIN_DECLS
+
+// grid points per axis of the sampled transforms
+#define DT_ICC_LUT_SIZE 65
+
+/* a lcms transform from Lab to RGB sampled into a regular grid over
+ * L [0, 100], a and b [-128, 128] and applied by tetrahedral interpolation.
+ * Only meant for LUT based profiles, those clip the Lab input to that
+ * range anyway, matrix profiles are unbounded and have their own path.
+ */
+typedef struct dt_icc_lut_t
+{
+  int size;       // grid points per axis
+  float *clut;    // size^3 RGBA entries, L varies fastest, then a, then b
+  float dE_mean;  // accuracy against the transform in dE76,
+  float dE_max;   // negative if it could not be measured
+} dt_icc_lut_t;
+
+// the key of the sampled transform from Lab into profile with intent, includes the lcms version
+dt_hash_t dt_icc_lut_hash(cmsHPROFILE profile, const int intent, const int size);
+
+// sample xform (TYPE_LabA_FLT to TYPE_RGBA_FLT, into profile) or load it from the
+// disk cache under hash. profile is used to measure the accuracy, NULL skips that.
+dt_icc_lut_t *dt_icc_lut_new(cmsHTRANSFORM xform,
+                             cmsHPROFILE profile,
+                             const dt_hash_t hash,
+                             const int size);
+
+void dt_icc_lut_free(dt_icc_lut_t *lut);
+
+// Lab to RGB of npixels 4 channel pixels, alpha is passed through
+void dt_icc_lut_apply_Lab(const dt_icc_lut_t *const lut,
+                          const float *const in,
+                          float *const out,
+                          const size_t npixels);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
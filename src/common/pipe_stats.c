@@ -0,0 +1,182 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/pipe_stats.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/noise_generator.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// key of the sample positions, fixed so estimates are reproducible
+#define DT_PIPE_STATS_SEED 0x5851f42du
+// entries kept in a cache
+#define DT_PIPE_STATS_CACHE_SIZE 16
+
+typedef struct dt_pipe_stats_entry_t
+{
+  dt_hash_t key;
+  float values[DT_PIPE_STATS_MAX_VALUES];
+} dt_pipe_stats_entry_t;
+
+size_t dt_pipe_stats_sample(const int width,
+                            const int height,
+                            const size_t n,
+                            size_t *const idx)
+{
+  const size_t size = (size_t)width * height;
+  if(size <= n)
+  {
+    for(size_t k = 0; k < size; k++) idx[k] = k;
+    return size;
+  }
+  if(n == 0) return 0;
+
+  // about square cells. Taking gh from n / gw keeps the number of cells at
+  // or below n also for very thin images and after rounding.
+  const double cell = sqrt((double)size / n);
+  const int gw = (int)CLAMP((size_t)(width / cell), 1, MIN((size_t)width, n));
+  const int gh = (int)CLAMP((size_t)(height / cell), 1, MIN((size_t)height, n / gw));
+
+  DT_OMP_FOR(collapse(2))
+  for(int gy = 0; gy < gh; gy++)
+    for(int gx = 0; gx < gw; gx++)
+    {
+      const size_t x0 = (size_t)gx * width / gw;
+      const size_t x1 = (size_t)(gx + 1) * width / gw;
+      const size_t y0 = (size_t)gy * height / gh;
+      const size_t y1 = (size_t)(gy + 1) * height / gh;
+      const uint64_t r = philox2x32(gx, gy, DT_PIPE_STATS_SEED);
+      const size_t x = x0 + (((r >> 32) * (x1 - x0)) >> 32);
+      const size_t y = y0 + (((r & 0xffffffffu) * (y1 - y0)) >> 32);
+      idx[(size_t)gy * gw + gx] = y * width + x;
+    }
+  return (size_t)gw * gh;
+}
+
+static int _compare_floats(const void *a, const void *b)
+{
+  const float fa = *(const float *)a;
+  const float fb = *(const float *)b;
+  return (fa > fb) - (fa < fb);
+}
+
+float dt_pipe_stats_quantile(float *const values,
+                             const size_t n,
+                             const float q)
+{
+  if(n == 0) return NAN;
+  qsort(values, n, sizeof(float), _compare_floats);
+  return values[MIN((size_t)(n * q), n - 1)];
+}
+
+float dt_pipe_stats_rank_error(const size_t n,
+                               const float delta)
+{
+  return n ? sqrtf(logf(2.0f / delta) / (2.0f * n)) : 1.0f;
+}
+
+void dt_pipe_stats_cache_init(dt_pipe_stats_cache_t *cache)
+{
+  dt_pthread_mutex_init(&cache->lock, NULL);
+  cache->entries = NULL;
+}
+
+void dt_pipe_stats_cache_cleanup(dt_pipe_stats_cache_t *cache)
+{
+  g_list_free_full(cache->entries, free);
+  cache->entries = NULL;
+  dt_pthread_mutex_destroy(&cache->lock);
+}
+
+dt_hash_t dt_pipe_stats_key(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_iop_t *piece,
+                            const dt_iop_roi_t *const roi_in)
+{
+  // the input of the module, so its own parameters don't invalidate the entry
+  dt_hash_t hash = dt_dev_hash_plus(self->dev, piece->pipe, self->iop_order,
+                                    DT_DEV_TRANSFORM_DIR_BACK_EXCL);
+  // no history hash, nothing to find the entry again by
+  if(hash == DT_INVALID_HASH) return DT_INVALID_HASH;
+  hash = dt_hash(hash, &piece->pipe->image.id, sizeof(piece->pipe->image.id));
+  hash = dt_hash(hash, &roi_in->x, sizeof(roi_in->x));
+  hash = dt_hash(hash, &roi_in->y, sizeof(roi_in->y));
+  hash = dt_hash(hash, &roi_in->width, sizeof(roi_in->width));
+  hash = dt_hash(hash, &roi_in->height, sizeof(roi_in->height));
+  hash = dt_hash(hash, &roi_in->scale, sizeof(roi_in->scale));
+  return hash;
+}
+
+gboolean dt_pipe_stats_cache_get(dt_pipe_stats_cache_t *cache,
+                                 const dt_hash_t key,
+                                 float *const values,
+                                 const int count)
+{
+  if(key == DT_INVALID_HASH || count > DT_PIPE_STATS_MAX_VALUES) return FALSE;
+
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&cache->lock);
+  for(GList *l = cache->entries; l; l = g_list_next(l))
+  {
+    dt_pipe_stats_entry_t *entry = l->data;
+    if(entry->key == key)
+    {
+      memcpy(values, entry->values, sizeof(float) * count);
+      cache->entries = g_list_remove_link(cache->entries, l);
+      cache->entries = g_list_concat(l, cache->entries);
+      found = TRUE;
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+  return found;
+}
+
+void dt_pipe_stats_cache_put(dt_pipe_stats_cache_t *cache,
+                             const dt_hash_t key,
+                             const float *const values,
+                             const int count)
+{
+  if(key == DT_INVALID_HASH || count > DT_PIPE_STATS_MAX_VALUES) return;
+
+  dt_pipe_stats_entry_t *entry = calloc(1, sizeof(dt_pipe_stats_entry_t));
+  if(!entry) return;
+  entry->key = key;
+  memcpy(entry->values, values, sizeof(float) * count);
+
+  dt_pthread_mutex_lock(&cache->lock);
+  cache->entries = g_list_prepend(cache->entries, entry);
+  GList *last = g_list_nth(cache->entries, DT_PIPE_STATS_CACHE_SIZE);
+  if(last)
+  {
+    last->prev->next = NULL;
+    last->prev = NULL;
+    g_list_free_full(last, free);
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
+#undef DT_PIPE_STATS_SEED
+#undef DT_PIPE_STATS_CACHE_SIZE
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,105 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+
+G_BEGIN_DECLS
+
+/* Approximate statistics of pipe buffers for the automatic estimators of
+   modules, like the ambient light of haze removal.
+
+   Instead of every pixel a stratified sample is used: the image is split
+   into a grid of about n cells and one pixel at a random but reproducible
+   position is taken from each cell.
+
+   Error bound: the empirical distribution of n independent samples is
+   within eps = sqrt(ln(2 / delta) / (2 n)) of the true distribution with
+   probability 1 - delta (Dvoretzky-Kiefer-Wolfowitz). So a quantile q
+   estimated from the samples lies between the true quantiles q - eps and
+   q + eps. Stratification only makes that tighter. For 2^18 samples and
+   delta = 1e-3 eps is 0.0038.
+
+   The estimates can be kept in a small cache, keyed by the image, the
+   history up to the module and the roi, so repeated runs on the same
+   input don't redo them. The cache lives in memory for the session only,
+   nothing is written to the library or the sidecar files.
+*/
+
+// default number of samples
+#define DT_PIPE_STATS_SAMPLES (1 << 18)
+// floats per cache entry
+#define DT_PIPE_STATS_MAX_VALUES 8
+
+struct dt_iop_module_t;
+struct dt_dev_pixelpipe_iop_t;
+struct dt_iop_roi_t;
+
+// fill idx with the linear indices of about n sampled pixels, idx must hold
+// n entries. If the image has no more than n pixels all of them are used.
+// Returns the number of samples.
+size_t dt_pipe_stats_sample(const int width,
+                            const int height,
+                            const size_t n,
+                            size_t *const idx);
+
+// the q quantile of the n values, sorts values in place. That is the value
+// at rank q * n as used by the full resolution estimators.
+float dt_pipe_stats_quantile(float *const values,
+                             const size_t n,
+                             const float q);
+
+// eps above for n samples, the bound on the error of estimated quantiles
+// in rank, holding with probability 1 - delta
+float dt_pipe_stats_rank_error(const size_t n,
+                               const float delta);
+
+typedef struct dt_pipe_stats_cache_t
+{
+  dt_pthread_mutex_t lock;
+  GList *entries; // most recently used first
+} dt_pipe_stats_cache_t;
+
+void dt_pipe_stats_cache_init(dt_pipe_stats_cache_t *cache);
+void dt_pipe_stats_cache_cleanup(dt_pipe_stats_cache_t *cache);
+
+// key of the statistics of the input of the module in piece for roi_in
+dt_hash_t dt_pipe_stats_key(struct dt_iop_module_t *self,
+                            struct dt_dev_pixelpipe_iop_t *piece,
+                            const struct dt_iop_roi_t *const roi_in);
+
+// copy count values stored under key, FALSE if there are none
+gboolean dt_pipe_stats_cache_get(dt_pipe_stats_cache_t *cache,
+                                 const dt_hash_t key,
+                                 float *const values,
+                                 const int count);
+
+void dt_pipe_stats_cache_put(dt_pipe_stats_cache_t *cache,
+                             const dt_hash_t key,
+                             const float *const values,
+                             const int count);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -270,13 +270,8 @@ static void _refine_with_detail_mask(dt_iop_module_t *self,
   dt_dev_pixelpipe_t *p = piece->pipe;
   if(p->scharr.data == NULL) goto error;
 
-  float *lum = dt_masks_calc_detail_mask(piece, threshold, detail);
-  if(lum == NULL) goto error;
-
-  // here we have the slightly blurred full detail mask available
-  float *warp_mask = dt_dev_distort_detail_mask(piece, lum, self);
-  dt_free_align(lum);
-
+  // the slightly blurred detail mask distorted to our roi, shared with the pipe
+  const float *warp_mask = dt_dev_get_detail_mask(piece, self, threshold, detail, DT_DEVICE_CPU);
   if(warp_mask == NULL) goto error;
 
   dt_print_pipe(DT_DEBUG_PIPE,
@@ -287,7 +282,7 @@ static void _refine_with_detail_mask(dt_iop_module_t *self,
   DT_OMP_FOR_SIMD(aligned(mask, warp_mask : 64))
   for(size_t idx =0; idx < msize; idx++)
     mask[idx] = mask[idx] * CLIP(warp_mask[idx]);
-  dt_free_align(warp_mask);
+  dt_dev_release_detail_mask(p, warp_mask);
 
   return;
 
@@ -357,6 +352,17 @@ static inline int _get_required_w(const float radius, const float scale)
   return MAX(1, (int)(2.0f * radius * scale + 0.5f));
 }
 
+// for large feathering windows the guided filter coefficients are calculated on a
+// downsampled mask, one pixel there covers an eighth of the window. The CPU and
+// OpenCL paths use the same subsampling so they give the same masks.
+#define DT_FEATHER_FAST_MIN_W 16
+#define DT_FEATHER_MAX_SUBSAMPLE 8
+
+static inline int _get_feather_subsample(const int w)
+{
+  return (w < DT_FEATHER_FAST_MIN_W) ? 1 : MIN(w / 8, DT_FEATHER_MAX_SUBSAMPLE);
+}
+
 /* Reminder: stability of the feathering guide filter depends on input data range
    and signal but also on the chose weight and eps.
 */
@@ -395,7 +401,8 @@ static void _develop_blend_process_feather(const float *const guide,
   if(mask_bak)
   {
     dt_iop_image_copy_by_size(mask_bak, mask, width, height, 1);
-    guided_filter(guide, mask_bak, mask, width, height, ch, w, sqrt_eps, guide_weight, 0.f, 1.f);
+    fast_guided_filter(guide, mask_bak, mask, width, height, ch, w, sqrt_eps, guide_weight, 0.f, 1.f,
+                       _get_feather_subsample(w));
     dt_free_align(mask_bak);
   }
 }
@@ -447,6 +454,36 @@ static const char *_develop_blend_colorspace_to_str(const dt_develop_blend_color
   }
 }
 
+// parametric-only masks without any post processing don't need a separate full-image pass for
+// the mask, the blendif code computes it row by row and blends while the rows are still in cache
+static gboolean _develop_blend_process_fused(dt_dev_pixelpipe_iop_t *piece,
+                                             const dt_develop_blend_colorspace_t blend_csp,
+                                             const void *const ivoid,
+                                             void *const ovoid,
+                                             const dt_iop_roi_t *const roi_in,
+                                             const dt_iop_roi_t *const roi_out,
+                                             const float fill,
+                                             float *const mask)
+{
+  switch(blend_csp)
+  {
+    case DEVELOP_BLEND_CS_LAB:
+      return dt_develop_blendif_lab_make_mask_and_blend(piece, (const float *const restrict)ivoid,
+                                                        (float *const restrict)ovoid,
+                                                        roi_in, roi_out, fill, mask);
+    case DEVELOP_BLEND_CS_RGB_DISPLAY:
+      return dt_develop_blendif_rgb_hsl_make_mask_and_blend(piece, (const float *const restrict)ivoid,
+                                                            (float *const restrict)ovoid,
+                                                            roi_in, roi_out, fill, mask);
+    case DEVELOP_BLEND_CS_RGB_SCENE:
+      return dt_develop_blendif_rgb_jzczhz_make_mask_and_blend(piece, (const float *const restrict)ivoid,
+                                                               (float *const restrict)ovoid,
+                                                               roi_in, roi_out, fill, mask);
+    default:
+      return FALSE;
+  }
+}
+
 void dt_develop_blend_process(dt_iop_module_t *self,
                               dt_dev_pixelpipe_iop_t *piece,
                               const void *const ivoid,
@@ -540,7 +577,25 @@ void dt_develop_blend_process(dt_iop_module_t *self,
 
   float *const restrict mask = _mask;
 
-  if(uniform)
+  // with nothing but a parametric mask, mask generation and blending are done in one pass
+  const gboolean drawn = mode_drawn && !(self->flags() & IOP_FLAGS_NO_MASKS);
+  const gboolean fused = !uniform && !raster && !drawn
+    && post_operations_size == 0
+    && feqf(d->details, 0.0f, 1e-6f)
+    && !(request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY)
+    && _develop_blend_process_fused(piece, blend_csp, ivoid, ovoid, roi_in, roi_out,
+                                    (d->mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f, mask);
+
+  if(fused)
+  {
+    dt_print_pipe(DT_DEBUG_PIPE,
+       "blend fused",
+       piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out, "%s, %s%s",
+       dt_iop_colorspace_to_name(cst),
+       _develop_blend_colorspace_to_str(blend_csp),
+       rois_equal ? "" : ", roi differ");
+  }
+  else if(uniform)
   {
     // blend uniformly (no drawn or parametric mask)
     dt_iop_image_fill(mask, opacity, owidth, oheight, 1); // mask[k] = value;
@@ -548,21 +603,19 @@ void dt_develop_blend_process(dt_iop_module_t *self,
   else if(raster)
   {
     /* use a raster mask from another module earlier in the pipe
-       dt_dev_get_raster_mask() sets a flag if the returned mask has been
-       distorted and thus must be deallocated by the caller
+       dt_dev_get_raster_mask() returns a mask shared with other modules
+       which must be handed back by the caller
     */
-    gboolean free_mask;
     float *raster_mask = dt_dev_get_raster_mask(piece,
                                                 self->raster_mask.sink.source,
                                                 self->raster_mask.sink.id,
-                                                self, &free_mask);
+                                                self);
     if(raster_mask)
     {
       dt_print_pipe(DT_DEBUG_PIPE,
          "blend raster",
-         piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out, "%s%s%s",
+         piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out, "%s%s",
          dt_iop_colorspace_to_name(cst),
-         free_mask ? " temp" : " permanent",
          d->raster_mask_invert ? " inverted" : "");
       // invert if required
       if(d->raster_mask_invert)
@@ -576,7 +629,7 @@ void dt_develop_blend_process(dt_iop_module_t *self,
         // mask[k] = opacity * raster_mask[k];
         dt_iop_image_scaled_copy(mask, raster_mask, opacity, owidth, oheight, 1);
       }
-      if(free_mask) dt_free_align(raster_mask);
+      dt_dev_release_raster_mask(piece->pipe, raster_mask);
       _refine_with_detail_mask(self, piece, mask, roi_in, roi_out, d->details);
     }
     else
@@ -657,7 +710,7 @@ void dt_develop_blend_process(dt_iop_module_t *self,
     }
   }
 
-  if(!uniform)
+  if(!uniform && !fused)
   {
     const float guide_weight = _get_guide_weight(piece);
     const float sqrt_eps = _get_feathering_eps(piece);
@@ -722,30 +775,33 @@ void dt_develop_blend_process(dt_iop_module_t *self,
 
   // now apply blending with per-pixel opacity value as defined in mask
   // select the blend operator
-  switch(blend_csp)
+  if(!fused)
   {
-    case DEVELOP_BLEND_CS_LAB:
-      dt_develop_blendif_lab_blend(piece, (const float *const restrict)ivoid,
-                                   (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_DISPLAY:
-      dt_develop_blendif_rgb_hsl_blend(piece, (const float *const restrict)ivoid,
-                                       (float *const restrict)ovoid,
-                                       roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_SCENE:
-      dt_develop_blendif_rgb_jzczhz_blend(piece, (const float *const restrict)ivoid,
-                                          (float *const restrict)ovoid,
-                                          roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RAW:
-      dt_develop_blendif_raw_blend(piece, (const float *const restrict)ivoid,
-                                   (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    default:
-      break;
+    switch(blend_csp)
+    {
+      case DEVELOP_BLEND_CS_LAB:
+        dt_develop_blendif_lab_blend(piece, (const float *const restrict)ivoid,
+                                     (float *const restrict)ovoid,
+                                     roi_in, roi_out, mask, request_mask_display);
+        break;
+      case DEVELOP_BLEND_CS_RGB_DISPLAY:
+        dt_develop_blendif_rgb_hsl_blend(piece, (const float *const restrict)ivoid,
+                                         (float *const restrict)ovoid,
+                                         roi_in, roi_out, mask, request_mask_display);
+        break;
+      case DEVELOP_BLEND_CS_RGB_SCENE:
+        dt_develop_blendif_rgb_jzczhz_blend(piece, (const float *const restrict)ivoid,
+                                            (float *const restrict)ovoid,
+                                            roi_in, roi_out, mask, request_mask_display);
+        break;
+      case DEVELOP_BLEND_CS_RAW:
+        dt_develop_blendif_raw_blend(piece, (const float *const restrict)ivoid,
+                                     (float *const restrict)ovoid,
+                                     roi_in, roi_out, mask, request_mask_display);
+        break;
+      default:
+        break;
+    }
   }
 
   // register if _this_ module should expose mask or display channel
@@ -781,11 +837,6 @@ static void _refine_with_detail_mask_cl(dt_iop_module_t *self,
 
   const gboolean detail = (level > 0.0f);
   const float threshold = _detail_mask_threshold(level, detail);
-  float *lum = NULL;
-  cl_mem tmp = NULL;
-  cl_mem blur = NULL;
-  cl_mem out = NULL;
-  cl_int err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
 
   dt_dev_pixelpipe_t *p = piece->pipe;
   if(p->scharr.data == NULL)
@@ -794,40 +845,16 @@ static void _refine_with_detail_mask_cl(dt_iop_module_t *self,
        "no detail data available", piece->pipe, self, devid, roi_in, roi_out);
     return;
   }
-  const int iwidth  = p->scharr.roi.width;
-  const int iheight = p->scharr.roi.height;
-
-  lum = dt_alloc_align_float((size_t)iwidth * iheight);
-  out = dt_opencl_alloc_device_buffer(devid, sizeof(float) * iwidth * iheight);
-  blur = dt_opencl_alloc_device_buffer(devid, sizeof(float) * iwidth * iheight);
-  if((lum == NULL) || (out == NULL) || (blur == NULL))
-    goto error;
-
-  err = dt_opencl_write_buffer_to_device(devid, p->scharr.data, out, 0, sizeof(float) * iwidth * iheight, TRUE);
-  if(err != CL_SUCCESS) goto error;
-
-  err = dt_opencl_enqueue_kernel_2d_args(devid, darktable.opencl->blendop->kernel_calc_blend, iwidth, iheight,
-          CLARG(out), CLARG(blur), CLARG(iwidth), CLARG(iheight), CLARG(threshold), CLARG(detail));
-  if(err != CL_SUCCESS) goto error;
-
-  err = dt_gaussian_fast_blur_cl_buffer(devid, blur, out, iwidth, iheight, 2.0f, 1, 0.0f, 1.0f);
-  if(err != CL_SUCCESS) goto error;
 
-  err = dt_opencl_read_buffer_from_device(devid, lum, out, 0, sizeof(float) * iwidth * iheight, TRUE);
-  if(err != CL_SUCCESS) goto error;
-
-  dt_opencl_release_mem_object(blur);
-  dt_opencl_release_mem_object(out);
-  out = NULL;
-  blur = NULL;
-
-  // here we have the slightly blurred full detail mask available
-  float *warp_mask = dt_dev_distort_detail_mask(piece, lum, self);
-  dt_free_align(lum);
+  // the slightly blurred detail mask distorted to our roi, shared with the pipe
+  const float *warp_mask = dt_dev_get_detail_mask(piece, self, threshold, detail, devid);
   if(warp_mask == NULL)
   {
-    err = DT_OPENCL_PROCESS_CL;
-    goto error;
+    dt_control_log(_("detail mask CL blending problem"));
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_OPENCL,
+       "refine with detail_mask",
+        piece->pipe, self, devid, roi_in, roi_out, "no mask available");
+    return;
   }
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE,
        "refine with detail mask", piece->pipe, self, devid, roi_in, roi_out);
@@ -837,18 +864,7 @@ static void _refine_with_detail_mask_cl(dt_iop_module_t *self,
   for(size_t idx = 0; idx < msize; idx++)
     mask[idx] = mask[idx] * CLIP(warp_mask[idx]);
 
-  dt_free_align(warp_mask);
-  return;
-
-  error:
-  dt_control_log(_("detail mask CL blending problem"));
-  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_OPENCL,
-       "refine with detail_mask",
-        piece->pipe, self, piece->pipe->devid, roi_in, roi_out, "OpenCL error: %s", cl_errstr(err));
-
-  dt_opencl_release_mem_object(tmp);
-  dt_opencl_release_mem_object(blur);
-  dt_opencl_release_mem_object(out);
+  dt_dev_release_detail_mask(p, warp_mask);
 }
 
 static inline void _blend_process_cl_exchange(cl_mem *a, cl_mem *b)
@@ -1050,23 +1066,20 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
   else if(raster)
   {
     /* use a raster mask from another module earlier in the pipe
-       dt_dev_get_raster_mask() sets a flag if the returned mask has been
-       distorted and thus must be deallocated by the caller
+       dt_dev_get_raster_mask() returns a mask shared with other modules
+       which must be handed back by the caller
     */
-    gboolean free_mask;
     float *raster_mask = dt_dev_get_raster_mask(piece,
                                                 self->raster_mask.sink.source,
                                                 self->raster_mask.sink.id,
-                                                self,
-                                                &free_mask);
+                                                self);
     if(raster_mask)
     {
       dt_print_pipe(DT_DEBUG_PIPE,
          "blend raster",
-        piece->pipe, self, piece->pipe->devid, roi_in, roi_out, "%s%s%s",
+        piece->pipe, self, piece->pipe->devid, roi_in, roi_out, "%s%s",
         dt_iop_colorspace_to_name(cst),
-        d->raster_mask_invert ? " inverted" : "",
-        free_mask ? " temp" : " permanent");
+        d->raster_mask_invert ? " inverted" : "");
       // invert if required
       if(d->raster_mask_invert)
       {
@@ -1079,7 +1092,7 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
         // mask[k] = opacity * raster_mask[k];
         dt_iop_image_scaled_copy(mask, raster_mask, opacity, owidth, oheight, 1);
       }
-      if(free_mask) dt_free_align(raster_mask);
+      dt_dev_release_raster_mask(piece->pipe, raster_mask);
       _refine_with_detail_mask_cl(self, piece, mask, roi_in, roi_out, d->details, devid);
     }
     else
@@ -1169,6 +1182,7 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
   {
     // post processing the mask (it will always be stored in dev_mask)
     const int featherw = _get_required_w(d->feathering_radius, roi_out->scale / piece->iscale);
+    const int subsample = _get_feather_subsample(featherw);
     const float sqrt_eps = _get_feathering_eps(piece);
     const float guide_weight = _get_guide_weight(piece);
 
@@ -1190,22 +1204,22 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
             dt_opencl_release_mem_object(dev_guide);
             goto error;
           }
-          err = guided_filter_cl(devid, dev_guide, dev_mask, dev_mask_2, owidth, oheight, ch,
-                            featherw, sqrt_eps, guide_weight, 0.0f, 1.0f);
+          err = fast_guided_filter_cl(devid, dev_guide, dev_mask, dev_mask_2, owidth, oheight, ch,
+                                      featherw, sqrt_eps, guide_weight, 0.0f, 1.0f, subsample);
           dt_opencl_release_mem_object(dev_guide);
           if(err != CL_SUCCESS) goto error;
         }
         else
         {
-          err = guided_filter_cl(devid, dev_in, dev_mask, dev_mask_2, owidth, oheight, ch,
-                            featherw, sqrt_eps, guide_weight, 0.0f, 1.0f);
+          err = fast_guided_filter_cl(devid, dev_in, dev_mask, dev_mask_2, owidth, oheight, ch,
+                                      featherw, sqrt_eps, guide_weight, 0.0f, 1.0f, subsample);
           if(err != CL_SUCCESS) goto error;
         }
       }
       else if(operation == DEVELOP_MASK_POST_FEATHER_OUT)
       {
-        err = guided_filter_cl(devid, dev_out, dev_mask, dev_mask_2, owidth, oheight, ch,
-                          featherw, sqrt_eps, guide_weight, 0.0f, 1.0f);
+        err = fast_guided_filter_cl(devid, dev_out, dev_mask, dev_mask_2, owidth, oheight, ch,
+                                    featherw, sqrt_eps, guide_weight, 0.0f, 1.0f, subsample);
         if(err != CL_SUCCESS) goto error;
       }
       else if(operation == DEVELOP_MASK_POST_BLUR)
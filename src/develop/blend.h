@@ -494,6 +494,34 @@ void dt_develop_blendif_rgb_jzczhz_blend(dt_dev_pixelpipe_iop_t *piece,
                                          const dt_dev_pixelpipe_display_mask_t request_mask_display);
 
 
+/** fused mask generation and blending for parametric-only masks: the mask is computed and applied
+ *  row by row in a single pass instead of separate full-image passes. 'fill' is the value the mask
+ *  would have been initialized with, 'mask' receives the final mask. returns FALSE without touching
+ *  the buffers if the case is not handled, the caller then has to use the separate passes. */
+gboolean dt_develop_blendif_lab_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                    const float *const a,
+                                                    float *const b,
+                                                    const dt_iop_roi_t *const roi_in,
+                                                    const dt_iop_roi_t *const roi_out,
+                                                    const float fill,
+                                                    float *const mask);
+
+gboolean dt_develop_blendif_rgb_hsl_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                        const float *const a,
+                                                        float *const b,
+                                                        const dt_iop_roi_t *const roi_in,
+                                                        const dt_iop_roi_t *const roi_out,
+                                                        const float fill,
+                                                        float *const mask);
+
+gboolean dt_develop_blendif_rgb_jzczhz_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                           const float *const a,
+                                                           float *const b,
+                                                           const dt_iop_roi_t *const roi_in,
+                                                           const dt_iop_roi_t *const roi_out,
+                                                           const float fill,
+                                                           float *const mask);
+
 /** gui related stuff */
 void dt_iop_gui_init_blending(GtkWidget *iopw, dt_iop_module_t *module);
 void dt_iop_gui_update_blending(dt_iop_module_t *module);
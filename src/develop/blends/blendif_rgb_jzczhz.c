@@ -253,6 +253,44 @@ static void _blendif_combine_channels(const float *const restrict pixels,
   }
 }
 
+// combine the per-channel factors of one row with the incoming mask value and the global opacity,
+// the same arithmetic as the last step of the full-image mask generation
+static inline void _blendif_apply_opacity_row(float *const restrict mask,
+                                              const float *const restrict temp_mask,
+                                              const float fill,
+                                              const size_t stride,
+                                              const unsigned int mask_inclusive,
+                                              const unsigned int mask_inversed,
+                                              const float global_opacity)
+{
+  if(mask_inclusive)
+  {
+    if(mask_inversed)
+    {
+      DT_OMP_SIMD(aligned(temp_mask: 16))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - fill) * temp_mask[x];
+    }
+    else
+    {
+      DT_OMP_SIMD(aligned(temp_mask: 16))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - (1.0f - fill) * temp_mask[x]);
+    }
+  }
+  else
+  {
+    if(mask_inversed)
+    {
+      DT_OMP_SIMD(aligned(temp_mask: 16))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - fill * temp_mask[x]);
+    }
+    else
+    {
+      DT_OMP_SIMD(aligned(temp_mask: 16))
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * fill * temp_mask[x];
+    }
+  }
+}
+
 void dt_develop_blendif_rgb_jzczhz_make_mask(dt_dev_pixelpipe_iop_t *piece,
                                              const float *const restrict a,
                                              const float *const restrict b,
@@ -1077,6 +1115,102 @@ void dt_develop_blendif_rgb_jzczhz_blend(dt_dev_pixelpipe_iop_t *piece,
   }
 }
 
+gboolean dt_develop_blendif_rgb_jzczhz_make_mask_and_blend(dt_dev_pixelpipe_iop_t *piece,
+                                                           const float *const restrict a,
+                                                           float *const restrict b,
+                                                           const dt_iop_roi_t *const roi_in,
+                                                           const dt_iop_roi_t *const roi_out,
+                                                           const float fill,
+                                                           float *const restrict mask)
+{
+  const dt_develop_blend_params_t *const d = piece->blendop_data;
+
+  if(piece->colors != DT_BLENDIF_RGB_CH) return FALSE;
+
+  const unsigned int any_channel_active = d->blendif & DEVELOP_BLENDIF_RGB_MASK;
+  const unsigned int mask_inclusive = d->mask_combine & DEVELOP_COMBINE_INCL;
+  const unsigned int mask_inversed = d->mask_combine & DEVELOP_COMBINE_INV;
+
+  // invert the individual channels if the combine mode is inclusive
+  const unsigned int blendif = d->blendif ^ (mask_inclusive ? DEVELOP_BLENDIF_RGB_MASK << 16 : 0);
+
+  // a channel cancels the mask if the whole span is selected and the channel is inverted
+  const unsigned int canceling_channel = (blendif >> 16) & ~blendif & DEVELOP_BLENDIF_RGB_MASK;
+
+  // only the case where all conditional channels have to be processed is fused, the other ones
+  // give a constant mask which is cheap to produce with the separate passes
+  if(!(d->mask_mode & DEVELOP_MASK_CONDITIONAL) || canceling_channel || !any_channel_active)
+    return FALSE;
+
+  const int xoffs = roi_out->x - roi_in->x;
+  const int yoffs = roi_out->y - roi_in->y;
+  const int iwidth = roi_in->width;
+  const size_t owidth = roi_out->width;
+  const size_t oheight = roi_out->height;
+  const size_t stride = owidth * DT_BLENDIF_RGB_CH;
+
+  // get the clipped opacity value  0 - 1
+  const float global_opacity = clamp_simd(d->opacity / 100.0f);
+
+  // only non-zero if mask_display was set by an _earlier_ module
+  const gboolean copy_mask = piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK;
+
+  // parameters, for every channel the 4 limits + pre-computed increasing slope and decreasing slope
+  float parameters[DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+  dt_develop_blendif_process_parameters(parameters, d);
+
+  dt_iop_order_iccprofile_info_t blend_profile;
+  if(!dt_develop_blendif_init_masking_profile(piece, &blend_profile, DEVELOP_BLEND_CS_RGB_SCENE))
+    return FALSE;
+  const dt_iop_order_iccprofile_info_t *profile = &blend_profile;
+
+  // one row of channel factors per thread instead of a full-image temporary mask
+  size_t padded_size;
+  float *const restrict temp_buf = dt_alloc_perthread_float(owidth, &padded_size);
+  if(!temp_buf) return FALSE;
+
+  const float p = exp2f(d->blend_parameter);
+  _blend_row_func *const blend = _choose_blend_func(d->blend_mode);
+  const gboolean reverse = (d->blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE;
+
+  DT_OMP_PRAGMA(parallel default(none)
+                dt_omp_firstprivate(temp_buf, padded_size, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs,
+                                    stride, blendif, profile, parameters, mask_inclusive, mask_inversed,
+                                    global_opacity, fill, blend, reverse, copy_mask, p))
+  {
+    float *const restrict temp_mask = dt_get_perthread(temp_buf, padded_size);
+
+    DT_OMP_PRAGMA(for schedule(static))
+    for(size_t y = 0; y < oheight; y++)
+    {
+      const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
+      const size_t b_start = y * stride;
+      float *const restrict row_mask = mask + y * owidth;
+
+      // flush denormals to zero to avoid performance penalty if there are a lot of zero values in the mask
+      const int oldMode = dt_mm_enable_flush_zero();
+      for(size_t x = 0; x < owidth; x++) temp_mask[x] = 1.0f;
+      _blendif_combine_channels(a + a_start, temp_mask, owidth, blendif, parameters, profile);
+      _blendif_combine_channels(b + b_start, temp_mask, owidth, blendif >> DEVELOP_BLENDIF_GRAY_out,
+                                parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out, profile);
+      _blendif_apply_opacity_row(row_mask, temp_mask, fill, owidth, mask_inclusive, mask_inversed,
+                                 global_opacity);
+      dt_mm_restore_flush_zero(oldMode);
+
+      // blend the row while input and output are still in cache
+      if(reverse)
+        blend(b + b_start, a + a_start, p, b + b_start, row_mask, owidth);
+      else
+        blend(a + a_start, b + b_start, p, b + b_start, row_mask, owidth);
+
+      if(copy_mask) _copy_mask(a + a_start, b + b_start, stride);
+    }
+  }
+
+  dt_free_align(temp_buf);
+  return TRUE;
+}
+
 // tools/update_modelines.sh
 // remove-trailing-space on;
 // clang-format off
@@ -51,6 +51,10 @@
 #endif
 
 #define DT_DEV_AVERAGE_DELAY_COUNT 5
+// progressive rendering: downscale of the low resolution pass and the
+// average processing time in ms of the full pipe that makes it worth it
+#define DT_DEV_PROGRESSIVE_SCALE 4
+#define DT_DEV_PROGRESSIVE_DELAY 200
 
 void dt_dev_init(dt_develop_t *dev,
                  const gboolean gui_attached)
@@ -294,6 +298,34 @@ static void _dev_average_delay_update(const dt_times_t *start,
                      - *average_delay / DT_DEV_AVERAGE_DELAY_COUNT);
 }
 
+// Decide whether a parameter change of the main darkroom pipe gets a low resolution
+// pass displayed before the full one. That pass runs in fast pipe mode and only uses
+// the swap cachelines, it must not leave state behind the full resolution pass would
+// pick up: the detail mask and raster masks are written at the scale of the pass.
+static gboolean _dev_progressive_pass(dt_develop_t *dev,
+                                      dt_dev_viewport_t *port,
+                                      dt_dev_pixelpipe_t *pipe,
+                                      const dt_dev_pixelpipe_change_t changed)
+{
+  if(port != &dev->full
+     || !(changed & (DT_DEV_PIPE_TOP_CHANGED | DT_DEV_PIPE_REMOVE | DT_DEV_PIPE_SYNCH))
+     || pipe->loading
+     || pipe->output_imgid != dev->image_storage.id
+     || pipe->want_detail_mask
+     || pipe->average_delay < DT_DEV_PROGRESSIVE_DELAY
+     || !dt_conf_get_bool("darkroom/ui/progressive_rendering"))
+    return FALSE;
+
+  for(const GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = nodes->data;
+    if(piece->enabled
+       && g_hash_table_size(piece->module->raster_mask.source.users) > 0)
+      return FALSE;
+  }
+  return TRUE;
+}
+
 void dt_dev_process_image_job(dt_develop_t *dev,
                               dt_dev_viewport_t *port,
                               dt_dev_pixelpipe_t *pipe,
@@ -407,6 +439,7 @@ restart:
   const gboolean changing = (pipe->changed != DT_DEV_PIPE_UNCHANGED) || initial;
   const gboolean port_loading = port && pipe->loading;
   const gboolean require_zoom_test = (pipe->changed & ~DT_DEV_PIPE_ZOOMED) || initial;
+  const dt_dev_pixelpipe_change_t changed = pipe->changed;
   initial = FALSE; // don't enforce dt_dev_pixelpipe_change() for restarts
 
   /* dt_dev_pixelpipe_change()
@@ -453,11 +486,35 @@ restart:
   const int x = port ? CLAMP(pipe_width  * (.5 + zoom_x) - wd / 2, 0, pipe_width  - wd) : 0;
   const int y = port ? CLAMP(pipe_height * (.5 + zoom_y) - ht / 2, 0, pipe_height - ht) : 0;
 
-  dt_get_times(&start);
-
   // keep error status of dt_dev_pixelpipe_process() for easy log code && check
   // for safe dt_control_queue_redraw_widget
-  const gboolean problem = dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid);
+  gboolean problem = FALSE;
+
+  // show a low resolution result first, a newer parameter change stops both passes
+  // via dt_iop_breakpoint() and we restart
+  if(_dev_progressive_pass(dev, port, pipe, changed))
+  {
+    const float cscale = scale / DT_DEV_PROGRESSIVE_SCALE;
+    const int cx = x / DT_DEV_PROGRESSIVE_SCALE;
+    const int cy = y / DT_DEV_PROGRESSIVE_SCALE;
+    const int cwd = MIN(wd / DT_DEV_PROGRESSIVE_SCALE + 2, (int)(cscale * pipe->processed_width) - cx);
+    const int cht = MIN(ht / DT_DEV_PROGRESSIVE_SCALE + 2, (int)(cscale * pipe->processed_height) - cy);
+
+    dt_get_times(&start);
+    pipe->progressive = TRUE;
+    problem = dt_dev_pixelpipe_process(pipe, dev, cx, cy, cwd, cht, cscale, devid);
+    pipe->progressive = FALSE;
+    dt_show_times_f(&start,
+                    "[dev_process_image] progressive pass", "%dx%d %s",
+                    cwd, cht, problem ? "problem" : "success");
+    if(!problem && port->widget)
+      dt_control_queue_redraw_widget(port->widget);
+  }
+
+  dt_get_times(&start);
+
+  if(!problem)
+    problem = dt_dev_pixelpipe_process(pipe, dev, x, y, wd, ht, scale, devid);
   const dt_dev_pixelpipe_stopper_t shutdown = dt_atomic_get_int(&pipe->shutdown);
   if(problem || shutdown)
     dt_print(DT_DEBUG_PIPE, "dt_dev_pixelpipe_process %dx%d x=%d y=%d %s%s",
@@ -3683,6 +3683,8 @@ void dt_iop_piece_set_raster(dt_dev_pixelpipe_iop_t *piece,
   // Note: technically we don't need the roi_in here at all; provided as we later want more work to be done here
   // possibly changing a rastermask to something else
   const gboolean new = g_hash_table_replace(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID), mask);
+  // distorted copies of the old mask are of no use any more
+  dt_dev_clear_raster_variants(piece->pipe, piece);
 
   // If we place a raster mask we must invalidate the following cachelines
   if(!new)
@@ -3698,6 +3700,7 @@ void dt_iop_piece_clear_raster(dt_dev_pixelpipe_iop_t *piece, float *mask)
 {
   if(g_hash_table_remove(piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID)))
   {
+    dt_dev_clear_raster_variants(piece->pipe, piece);
     dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MASKS,
         "delete raster mask", piece->pipe, piece->module, piece->pipe->devid, NULL, NULL);
     dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, piece->module->iop_order);
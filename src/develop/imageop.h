@@ -104,7 +104,9 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_CROP_EXPOSER = 1 << 16,      // offers crop exposing
   IOP_FLAGS_EXPAND_ROI_IN = 1 << 17,     // we might have to take special care about roi expansion
   IOP_FLAGS_WRITE_DETAILS = 1 << 18,     // provides the scharr mask used by details
-  IOP_FLAGS_WRITE_RASTER = 1 << 19       // modules not supporting blending might still advertise a raster mask
+  IOP_FLAGS_WRITE_RASTER = 1 << 19,      // modules not supporting blending might still advertise a raster mask
+  IOP_FLAGS_EXACT_LOCAL = 1 << 20        // output at a location depends only on the input within the tiling overlap,
+                                         // so any part of the roi can be reprocessed exactly. Needs ALLOW_TILING
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -625,6 +625,57 @@ void dt_masks_iop_combo_populate(GtkWidget *w,
 void dt_masks_iop_use_same_as(struct dt_iop_module_t *module,
                               struct dt_iop_module_t *src);
 dt_hash_t dt_masks_group_hash(dt_hash_t hash, dt_masks_form_t *form);
+/** same as above with the children of a group taken from the given list of forms */
+dt_hash_t dt_masks_group_hash_ext(dt_hash_t hash, GList *forms, dt_masks_form_t *form);
+
+/** per-pipe cache of rasterized shapes so that unchanged shapes are not rendered again on
+    every pipe run. the key covers the shape, the roi and all distortions up to the module,
+    DT_INVALID_HASH if the pipe doesn't cache. */
+dt_hash_t dt_masks_raster_hash(const struct dt_iop_module_t *const module,
+                               const dt_dev_pixelpipe_iop_t *const piece,
+                               dt_masks_form_t *const form,
+                               const dt_iop_roi_t *const roi);
+/** fills buffer (roi sized) with the cached raster for key, FALSE if there is none */
+gboolean dt_masks_raster_cache_lookup(dt_dev_pixelpipe_t *pipe,
+                                      const dt_hash_t key,
+                                      float *const buffer,
+                                      const int width,
+                                      const int height);
+/** keeps a copy of the non-zero part of buffer for later lookups */
+void dt_masks_raster_cache_insert(dt_dev_pixelpipe_t *pipe,
+                                  const dt_hash_t key,
+                                  const float *const buffer,
+                                  const int width,
+                                  const int height);
+void dt_masks_raster_cache_cleanup(dt_dev_pixelpipe_t *pipe);
+
+/** a ray of the falloff of paths and brushes from a point of the shape (x0,y0) to its border
+    point (x1,y1). the opacity is density up to hardness of the length, then fading out linearly.
+    the pixels at dx and dy next to each step are drawn as well to avoid gaps due to int rounding */
+typedef struct dt_masks_falloff_ray_t
+{
+  int x0, y0, x1, y1;
+  int dx, dy;
+  float hardness;
+  float density;
+} dt_masks_falloff_ray_t;
+
+/** fill the closed polygon (count x,y pairs in buffer coordinates) with 1.0 using the
+    even-odd rule. pixels of a row left open by a clipped polygon are filled up to xmax.
+    FALSE if we ran out of memory */
+gboolean dt_masks_fill_polygon(float *const buffer,
+                               const int width,
+                               const int height,
+                               const float *const points,
+                               const int count,
+                               const int xmax);
+/** draw the falloff rays into buffer, keeping the maximum of the existing values.
+    FALSE if we ran out of memory */
+gboolean dt_masks_falloff_rays(float *const buffer,
+                               const int width,
+                               const int height,
+                               const dt_masks_falloff_ray_t *const rays,
+                               const int count);
 
 void dt_masks_form_remove(struct dt_iop_module_t *module,
                           dt_masks_form_t *grp,
@@ -706,6 +757,12 @@ float *dt_masks_calc_scharr_mask(struct dt_dev_pixelpipe_t *pipe,
 float *dt_masks_calc_detail_mask(struct dt_dev_pixelpipe_iop_t *piece,
                                  const float threshold,
                                  const gboolean detail);
+#ifdef HAVE_OPENCL
+float *dt_masks_calc_detail_mask_cl(struct dt_dev_pixelpipe_iop_t *piece,
+                                    const float threshold,
+                                    const gboolean detail,
+                                    const int devid);
+#endif
 void dt_masks_calc_detail_blend(float *const src,
                                 float *out,
                                 const size_t msize,
@@ -77,11 +77,20 @@
   Now we have an unscaled detail mask which requires to be transformed
   through the pipeline using
 
-  float *dt_dev_distort_detail_mask(const dt_dev_pixelpipe_t *pipe, float *src, const dt_iop_module_t *target_module)
+  const float *dt_dev_get_detail_mask(dt_dev_pixelpipe_iop_t *piece,
+                                      const dt_iop_module_t *target_module,
+                                      const float threshold,
+                                      const gboolean detail,
+                                      const int devid)
 
-  returning a pointer to a distorted mask (DT) with same size as used
-  in the module wanting the refinement.  This DM is finally used to
-  refine the original mask.
+  returning a read-only pointer to a distorted mask (DT) with same size
+  as used in the module wanting the refinement.  This DM is finally used
+  to refine the original mask and handed back via dt_dev_release_detail_mask().
+
+  The pipe keeps the IM and the DTs for the recently used thresholds and
+  module positions. Stacked modules with the same threshold share the IM
+  and continue distorting from the DT of the module before them, the
+  cache is dropped whenever the SM is written again.
 
   All other refinements and parametric parameters are untouched.
 
@@ -205,6 +214,54 @@ float *dt_masks_calc_detail_mask(dt_dev_pixelpipe_iop_t *piece,
   return mask;
 }
 
+#ifdef HAVE_OPENCL
+float *dt_masks_calc_detail_mask_cl(dt_dev_pixelpipe_iop_t *piece,
+                                    const float threshold,
+                                    const gboolean detail,
+                                    const int devid)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  dt_dev_detail_mask_t *details = &pipe->scharr;
+
+  if(!details->data)
+    return NULL;
+
+  const int width = details->roi.width;
+  const int height = details->roi.height;
+  const size_t msize = (size_t)width * height;
+  cl_int err = DT_OPENCL_SYSMEM_ALLOCATION;
+  float *mask = dt_alloc_align_float(msize);
+  cl_mem out = dt_opencl_alloc_device_buffer(devid, sizeof(float) * msize);
+  cl_mem blur = dt_opencl_alloc_device_buffer(devid, sizeof(float) * msize);
+  if(!mask || !out || !blur) goto error;
+
+  err = dt_opencl_write_buffer_to_device(devid, details->data, out, 0, sizeof(float) * msize, TRUE);
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_enqueue_kernel_2d_args(devid, darktable.opencl->blendop->kernel_calc_blend, width, height,
+          CLARG(out), CLARG(blur), CLARG(width), CLARG(height), CLARG(threshold), CLARG(detail));
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_gaussian_fast_blur_cl_buffer(devid, blur, out, width, height, 2.0f, 1, 0.0f, 1.0f);
+  if(err != CL_SUCCESS) goto error;
+
+  err = dt_opencl_read_buffer_from_device(devid, mask, out, 0, sizeof(float) * msize, TRUE);
+
+  error:
+  if(err != CL_SUCCESS)
+  {
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_OPENCL,
+                  "calc detail mask CL", pipe, piece->module, devid, NULL, NULL,
+                  "OpenCL error: %s", cl_errstr(err));
+    dt_free_align(mask);
+    mask = NULL;
+  }
+  dt_opencl_release_mem_object(blur);
+  dt_opencl_release_mem_object(out);
+  return mask;
+}
+#endif
+
 
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
@@ -648,14 +648,22 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
   for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts))
   {
     dt_masks_point_group_t *fpt = fpts->data;
-    dt_masks_form_t *sel = dt_masks_get_from_id(module->dev, fpt->formid);
+    dt_masks_form_t *sel = dt_masks_get_from_id_ext(piece->pipe->forms, fpt->formid);
 
     if(sel)
     {
-      // ensure that we start with a zeroed buffer regardless of what
-      // was previously written into 'bufs'
-      memset(bufs, 0, npixels*sizeof(float));
-      const int ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+      // shapes which did not change since the last run are taken from the
+      // pipe's raster cache, only the modified ones are rendered again
+      const dt_hash_t key = dt_masks_raster_hash(module, piece, sel, roi);
+      int ok = dt_masks_raster_cache_lookup(piece->pipe, key, bufs, width, height);
+      if(!ok)
+      {
+        // ensure that we start with a zeroed buffer regardless of what
+        // was previously written into 'bufs'
+        memset(bufs, 0, npixels*sizeof(float));
+        ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+        if(ok) dt_masks_raster_cache_insert(piece->pipe, key, bufs, width, height);
+      }
       const float op = fpt->opacity;
       const int state = fpt->state;
 
@@ -741,7 +749,19 @@ int dt_masks_group_render_roi(dt_iop_module_t *module,
   if(!form) return 0;
 
   double start = dt_get_debug_wtime();
+
+  // nothing changed in the whole group, no need to combine the shapes again
+  const dt_hash_t key = dt_masks_raster_hash(module, piece, form, roi);
+  if(dt_masks_raster_cache_lookup(piece->pipe, key, buffer, roi->width, roi->height))
+  {
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+             "[masks] cached masks took %0.04f sec",
+             dt_get_lap_time(&start));
+    return 1;
+  }
+
   const int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+  if(ok) dt_masks_raster_cache_insert(piece->pipe, key, buffer, roi->width, roi->height);
 
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
            "[masks] render all masks took %0.04f sec",
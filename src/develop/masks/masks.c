@@ -2024,7 +2024,7 @@ void dt_masks_group_ungroup(dt_masks_form_t *dest_grp,
   }
 }
 
-dt_hash_t dt_masks_group_hash(dt_hash_t hash, dt_masks_form_t *form)
+dt_hash_t dt_masks_group_hash_ext(dt_hash_t hash, GList *forms, dt_masks_form_t *form)
 {
   if(!form) return hash;
   // basic infos
@@ -2033,28 +2033,186 @@ dt_hash_t dt_masks_group_hash(dt_hash_t hash, dt_masks_form_t *form)
   hash = dt_hash(hash, &form->version, sizeof(int));
   hash = dt_hash(hash, &form->source, sizeof(float) * 2);
 
-  for(const GList *forms = form->points; forms; forms = g_list_next(forms))
+  for(const GList *points = form->points; points; points = g_list_next(points))
   {
     if(form->type & DT_MASKS_GROUP)
     {
-      const dt_masks_point_group_t *grpt = forms->data;
-      dt_masks_form_t *f = dt_masks_get_from_id(darktable.develop, grpt->formid);
+      const dt_masks_point_group_t *grpt = points->data;
+      dt_masks_form_t *f = dt_masks_get_from_id_ext(forms, grpt->formid);
       if(f)
       {
         // state & opacity
         hash = dt_hash(hash, &grpt->state, sizeof(int));
         hash = dt_hash(hash, &grpt->opacity, sizeof(float));
-        hash = dt_masks_group_hash(hash, f);
+        hash = dt_masks_group_hash_ext(hash, forms, f);
       }
     }
     else if(form->functions)
     {
-      hash = dt_hash(hash, forms->data, form->functions->point_struct_size);
+      hash = dt_hash(hash, points->data, form->functions->point_struct_size);
     }
   }
   return hash;
 }
 
+dt_hash_t dt_masks_group_hash(dt_hash_t hash, dt_masks_form_t *form)
+{
+  return dt_masks_group_hash_ext(hash, darktable.develop->forms, form);
+}
+
+// upper limit for the memory used by the rasterized shapes of one pipe
+#define DT_MASKS_RASTER_CACHE_SIZE ((size_t)128 << 20)
+
+// a rasterized shape, only the bounding box of the non-zero pixels is stored as most
+// shapes (think brush strokes) cover a small part of the roi
+typedef struct dt_masks_raster_t
+{
+  dt_hash_t key;
+  int x, y, width, height;
+  float *data;
+} dt_masks_raster_t;
+
+static void _raster_free(dt_masks_raster_t *raster)
+{
+  dt_free_align(raster->data);
+  free(raster);
+}
+
+static size_t _raster_size(const dt_masks_raster_t *const raster)
+{
+  return sizeof(dt_masks_raster_t) + sizeof(float) * raster->width * raster->height;
+}
+
+dt_hash_t dt_masks_raster_hash(const dt_iop_module_t *const module,
+                               const dt_dev_pixelpipe_iop_t *const piece,
+                               dt_masks_form_t *const form,
+                               const dt_iop_roi_t *const roi)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  // only the darkroom pipes are run again and again with mostly the same shapes
+  if(!form || !(pipe->type & DT_DEV_PIXELPIPE_SCREEN)) return DT_INVALID_HASH;
+
+  // shapes are transformed by all distorting modules up to and including this one
+  const dt_hash_t distort = dt_dev_hash_distort_plus(module->dev, pipe, module->iop_order,
+                                                     DT_DEV_TRANSFORM_DIR_BACK_INCL);
+  if(distort == DT_INVALID_HASH) return DT_INVALID_HASH;
+
+  // the pipe renders its own copy of the forms, the children are taken from there too
+  dt_hash_t hash = dt_masks_group_hash_ext(distort, pipe->forms, form);
+  hash = dt_hash(hash, roi, sizeof(dt_iop_roi_t));
+  hash = dt_hash(hash, &module->iop_order, sizeof(module->iop_order));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  return hash;
+}
+
+gboolean dt_masks_raster_cache_lookup(dt_dev_pixelpipe_t *pipe,
+                                      const dt_hash_t key,
+                                      float *const buffer,
+                                      const int width,
+                                      const int height)
+{
+  if(key == DT_INVALID_HASH) return FALSE;
+
+  dt_pthread_mutex_lock(&pipe->mask_rasters_mutex);
+  GList *l = pipe->mask_rasters;
+  while(l && ((dt_masks_raster_t *)l->data)->key != key)
+    l = g_list_next(l);
+
+  if(!l)
+  {
+    dt_pthread_mutex_unlock(&pipe->mask_rasters_mutex);
+    return FALSE;
+  }
+
+  // most recently used first
+  pipe->mask_rasters = g_list_remove_link(pipe->mask_rasters, l);
+  pipe->mask_rasters = g_list_concat(l, pipe->mask_rasters);
+
+  const dt_masks_raster_t *const raster = l->data;
+  memset(buffer, 0, sizeof(float) * width * height);
+  DT_OMP_FOR()
+  for(int y = 0; y < raster->height; y++)
+    memcpy(buffer + (size_t)(raster->y + y) * width + raster->x,
+           raster->data + (size_t)y * raster->width,
+           sizeof(float) * raster->width);
+
+  dt_pthread_mutex_unlock(&pipe->mask_rasters_mutex);
+  return TRUE;
+}
+
+void dt_masks_raster_cache_insert(dt_dev_pixelpipe_t *pipe,
+                                  const dt_hash_t key,
+                                  const float *const buffer,
+                                  const int width,
+                                  const int height)
+{
+  if(key == DT_INVALID_HASH) return;
+
+  // bounding box of the non-zero part
+  int xmin = width, ymin = height, xmax = -1, ymax = -1;
+  DT_OMP_FOR(reduction(min : xmin, ymin) reduction(max : xmax, ymax))
+  for(int y = 0; y < height; y++)
+  {
+    const float *const row = buffer + (size_t)y * width;
+    int x0 = 0;
+    while(x0 < width && row[x0] == 0.0f) x0++;
+    if(x0 == width) continue;
+    int x1 = width - 1;
+    while(row[x1] == 0.0f) x1--;
+    xmin = MIN(xmin, x0);
+    xmax = MAX(xmax, x1);
+    ymin = MIN(ymin, y);
+    ymax = MAX(ymax, y);
+  }
+
+  dt_masks_raster_t *raster = calloc(1, sizeof(dt_masks_raster_t));
+  if(!raster) return;
+  raster->key = key;
+  if(xmax >= 0)
+  {
+    raster->x = xmin;
+    raster->y = ymin;
+    raster->width = xmax - xmin + 1;
+    raster->height = ymax - ymin + 1;
+    raster->data = dt_alloc_align_float((size_t)raster->width * raster->height);
+    if(!raster->data || _raster_size(raster) > DT_MASKS_RASTER_CACHE_SIZE / 2)
+    {
+      _raster_free(raster);
+      return;
+    }
+    DT_OMP_FOR()
+    for(int y = 0; y < raster->height; y++)
+      memcpy(raster->data + (size_t)y * raster->width,
+             buffer + (size_t)(raster->y + y) * width + raster->x,
+             sizeof(float) * raster->width);
+  }
+
+  dt_pthread_mutex_lock(&pipe->mask_rasters_mutex);
+  pipe->mask_rasters = g_list_prepend(pipe->mask_rasters, raster);
+  pipe->mask_rasters_size += _raster_size(raster);
+  // drop the least recently used rasters, shapes which changed end up there
+  while(pipe->mask_rasters_size > DT_MASKS_RASTER_CACHE_SIZE)
+  {
+    GList *last = g_list_last(pipe->mask_rasters);
+    dt_masks_raster_t *old = last->data;
+    pipe->mask_rasters_size -= _raster_size(old);
+    pipe->mask_rasters = g_list_delete_link(pipe->mask_rasters, last);
+    _raster_free(old);
+  }
+  dt_pthread_mutex_unlock(&pipe->mask_rasters_mutex);
+}
+
+void dt_masks_raster_cache_cleanup(dt_dev_pixelpipe_t *pipe)
+{
+  dt_pthread_mutex_lock(&pipe->mask_rasters_mutex);
+  g_list_free_full(pipe->mask_rasters, (GDestroyNotify)_raster_free);
+  pipe->mask_rasters = NULL;
+  pipe->mask_rasters_size = 0;
+  dt_pthread_mutex_unlock(&pipe->mask_rasters_mutex);
+}
+
 // adds formid to used array
 // if formid is a group it adds all the forms that belongs to that group
 static void _cleanup_unused_recurs(GList *forms,
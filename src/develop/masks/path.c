@@ -3129,35 +3129,81 @@ static int _path_get_area(const dt_iop_module_t *const module,
   return _get_area(module, piece, form, width, height, posx, posy, FALSE);
 }
 
-/** we write a falloff segment */
-static void _path_falloff(float *const restrict buffer,
-                          int *p0,
-                          int *p1,
-                          const int posx,
-                          const int posy,
-                          const int bw)
+/** collect the falloff rays from each point of the path to its border point. posx, posy
+    are subtracted from the coordinates. for roi masks the points are rounded and the gaps
+    are closed in the direction of the ray. returns the number of rays */
+static int _path_falloff_rays(const float *const points,
+                              const float *const border,
+                              const int nb_corner,
+                              const int border_count,
+                              const int posx,
+                              const int posy,
+                              const gboolean roi,
+                              dt_masks_falloff_ray_t *rays)
 {
-  // segment length
-  int l = sqrtf(sqf(p1[0] - p0[0]) + sqf(p1[1] - p0[1])) + 1;
+  int nrays = 0;
+  int p0[2], p1[2];
+  float pf1[2];
+  int last0[2] = { -100, -100 };
+  int last1[2] = { -100, -100 };
+  int next = 0;
+  for(int i = _nb_wctrl_points(nb_corner); i < border_count; i++)
+  {
+    if(roi)
+    {
+      p0[0] = floorf(points[i * 2] + 0.5f);
+      p0[1] = ceilf(points[i * 2 + 1]);
+    }
+    else
+    {
+      p0[0] = points[i * 2];
+      p0[1] = points[i * 2 + 1];
+    }
+    if(next > 0)
+    {
+      p1[0] = pf1[0] = border[next * 2];
+      p1[1] = pf1[1] = border[next * 2 + 1];
+    }
+    else
+    {
+      p1[0] = pf1[0] = border[i * 2];
+      p1[1] = pf1[1] = border[i * 2 + 1];
+    }
 
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
+    // now we check p1 value to know if we have to skip a part
+    if(next == i) next = 0;
+    while(pf1[0] == DT_INVALID_COORDINATE)
+    {
+      if(pf1[1] == DT_INVALID_COORDINATE)
+        next = i - 1;
+      else
+        next = p1[1];
+      p1[0] = pf1[0] = border[next * 2];
+      p1[1] = pf1[1] = border[next * 2 + 1];
+    }
 
-  for(int i = 0; i < l; i++)
-  {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0] - posx;
-    const int y = (int)((float)i * ly / (float)l) + p0[1] - posy;
-    const float op = 1.0 - (float)i / (float)l;
-    size_t idx = y * bw + x;
-    buffer[idx] = fmaxf(buffer[idx], op);
-    // this one is to avoid gap due to int rounding
-    if(x > 0)
-      buffer[idx - 1] = fmaxf(buffer[idx - 1], op);
-    // this one is to avoid gap due to int rounding
-    if(y > 0)
-      buffer[idx - bw] = fmaxf(buffer[idx - bw], op);
+    if(last0[0] != p0[0]
+       || last0[1] != p0[1]
+       || last1[0] != p1[0]
+       || last1[1] != p1[1])
+    {
+      dt_masks_falloff_ray_t *r = rays + nrays++;
+      r->x0 = p0[0] - posx;
+      r->y0 = p0[1] - posy;
+      r->x1 = p1[0] - posx;
+      r->y1 = p1[1] - posy;
+      r->dx = roi && p1[0] >= p0[0] ? 1 : -1;
+      r->dy = roi && p1[1] >= p0[1] ? 1 : -1;
+      r->hardness = 0.0f;
+      r->density = 1.0f;
+
+      last0[0] = p0[0];
+      last0[1] = p0[1];
+      last1[0] = p1[0];
+      last1[1] = p1[1];
+    }
   }
+  return nrays;
 }
 
 static int _path_get_mask(const dt_iop_module_t *const module,
@@ -3215,170 +3261,49 @@ static int _path_get_mask(const dt_iop_module_t *const module,
     return 0;
   }
 
-  // we write all the point around the path into the buffer
-  const int nbp = border_count;
-  if(nbp > 2)
+  // the path in buffer coordinates
+  const int nbw = _nb_wctrl_points(nb_corner);
+  const int nbp = points_count - nbw;
+  float *cpoints = dt_alloc_align_float((size_t)2 * MAX(nbp, 1));
+  dt_masks_falloff_ray_t *rays =
+    dt_alloc_aligned(sizeof(dt_masks_falloff_ray_t) * MAX(border_count, 1));
+  if(cpoints == NULL || rays == NULL)
   {
-    int lastx = (int)points[(nbp - 1) * 2];
-    int lasty = (int)points[(nbp - 1) * 2 + 1];
-    int lasty2 = (int)points[(nbp - 2) * 2 + 1];
-
-    int just_change_dir = 0;
-    for(int ii = _nb_wctrl_points(nb_corner);
-        ii < 2 * nbp - _nb_wctrl_points(nb_corner);
-        ii++)
-    {
-      // we are writing more than 1 loop in the case the dir in y change
-      // exactly at start/end point
-      int i = ii;
-      if(ii >= nbp)
-        i = (ii - _nb_wctrl_points(nb_corner))
-          % (nbp - _nb_wctrl_points(nb_corner)) + _nb_wctrl_points(nb_corner);
-      const int xx = (int)points[i * 2];
-      const int yy = (int)points[i * 2 + 1];
-
-      // we don't store the point if it has the same y value as the last one
-      if(yy == lasty) continue;
-
-      // we want to be sure that there is no y jump
-      if(yy - lasty > 1 || yy - lasty < -1)
-      {
-        if(yy < lasty)
-        {
-          for(int j = yy + 1; j < lasty; j++)
-          {
-            const int nx = (j - yy) * (lastx - xx) / (float)(lasty - yy) + xx;
-            const size_t idx = (size_t)(j - (*posy)) * (*width) + nx - (*posx);
-            assert(idx < bufsize);
-            bufptr[idx] = 1.0f;
-          }
-          lasty2 = yy + 2;
-          lasty = yy + 1;
-        }
-        else
-        {
-          for(int j = lasty + 1; j < yy; j++)
-          {
-            const int nx = (j - lasty) * (xx - lastx) / (float)(yy - lasty) + lastx;
-            const size_t idx = (size_t)(j - (*posy)) * (*width) + nx - (*posx);
-            assert(idx < bufsize);
-            bufptr[idx] = 1.0f;
-          }
-          lasty2 = yy - 2;
-          lasty = yy - 1;
-        }
-      }
-      // if we change the direction of the path (in y), then we add a extra point
-      if((lasty - lasty2) * (lasty - yy) > 0)
-      {
-        const size_t idx = (size_t)(lasty - (*posy)) * (*width) + lastx + 1 - (*posx);
-        assert(idx < bufsize);
-        bufptr[idx] = 1.0f;
-        just_change_dir = 1;
-      }
-      // we add the point
-      if(just_change_dir && ii == i)
-      {
-        // if we have changed the direction, we have to be careful
-        // that point can be at the same place as the previous one,
-        // especially on sharp edges
-        const size_t idx = (size_t)(yy - (*posy)) * (*width) + xx - (*posx);
-        assert(idx < bufsize);
-        float v = bufptr[idx];
-        if(v > 0.0)
-        {
-          if(xx - (*posx) > 0)
-          {
-            const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx - 1 - (*posx);
-            assert(idx_ < bufsize);
-            bufptr[idx_] = 1.0f;
-          }
-          else if(xx - (*posx) < (*width) - 1)
-          {
-            const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx + 1 - (*posx);
-            assert(idx_ < bufsize);
-            bufptr[idx_] = 1.0f;
-          }
-        }
-        else
-        {
-          const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx - (*posx);
-          assert(idx_ < bufsize);
-          bufptr[idx_] = 1.0f;
-          just_change_dir = 0;
-        }
-      }
-      else
-      {
-        const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx - (*posx);
-        assert(idx_ < bufsize);
-        bufptr[idx_] = 1.0f;
-      }
-      // we change last values
-      lasty2 = lasty;
-      lasty = yy;
-      lastx = xx;
-      if(ii != i) break;
-    }
+    dt_free_align(cpoints);
+    dt_free_align(rays);
+    dt_free_align(points);
+    dt_free_align(border);
+    dt_free_align(*buffer);
+    *buffer = NULL;
+    return 0;
   }
-  dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
-           "[masks %s] path_fill draw path took %0.04f sec", form->name,
-           dt_get_lap_time(&start2));
-
-  DT_OMP_FOR()
-  for(int yy = 0; yy < hb; yy++)
+  for(int i = 0; i < nbp; i++)
   {
-    int state = 0;
-    for(int xx = 0; xx < wb; xx++)
-    {
-      const float v = bufptr[yy * wb + xx];
-      if(v == 1.0f) state = !state;
-      if(state) bufptr[yy * wb + xx] = 1.0f;
-    }
+    cpoints[i * 2] = points[(nbw + i) * 2] - *posx;
+    cpoints[i * 2 + 1] = points[(nbw + i) * 2 + 1] - *posy;
   }
 
+  // we fill the inside plain
+  gboolean ok = dt_masks_fill_polygon(bufptr, wb, hb, cpoints, nbp, wb - 1);
+  dt_free_align(cpoints);
+
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
            "[masks %s] path_fill fill plain took %0.04f sec", form->name,
            dt_get_lap_time(&start2));
 
   // now we fill the falloff
-  int p0[2] = { 0 }, p1[2] = { 0 };
-  float pf1[2] = { 0.0f };
-  int last0[2] = { -100, -100 }, last1[2] = { -100, -100 };
-  int next = 0;
-  for(int i = _nb_wctrl_points(nb_corner); i < border_count; i++)
-  {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    if(next > 0)
-      p1[0] = pf1[0] = border[next * 2], p1[1] = pf1[1] = border[next * 2 + 1];
-    else
-      p1[0] = pf1[0] = border[i * 2], p1[1] = pf1[1] = border[i * 2 + 1];
+  const int nrays = _path_falloff_rays(points, border, nb_corner, border_count,
+                                       *posx, *posy, FALSE, rays);
+  ok = ok && dt_masks_falloff_rays(bufptr, wb, hb, rays, nrays);
+  dt_free_align(rays);
 
-    // now we check p1 value to know if we have to skip a part
-    if(next == i) next = 0;
-    while(pf1[0] == DT_INVALID_COORDINATE)
-    {
-      if(pf1[1] == DT_INVALID_COORDINATE)
-        next = i - 1;
-      else
-        next = p1[1];
-      p1[0] = pf1[0] = border[next * 2];
-      p1[1] = pf1[1] = border[next * 2 + 1];
-    }
-
-    // and we draw the falloff
-    if(last0[0] != p0[0]
-       || last0[1] != p0[1]
-       || last1[0] != p1[0]
-       || last1[1] != p1[1])
-    {
-      _path_falloff(bufptr, p0, p1, *posx, *posy, *width);
-      last0[0] = p0[0];
-      last0[1] = p0[1];
-      last1[0] = p1[0];
-      last1[1] = p1[1];
-    }
+  if(!ok)
+  {
+    dt_free_align(points);
+    dt_free_align(border);
+    dt_free_align(*buffer);
+    *buffer = NULL;
+    return 0;
   }
 
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
@@ -3555,41 +3480,6 @@ static int _path_crop_to_roi(float *path,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer,
-                              int *p0,
-                              int *p1,
-                              const int bw,
-                              const int bh)
-{
-  // segment length
-  const int l = sqrtf((p1[0] - p0[0]) * (p1[0] - p0[0])
-                      + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
-
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
-
-  const int dx = lx < 0 ? -1 : 1;
-  const int dy = ly < 0 ? -1 : 1;
-  const int dpy = dy * bw;
-
-  for(int i = 0; i < l; i++)
-  {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0];
-    const int y = (int)((float)i * ly / (float)l) + p0[1];
-    const float op = 1.0f - (float)i / (float)l;
-    float *buf = buffer + (size_t)y * bw + x;
-
-    if(x >= 0 && x < bw && y >= 0 && y < bh)
-      buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
-      buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
-      buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
-  }
-}
-
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
 static int _path_get_mask_roi(const dt_iop_module_t *const module,
@@ -3777,73 +3667,18 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
     }
     else
     {
-      // all other cases
-
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = _nb_wctrl_points(nb_corner); i < points_count; i++)
-      {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        // we don't need special handling of ystart==yend
-        // as following loop will take care
-        const float m = (xstart - xend) / (ystart - yend);
-
-        for(int yy = (int)ceilf(ystart);
-            (float)yy < yend;
-            yy++) // this would normally never touch the last roi line
-                  // => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross)
-            xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          const size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
-               "[masks %s] path_fill draw path took %0.04f sec", form->name,
-               dt_get_lap_time(&start2));
-
-      // we fill the inside plain
-      // we don't need to deal with parts of shape outside of roi
-      const int xxmin = MAX(xmin, 0);
+      // all other cases, scanline fill of the inside. we don't need
+      // to deal with parts of shape outside of roi
       const int xxmax = MIN(xmax, width - 1);
-      const int yymin = MAX(ymin, 0);
-      const int yymax = MIN(ymax, height - 1);
-
-      DT_OMP_FOR(num_threads(MIN(8, dt_get_num_threads())))
-      for(int yy = yymin; yy <= yymax; yy++)
+      if(!dt_masks_fill_polygon(buffer, width, height,
+                                cpoints + 2 * _nb_wctrl_points(nb_corner),
+                                points_count - _nb_wctrl_points(nb_corner),
+                                xxmax))
       {
-        int state = 0;
-        for(int xx = xxmin; xx <= xxmax; xx++)
-        {
-          const size_t index = (size_t)yy * width + xx;
-          const float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
+        dt_free_align(cpoints);
+        dt_free_align(points);
+        dt_free_align(border);
+        return 0;
       }
 
       dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
@@ -3856,72 +3691,26 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
   // deal with feather if it does not lie outside of roi
   if(!path_encircles_roi)
   {
-    int *dpoints = dt_alloc_align_int(4 * border_count);
-    if(dpoints == NULL)
+    dt_masks_falloff_ray_t *rays =
+      dt_alloc_aligned(sizeof(dt_masks_falloff_ray_t) * border_count);
+    if(rays == NULL)
     {
       dt_free_align(points);
       dt_free_align(border);
       return 0;
     }
 
-    int dindex = 0;
-    int p0[2], p1[2];
-    float pf1[2];
-    int last0[2] = { -100, -100 };
-    int last1[2] = { -100, -100 };
-    int next = 0;
-    for(int i = _nb_wctrl_points(nb_corner); i < border_count; i++)
+    const int nrays = _path_falloff_rays(points, border, nb_corner, border_count,
+                                         0, 0, TRUE, rays);
+    const gboolean ok = dt_masks_falloff_rays(buffer, width, height, rays, nrays);
+    dt_free_align(rays);
+    if(!ok)
     {
-      p0[0] = floorf(points[i * 2] + 0.5f);
-      p0[1] = ceilf(points[i * 2 + 1]);
-      if(next > 0)
-      {
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
-      }
-      else
-      {
-        p1[0] = pf1[0] = border[i * 2];
-        p1[1] = pf1[1] = border[i * 2 + 1];
-      }
-
-      // now we check p1 value to know if we have to skip a part
-      if(next == i) next = 0;
-      while(pf1[0] == DT_INVALID_COORDINATE)
-      {
-        if(pf1[1] == DT_INVALID_COORDINATE)
-          next = i - 1;
-        else
-          next = p1[1];
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
-      }
-
-      // and we draw the falloff
-      if(last0[0] != p0[0]
-         || last0[1] != p0[1]
-         || last1[0] != p1[0]
-         || last1[1] != p1[1])
-      {
-        dpoints[dindex] = p0[0];
-        dpoints[dindex + 1] = p0[1];
-        dpoints[dindex + 2] = p1[0];
-        dpoints[dindex + 3] = p1[1];
-        dindex += 4;
-
-        last0[0] = p0[0];
-        last0[1] = p0[1];
-        last1[0] = p1[0];
-        last1[1] = p1[1];
-      }
+      dt_free_align(points);
+      dt_free_align(border);
+      return 0;
     }
 
-    DT_OMP_FOR()
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
-
-    dt_free_align(dpoints);
-
     dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
              "[masks %s] path_fill fill falloff took %0.04f sec", form->name,
              dt_get_lap_time(&start2));
@@ -0,0 +1,347 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Rasterization engine for the polygon based shapes (path and brush).
+
+  The shapes are given as dense polylines, the plain part of a path is
+  filled with a classic scanline algorithm using an active edge table,
+  the soft falloff of paths and brushes is drawn as one ray from each
+  point of the shape to its border point, keeping the maximum opacity
+  of all rays at each pixel. Both work on blocks of rows so that all
+  threads can contribute without writing into the same pixels: the
+  rays are sorted into the blocks they cross and every block only
+  draws the steps of its rays falling into its own rows.
+*/
+
+#include "common/darktable.h"
+#include "common/math.h"
+#include "develop/masks.h"
+
+
+// rows processed by a thread in one go
+#define DT_MASKS_RASTER_ROWS 16
+// rows of a block of the falloff, larger as most rays cross several blocks
+#define DT_MASKS_FALLOFF_ROWS 64
+
+typedef struct _edge_t
+{
+  float xstart, ystart, m;
+  int y0, y1;
+} _edge_t;
+
+static int _edge_cmp(const void *a, const void *b)
+{
+  const _edge_t *ea = a;
+  const _edge_t *eb = b;
+  return (ea->y0 > eb->y0) - (ea->y0 < eb->y0);
+}
+
+static int _int_cmp(const void *a, const void *b)
+{
+  const int ia = *(const int *)a;
+  const int ib = *(const int *)b;
+  return (ia > ib) - (ia < ib);
+}
+
+static inline void _sort_crossings(int *const x, const int count)
+{
+  // the number of crossings per row is small for all realistic shapes
+  if(count > 32)
+  {
+    qsort(x, count, sizeof(int), _int_cmp);
+    return;
+  }
+  for(int i = 1; i < count; i++)
+  {
+    const int v = x[i];
+    int j = i - 1;
+    for(; j >= 0 && x[j] > v; j--) x[j + 1] = x[j];
+    x[j + 1] = v;
+  }
+}
+
+gboolean dt_masks_fill_polygon(float *const buffer,
+                               const int width,
+                               const int height,
+                               const float *const points,
+                               const int count,
+                               const int xmax)
+{
+  if(count < 3 || width <= 0 || height <= 0) return TRUE;
+
+  _edge_t *edges = dt_alloc_aligned(sizeof(_edge_t) * count);
+  if(!edges) return FALSE;
+
+  // build the edge table, the pixel centers on row yy with
+  // ceil(ystart) <= yy < yend are crossed by an edge
+  int nedges = 0;
+  float xlast = points[(count - 1) * 2];
+  float ylast = points[(count - 1) * 2 + 1];
+  for(int i = 0; i < count; i++)
+  {
+    float xstart = xlast;
+    float ystart = ylast;
+    float xend = xlast = points[i * 2];
+    float yend = ylast = points[i * 2 + 1];
+    if(ystart > yend)
+    {
+      float tmp;
+      tmp = ystart, ystart = yend, yend = tmp;
+      tmp = xstart, xstart = xend, xend = tmp;
+    }
+    const int y0 = MAX(0, (int)ceilf(ystart));
+    const int y1 = MIN(height - 1, (int)ceilf(yend) - 1);
+    if(y0 > y1) continue;
+
+    _edge_t *e = edges + nedges++;
+    e->xstart = xstart;
+    e->ystart = ystart;
+    e->m = (xstart - xend) / (ystart - yend);
+    e->y0 = y0;
+    e->y1 = y1;
+  }
+
+  if(nedges == 0)
+  {
+    dt_free_align(edges);
+    return TRUE;
+  }
+  qsort(edges, nedges, sizeof(_edge_t), _edge_cmp);
+
+  const int ymin = edges[0].y0;
+  int ymax = 0;
+  for(int k = 0; k < nedges; k++) ymax = MAX(ymax, edges[k].y1);
+  const int xlim = MIN(xmax, width - 1);
+
+  // per thread active edge table and crossings of the current row
+  size_t padded;
+  int *const scratch = dt_alloc_perthread(2 * nedges, sizeof(int), &padded);
+  if(!scratch)
+  {
+    dt_free_align(edges);
+    return FALSE;
+  }
+
+  const int nblocks = (ymax - ymin) / DT_MASKS_RASTER_ROWS + 1;
+
+  DT_OMP_FOR()
+  for(int b = 0; b < nblocks; b++)
+  {
+    int *const active = dt_get_perthread(scratch, padded);
+    int *const cross = active + nedges;
+    const int ystart = ymin + b * DT_MASKS_RASTER_ROWS;
+    const int yend = MIN(ymax, ystart + DT_MASKS_RASTER_ROWS - 1);
+
+    // edges already running when the block starts
+    int nactive = 0;
+    int next = 0;
+    for(; next < nedges && edges[next].y0 <= ystart; next++)
+      if(edges[next].y1 >= ystart) active[nactive++] = next;
+
+    for(int yy = ystart; yy <= yend; yy++)
+    {
+      // update the active edge table
+      for(; next < nedges && edges[next].y0 <= yy; next++)
+        active[nactive++] = next;
+      int ncross = 0;
+      for(int k = 0; k < nactive; k++)
+      {
+        const _edge_t *e = edges + active[k];
+        if(e->y1 < yy)
+        {
+          // the edge ended above this row
+          nactive--;
+          active[k] = active[nactive];
+          k--;
+          continue;
+        }
+        const float xcross = e->xstart + e->m * (yy - e->ystart);
+        int xx = floorf(xcross);
+        if((float)xx + 0.5f <= xcross) xx++;
+        if(xx < 0 || xx >= width) continue;
+        cross[ncross++] = xx;
+      }
+      _sort_crossings(cross, ncross);
+
+      // even-odd rule, crossings on the same pixel cancel each other and
+      // the pixels holding a crossing belong to the inside
+      float *const row = buffer + (size_t)yy * width;
+      int k = 0;
+      int xin = -1;
+      while(k < ncross)
+      {
+        const int x = cross[k];
+        int n = 0;
+        for(; k < ncross && cross[k] == x; k++) n++;
+        if(!(n & 1)) continue;
+        if(xin < 0)
+          xin = x;
+        else
+        {
+          for(int xx = xin; xx <= x; xx++) row[xx] = 1.0f;
+          xin = -1;
+        }
+      }
+      if(xin >= 0)
+      {
+        row[xin] = 1.0f;
+        for(int xx = xin + 1; xx <= xlim; xx++) row[xx] = 1.0f;
+      }
+    }
+  }
+
+  dt_free_align(scratch);
+  dt_free_align(edges);
+  return TRUE;
+}
+
+// draw the steps of the ray which fall into the rows ystart..yend
+static inline void _falloff_ray(float *const buffer,
+                                const int width,
+                                const int ystart,
+                                const int yend,
+                                const dt_masks_falloff_ray_t *const ray)
+{
+  const int vx = ray->x1 - ray->x0;
+  const int vy = ray->y1 - ray->y0;
+  // segment length, increased by 1 to avoid division by zero
+  const int l = sqrt((double)vx * vx + (double)vy * vy) + 1;
+  const int solid = (int)l * ray->hardness;
+  const int soft = l - solid;
+
+  const float lx = vx;
+  const float ly = vy;
+
+  // the row of a step only grows or shrinks along the ray, so only a
+  // range of steps can reach the rows including the ones at dy
+  int i0 = 0;
+  int i1 = l - 1;
+  const float lo = ystart - 1 - ray->y0;
+  const float hi = yend + 1 - ray->y0;
+  if(ly > 0.0f)
+  {
+    i0 = MAX(i0, (int)floorf(lo * l / ly) - 1);
+    i1 = MIN(i1, (int)ceilf((hi + 1.0f) * l / ly) + 1);
+  }
+  else if(ly < 0.0f)
+  {
+    i0 = MAX(i0, (int)floorf(hi * l / ly) - 1);
+    i1 = MIN(i1, (int)ceilf((lo - 1.0f) * l / ly) + 1);
+  }
+
+  for(int i = i0; i <= i1; i++)
+  {
+    const int x = (int)((float)i * lx / (float)l) + ray->x0;
+    const int y = (int)((float)i * ly / (float)l) + ray->y0;
+    const float op = ray->density * ((i <= solid)
+                                     ? 1.0f
+                                     : 1.0 - (float)(i - solid) / (float)soft);
+
+    const gboolean xin = x >= 0 && x < width;
+    if(y >= ystart && y <= yend)
+    {
+      float *const row = buffer + (size_t)y * width;
+      if(xin)
+        row[x] = MAX(row[x], op);
+      // this one is to avoid gaps due to int rounding
+      if(x + ray->dx >= 0 && x + ray->dx < width)
+        row[x + ray->dx] = MAX(row[x + ray->dx], op);
+    }
+    // this one is to avoid gaps due to int rounding
+    if(xin && y + ray->dy >= ystart && y + ray->dy <= yend)
+    {
+      float *const row = buffer + (size_t)(y + ray->dy) * width;
+      row[x] = MAX(row[x], op);
+    }
+  }
+}
+
+// the rows of the buffer touched by a ray, FALSE if it misses the buffer
+static inline gboolean _falloff_ray_rows(const dt_masks_falloff_ray_t *const r,
+                                         const int width,
+                                         const int height,
+                                         int *y0,
+                                         int *y1)
+{
+  // a step also draws into the rows and columns next to it
+  if(MAX(r->x0, r->x1) + 1 < 0 || MIN(r->x0, r->x1) - 1 >= width
+     || MAX(r->y0, r->y1) + 1 < 0 || MIN(r->y0, r->y1) - 1 >= height)
+    return FALSE;
+  *y0 = MAX(0, MIN(r->y0, r->y1) - 1);
+  *y1 = MIN(height - 1, MAX(r->y0, r->y1) + 1);
+  return TRUE;
+}
+
+gboolean dt_masks_falloff_rays(float *const buffer,
+                               const int width,
+                               const int height,
+                               const dt_masks_falloff_ray_t *const rays,
+                               const int count)
+{
+  if(count <= 0 || width <= 0 || height <= 0) return TRUE;
+
+  // sort the rays into the blocks of rows they draw into
+  const int nblocks = (height - 1) / DT_MASKS_FALLOFF_ROWS + 1;
+  int *const blockstart = dt_calloc_align_int(nblocks + 1);
+  if(!blockstart) return FALSE;
+
+  int y0, y1;
+  for(int k = 0; k < count; k++)
+    if(_falloff_ray_rows(rays + k, width, height, &y0, &y1))
+      for(int b = y0 / DT_MASKS_FALLOFF_ROWS; b <= y1 / DT_MASKS_FALLOFF_ROWS; b++)
+        blockstart[b + 1]++;
+  for(int b = 0; b < nblocks; b++) blockstart[b + 1] += blockstart[b];
+
+  int *const list = dt_alloc_align_int(MAX(blockstart[nblocks], 1));
+  int *const fill = dt_alloc_align_int(nblocks);
+  if(!list || !fill)
+  {
+    dt_free_align(list);
+    dt_free_align(fill);
+    dt_free_align(blockstart);
+    return FALSE;
+  }
+  memcpy(fill, blockstart, sizeof(int) * nblocks);
+  for(int k = 0; k < count; k++)
+    if(_falloff_ray_rows(rays + k, width, height, &y0, &y1))
+      for(int b = y0 / DT_MASKS_FALLOFF_ROWS; b <= y1 / DT_MASKS_FALLOFF_ROWS; b++)
+        list[fill[b]++] = k;
+  dt_free_align(fill);
+
+  // every block only writes its own rows, as we keep the maximum the
+  // order of the rays doesn't matter. the number of rays per block
+  // varies a lot, so hand out the blocks dynamically
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int b = 0; b < nblocks; b++)
+  {
+    const int ystart = b * DT_MASKS_FALLOFF_ROWS;
+    const int yend = MIN(height - 1, ystart + DT_MASKS_FALLOFF_ROWS - 1);
+    for(int k = blockstart[b]; k < blockstart[b + 1]; k++)
+      _falloff_ray(buffer, width, ystart, yend, rays + list[k]);
+  }
+
+  dt_free_align(list);
+  dt_free_align(blockstart);
+  return TRUE;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
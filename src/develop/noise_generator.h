@@ -16,6 +16,8 @@
    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#pragma once
+
 #include "develop/openmp_maths.h"
 
 
@@ -66,6 +68,35 @@ static inline float xoshiro128plus(uint32_t state[4])
 }
 
 
+DT_OMP_DECLARE_SIMD(uniform(key))
+static inline uint64_t philox2x32(const uint32_t ctr0, const uint32_t ctr1, const uint32_t key)
+{
+  // counter based random number generator, Philox 2x32 with 10 rounds.
+  // The result is a keyed scramble of the counter, so there is no state
+  // to carry from one pixel to the next: use pixel coordinates as counter
+  // and noise won't depend on threads, tiles or processing order, and
+  // loops over pixels vectorize.
+  // reference: Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"
+  uint32_t c0 = ctr0, c1 = ctr1, k = key;
+  for(int r = 0; r < 10; r++)
+  {
+    const uint64_t prod = (uint64_t)0xd256d193u * c0;
+    c0 = (uint32_t)(prod >> 32) ^ k ^ c1;
+    c1 = (uint32_t)prod;
+    k += 0x9e3779b9u;
+  }
+  return ((uint64_t)c0 << 32) | c1;
+}
+
+
+DT_OMP_DECLARE_SIMD(uniform(seed))
+static inline float philox_uniform(const uint32_t x, const uint32_t y, const uint32_t seed)
+{
+  // uniform in [0, 1) for pixel (x, y), take the first 24 bits and put them in mantissa
+  return (float)(philox2x32(x, y, seed) >> 40) * 0x1.0p-24f;
+}
+
+
 DT_OMP_DECLARE_SIMD(uniform(sigma) aligned(state:64))
 static inline float uniform_noise(const float mu, const float sigma, uint32_t state[4])
 {
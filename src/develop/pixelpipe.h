@@ -99,6 +99,8 @@ typedef struct dt_dev_histogram_collection_params_t
   const struct dt_histogram_roi_t *roi;
   /** count of histogram bins. */
   uint32_t bins_count;
+  /** 0 or 1 to bin all pixels, else bin one pixel of every sample_step x sample_step cell. */
+  int sample_step;
 } dt_dev_histogram_collection_params_t;
 
 // params used to collect histogram during last histogram capture
@@ -197,6 +197,33 @@ gboolean dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_t *pipe,
   return FALSE;
 }
 
+gboolean dt_dev_pixelpipe_cache_peek(dt_dev_pixelpipe_t *pipe,
+                                     const dt_hash_t hash,
+                                     const size_t size,
+                                     void **data,
+                                     dt_iop_buffer_dsc_t **dsc)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  if(pipe->mask_display
+     || pipe->nocache
+     || (cache->entries == DT_PIPECACHE_MIN)
+     || (hash == DT_INVALID_HASH))
+    return FALSE;
+
+  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  {
+    if((cache->hash[k] == hash) && (cache->size[k] == size) && cache->data[k])
+    {
+      *data = cache->data[k];
+      *dsc = &cache->dsc[k];
+      // as young as possible without losing importance
+      cache->used[k] = MIN(cache->used[k], 0);
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
 // While looking for the oldest cacheline we always ignore the first two lines as they are used
 // for swapping buffers while in entries==DT_PIPECACHE_MIN or masking mode
 static int _get_oldest_cacheline(dt_dev_pixelpipe_cache_t *cache,
@@ -77,6 +77,11 @@ dt_hash_t dt_dev_pixelpipe_cache_hash(const struct dt_iop_roi_t *roi,
 gboolean dt_dev_pixelpipe_cache_get(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash,
                                const size_t size, void **data, struct dt_iop_buffer_dsc_t **dsc, const struct dt_iop_module_t *module, const gboolean important);
 
+/** returns the data of the valid cache line for hash without taking it over.
+    The line is kept from being reused by the next dt_dev_pixelpipe_cache_get(). */
+gboolean dt_dev_pixelpipe_cache_peek(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash,
+                                     const size_t size, void **data, struct dt_iop_buffer_dsc_t **dsc);
+
 /** test availability of a cache line without destroying another, if it is not found. */
 gboolean dt_dev_pixelpipe_cache_available(struct dt_dev_pixelpipe_t *pipe, const dt_hash_t hash, const size_t size);
 
@@ -248,11 +248,17 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   pipe->cache_obsolete = FALSE;
   pipe->backbuf = NULL;
   pipe->backbuf_scale = 0.0f;
+  pipe->backbuf_coarse = FALSE;
+  pipe->progressive = FALSE;
   memset(pipe->backbuf_zoom_pos, 0, sizeof(dt_dev_zoom_pos_t));
   pipe->output_imgid = NO_IMGID;
 
   memset(&pipe->scharr, 0, sizeof(dt_dev_detail_mask_t));
   pipe->want_detail_mask = FALSE;
+  pipe->detail_masks = NULL;
+  dt_pthread_mutex_init(&pipe->detail_masks_mutex, NULL);
+  pipe->raster_variants = NULL;
+  dt_pthread_mutex_init(&pipe->raster_variants_mutex, NULL);
 
   pipe->processing = FALSE;
   dt_atomic_set_int(&pipe->shutdown, DT_DEV_PIXELPIPE_STOP_NO);
@@ -265,6 +271,9 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
   dt_pthread_mutex_init(&pipe->mutex, NULL);
   dt_pthread_mutex_init(&pipe->backbuf_mutex, NULL);
   dt_pthread_mutex_init(&pipe->busy_mutex, NULL);
+  pipe->mask_rasters = NULL;
+  pipe->mask_rasters_size = 0;
+  dt_pthread_mutex_init(&pipe->mask_rasters_mutex, NULL);
   pipe->icc_type = DT_COLORSPACE_NONE;
   pipe->icc_filename = NULL;
   pipe->icc_intent = DT_INTENT_LAST;
@@ -359,6 +368,10 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
     g_list_free_full(pipe->forms, (void (*)(void *))dt_masks_free_form);
     pipe->forms = NULL;
   }
+  dt_masks_raster_cache_cleanup(pipe);
+  dt_pthread_mutex_destroy(&pipe->mask_rasters_mutex);
+  dt_pthread_mutex_destroy(&pipe->detail_masks_mutex);
+  dt_pthread_mutex_destroy(&pipe->raster_variants_mutex);
   dt_pthread_mutex_destroy(&pipe->busy_mutex);
   dt_pthread_mutex_destroy(&pipe->mutex);
 }
@@ -373,6 +386,9 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
   // [[does the above still apply?]]
   dt_pthread_mutex_lock(&pipe->busy_mutex); // block until the pipe has shut down
 
+  // the shared raster masks refer to the nodes
+  dt_dev_clear_raster_variants(pipe, NULL);
+
   // destroy all nodes
   for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
   {
@@ -451,6 +467,8 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe,
     piece->pipe = pipe;
     piece->data = NULL;
     piece->hash = DT_INVALID_HASH;
+    piece->dirty_hash = DT_INVALID_HASH;
+    piece->dirty_input = DT_INVALID_HASH;
     piece->process_cl_ready = FALSE;
     piece->process_tiling_ready = FALSE;
     piece->raster_masks = g_hash_table_new_full(g_direct_hash,
@@ -784,6 +802,19 @@ static void _histogram_collect(dt_dev_pixelpipe_iop_t *piece,
     histogram_params.roi = &histogram_roi;
   }
 
+  // the display histograms of the preview pipe are only drawn, a
+  // sampled one is good enough there and keeps slider drags
+  // responsive. high resolution histograms (e.g. levels in automatic
+  // mode) are used to derive statistics and are always complete.
+  if((piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+     && histogram_params.bins_count <= 256)
+  {
+    const dt_histogram_roi_t *hroi = histogram_params.roi;
+    histogram_params.sample_step =
+      dt_histogram_sample_step(hroi->width - hroi->crop_x - hroi->crop_right,
+                               hroi->height - hroi->crop_y - hroi->crop_bottom);
+  }
+
   const dt_iop_colorspace_type_t cst =
     piece->module->input_colorspace(piece->module, piece->pipe, piece);
 
@@ -849,6 +880,19 @@ static void _histogram_collect_cl(const int devid,
     histogram_params.roi = &histogram_roi;
   }
 
+  // the display histograms of the preview pipe are only drawn, a
+  // sampled one is good enough there and keeps slider drags
+  // responsive. high resolution histograms (e.g. levels in automatic
+  // mode) are used to derive statistics and are always complete.
+  if((piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+     && histogram_params.bins_count <= 256)
+  {
+    const dt_histogram_roi_t *hroi = histogram_params.roi;
+    histogram_params.sample_step =
+      dt_histogram_sample_step(hroi->width - hroi->crop_x - hroi->crop_right,
+                               hroi->height - hroi->crop_y - hroi->crop_bottom);
+  }
+
   const dt_iop_colorspace_type_t cst =
     piece->module->input_colorspace(piece->module, piece->pipe, piece);
 
@@ -1552,6 +1596,309 @@ static inline gboolean _skip_piece_on_tags(const dt_dev_pixelpipe_iop_t *piece)
           && (piece->pipe->type & DT_DEV_PIXELPIPE_BASIC);
 }
 
+/* About reprocessing dirty regions
+  Local edits like moving a retouch shape or a liquify node change only a small part
+  of the output of the edited module but the pipe would process the full roi of all
+  following modules. So for every piece we remember the cacheline of it's last output.
+
+  If that is still available for the same roi the piece reports the region its new output
+  differs from it via pipe->dirty.
+    - a piece with changed parameters finds the region by comparing both buffers, this is
+      only done if the following piece can make use of it,
+    - for a piece with unchanged parameters declaring IOP_FLAGS_EXACT_LOCAL the changed
+      input region grown by the tiling overlap is dirty. Only that region plus the overlap
+      is processed like a tile, the rest is copied from the last output.
+
+  Other modules might depend on the whole roi in ways the tiling overlap doesn't describe,
+  for example by statistics or a downscaled copy of the input, so they are always processed
+  fully.
+  All this is done on CPU pipes only, on the GPU copying the buffers would cost more than
+  what could be saved.
+*/
+static inline gboolean _dirty_enabled(const dt_dev_pixelpipe_t *pipe)
+{
+  return pipe->devid <= DT_DEVICE_CPU
+    && pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE;
+}
+
+// the region is processed like a tile so the module must support tiling
+static inline gboolean _dirty_exact_local(const dt_dev_pixelpipe_iop_t *piece)
+{
+  const int flags = piece->module->flags();
+  return (flags & IOP_FLAGS_EXACT_LOCAL) && (flags & IOP_FLAGS_ALLOW_TILING);
+}
+
+// is the next processed piece able to use the dirty region of our output, disabled
+// and skipped pieces are passed through by the pipe
+static gboolean _dirty_wanted(GList *pieces)
+{
+  for(GList *next = g_list_next(pieces); next; next = g_list_next(next))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = next->data;
+    if(!piece->enabled || _skip_piece_on_tags(piece))
+      continue;
+
+    return _dirty_exact_local(piece);
+  }
+  return FALSE;
+}
+
+// everything besides the input data the output of a piece depends on
+static dt_hash_t _dirty_state(const dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  dt_hash_t hash = dt_dev_pixelpipe_cache_hash(NULL, pipe, 0);
+  hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
+  hash = dt_hash(hash, &pipe->type, sizeof(pipe->type));
+  hash = dt_hash(hash, &pipe->want_detail_mask, sizeof(pipe->want_detail_mask));
+  hash = dt_hash(hash, &pipe->scharr.hash, sizeof(pipe->scharr.hash));
+  return hash;
+}
+
+// report the region changed since the last output and take the new one as reference
+static inline void _dirty_remember(dt_dev_pixelpipe_iop_t *piece,
+                                   const dt_dev_dirty_region_t *dirty,
+                                   const dt_hash_t hash,
+                                   const dt_hash_t input,
+                                   const dt_hash_t state,
+                                   const dt_iop_roi_t *roi)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  pipe->dirty = *dirty;
+  pipe->dirty.hash = hash;
+  pipe->dirty.base = piece->dirty_hash;
+  // a progressive pass must not replace the reference of the full resolution output
+  if(dt_pipe_shutdown(pipe) || pipe->progressive) return;
+
+  piece->dirty_hash = hash;
+  piece->dirty_input = input;
+  piece->dirty_state = state;
+  piece->dirty_roi = *roi;
+}
+
+void dt_dev_dirty_region_grow(dt_dev_dirty_region_t *dirty,
+                              const int border,
+                              const int width,
+                              const int height)
+{
+  if(dirty->width <= 0 || dirty->height <= 0)
+  {
+    dirty->width = dirty->height = 0;
+    return;
+  }
+  const int x0 = MAX(0, dirty->x - border);
+  const int y0 = MAX(0, dirty->y - border);
+  const int x1 = MIN(width, dirty->x + dirty->width + border);
+  const int y1 = MIN(height, dirty->y + dirty->height + border);
+  dirty->x = x0;
+  dirty->y = y0;
+  dirty->width = MAX(0, x1 - x0);
+  dirty->height = MAX(0, y1 - y0);
+}
+
+// processing more than half of the roi plus copying doesn't pay off
+static inline gboolean _dirty_small(const dt_dev_dirty_region_t *dirty,
+                                    const int width,
+                                    const int height)
+{
+  return (size_t)dirty->width * dirty->height <= (size_t)width * height / 2;
+}
+
+gboolean dt_dev_dirty_region_local(const dt_dev_dirty_region_t *in_dirty,
+                                   const int overlap,
+                                   const int width,
+                                   const int height,
+                                   dt_dev_dirty_region_t *dirty,
+                                   dt_dev_dirty_region_t *region)
+{
+  // the output changes within the overlap around the changed input ...
+  *dirty = *in_dirty;
+  dt_dev_dirty_region_grow(dirty, overlap, width, height);
+  // ... and that region requires the overlap around it as input
+  *region = *dirty;
+  dt_dev_dirty_region_grow(region, overlap, width, height);
+  return _dirty_small(region, width, height);
+}
+
+void dt_dev_dirty_region_diff(const uint8_t *const a,
+                              const uint8_t *const b,
+                              const int width,
+                              const int height,
+                              const size_t bpp,
+                              dt_dev_dirty_region_t *dirty)
+{
+  const size_t stride = bpp * width;
+  int x0 = width;
+  int y0 = height;
+  int x1 = -1;
+  int y1 = -1;
+  DT_OMP_FOR(reduction(min : x0, y0) reduction(max : x1, y1))
+  for(int row = 0; row < height; row++)
+  {
+    const uint8_t *ra = a + row * stride;
+    const uint8_t *rb = b + row * stride;
+    if(memcmp(ra, rb, stride))
+    {
+      int left = 0;
+      while(!memcmp(ra + left * bpp, rb + left * bpp, bpp)) left++;
+      int right = width - 1;
+      while(!memcmp(ra + right * bpp, rb + right * bpp, bpp)) right--;
+      x0 = MIN(x0, left);
+      x1 = MAX(x1, right);
+      y0 = MIN(y0, row);
+      y1 = MAX(y1, row);
+    }
+  }
+  dirty->valid = TRUE;
+  dirty->x = x1 < 0 ? 0 : x0;
+  dirty->y = y1 < 0 ? 0 : y0;
+  dirty->width = x1 < 0 ? 0 : x1 - x0 + 1;
+  dirty->height = y1 < 0 ? 0 : y1 - y0 + 1;
+}
+
+void dt_dev_dirty_region_copy(uint8_t *const out,
+                              const int out_width,
+                              const int out_x,
+                              const int out_y,
+                              const uint8_t *const in,
+                              const int in_width,
+                              const int in_x,
+                              const int in_y,
+                              const int width,
+                              const int height,
+                              const size_t bpp)
+{
+  DT_OMP_FOR()
+  for(int row = 0; row < height; row++)
+    memcpy(out + bpp * ((size_t)(out_y + row) * out_width + out_x),
+           in + bpp * ((size_t)(in_y + row) * in_width + in_x),
+           bpp * width);
+}
+
+static gboolean _dirty_piece_local(dt_dev_pixelpipe_t *pipe,
+                                   dt_develop_t *dev,
+                                   dt_iop_module_t *module,
+                                   const dt_dev_pixelpipe_iop_t *piece,
+                                   const dt_hash_t state,
+                                   const dt_iop_buffer_dsc_t *input_format,
+                                   const dt_iop_roi_t *roi_in,
+                                   const dt_iop_roi_t *roi_out)
+{
+  // masks might depend on other parts of the image or have to be written completely
+  const dt_develop_blend_params_t *const bd = piece->blendop_data;
+  const gboolean plain_blend = !bd
+    || bd->mask_mode == DEVELOP_MASK_DISABLED
+    || bd->mask_mode == DEVELOP_MASK_ENABLED;
+
+  return piece->dirty_state == state
+    && _dirty_exact_local(piece)
+    && plain_blend
+    && !memcmp(roi_in, roi_out, sizeof(dt_iop_roi_t))
+    && input_format->cst != IOP_CS_RAW
+    && !(piece->request_histogram & DT_REQUEST_ON)
+    && !_request_color_pick(pipe, dev, module)
+    && g_hash_table_size(module->raster_mask.source.users) == 0;
+}
+
+/* Returns TRUE if the output has been written by processing the dirty region only.
+   Otherwise dirty is still valid if the full processing will only change that region.
+*/
+static gboolean _process_dirty_region(dt_dev_pixelpipe_t *pipe,
+                                      dt_develop_t *dev,
+                                      void *input,
+                                      const dt_iop_buffer_dsc_t *input_format,
+                                      const dt_iop_roi_t *roi_in,
+                                      void **output,
+                                      dt_iop_buffer_dsc_t **out_format,
+                                      const dt_iop_roi_t *roi_out,
+                                      dt_iop_module_t *module,
+                                      dt_dev_pixelpipe_iop_t *piece,
+                                      dt_develop_tiling_t *tiling,
+                                      const dt_hash_t state,
+                                      const dt_dev_dirty_region_t *in_dirty,
+                                      const void *prev,
+                                      const dt_iop_buffer_dsc_t *prev_dsc,
+                                      const int pos,
+                                      dt_dev_dirty_region_t *dirty)
+{
+  dirty->valid = FALSE;
+  if(!in_dirty->valid
+     || !_dirty_piece_local(pipe, dev, module, piece, state, input_format, roi_in, roi_out))
+    return FALSE;
+
+  dt_dev_dirty_region_t region;
+  if(!dt_dev_dirty_region_local(in_dirty, tiling->overlap, roi_out->width, roi_out->height,
+                                dirty, &region))
+    return FALSE;
+
+  const dt_iop_roi_t sub_out = { roi_out->x + region.x, roi_out->y + region.y,
+                                 region.width, region.height, roi_out->scale };
+  dt_iop_roi_t sub_in = sub_out;
+  const gboolean process = region.width > 0;
+  if(process)
+  {
+    module->modify_roi_in(module, piece, &sub_out, &sub_in);
+    if(memcmp(&sub_in, &sub_out, sizeof(dt_iop_roi_t)))
+      return FALSE;
+  }
+
+  const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
+  const size_t bpp = dt_iop_buffer_dsc_to_bpp(*out_format);
+  void *sub_input = process ? dt_alloc_aligned(in_bpp * region.width * region.height) : NULL;
+  void *sub_output = process ? dt_alloc_aligned(bpp * region.width * region.height) : NULL;
+  if(process && (!sub_input || !sub_output))
+  {
+    dt_free_align(sub_input);
+    dt_free_align(sub_output);
+    return FALSE;
+  }
+
+  if(process)
+  {
+    dt_dev_dirty_region_copy(sub_input, region.width, 0, 0,
+                             input, roi_in->width, region.x, region.y,
+                             region.width, region.height, in_bpp);
+
+    dt_print_pipe(DT_DEBUG_PIPE,
+                  "process dirty region",
+                  pipe, module, DT_DEVICE_CPU, &sub_in, &sub_out, "%ix%i of %ix%i",
+                  dirty->width, dirty->height, roi_out->width, roi_out->height);
+
+    dt_iop_buffer_dsc_t sub_format = *input_format;
+    dt_pixelpipe_flow_t pixelpipe_flow = PIXELPIPE_FLOW_NONE | PIXELPIPE_FLOW_HISTOGRAM_NONE;
+    if(_pixelpipe_process_on_CPU(pipe, dev, sub_input, &sub_format, &sub_in,
+                                 &sub_output, out_format, &sub_out,
+                                 module, piece, tiling, &pixelpipe_flow, pos))
+    {
+      dt_free_align(sub_input);
+      dt_free_align(sub_output);
+      dirty->valid = FALSE;
+      return TRUE;
+    }
+
+    if(pipe->dsc.cst != prev_dsc->cst)
+    {
+      dt_free_align(sub_input);
+      dt_free_align(sub_output);
+      return FALSE;
+    }
+  }
+
+  dt_iop_image_copy_by_size(*output, prev, roi_out->width, roi_out->height, bpp / sizeof(float));
+  if(process)
+    dt_dev_dirty_region_copy(*output, roi_out->width, dirty->x, dirty->y,
+                             sub_output, region.width, dirty->x - region.x, dirty->y - region.y,
+                             dirty->width, dirty->height, bpp);
+  else
+    dt_print_pipe(DT_DEBUG_PIPE,
+                  "pipe data: unchanged", pipe, module, DT_DEVICE_NONE, roi_in, roi_out);
+
+  pipe->dsc = *prev_dsc;
+  dt_free_align(sub_input);
+  dt_free_align(sub_output);
+  return TRUE;
+}
+
 // recursive helper for process, returns TRUE in case of unfinished work or error
 static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                            dt_develop_t *dev,
@@ -1566,6 +1913,9 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
   if(dt_pipe_shutdown(pipe))
     return TRUE;
 
+  // unknown unless we find out below
+  pipe->dirty = (dt_dev_dirty_region_t){ .valid = FALSE };
+
   dt_iop_roi_t roi_in = *roi_out;
 
   char module_name[256] = { 0 };
@@ -1577,11 +1927,13 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   const dt_dev_pixelpipe_type_t old_pipetype = pipe->type;
   const dt_iop_module_t *gui_module = dt_dev_gui_module();
-  // if a module is active, check if this module allow a fast pipe run
-  if(gui_module
-     && gui_module->flags() & IOP_FLAGS_ALLOW_FAST_PIPE
-     && pipe->type & DT_DEV_PIXELPIPE_BASIC
-     && dt_dev_modulegroups_test_activated(darktable.develop))
+  // if a module is active, check if this module allow a fast pipe run,
+  // the low resolution pass of progressive rendering always does
+  if(pipe->progressive
+     || (gui_module
+         && gui_module->flags() & IOP_FLAGS_ALLOW_FAST_PIPE
+         && pipe->type & DT_DEV_PIXELPIPE_BASIC
+         && dt_dev_modulegroups_test_activated(darktable.develop)))
   {
     pipe->type |= DT_DEV_PIXELPIPE_FAST;
   }
@@ -1649,6 +2001,14 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     dt_print_pipe(DT_DEBUG_PIPE,
                   "pipe data: from cache",
                   pipe, module, DT_DEVICE_NONE, &roi_in, NULL);
+    // as we don't know the input for this buffer it's only a reference for an unchanged one
+    if(piece)
+    {
+      const dt_dev_dirty_region_t dirty = { .valid = hash == piece->dirty_hash };
+      _dirty_remember(piece, &dirty, hash, DT_INVALID_HASH, _dirty_state(piece), roi_out);
+    }
+    else
+      pipe->dirty.hash = hash;
     // we're done! as colorpicker/scopes only work on gamma iop
     // input -- which is unavailable via cache -- there's no need to
     // run these
@@ -1840,6 +2200,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     dt_show_times_f(&start, "[dev_pixelpipe]",
                     "initing base buffer [%s]", dt_dev_pixelpipe_type_to_str(pipe->type));
 
+    pipe->dirty.hash = hash;
     return dt_pipe_shutdown(pipe);
   }
 
@@ -1873,6 +2234,14 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                 g_list_previous(pieces), pos - 1))
     return TRUE;
 
+  // the changed input region is only of use if our last output was processed from the
+  // same buffer it refers to
+  dt_dev_dirty_region_t in_dirty = pipe->dirty;
+  in_dirty.valid = in_dirty.valid
+    && in_dirty.base != DT_INVALID_HASH
+    && in_dirty.base == piece->dirty_input;
+  pipe->dirty = (dt_dev_dirty_region_t){ .valid = FALSE };
+
   const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(input_format);
 
   piece->dsc_out = piece->dsc_in = *input_format;
@@ -1883,6 +2252,19 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   const size_t out_bpp = dt_iop_buffer_dsc_to_bpp(*out_format);
 
+  // the last output of this piece at the same roi, must be taken before reserving the output.
+  // It's of use if we might process the dirty region only or if the next piece could do so.
+  const dt_hash_t state = _dirty_state(piece);
+  const gboolean dirty_source = piece->dirty_state != state && _dirty_wanted(pieces);
+  void *prev = NULL;
+  dt_iop_buffer_dsc_t *prev_dsc = NULL;
+  if(_dirty_enabled(pipe)
+     && (dirty_source || (in_dirty.valid && _dirty_exact_local(piece)))
+     && piece->dirty_hash != hash
+     && !memcmp(&piece->dirty_roi, roi_out, sizeof(dt_iop_roi_t))
+     && !dt_dev_pixelpipe_cache_peek(pipe, piece->dirty_hash, bufsize, &prev, &prev_dsc))
+    prev = NULL;
+
   // reserve new cache line: output
   if(dt_pipe_shutdown(pipe))
     return TRUE;
@@ -1981,6 +2363,17 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
   if(dt_pipe_shutdown(pipe))
     return TRUE;
 
+  dt_dev_dirty_region_t dirty = { .valid = FALSE };
+  if(prev
+     && _process_dirty_region(pipe, dev, input, input_format, &roi_in,
+                              output, out_format, roi_out, module, piece, &tiling,
+                              state, &in_dirty, prev, prev_dsc, pos, &dirty))
+  {
+    **out_format = piece->dsc_out = pipe->dsc;
+    _dirty_remember(piece, &dirty, hash, in_dirty.hash, state, roi_out);
+    return dt_pipe_shutdown(pipe);
+  }
+
   piece->module->position = pos;
 
 #ifdef HAVE_OPENCL
@@ -2823,6 +3216,21 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
 
   if(pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE)
     dt_dev_pixelpipe_invalidate_cacheline(pipe, *output);
+  else if(prev
+          && !dirty.valid
+          && dirty_source
+          && !dt_pipe_shutdown(pipe))
+  {
+    // find out what changed since the last run
+    dt_dev_dirty_region_diff(*output, prev, roi_out->width, roi_out->height, bpp, &dirty);
+    if(!_dirty_small(&dirty, roi_out->width, roi_out->height))
+      dirty.valid = FALSE;
+    else
+      dt_print_pipe(DT_DEBUG_PIPE,
+                    "dirty region", pipe, module, DT_DEVICE_NONE, NULL, roi_out,
+                    "%ix%i at %i/%i", dirty.width, dirty.height, dirty.x, dirty.y);
+  }
+  _dirty_remember(piece, &dirty, hash, in_dirty.hash, state, roi_out);
 
   char histogram_log[32] = "";
   if(!(pixelpipe_flow & PIXELPIPE_FLOW_HISTOGRAM_NONE))
@@ -2864,6 +3272,7 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     const gboolean last_history = darktable.develop->history_last_module == module;
     if((pipe->type & DT_DEV_PIXELPIPE_BASIC)
         && (pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE)
+        && !pipe->progressive
         && (has_focus || last_history || important_cl))
     {
       dt_print_pipe(DT_DEBUG_PIPE,
@@ -3102,7 +3511,9 @@ gboolean dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
                                   const int devid)
 {
   pipe->processing = TRUE;
-  pipe->nocache = (pipe->type & DT_DEV_PIXELPIPE_IMAGE) != 0;
+  // the low resolution pass of progressive rendering only uses the swap lines
+  // so the cachelines of the full resolution output are kept
+  pipe->nocache = (pipe->type & DT_DEV_PIXELPIPE_IMAGE) != 0 || pipe->progressive;
   pipe->runs++;
   pipe->opencl_enabled = dt_opencl_running();
 
@@ -3271,6 +3682,7 @@ restart:
     {
       memcpy(pipe->backbuf, buf, sizeof(uint8_t) * 4 * width * height);
       pipe->backbuf_scale = scale;
+      pipe->backbuf_coarse = pipe->progressive;
       for(int i = 0; i < 6; i++) pipe->backbuf_zoom_pos[i] = pts[i] * pipe->iscale;
       pipe->output_imgid = pipe->image.id;
     }
@@ -3366,25 +3778,161 @@ static inline gboolean _empty_finalscale(const dt_dev_pixelpipe_iop_t *piece)
       && piece->processed_roi_in.height == 0;
 
 }
+// a raster mask distorted for the consumers at some module position
+typedef struct dt_dev_raster_variant_t
+{
+  const dt_dev_pixelpipe_iop_t *source;
+  dt_hash_t key;
+  int width, height;
+  int refs;  // references held right now
+  int users; // consumers of this run not yet done with it
+  float *data;
+} dt_dev_raster_variant_t;
+
+// number of variants kept if their consumers didn't ask for them, possibly cached modules
+#define DT_DEV_RASTER_VARIANTS 8
+
+static void _raster_variant_free(dt_dev_raster_variant_t *variant)
+{
+  dt_free_align(variant->data);
+  free(variant);
+}
+
+static void _raster_variants_stats(dt_dev_pixelpipe_t *pipe,
+                                   const dt_iop_module_t *module,
+                                   const char *msg)
+{
+  if(!(darktable.unmuted & DT_DEBUG_MASKS)) return;
+
+  int refs = 0, users = 0;
+  size_t size = 0;
+  for(GList *l = pipe->raster_variants; l; l = g_list_next(l))
+  {
+    const dt_dev_raster_variant_t *variant = l->data;
+    refs += variant->refs;
+    users += variant->users;
+    size += sizeof(float) * variant->width * variant->height;
+  }
+  dt_print_pipe(DT_DEBUG_MASKS,
+                msg, pipe, module, DT_DEVICE_NONE, NULL, NULL,
+                "%i variants, %i refs, %i pending users, %.1fMB",
+                g_list_length(pipe->raster_variants), refs, users, size / (1024.0 * 1024.0));
+}
+
+void dt_dev_clear_raster_variants(dt_dev_pixelpipe_t *pipe,
+                                  const dt_dev_pixelpipe_iop_t *source)
+{
+  dt_pthread_mutex_lock(&pipe->raster_variants_mutex);
+  for(GList *l = pipe->raster_variants; l; )
+  {
+    GList *next = g_list_next(l);
+    dt_dev_raster_variant_t *variant = l->data;
+    if(!source || variant->source == source)
+    {
+      pipe->raster_variants = g_list_delete_link(pipe->raster_variants, l);
+      _raster_variant_free(variant);
+    }
+    l = next;
+  }
+  dt_pthread_mutex_unlock(&pipe->raster_variants_mutex);
+}
+
+void dt_dev_release_raster_mask(dt_dev_pixelpipe_t *pipe,
+                                const float *mask)
+{
+  if(!mask) return;
+
+  dt_pthread_mutex_lock(&pipe->raster_variants_mutex);
+  for(GList *l = pipe->raster_variants; l; l = g_list_next(l))
+  {
+    dt_dev_raster_variant_t *variant = l->data;
+    if(variant->data == mask)
+    {
+      variant->refs--;
+      variant->users--;
+      // the last consumer is done
+      if(variant->refs <= 0 && variant->users <= 0)
+      {
+        pipe->raster_variants = g_list_delete_link(pipe->raster_variants, l);
+        _raster_variant_free(variant);
+      }
+      _raster_variants_stats(pipe, NULL, "release raster mask");
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&pipe->raster_variants_mutex);
+}
+
+// the key of a raster mask distorted up to target_module covers the output of the source module,
+// the mask id and the parameters plus roi's of all distorting modules in between
+static dt_hash_t _raster_variant_key(GList *source_iter,
+                                     const dt_mask_id_t raster_mask_id,
+                                     const dt_iop_module_t *target_module)
+{
+  dt_dev_pixelpipe_iop_t *source_piece = source_iter->data;
+  dt_hash_t key = dt_dev_pixelpipe_piece_hash(source_piece, &source_piece->processed_roi_out, TRUE);
+  key = dt_hash(key, &raster_mask_id, sizeof(raster_mask_id));
+  for(GList *iter = g_list_next(source_iter); iter; iter = g_list_next(iter))
+  {
+    const dt_dev_pixelpipe_iop_t *it_piece = iter->data;
+    if(!_skip_piece_on_tags(it_piece)
+       && it_piece->module->distort_mask
+       && !_empty_finalscale(it_piece))
+    {
+      key = dt_hash(key, &it_piece->hash, sizeof(it_piece->hash));
+      key = dt_hash(key, &it_piece->processed_roi_in, sizeof(dt_iop_roi_t));
+      key = dt_hash(key, &it_piece->processed_roi_out, sizeof(dt_iop_roi_t));
+    }
+    if(target_module && it_piece->module == target_module)
+      break;
+  }
+  return key;
+}
+
+// number of modules in the pipe blending with the raster mask distorted like for target_module
+static int _raster_variant_users(GList *source_iter,
+                                 const dt_mask_id_t raster_mask_id,
+                                 const dt_iop_module_t *target_module,
+                                 const dt_hash_t key)
+{
+  if(!target_module) return 1;
+
+  const dt_dev_pixelpipe_iop_t *source_piece = source_iter->data;
+  int users = 0;
+  for(GList *iter = g_list_next(source_iter); iter; iter = g_list_next(iter))
+  {
+    const dt_dev_pixelpipe_iop_t *it_piece = iter->data;
+    const dt_develop_blend_params_t *const d = it_piece->blendop_data;
+    if(it_piece->enabled
+       && d
+       && (d->mask_mode & DEVELOP_MASK_ENABLED)
+       && (d->mask_mode & DEVELOP_MASK_RASTER)
+       && it_piece->module->raster_mask.sink.source == source_piece->module
+       && it_piece->module->raster_mask.sink.id == raster_mask_id
+       && _raster_variant_key(source_iter, raster_mask_id, it_piece->module) == key)
+      users++;
+  }
+  return MAX(1, users);
+}
+
 /* this looks for a raster mask (mask output) generated by raster_mask_source, the size of
    the mask must now be equal to the roi_out of the requesting (target_module) module.
 
    As the raster mask was generated with roi_out size of the source module we always have
    to check for a necessary transformation by all modules between in the pixelpipe.
 
-   The functions returns a pointer the the mask data or NULL if none was available.
-   Also the boolean at free_mask is set to TRUE if mask has been somehow transformed,
-   all callers must check this flag and de-allocate after usage (dt_free_align).
+   A distorted mask is kept in the pipe and shared by all modules using the raster mask at
+   the same position, it's freed once the last of them is done with it.
+
+   The functions returns a read-only pointer to the mask data or NULL if none was available,
+   all callers must hand it back via dt_dev_release_raster_mask() after usage.
 */
 
 float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                               const dt_iop_module_t *raster_mask_source,
                               const dt_mask_id_t raster_mask_id,
-                              const dt_iop_module_t *target_module,
-                              gboolean *free_mask)
+                              const dt_iop_module_t *target_module)
 {
-  *free_mask = FALSE;
-
   if(!raster_mask_source)
   {
     dt_print(DT_DEBUG_PIPE, "[dt_dev_get_raster_mask] no raster mask source provided");
@@ -3434,7 +3982,10 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
   // we found the raster_mask source piece and can proceed further
 
   float *raster_mask = NULL;
-  dt_iop_roi_t *final_roi = &piece->processed_roi_out;
+  dt_dev_raster_variant_t *variant = NULL;
+  gboolean distorted = FALSE;
+  int width = piece->processed_roi_out.width;
+  int height = piece->processed_roi_out.height;
 
   const dt_develop_mask_mode_t maskmode = source_piece->enabled ? source_piece->module->blend_params->mask_mode : DEVELOP_MASK_DISABLED;
   const gboolean source_writing = (maskmode > DEVELOP_MASK_ENABLED)
@@ -3445,6 +3996,7 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
   if(!source_piece->enabled || !source_writing)
   {
     const gboolean deleted = g_hash_table_remove(source_piece->raster_masks, GINT_TO_POINTER(BLEND_RASTER_ID));
+    if(deleted) dt_dev_clear_raster_variants(piece->pipe, source_piece);
     dt_print_pipe(DT_DEBUG_PIPE,
                     "no raster mask",
                     piece->pipe, piece->module, DT_DEVICE_NONE, NULL, NULL,
@@ -3470,77 +4022,162 @@ float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
     {
       dt_print_pipe(DT_DEBUG_VERBOSE, "source raster mask",
                 piece->pipe, source_piece->module, DT_DEVICE_NONE, &source_piece->processed_roi_in, &source_piece->processed_roi_out);
-      for(GList *iter = g_list_next(source_iter); iter; iter = g_list_next(iter))
+
+      dt_dev_pixelpipe_t *pipe = piece->pipe;
+      const dt_hash_t key = _raster_variant_key(source_iter, raster_mask_id, target_module);
+      dt_pthread_mutex_lock(&pipe->raster_variants_mutex);
+      for(GList *l = pipe->raster_variants; l; l = g_list_next(l))
+      {
+        dt_dev_raster_variant_t *found = l->data;
+        if(found->key == key && found->source == source_piece)
+        {
+          variant = found;
+          variant->refs++;
+          break;
+        }
+      }
+      dt_pthread_mutex_unlock(&pipe->raster_variants_mutex);
+
+      if(variant)
+      {
+        raster_mask = variant->data;
+        width = variant->width;
+        height = variant->height;
+      }
+      else
       {
-        dt_dev_pixelpipe_iop_t *it_piece = iter->data;
-        if(!_skip_piece_on_tags(it_piece))
+        for(GList *iter = g_list_next(source_iter); iter; iter = g_list_next(iter))
         {
-          if(it_piece->module->distort_mask && !_empty_finalscale(it_piece))
+          dt_dev_pixelpipe_iop_t *it_piece = iter->data;
+          if(!_skip_piece_on_tags(it_piece))
           {
-            dt_iop_roi_t *roi = &it_piece->processed_roi_in;
-            dt_iop_roi_t *roo = &it_piece->processed_roi_out;
-            float *tmp = dt_iop_image_alloc(roo->width, roo->height, 1);
-            if(tmp)
+            if(it_piece->module->distort_mask && !_empty_finalscale(it_piece))
             {
-              dt_print_pipe(DT_DEBUG_MASKS | DT_DEBUG_PIPE | DT_DEBUG_VERBOSE,
-                              "distort raster mask",
-                              piece->pipe, it_piece->module, DT_DEVICE_NONE, roi, roo);
-              it_piece->module->distort_mask(it_piece->module, it_piece, raster_mask, tmp, roi, roo);
-
-              if(*free_mask)
-                dt_free_align(raster_mask);
+              dt_iop_roi_t *roi = &it_piece->processed_roi_in;
+              dt_iop_roi_t *roo = &it_piece->processed_roi_out;
+              float *tmp = dt_iop_image_alloc(roo->width, roo->height, 1);
+              if(tmp)
+              {
+                dt_print_pipe(DT_DEBUG_MASKS | DT_DEBUG_PIPE | DT_DEBUG_VERBOSE,
+                                "distort raster mask",
+                                piece->pipe, it_piece->module, DT_DEVICE_NONE, roi, roo);
+                it_piece->module->distort_mask(it_piece->module, it_piece, raster_mask, tmp, roi, roo);
+
+                if(distorted)
+                  dt_free_align(raster_mask);
+                else
+                  distorted = TRUE;
+
+                raster_mask = tmp;
+                width = roo->width;
+                height = roo->height;
+              }
               else
-                *free_mask = TRUE;
-
-              raster_mask = tmp;
-              final_roi = roo;
+              {
+                dt_print_pipe(DT_DEBUG_ALWAYS,
+                                "no distort raster mask",
+                                piece->pipe, it_piece->module, DT_DEVICE_NONE, roi, roo,
+                                "skipped transforming mask due to lack of memory");
+                goto failure;
+              }
             }
-            else
+            else if(_distort_piece_roi(it_piece)) goto failure;
+          }
+
+          if(target_module && it_piece->module == target_module)
+            break;
+        }
+
+        if(distorted)
+        {
+          variant = calloc(1, sizeof(dt_dev_raster_variant_t));
+          if(!variant) goto failure;
+          variant->source = source_piece;
+          variant->key = key;
+          variant->width = width;
+          variant->height = height;
+          variant->refs = 1;
+          variant->users = _raster_variant_users(source_iter, raster_mask_id, target_module, key);
+          variant->data = raster_mask;
+
+          dt_pthread_mutex_lock(&pipe->raster_variants_mutex);
+          pipe->raster_variants = g_list_prepend(pipe->raster_variants, variant);
+          // consumers might not run at all as their output is cached,
+          // drop the oldest of those variants
+          int unused = 0;
+          for(GList *l = pipe->raster_variants; l; )
+          {
+            GList *next = g_list_next(l);
+            dt_dev_raster_variant_t *old = l->data;
+            if(old->refs == 0 && ++unused > DT_DEV_RASTER_VARIANTS)
             {
-              dt_print_pipe(DT_DEBUG_ALWAYS,
-                              "no distort raster mask",
-                              piece->pipe, it_piece->module, DT_DEVICE_NONE, roi, roo,
-                              "skipped transforming mask due to lack of memory");
-              goto failure;
+              pipe->raster_variants = g_list_delete_link(pipe->raster_variants, l);
+              _raster_variant_free(old);
             }
+            l = next;
           }
-          else if(_distort_piece_roi(it_piece)) goto failure;
+          _raster_variants_stats(pipe, target_module, "new raster mask variant");
+          dt_pthread_mutex_unlock(&pipe->raster_variants_mutex);
         }
-
-        if(target_module && it_piece->module == target_module)
-          break;
       }
     }
   }
 
   const gboolean correct = (target_module == NULL)
-                        || (piece->processed_roi_out.width == final_roi->width
-                             && piece->processed_roi_out.height == final_roi->height);
+                        || (piece->processed_roi_out.width == width
+                             && piece->processed_roi_out.height == height);
 
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MASKS,
                 correct ? "got raster mask" : "RASTER SIZE MISMATCH",
                 piece->pipe, target_module, DT_DEVICE_NONE, NULL, NULL,
                 "from module `%s%s'%s %ix%i",
                 raster_mask_source->op, dt_iop_get_instance_id(raster_mask_source),
-                *free_mask ? ", distorted to" : "",
-                final_roi->width, final_roi->height);
+                variant ? (distorted ? ", distorted to" : ", shared") : "",
+                width, height);
 
   if(correct)
     return raster_mask;
 
 failure:
-  if(*free_mask)
-  {
+  if(variant)
+    dt_dev_release_raster_mask(piece->pipe, variant->data);
+  else if(distorted)
     dt_free_align(raster_mask);
-    *free_mask = FALSE;
-  }
   return NULL;
 }
 
+// a detail mask refined with a threshold from the scharr mask, distorted up to some module
+typedef struct dt_dev_detail_variant_t
+{
+  dt_hash_t key;
+  int width, height;
+  int refs;
+  float *data;
+} dt_dev_detail_variant_t;
+
+// number of unused detail masks kept by the darkroom pipes, the refined mask plus a few module positions
+#define DT_DEV_DETAIL_VARIANTS 4
+
+static void _detail_variant_free(dt_dev_detail_variant_t *variant)
+{
+  dt_free_align(variant->data);
+  free(variant);
+}
+
+static void _clear_detail_variants(dt_dev_pixelpipe_t *pipe)
+{
+  dt_pthread_mutex_lock(&pipe->detail_masks_mutex);
+  g_list_free_full(pipe->detail_masks, (GDestroyNotify)_detail_variant_free);
+  pipe->detail_masks = NULL;
+  dt_pthread_mutex_unlock(&pipe->detail_masks_mutex);
+}
+
 void dt_dev_clear_scharr_mask(dt_dev_pixelpipe_t *pipe)
 {
   if(pipe->scharr.data) dt_free_align(pipe->scharr.data);
   memset(&pipe->scharr, 0, sizeof(dt_dev_detail_mask_t));
+  // all variants have been derived from the old mask
+  _clear_detail_variants(pipe);
 }
 
 gboolean dt_dev_write_scharr_mask(dt_dev_pixelpipe_iop_t *piece,
@@ -3643,15 +4280,100 @@ int dt_dev_write_scharr_mask_cl(dt_dev_pixelpipe_iop_t *piece,
 }
 #endif
 
-// this expects a mask prepared by rawprepare or demosaic and distorts it
-// through all pipeline modules until target
-float *dt_dev_distort_detail_mask(dt_dev_pixelpipe_iop_t *piece,
-                                  float *src,
-                                  const dt_iop_module_t *target_module)
+// looks for a variant and takes a reference, must be called with detail_masks_mutex locked
+static dt_dev_detail_variant_t *_get_detail_variant(dt_dev_pixelpipe_t *pipe,
+                                                    const dt_hash_t key)
 {
-  if(!src) return NULL;
+  for(GList *l = pipe->detail_masks; l; l = g_list_next(l))
+  {
+    dt_dev_detail_variant_t *variant = l->data;
+    if(variant->key == key)
+    {
+      // most recently used first
+      pipe->detail_masks = g_list_remove_link(pipe->detail_masks, l);
+      pipe->detail_masks = g_list_concat(l, pipe->detail_masks);
+      variant->refs++;
+      return variant;
+    }
+  }
+  return NULL;
+}
+
+// keeps data as a variant and takes a reference, data is owned by the cache from now on
+static dt_dev_detail_variant_t *_add_detail_variant(dt_dev_pixelpipe_t *pipe,
+                                                    const dt_hash_t key,
+                                                    float *data,
+                                                    const int width,
+                                                    const int height)
+{
+  dt_dev_detail_variant_t *variant = calloc(1, sizeof(dt_dev_detail_variant_t));
+  if(!variant)
+  {
+    dt_free_align(data);
+    return NULL;
+  }
+  variant->key = key;
+  variant->width = width;
+  variant->height = height;
+  variant->refs = 1;
+  variant->data = data;
+
+  dt_pthread_mutex_lock(&pipe->detail_masks_mutex);
+  pipe->detail_masks = g_list_prepend(pipe->detail_masks, variant);
+  // drop the least recently used variants nobody holds a reference to, pipes not run
+  // again and again only keep the last one for stacked modules
+  const int keep = (pipe->type & DT_DEV_PIXELPIPE_SCREEN) ? DT_DEV_DETAIL_VARIANTS : 1;
+  int unused = 0;
+  for(GList *l = pipe->detail_masks; l; )
+  {
+    GList *next = g_list_next(l);
+    dt_dev_detail_variant_t *old = l->data;
+    if(old->refs == 0 && ++unused > keep)
+    {
+      pipe->detail_masks = g_list_delete_link(pipe->detail_masks, l);
+      _detail_variant_free(old);
+    }
+    l = next;
+  }
+  dt_pthread_mutex_unlock(&pipe->detail_masks_mutex);
+  return variant;
+}
 
+void dt_dev_release_detail_mask(dt_dev_pixelpipe_t *pipe,
+                                const float *mask)
+{
+  if(!mask) return;
+
+  dt_pthread_mutex_lock(&pipe->detail_masks_mutex);
+  for(GList *l = pipe->detail_masks; l; l = g_list_next(l))
+  {
+    dt_dev_detail_variant_t *variant = l->data;
+    if(variant->data == mask)
+    {
+      variant->refs--;
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&pipe->detail_masks_mutex);
+}
+
+/* The scharr mask prepared by rawprepare or demosaic is refined via threshold and detail and
+   distorted through all pipeline modules until target_module.
+
+   Every refined and distorted mask is kept as a variant with a key covering the threshold and
+   all distortions so far. So a module uses the variant of a module before it with the same
+   threshold and only distorts through the modules in between, unchanged modules don't have to
+   do any work on later pipe runs.
+*/
+const float *dt_dev_get_detail_mask(dt_dev_pixelpipe_iop_t *piece,
+                                    const dt_iop_module_t *target_module,
+                                    const float threshold,
+                                    const gboolean detail,
+                                    const int devid)
+{
   dt_dev_pixelpipe_t *pipe = piece->pipe;
+  if(!pipe->scharr.data) return NULL;
+
   gboolean valid = FALSE;
   const gboolean raw_img = dt_image_is_raw(&pipe->image) || dt_image_is_mono_sraw(&pipe->image);
 
@@ -3677,57 +4399,128 @@ float *dt_dev_distort_detail_mask(dt_dev_pixelpipe_iop_t *piece,
   }
   if(!valid || !source_iter) return NULL;
 
-  dt_iop_roi_t *final_roi = &pipe->scharr.roi;
-
-  float *resmask = src;
-  float *inmask  = src;
+  // the refined mask has the size of the scharr mask, every distorting module adds its
+  // parameters and roi's to the key
+  dt_hash_t key = dt_hash(pipe->scharr.hash, &threshold, sizeof(threshold));
+  key = dt_hash(key, &detail, sizeof(detail));
+
+  // find the last known variant on the way to target_module
+  dt_dev_detail_variant_t *variant = NULL;
+  GList *start_iter = source_iter;
+  gboolean done = FALSE;
+  dt_pthread_mutex_lock(&pipe->detail_masks_mutex);
+  variant = _get_detail_variant(pipe, key);
   for(GList *iter = source_iter; iter; iter = g_list_next(iter))
   {
     dt_dev_pixelpipe_iop_t *it_piece = iter->data;
     if(!_skip_piece_on_tags(it_piece))
     {
       if(it_piece->module->distort_mask && !_empty_finalscale(it_piece))
+      {
+        key = dt_hash(key, &it_piece->hash, sizeof(it_piece->hash));
+        key = dt_hash(key, &it_piece->processed_roi_in, sizeof(dt_iop_roi_t));
+        key = dt_hash(key, &it_piece->processed_roi_out, sizeof(dt_iop_roi_t));
+        dt_dev_detail_variant_t *found = _get_detail_variant(pipe, key);
+        if(found)
+        {
+          if(variant) variant->refs--;
+          variant = found;
+          start_iter = iter;
+          done = TRUE;
+        }
+      }
+      else _distort_piece_roi(it_piece);
+
+      if(it_piece->module == target_module) break;
+    }
+  }
+  dt_pthread_mutex_unlock(&pipe->detail_masks_mutex);
+
+  if(!variant)
+  {
+    float *lum = NULL;
+#ifdef HAVE_OPENCL
+    if(devid > DT_DEVICE_CPU)
+      lum = dt_masks_calc_detail_mask_cl(piece, threshold, detail, devid);
+    else
+#endif
+      lum = dt_masks_calc_detail_mask(piece, threshold, detail);
+    if(!lum) return NULL;
+
+    key = dt_hash(pipe->scharr.hash, &threshold, sizeof(threshold));
+    key = dt_hash(key, &detail, sizeof(detail));
+    variant = _add_detail_variant(pipe, key, lum, pipe->scharr.roi.width, pipe->scharr.roi.height);
+    if(!variant) return NULL;
+    start_iter = source_iter;
+  }
+  key = variant->key;
+
+  // distort from the last known variant on, we only keep the result for target_module
+  float *inmask = variant->data;
+  int width = variant->width;
+  int height = variant->height;
+  gboolean distorted = FALSE;
+  gboolean reached = FALSE;
+  for(GList *iter = start_iter; iter && !reached; iter = g_list_next(iter))
+  {
+    dt_dev_pixelpipe_iop_t *it_piece = iter->data;
+    if(!_skip_piece_on_tags(it_piece))
+    {
+      // the variant already holds the output of the module we start with
+      if(done)
+        done = FALSE;
+      else if(it_piece->module->distort_mask && !_empty_finalscale(it_piece))
       {
         dt_iop_roi_t *roi = &it_piece->processed_roi_in;
         dt_iop_roi_t *roo = &it_piece->processed_roi_out;
         float *tmp = dt_iop_image_alloc(roo->width, roo->height, 1);
+        if(!tmp)
+        {
+          if(distorted) dt_free_align(inmask);
+          dt_dev_release_detail_mask(pipe, variant->data);
+          return NULL;
+        }
         dt_print_pipe(DT_DEBUG_MASKS | DT_DEBUG_PIPE | DT_DEBUG_VERBOSE,
                         "distort detail mask",
                         pipe, it_piece->module, DT_DEVICE_NONE, roi, roo);
 
         it_piece->module->distort_mask(it_piece->module, it_piece, inmask, tmp, roi, roo);
-        resmask = tmp;
-        if(inmask != src) dt_free_align(inmask);
+        if(distorted) dt_free_align(inmask);
         inmask = tmp;
-        final_roi = roo;
+        distorted = TRUE;
+        width = roo->width;
+        height = roo->height;
+        key = dt_hash(key, &it_piece->hash, sizeof(it_piece->hash));
+        key = dt_hash(key, roi, sizeof(dt_iop_roi_t));
+        key = dt_hash(key, roo, sizeof(dt_iop_roi_t));
       }
-      else _distort_piece_roi(it_piece);
-
-      if(it_piece->module == target_module) break;
+      reached = it_piece->module == target_module;
     }
   }
-  const gboolean correct =  piece->processed_roi_out.width == final_roi->width
-                        &&  piece->processed_roi_out.height == final_roi->height;
+
+  if(distorted)
+  {
+    dt_dev_release_detail_mask(pipe, variant->data);
+    variant = _add_detail_variant(pipe, key, inmask, width, height);
+    if(!variant) return NULL;
+  }
+
+  const gboolean correct =  piece->processed_roi_out.width == variant->width
+                        &&  piece->processed_roi_out.height == variant->height;
 
   dt_print_pipe(DT_DEBUG_MASKS | DT_DEBUG_PIPE,
                 correct ? "got detail mask" : "DETAIL SIZE MISMATCH",
                 pipe, target_module, DT_DEVICE_NONE, NULL, NULL,
-                "from (%ix%i) distorted to (%ix%i)",
+                "from (%ix%i) distorted to (%ix%i)%s",
                 pipe->scharr.roi.width, pipe->scharr.roi.height,
-                final_roi->width, final_roi->height);
+                variant->width, variant->height, distorted ? "" : ", cached");
 
   if(!correct)
   {
-    if(resmask != src) dt_free_align(resmask);
-    resmask = NULL;
-  }
-
-  if(src && src == resmask)
-  {
-    resmask = dt_iop_image_alloc(pipe->scharr.roi.width, pipe->scharr.roi.height, 1);
-    dt_iop_image_copy(resmask, src, pipe->scharr.roi.width * pipe->scharr.roi.height);
+    dt_dev_release_detail_mask(pipe, variant->data);
+    return NULL;
   }
-  return resmask;
+  return variant->data;
 }
 
 dt_hash_t dt_dev_pixelpipe_piece_hash(dt_dev_pixelpipe_iop_t *piece,
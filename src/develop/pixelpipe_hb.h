@@ -63,6 +63,11 @@ typedef struct dt_dev_pixelpipe_iop_t
   uint8_t xtrans[6][6];
   uint32_t filters;
   GHashTable *raster_masks;
+  // the last output of this piece, used to reprocess only a dirty region
+  dt_hash_t dirty_hash;           // hash of the cacheline
+  dt_hash_t dirty_input;          // hash of the input it has been processed from
+  dt_hash_t dirty_state;          // params and pipe state it has been processed with
+  dt_iop_roi_t dirty_roi;
 } dt_dev_pixelpipe_iop_t;
 
 typedef enum dt_dev_pixelpipe_change_t
@@ -91,6 +96,34 @@ typedef enum dt_dev_pixelpipe_stopper_t
   DT_DEV_PIXELPIPE_STOP_LAST,
 } dt_dev_pixelpipe_stopper_t;
 
+/**
+ * the region a buffer of the pixelpipe differs from the previous buffer of the
+ * same piece and roi, in coordinates relative to the roi.
+ */
+typedef struct dt_dev_dirty_region_t
+{
+  gboolean valid;  // FALSE if unknown, the buffer must be taken as changed completely
+  dt_hash_t hash;  // hash of the buffer
+  dt_hash_t base;  // hash of the previous buffer
+  int x, y, width, height;
+} dt_dev_dirty_region_t;
+
+// grow the region by border, clipped to width x height
+void dt_dev_dirty_region_grow(dt_dev_dirty_region_t *dirty, int border, int width, int height);
+// for a module with the given overlap and the changed input region in_dirty get the changed
+// output region dirty and the region that has to be processed to get it.
+// Returns FALSE if that is too large to be worth it.
+gboolean dt_dev_dirty_region_local(const dt_dev_dirty_region_t *in_dirty, int overlap,
+                                   int width, int height,
+                                   dt_dev_dirty_region_t *dirty, dt_dev_dirty_region_t *region);
+// bounding box of all pixels differing in the buffers a and b
+void dt_dev_dirty_region_diff(const uint8_t *a, const uint8_t *b, int width, int height, size_t bpp,
+                              dt_dev_dirty_region_t *dirty);
+// copy a width x height block of pixels between buffers of different widths
+void dt_dev_dirty_region_copy(uint8_t *out, int out_width, int out_x, int out_y,
+                              const uint8_t *in, int in_width, int in_x, int in_y,
+                              int width, int height, size_t bpp);
+
 typedef struct dt_dev_detail_mask_t
 {
   dt_iop_roi_t roi;
@@ -146,6 +179,8 @@ typedef struct dt_dev_pixelpipe_t
   float backbuf_scale;
   dt_dev_zoom_pos_t backbuf_zoom_pos;
   dt_hash_t backbuf_hash;
+  // backbuf holds the low resolution pass of progressive rendering
+  gboolean backbuf_coarse;
   dt_pthread_mutex_t mutex, backbuf_mutex, busy_mutex;
   int final_width, final_height;
 
@@ -153,9 +188,19 @@ typedef struct dt_dev_pixelpipe_t
   // as we have to scale the mask later we keep size at that stage
   gboolean want_detail_mask;
   struct dt_dev_detail_mask_t scharr;
+  // refined and distorted variants of the scharr mask, see dt_dev_get_detail_mask()
+  GList *detail_masks;
+  dt_pthread_mutex_t detail_masks_mutex;
+  // distorted raster masks shared by their consumers, see dt_dev_get_raster_mask()
+  GList *raster_variants;
+  dt_pthread_mutex_t raster_variants_mutex;
 
   // avoid cached data for processed module
   gboolean nocache;
+  // running the low resolution pass of progressive rendering, see dt_dev_process_image_job()
+  gboolean progressive;
+  // changed region of the buffer just returned by the recursive processing
+  dt_dev_dirty_region_t dirty;
 
   dt_imgid_t output_imgid;
   // working?
@@ -204,6 +249,10 @@ typedef struct dt_dev_pixelpipe_t
   // module blending cache
   float *bcache_data;
   dt_hash_t bcache_hash;
+  // rasterized drawn shapes kept for later runs, see dt_masks_raster_cache_lookup()
+  GList *mask_rasters;
+  size_t mask_rasters_size;
+  dt_pthread_mutex_t mask_rasters_mutex;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
@@ -310,12 +359,17 @@ void dt_dev_pixelpipe_disable_after(dt_dev_pixelpipe_t *pipe, const char *op);
 // disable given op and all that comes before it in the pipe:
 void dt_dev_pixelpipe_disable_before(dt_dev_pixelpipe_t *pipe, const char *op);
 
-// helper function to pass a raster mask through a (so far) processed pipe
+// helper function to pass a raster mask through a (so far) processed pipe, the mask
+// is read-only and must be handed back via dt_dev_release_raster_mask()
 float *dt_dev_get_raster_mask(dt_dev_pixelpipe_iop_t *piece,
                               const struct dt_iop_module_t *raster_mask_source,
                               const dt_mask_id_t raster_mask_id,
-                              const struct dt_iop_module_t *target_module,
-                              gboolean *free_mask);
+                              const struct dt_iop_module_t *target_module);
+void dt_dev_release_raster_mask(dt_dev_pixelpipe_t *pipe,
+                                const float *mask);
+// drops the distorted raster masks of source, all of them if source is NULL
+void dt_dev_clear_raster_variants(dt_dev_pixelpipe_t *pipe,
+                                  const dt_dev_pixelpipe_iop_t *source);
 // some helper functions related to the details mask interface
 void dt_dev_clear_scharr_mask(dt_dev_pixelpipe_t *pipe);
 
@@ -342,10 +396,16 @@ void dt_print_pipe_ext(const char *title,
                        const char *msg, ...)
   __attribute__((format(printf, 7, 8)));
 
-// helper function writing the pipe-processed ctmask data to dest
-float *dt_dev_distort_detail_mask(dt_dev_pixelpipe_iop_t *piece,
-                                  float *src,
-                                  const struct dt_iop_module_t *target_module);
+// returns the detail mask for threshold and detail refined from the scharr mask and distorted up
+// to target_module. The mask is shared and read-only, hand it back via dt_dev_release_detail_mask().
+// devid is used for the refinement if it's an OpenCL device.
+const float *dt_dev_get_detail_mask(dt_dev_pixelpipe_iop_t *piece,
+                                    const struct dt_iop_module_t *target_module,
+                                    const float threshold,
+                                    const gboolean detail,
+                                    const int devid);
+void dt_dev_release_detail_mask(dt_dev_pixelpipe_t *pipe,
+                                const float *mask);
 
 dt_hash_t dt_dev_pixelpipe_piece_hash(dt_dev_pixelpipe_iop_t *piece,
                                       const dt_iop_roi_t *roi,
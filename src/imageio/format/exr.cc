@@ -280,6 +280,7 @@ icc_end:
   // add masks as additional channels
   // NB: GIMP does not support multi-part EXR files as layers yet
   //     (https://gitlab.gnome.org/GNOME/gimp/-/issues/4379)
+  // buffers to free (TRUE) or raster masks to hand back to the pipe (FALSE)
   std::forward_list<std::pair<gboolean, void *> > mask_bufs;
   if(export_masks && pipe)
   {
@@ -303,8 +304,7 @@ icc_end:
 
         header.channels().insert(layername, Imf::Channel(pixel_type, 1, 1, true));
 
-        gboolean free_mask;
-        float *raster_mask = dt_dev_get_raster_mask(piece, piece->module, GPOINTER_TO_INT(key), NULL, &free_mask);
+        float *raster_mask = dt_dev_get_raster_mask(piece, piece->module, GPOINTER_TO_INT(key), NULL);
 
         if(!raster_mask)
           return 1;
@@ -315,7 +315,8 @@ icc_end:
 
           data.insert(layername, Imf::Slice(pixel_type, (char *)raster_mask, stride, stride * exr->global.width));
 
-          mask_bufs.emplace_front(free_mask, raster_mask);
+          // shared with the pipe, handed back after writing
+          mask_bufs.emplace_front(FALSE, raster_mask);
         }
         else
         {
@@ -345,7 +346,7 @@ icc_end:
 
           mask_bufs.emplace_front(TRUE, out_mask);
 
-          if(free_mask) dt_free_align(raster_mask);
+          dt_dev_release_raster_mask(pipe, raster_mask);
         }
       } // for all raster masks
     } // for all pipe nodes
@@ -362,6 +363,7 @@ icc_end:
   for(auto &mb : mask_bufs)
   {
     if(mb.first) dt_free_align(mb.second);
+    else dt_dev_release_raster_mask(pipe, (float *)mb.second);
   }
 
   return 0;
@@ -78,7 +78,6 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 
   void *rowdata = NULL;
 
-  gboolean free_mask = FALSE;
   float *raster_mask = NULL;
 #ifdef _WIN32
   wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
@@ -385,8 +384,8 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
       g_hash_table_iter_init(&rm_iter, piece->raster_masks);
       while(g_hash_table_iter_next(&rm_iter, &key, &value))
       {
-        if(free_mask) dt_free_align(raster_mask);
-        raster_mask = dt_dev_get_raster_mask(piece, piece->module, GPOINTER_TO_INT(key), NULL, &free_mask);
+        dt_dev_release_raster_mask(pipe, raster_mask);
+        raster_mask = dt_dev_get_raster_mask(piece, piece->module, GPOINTER_TO_INT(key), NULL);
 
 
         size_t w = d->global.width, h = d->global.height;
@@ -396,7 +395,6 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
           w = missing_raster_mask_w;
           h = missing_raster_mask_h;
           raster_mask = missing_raster_mask;
-          free_mask = FALSE;
         }
 
         TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
@@ -579,8 +577,8 @@ exit:
 #ifdef _WIN32
   g_free(wfilename);
 #endif
-  if(free_mask)
-    dt_free_align(raster_mask);
+  if(pipe)
+    dt_dev_release_raster_mask(pipe, raster_mask);
 
   return rc;
 }
@@ -176,8 +176,7 @@ int write_image(dt_imageio_module_data_t *data, const char *filename, const void
       g_hash_table_iter_init(&rm_iter, piece->raster_masks);
       while(g_hash_table_iter_next(&rm_iter, &key, &value))
       {
-        gboolean free_mask;
-        float *raster_mask = dt_dev_get_raster_mask(piece, piece->module, GPOINTER_TO_INT(key), NULL, &free_mask);
+        float *raster_mask = dt_dev_get_raster_mask(piece, piece->module, GPOINTER_TO_INT(key), NULL);
 
         if(!raster_mask)
            goto exit;
@@ -228,8 +227,7 @@ int write_image(dt_imageio_module_data_t *data, const char *filename, const void
 
         if(free_channel_data)
           free(channel_data);
-        if(free_mask)
-          dt_free_align(raster_mask);
+        dt_dev_release_raster_mask(pipe, raster_mask);
       }
     }
 
@@ -18,6 +18,7 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/colorspaces_inline_conversions.h"
+#include "common/curve_baker.h"
 #include "common/custom_primaries.h"
 #include "common/image.h"
 #include "common/iop_profile.h"
@@ -269,6 +270,7 @@ typedef struct dt_iop_agx_data_t
 {
   tone_mapping_params_t tone_mapping_params;
   primaries_params_t primaries_params;
+  dt_baked_curve_t curve; // log encoding and curve, linearized if there's no look
 } dt_iop_agx_data_t;
 
 static void _set_scene_referred_default_params(dt_iop_agx_params_t *p);
@@ -1054,8 +1056,19 @@ static void _adjust_relative_exposure_from_exposure_params(dt_iop_module_t *self
   _update_pivot_x(old_black_ev, old_white_ev, self, p);
 }
 
+static float _baked_curve(const float x,
+                          const void *const data)
+{
+  const tone_mapping_params_t *params = data;
+  const float log_value = _apply_log_encoding(x, params->range_in_ev, params->black_relative_ev);
+  const float y = _apply_curve(log_value, params);
+  // the look goes between the curve and the linearization
+  return params->look_tuned ? y : powf(fmaxf(0.f, y), params->curve_gamma);
+}
+
 static void _agx_tone_mapping(dt_aligned_pixel_t rgb_in_out,
                               const tone_mapping_params_t *params,
+                              const dt_baked_curve_t *curve,
                               const dt_colormatrix_t rendering_to_xyz_transposed)
 {
   // record current chromaticity angle
@@ -1066,19 +1079,31 @@ static void _agx_tone_mapping(dt_aligned_pixel_t rgb_in_out,
 
   dt_aligned_pixel_t transformed_pixel = { 0.f };
 
-  for_three_channels(k, aligned(rgb_in_out, transformed_pixel : 16))
+  const gboolean baked = dt_baked_curve_valid(curve);
+  if(baked)
   {
-    const float log_value = _apply_log_encoding(rgb_in_out[k], params->range_in_ev, params->black_relative_ev);
-    transformed_pixel[k] = _apply_curve(log_value, params);
+    for_three_channels(k, aligned(rgb_in_out, transformed_pixel : 16))
+      transformed_pixel[k] = dt_baked_curve_eval(curve, rgb_in_out[k]);
+  }
+  else
+  {
+    for_three_channels(k, aligned(rgb_in_out, transformed_pixel : 16))
+    {
+      const float log_value = _apply_log_encoding(rgb_in_out[k], params->range_in_ev, params->black_relative_ev);
+      transformed_pixel[k] = _apply_curve(log_value, params);
+    }
   }
 
   if(params->look_tuned)
     _agx_look(transformed_pixel, params, rendering_to_xyz_transposed);
 
-  // Linearize
-  for_three_channels(k, aligned(transformed_pixel : 16))
+  // Linearize, the baked curve already did without a look
+  if(!baked || params->look_tuned)
   {
-    transformed_pixel[k] = powf(fmaxf(0.f, transformed_pixel[k]), params->curve_gamma);
+    for_three_channels(k, aligned(transformed_pixel : 16))
+    {
+      transformed_pixel[k] = powf(fmaxf(0.f, transformed_pixel[k]), params->curve_gamma);
+    }
   }
 
   // get post-curve chroma angle
@@ -1402,7 +1427,7 @@ void process(dt_iop_module_t *self,
     dt_apply_transposed_color_matrix(base_rgb, base_to_rendering_transposed, rendering_rgb);
 
     // Apply the tone mapping curve and look adjustments
-    _agx_tone_mapping(rendering_rgb, &d->tone_mapping_params,
+    _agx_tone_mapping(rendering_rgb, &d->tone_mapping_params, &d->curve,
                       rendering_profile.matrix_in_transposed);
 
     // Convert from internal rendering space back to pipe working space
@@ -1713,6 +1738,8 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_agx_data_t *d = piece->data;
+  dt_baked_curve_cleanup(&d->curve);
   dt_free_align(piece->data);
   piece->data = NULL;
 }
@@ -2659,6 +2686,15 @@ void commit_params(dt_iop_module_t *self,
   // Calculate curve parameters once
   processing_params->tone_mapping_params = _calculate_tone_mapping_params(p);
   processing_params->primaries_params = _get_primaries_params(p);
+
+  // the log encoding clips below black and above white, so the table only
+  // needs to cover the dynamic range
+  const tone_mapping_params_t *params = &processing_params->tone_mapping_params;
+  dt_baked_curve_cleanup(&processing_params->curve);
+  dt_baked_curve_init(&processing_params->curve, _baked_curve, params,
+                      0.09f * exp2f(params->black_relative_ev),
+                      0.36f * exp2f(params->black_relative_ev + params->range_in_ev),
+                      DT_CURVE_BAKER_TOLERANCE);
 }
 
 void reload_defaults(dt_iop_module_t *self)
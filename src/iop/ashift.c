@@ -66,6 +66,10 @@
 #define LSD_DENSITY_TH 0.7                  // LSD: minimal density of region points in rectangle
 #define LSD_N_BINS 1024                     // LSD: number of bins in pseudo-ordering of gradient modulus
 #define LSD_GAMMA 0.45                      // gamma correction to apply on raw images prior to line detection
+#define LSD_MAX_PIXELS 3000000              // LSD: larger images are scaled down prior to line detection
+#define LSD_BAND_HEIGHT 256                 // LSD: minimum height of the horizontal bands detected in parallel
+#define LSD_BAND_OVERLAP 32                 // LSD: number of rows each band sees of its neighbours
+#define LSD_JOIN_DISTANCE 2.0               // LSD: max distance of line pieces at band borders to be joined
 #define RANSAC_RUNS 400                     // how many iterations to run in ransac
 #define RANSAC_EPSILON 2                    // starting value for ransac epsilon (in -log10 units)
 #define RANSAC_EPSILON_STEP 1               // step size of epsilon optimization (log10 units)
@@ -77,6 +81,7 @@
 #define NMS_EPSILON 1e-3                    // break criterion for Nelder-Mead simplex
 #define NMS_SCALE 1.0                       // scaling factor for Nelder-Mead simplex
 #define NMS_ITERATIONS 400                  // number of iterations for Nelder-Mead simplex
+#define NMS_STARTS 4                        // number of Nelder-Mead simplex fits run in parallel from different start points
 #define NMS_CROP_EPSILON 100.0              // break criterion for Nelder-Mead simplex on crop fitting
 #define NMS_CROP_SCALE 0.5                  // scaling factor for Nelder-Mead simplex on crop fitting
 #define NMS_CROP_ITERATIONS 100             // number of iterations for Nelder-Mead simplex on crop fitting
@@ -1471,6 +1476,235 @@ static void gamma_correct(const float *const in,
   }
 }
 
+// end points of line segments cut at the border of their band
+typedef enum dt_iop_ashift_clip_t
+{
+  ASHIFT_CLIP_NONE = 0,
+  ASHIFT_CLIP_TOP = 1,
+  ASHIFT_CLIP_BOTTOM = 2,
+  ASHIFT_CLIP_REMOVED = 4 // joined into a segment of the next band
+} dt_iop_ashift_clip_t;
+
+typedef struct dt_iop_ashift_lsd_band_t
+{
+  double *lines;                 // LSD output, 7 values per segment
+  dt_iop_ashift_clip_t *clipped; // 2 per segment, one for each end point
+  int count;
+} dt_iop_ashift_lsd_band_t;
+
+// cut a segment to the rows in [top, bottom], returns FALSE if nothing is left
+static gboolean _clip_segment(double *seg,
+                              dt_iop_ashift_clip_t *clipped,
+                              const double top,
+                              const double bottom)
+{
+  const double dx = seg[2] - seg[0];
+  const double dy = seg[3] - seg[1];
+  clipped[0] = clipped[1] = ASHIFT_CLIP_NONE;
+
+  // horizontal segments belong to the band they are in
+  if(fabs(dy) < 1e-6) return seg[1] >= top && seg[1] < bottom;
+
+  const double t_top = (top - seg[1]) / dy;
+  const double t_bottom = (bottom - seg[1]) / dy;
+  const double t0 = MAX(0.0, MIN(t_top, t_bottom));
+  const double t1 = MIN(1.0, MAX(t_top, t_bottom));
+  if(t1 <= t0 || (t1 - t0) * sqrt(dx * dx + dy * dy) < 1.0) return FALSE;
+
+  const double x0 = seg[0];
+  const double y0 = seg[1];
+  if(t0 > 0.0)
+  {
+    seg[0] = x0 + t0 * dx;
+    seg[1] = y0 + t0 * dy;
+    clipped[0] = dy > 0.0 ? ASHIFT_CLIP_TOP : ASHIFT_CLIP_BOTTOM;
+  }
+  if(t1 < 1.0)
+  {
+    seg[2] = x0 + t1 * dx;
+    seg[3] = y0 + t1 * dy;
+    clipped[1] = dy > 0.0 ? ASHIFT_CLIP_BOTTOM : ASHIFT_CLIP_TOP;
+  }
+  return TRUE;
+}
+
+// index of the end point cut at the given border, -1 if there is none
+static inline int _clipped_end(const dt_iop_ashift_lsd_band_t *band,
+                               const int n,
+                               const dt_iop_ashift_clip_t border)
+{
+  if(band->clipped[2 * n] == border) return 0;
+  if(band->clipped[2 * n + 1] == border) return 1;
+  return -1;
+}
+
+static inline double _segment_length(const double *seg)
+{
+  return sqrt((seg[2] - seg[0]) * (seg[2] - seg[0]) + (seg[3] - seg[1]) * (seg[3] - seg[1]));
+}
+
+// the two pieces of a line at a band border need to point into the same
+// direction within the LSD angle tolerance
+static inline gboolean _same_direction(const double *a, const double *b)
+{
+  const double cross = (a[2] - a[0]) * (b[3] - b[1]) - (a[3] - a[1]) * (b[2] - b[0]);
+  return fabs(cross) <= sin(LSD_ANG_TH * M_PI / 180.0) * _segment_length(a) * _segment_length(b);
+}
+
+// join the piece a of the upper band into piece b of the lower band, the end
+// of b at the border is replaced by the far end of a. b may be joined again
+// at the next border that way.
+static void _join_segments(dt_iop_ashift_lsd_band_t *upper,
+                           const int i,
+                           const int ei,
+                           dt_iop_ashift_lsd_band_t *lower,
+                           const int j,
+                           const int ej)
+{
+  double *a = upper->lines + 7 * i;
+  double *b = lower->lines + 7 * j;
+  const double length_a = _segment_length(a);
+  const double length_b = _segment_length(b);
+
+  b[2 * ej] = a[2 * (1 - ei)];
+  b[2 * ej + 1] = a[2 * (1 - ei) + 1];
+  b[4] = MAX(a[4], b[4]);
+  b[5] = (a[5] * length_a + b[5] * length_b) / (length_a + length_b);
+  b[6] = MAX(a[6], b[6]);
+  lower->clipped[2 * j + ej] = upper->clipped[2 * i + 1 - ei];
+  upper->clipped[2 * i] = upper->clipped[2 * i + 1] = ASHIFT_CLIP_REMOVED;
+}
+
+// run LSD on horizontal bands of the image in parallel. Each band sees some
+// rows of its neighbours, segments are cut to the rows owned by their band
+// and the pieces of lines crossing band borders are joined again. Returns
+// the segments in the format of LineSegmentDetection().
+static double *_detect_lines(double *greyscale,
+                             const int width,
+                             const int height,
+                             const double scale,
+                             int *lines_count)
+{
+  *lines_count = 0;
+  if(height / LSD_BAND_HEIGHT < 2)
+    return LineSegmentDetection(lines_count, greyscale, width, height,
+                                scale, LSD_SIGMA_SCALE, LSD_QUANT,
+                                LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                LSD_N_BINS, 0.0, NULL, NULL, NULL);
+
+  // scale the image once so all bands share the same sampling grid
+  image_double image = new_image_double_ptr((unsigned int)width, (unsigned int)height, greyscale);
+  image_double scaled = scale != 1.0 ? gaussian_sampler(image, scale, LSD_SIGMA_SCALE) : image;
+  const int swidth = scaled->xsize;
+  const int sheight = scaled->ysize;
+
+  // the bands only depend on the image size so the result doesn't depend on the threads
+  const int nbands = MAX(sheight / LSD_BAND_HEIGHT, 1);
+  // the number of tests of the whole image, see LineSegmentDetection()
+  const double log_nt = 2.5 * (log10((double)swidth) + log10((double)sheight)) + log10(11.0);
+  dt_iop_ashift_lsd_band_t *bands = calloc(nbands, sizeof(dt_iop_ashift_lsd_band_t));
+  if(!bands)
+  {
+    if(scaled != image) free_image_double(scaled);
+    free((void *)image);
+    return NULL;
+  }
+
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int b = 0; b < nbands; b++)
+  {
+    const int core_start = (int)((size_t)sheight * b / nbands);
+    const int core_end = (int)((size_t)sheight * (b + 1) / nbands);
+    const int start = MAX(core_start - LSD_BAND_OVERLAP, 0);
+    const int end = MIN(core_end + LSD_BAND_OVERLAP, sheight);
+
+    int count = 0;
+    double *lines = LineSegmentDetection(&count, scaled->data + (size_t)start * swidth, swidth, end - start,
+                                         1.0, LSD_SIGMA_SCALE, LSD_QUANT,
+                                         LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                         LSD_N_BINS, log_nt, NULL, NULL, NULL);
+    dt_iop_ashift_clip_t *clipped = malloc(sizeof(dt_iop_ashift_clip_t) * 2 * MAX(count, 1));
+
+    // the outer borders of the image are not cut
+    const double top = b == 0 ? -sheight : core_start;
+    const double bottom = b == nbands - 1 ? 2.0 * sheight : core_end;
+    int n = 0;
+    for(int k = 0; k < count && clipped; k++)
+    {
+      double *seg = lines + 7 * n;
+      memmove(seg, lines + 7 * k, sizeof(double) * 7);
+      seg[1] += start;
+      seg[3] += start;
+      if(_clip_segment(seg, clipped + 2 * n, top, bottom)) n++;
+    }
+
+    bands[b].lines = lines;
+    bands[b].clipped = clipped;
+    bands[b].count = clipped ? n : 0;
+  }
+
+  if(scaled != image) free_image_double(scaled);
+  free((void *)image);
+
+  // join the pieces at each border, top to bottom
+  for(int b = 0; b < nbands - 1; b++)
+  {
+    dt_iop_ashift_lsd_band_t *upper = &bands[b];
+    dt_iop_ashift_lsd_band_t *lower = &bands[b + 1];
+    for(int i = 0; i < upper->count; i++)
+    {
+      const int ei = _clipped_end(upper, i, ASHIFT_CLIP_BOTTOM);
+      if(ei < 0) continue;
+
+      const double *a = upper->lines + 7 * i;
+      int best = -1;
+      int best_end = -1;
+      double best_distance = DBL_MAX;
+      for(int j = 0; j < lower->count; j++)
+      {
+        const int ej = _clipped_end(lower, j, ASHIFT_CLIP_TOP);
+        if(ej < 0) continue;
+
+        const double *c = lower->lines + 7 * j;
+        const double distance = fabs(a[2 * ei] - c[2 * ej]);
+        if(distance < best_distance
+           && distance <= LSD_JOIN_DISTANCE + 0.5 * MAX(a[4], c[4])
+           && _same_direction(a, c))
+        {
+          best = j;
+          best_end = ej;
+          best_distance = distance;
+        }
+      }
+      if(best >= 0) _join_segments(upper, i, ei, lower, best, best_end);
+    }
+  }
+
+  int total = 0;
+  for(int b = 0; b < nbands; b++) total += bands[b].count;
+
+  // collect the segments, scaled back to the input image like LSD does
+  double *lines = malloc(sizeof(double) * 7 * MAX(total, 1));
+  int n = 0;
+  for(int b = 0; b < nbands; b++)
+  {
+    for(int k = 0; k < bands[b].count && lines; k++)
+    {
+      if(bands[b].clipped[2 * k] == ASHIFT_CLIP_REMOVED) continue;
+
+      double *seg = lines + 7 * n++;
+      memcpy(seg, bands[b].lines + 7 * k, sizeof(double) * 7);
+      for(int c = 0; c < 5; c++) seg[c] /= scale;
+    }
+    free(bands[b].lines);
+    free(bands[b].clipped);
+  }
+  free(bands);
+
+  *lines_count = n;
+  return lines;
+}
+
 // do actual line_detection based on LSD algorithm and return results according
 // to this module's conventions
 static gboolean line_detect(float *in,
@@ -1527,10 +1761,14 @@ static gboolean line_detect(float *in,
   // it returns structural details as vector 'double lines[7 * lines_count]'
   int lines_count;
 
-  lsd_lines = LineSegmentDetection(&lines_count, greyscale, width, height,
-                                   LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
-                                   LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
-                                   LSD_N_BINS, NULL, NULL, NULL);
+  // large images are scaled down, LSD does so with proper low-pass
+  // filtering and reports the segments in full resolution
+  const double lsd_scale = MIN(LSD_SCALE, sqrt((double)LSD_MAX_PIXELS / ((double)width * height)));
+
+  const double start = dt_get_debug_wtime();
+  lsd_lines = _detect_lines(greyscale, width, height, lsd_scale, &lines_count);
+  dt_print(DT_DEBUG_PERF, "[ashift] %d line segments detected at scale %.2f, took %.3f sec",
+           lines_count, lsd_scale, dt_get_debug_wtime() - start);
 
   // we count the lines that we really want to use
   int lct = 0;
@@ -2250,6 +2488,47 @@ static double model_fitness(double *params, void *data)
   return sum;
 }
 
+// sanity check: in case of extreme values the image gets distorted
+// so strongly that it spans an insanely huge area. we check that
+// case and assume values that increase the image area by more than
+// a factor of 4 as being insane.
+static gboolean _fit_is_sane(const dt_iop_ashift_fit_params_t *fit)
+{
+  float DT_ALIGNED_ARRAY homograph[3][3];
+  _homography((float *)homograph, fit->rotation, fit->lensshift_v, fit->lensshift_h,
+              fit->shear, fit->f_length_kb,
+              fit->orthocorr, fit->aspect, fit->width, fit->height, ASHIFT_HOMOGRAPH_FORWARD);
+
+  // visit all four corners and find maximum span
+  float xm = FLT_MAX, xM = -FLT_MAX, ym = FLT_MAX, yM = -FLT_MAX;
+  for(int y = 0; y < fit->height; y += fit->height - 1)
+    for(int x = 0; x < fit->width; x += fit->width - 1)
+    {
+      float DT_ALIGNED_PIXEL pi[3], DT_ALIGNED_PIXEL po[3];
+      pi[0] = x;
+      pi[1] = y;
+      pi[2] = 1.0f;
+      mat3mulv(po, (float *)homograph, pi);
+      po[0] /= po[2];
+      po[1] /= po[2];
+      xm = MIN(xm, po[0]);
+      ym = MIN(ym, po[1]);
+      xM = MAX(xM, po[0]);
+      yM = MAX(yM, po[1]);
+    }
+
+  if((xM - xm) * (yM - ym) > 4.0f * fit->width * fit->height)
+  {
+#ifdef ASHIFT_DEBUG
+    printf("optimization not successful: degenerate case with"
+           " area growth factor (%f) exceeding limits\n",
+           (xM - xm) * (yM - ym) / (fit->width * fit->height));
+#endif
+    return FALSE;
+  }
+  return TRUE;
+}
+
 // setup all data structures for fitting and call NM simplex
 static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *self,
                                         dt_iop_ashift_params_t *p,
@@ -2376,86 +2655,87 @@ static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *self,
     return NMS_NOT_ENOUGH_LINES;
   }
 
-  // start the simplex fit
-  const int iter = simplex(model_fitness, params, fit.params_count,
-                           NMS_EPSILON, NMS_SCALE, NMS_ITERATIONS, NULL, (void*)&fit);
+  // start the simplex fits. the first one starts at the current
+  // parameters as always, the others at the neutral parameters and at
+  // shifted current ones to get out of local minima. they are
+  // independent so they run in parallel.
+  double starts[NMS_STARTS][4];
+  int iters[NMS_STARTS];
+  double fitness[NMS_STARTS];
+  for(int s = 0; s < NMS_STARTS; s++)
+    for(int k = 0; k < fit.params_count; k++)
+      starts[s][k] = s == 0 ? params[k] : s == 1 ? 0.0 : params[k] + (s & 1 ? 0.5 : -0.5);
+
+  const double start = dt_get_debug_wtime();
+  DT_OMP_FOR(shared(starts, iters, fitness))
+  for(int s = 0; s < NMS_STARTS; s++)
+  {
+    iters[s] = simplex(model_fitness, starts[s], fit.params_count,
+                       NMS_EPSILON, NMS_SCALE, NMS_ITERATIONS, NULL, (void*)&fit);
+    fitness[s] = model_fitness(starts[s], (void*)&fit);
+  }
 
-  // error case: the fit did not converge
-  if(iter >= NMS_ITERATIONS)
+  // keep the best of the converged and sane fits
+  dt_iop_ashift_nmsresult_t result = NMS_DID_NOT_CONVERGE;
+  double best = DBL_MAX;
+  for(int s = 0; s < NMS_STARTS; s++)
   {
+    // error case: the fit did not converge
+    if(iters[s] >= NMS_ITERATIONS)
+    {
 #ifdef ASHIFT_DEBUG
-    printf("optimization not successful: maximum number of iterations reached (%d)\n", iter);
+      printf("optimization not successful: maximum number of iterations reached (%d)\n", iters[s]);
 #endif
-    return NMS_DID_NOT_CONVERGE;
-  }
+      continue;
+    }
 
-  // fit was successful: now consolidate the results (order matters!!!)
-  pcount = 0;
-  fit.rotation = dt_isnan(fit.rotation)
-    ? ilogit(params[pcount++], -fit.rotation_range, fit.rotation_range)
-    : fit.rotation;
+    // fit was successful: now consolidate the results (order matters!!!)
+    dt_iop_ashift_fit_params_t res = fit;
+    pcount = 0;
+    res.rotation = dt_isnan(fit.rotation)
+      ? ilogit(starts[s][pcount++], -fit.rotation_range, fit.rotation_range)
+      : fit.rotation;
 
-  fit.lensshift_v = dt_isnan(fit.lensshift_v)
-    ? ilogit(params[pcount++], -fit.lensshift_v_range, fit.lensshift_v_range)
-    : fit.lensshift_v;
+    res.lensshift_v = dt_isnan(fit.lensshift_v)
+      ? ilogit(starts[s][pcount++], -fit.lensshift_v_range, fit.lensshift_v_range)
+      : fit.lensshift_v;
 
-  fit.lensshift_h = dt_isnan(fit.lensshift_h)
-    ? ilogit(params[pcount++], -fit.lensshift_h_range, fit.lensshift_h_range)
-    : fit.lensshift_h;
+    res.lensshift_h = dt_isnan(fit.lensshift_h)
+      ? ilogit(starts[s][pcount++], -fit.lensshift_h_range, fit.lensshift_h_range)
+      : fit.lensshift_h;
 
-  fit.shear = dt_isnan(fit.shear)
-    ? ilogit(params[pcount++], -fit.shear_range, fit.shear_range)
-    : fit.shear;
+    res.shear = dt_isnan(fit.shear)
+      ? ilogit(starts[s][pcount++], -fit.shear_range, fit.shear_range)
+      : fit.shear;
 
 #ifdef ASHIFT_DEBUG
-  printf("params after optimization (%d iterations): rotation %f,"
-         " lensshift_v %f, lensshift_h %f, shear %f\n",
-         iter, fit.rotation, fit.lensshift_v, fit.lensshift_h, fit.shear);
+    printf("params after optimization (%d iterations): rotation %f,"
+           " lensshift_v %f, lensshift_h %f, shear %f, fitness %f\n",
+           iters[s], res.rotation, res.lensshift_v, res.lensshift_h, res.shear, fitness[s]);
 #endif
 
-  // sanity check: in case of extreme values the image gets distorted
-  // so strongly that it spans an insanely huge area. we check that
-  // case and assume values that increase the image area by more than
-  // a factor of 4 as being insane.
-  float DT_ALIGNED_ARRAY homograph[3][3];
-  _homography((float *)homograph, fit.rotation, fit.lensshift_v, fit.lensshift_h,
-              fit.shear, fit.f_length_kb,
-              fit.orthocorr, fit.aspect, fit.width, fit.height, ASHIFT_HOMOGRAPH_FORWARD);
-
-  // visit all four corners and find maximum span
-  float xm = FLT_MAX, xM = -FLT_MAX, ym = FLT_MAX, yM = -FLT_MAX;
-  for(int y = 0; y < fit.height; y += fit.height - 1)
-    for(int x = 0; x < fit.width; x += fit.width - 1)
+    if(!_fit_is_sane(&res))
     {
-      float DT_ALIGNED_PIXEL pi[3], DT_ALIGNED_PIXEL po[3];
-      pi[0] = x;
-      pi[1] = y;
-      pi[2] = 1.0f;
-      mat3mulv(po, (float *)homograph, pi);
-      po[0] /= po[2];
-      po[1] /= po[2];
-      xm = MIN(xm, po[0]);
-      ym = MIN(ym, po[1]);
-      xM = MAX(xM, po[0]);
-      yM = MAX(yM, po[1]);
+      if(result != NMS_SUCCESS) result = NMS_INSANE;
+      continue;
     }
 
-  if((xM - xm) * (yM - ym) > 4.0f * fit.width * fit.height)
-  {
-#ifdef ASHIFT_DEBUG
-    printf("optimization not successful: degenerate case with"
-           " area growth factor (%f) exceeding limits\n",
-           (xM - xm) * (yM - ym) / (fit.width * fit.height));
-#endif
-    return NMS_INSANE;
+    if(result != NMS_SUCCESS || fitness[s] < best)
+    {
+      // now write the results into structure p
+      p->rotation = res.rotation;
+      p->lensshift_v = res.lensshift_v;
+      p->lensshift_h = res.lensshift_h;
+      p->shear = res.shear;
+      best = fitness[s];
+      result = NMS_SUCCESS;
+    }
   }
 
-  // now write the results into structure p
-  p->rotation = fit.rotation;
-  p->lensshift_v = fit.lensshift_v;
-  p->lensshift_h = fit.lensshift_h;
-  p->shear = fit.shear;
-  return NMS_SUCCESS;
+  dt_print(DT_DEBUG_PERF, "[ashift] %d simplex fits, took %.3f sec",
+           NMS_STARTS, dt_get_debug_wtime() - start);
+
+  return result;
 }
 
 #ifdef ASHIFT_DEBUG
@@ -3194,6 +3474,11 @@ static gboolean _do_clean_structure(dt_iop_module_t *self,
 }
 
 // helper function to start analysis for structural data and report about errors
+// TODO: auto-straightening from darktable-cli or Lua needs a headless entry point.
+// line_detect() and _detect_lines() already work on any buffer, but the buffer is
+// the preview captured in g->buf and _remove_outliers() and nmsfit() take the
+// lines and fit ranges from the gui data. Those have to move into a struct of
+// their own passed to both before the fit can run without the darkroom.
 static gboolean _do_get_structure_auto(dt_iop_module_t *self,
                                   dt_iop_ashift_params_t *p,
                                   const dt_iop_ashift_enhance_t enhance)
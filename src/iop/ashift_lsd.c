@@ -1068,10 +1068,15 @@ static double log_gamma_windschitl(const double x)
 
 static double *inv = NULL; /* table to keep computed inverse values */
 
+// the table is filled once and read-only afterwards, so the detector can
+// run on several parts of an image in parallel
 __attribute__((constructor)) static void invConstructor()
 {
   if(inv) return;
   inv = malloc(sizeof(double) * TABSIZE);
+  if(!inv) return;
+  inv[0] = 0.0;
+  for(int i = 1; i < TABSIZE; i++) inv[i] = 1.0 / (double) i;
 }
 
 __attribute__((destructor)) static void invDestructor()
@@ -1176,13 +1181,12 @@ static double nfa(const int n, const int k, const double p, const double logNT)
            term_i / term_i-1 = (n-i+1)/i * p/(1-p)
          and
            term_i = term_i-1 * (n-i+1)/i * p/(1-p).
-         1/i is stored in a table as they are computed,
+         1/i is taken from a precomputed table,
          because divisions are expensive.
          p/(1-p) is computed only once and stored in 'p_term'.
        */
-      bin_term = (double) (n-i+1) * ( i<TABSIZE ?
-                   ( inv[i]!=0.0 ? inv[i] : ( inv[i] = 1.0 / (double) i ) ) :
-                   1.0 / (double) i );
+      bin_term = (double) (n-i+1) * ( i<TABSIZE && inv ?
+                   inv[i] : 1.0 / (double) i );
 
       mult_term = bin_term * p_term;
       term *= mult_term;
@@ -2077,13 +2081,17 @@ static int refine( struct point * reg, int * reg_size, const image_double modgra
 
 /*----------------------------------------------------------------------------*/
 /** LSD full interface.
+
+    log_nt is the logarithm of the number of tests, it's derived from the
+    image size if not positive. Parts of an image can be processed with the
+    value of the whole image so their detections are validated the same way.
  */
 static
 double * LineSegmentDetection( int * n_out,
                                double * img, const int X, const int Y,
                                const double scale, const double sigma_scale, const double quant,
                                const double ang_th, const double log_eps, const double density_th,
-                               const int n_bins,
+                               const int n_bins, const double log_nt,
                                int ** reg_img, int * reg_x, int * reg_y )
 {
   image_double image;
@@ -2148,7 +2156,8 @@ double * LineSegmentDetection( int * n_out,
      whose logarithm value is
        log10(11) + 5/2 * (log10(X) + log10(Y)).
   */
-  logNT = 5.0 * ( log10( (double) xsize ) + log10( (double) ysize ) ) / 2.0
+  logNT = log_nt > 0.0 ? log_nt
+        : 5.0 * ( log10( (double) xsize ) + log10( (double) ysize ) ) / 2.0
           + log10(11.0);
   min_reg_size = (int) (-logNT/log10(p)); /* minimal number of points in region
                                              that can give a meaningful event */
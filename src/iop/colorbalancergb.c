@@ -186,7 +186,8 @@ const char **description(dt_iop_module_t *self)
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING
+    | IOP_FLAGS_EXACT_LOCAL;
 }
 
 int default_group()
@@ -907,10 +908,10 @@ void process(dt_iop_module_t *self,
 
     if(mask_display)
     {
-      // draw checkerboard
+      // draw checkerboard in image coordinates, so tiles and parts of the roi match the full roi
       dt_aligned_pixel_t color;
-      const size_t i = (k / 4) / out_width;
-      const size_t j = (k / 4) % out_width;
+      const size_t i = (k / 4) / out_width + roi_out->y;
+      const size_t j = (k / 4) % out_width + roi_out->x;
       if(i % checker_1 < i % checker_2)
       {
         if(j % checker_1 < j % checker_2)
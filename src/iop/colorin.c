@@ -137,7 +137,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_EXACT_LOCAL;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
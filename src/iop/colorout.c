@@ -20,6 +20,7 @@
 #include "common/colorspaces.h"
 #include "common/colorspaces_inline_conversions.h"
 #include "common/dttypes.h"
+#include "common/icc_lut.h"
 #include "common/imagebuf.h"
 #include "common/iop_profile.h"
 #include "common/opencl.h"
@@ -45,6 +46,17 @@
 
 DT_MODULE_INTROSPECTION(5, dt_iop_colorout_params_t)
 
+// number of sampled luts no pipe is using anymore that are kept around for reuse
+#define DT_IOP_COLOROUT_CACHE_UNUSED 2
+
+// a sampled lcms transform, shared read-only by all the pipes using the same profile and intent
+typedef struct dt_iop_colorout_cache_t
+{
+  dt_hash_t hash;   // see dt_icc_lut_hash()
+  dt_icc_lut_t *lut;
+  int users;        // number of pipes holding this lut
+} dt_iop_colorout_cache_t;
+
 typedef struct dt_iop_colorout_data_t
 {
   dt_colorspaces_color_profile_type_t type;
@@ -52,12 +64,15 @@ typedef struct dt_iop_colorout_data_t
   float lut[3][LUT_SAMPLES];
   dt_colormatrix_t cmatrix;
   cmsHTRANSFORM *xform;
+  dt_iop_colorout_cache_t *icc_lut; // reference into the global lut cache, replaces xform if set
   float unbounded_coeffs[3][3]; // for extrapolation of shaper curves
 } dt_iop_colorout_data_t;
 
 typedef struct dt_iop_colorout_global_data_t
 {
   int kernel_colorout;
+  dt_pthread_mutex_t lut_lock;
+  GList *luts; // dt_iop_colorout_cache_t, most recently used first
 } dt_iop_colorout_global_data_t;
 
 typedef struct dt_iop_colorout_params_t
@@ -97,7 +112,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE;
+  return IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_ONE_INSTANCE | IOP_FLAGS_EXACT_LOCAL;
 }
 
 dt_iop_colorspace_type_t default_colorspace(dt_iop_module_t *self,
@@ -228,8 +243,9 @@ int legacy_params(dt_iop_module_t *self,
 void init_global(dt_iop_module_so_t *self)
 {
   const int program = 2; // basic.cl, from programs.conf
-  dt_iop_colorout_global_data_t *gd = malloc(sizeof(dt_iop_colorout_global_data_t));
+  dt_iop_colorout_global_data_t *gd = calloc(1, sizeof(dt_iop_colorout_global_data_t));
   self->data = gd;
+  dt_pthread_mutex_init(&gd->lut_lock, NULL);
   gd->kernel_colorout = dt_opencl_create_kernel(program, "colorout");
 }
 
@@ -237,10 +253,92 @@ void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_colorout_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->kernel_colorout);
+  for(GList *l = gd->luts; l; l = g_list_next(l))
+  {
+    dt_iop_colorout_cache_t *lut = l->data;
+    dt_icc_lut_free(lut->lut);
+    free(lut);
+  }
+  g_list_free(gd->luts);
+  dt_pthread_mutex_destroy(&gd->lut_lock);
   free(self->data);
   self->data = NULL;
 }
 
+// drop the luts nobody uses beyond the most recently used ones, called with the lock held
+static void _lut_cache_trim(dt_iop_colorout_global_data_t *gd)
+{
+  int unused = 0;
+  GList *l = gd->luts;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    dt_iop_colorout_cache_t *lut = l->data;
+    if(lut->users == 0 && ++unused > DT_IOP_COLOROUT_CACHE_UNUSED)
+    {
+      dt_icc_lut_free(lut->lut);
+      free(lut);
+      gd->luts = g_list_delete_link(gd->luts, l);
+    }
+    l = next;
+  }
+}
+
+// returns the sampled xform into profile, sampling it only if no pipe has it already.
+// the caller holds a reference until _lut_release()
+static dt_iop_colorout_cache_t *_lut_acquire(dt_iop_colorout_global_data_t *gd,
+                                             cmsHTRANSFORM xform,
+                                             cmsHPROFILE profile,
+                                             const dt_iop_color_intent_t intent)
+{
+  const dt_hash_t hash = dt_icc_lut_hash(profile, intent, DT_ICC_LUT_SIZE);
+  if(hash == DT_INVALID_HASH) return NULL;
+
+  dt_pthread_mutex_lock(&gd->lut_lock);
+  for(GList *l = gd->luts; l; l = g_list_next(l))
+  {
+    dt_iop_colorout_cache_t *lut = l->data;
+    if(lut->hash == hash)
+    {
+      lut->users++;
+      gd->luts = g_list_remove_link(gd->luts, l);
+      gd->luts = g_list_concat(l, gd->luts);
+      dt_pthread_mutex_unlock(&gd->lut_lock);
+      return lut;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->lut_lock);
+
+  // sample outside of the lock, the worst that can happen is two pipes sampling the same profile
+  dt_icc_lut_t *icc_lut = dt_icc_lut_new(xform, profile, hash, DT_ICC_LUT_SIZE);
+  if(!icc_lut) return NULL;
+
+  dt_iop_colorout_cache_t *lut = malloc(sizeof(dt_iop_colorout_cache_t));
+  if(!lut)
+  {
+    dt_icc_lut_free(icc_lut);
+    return NULL;
+  }
+  lut->hash = hash;
+  lut->lut = icc_lut;
+  lut->users = 1;
+
+  dt_pthread_mutex_lock(&gd->lut_lock);
+  gd->luts = g_list_prepend(gd->luts, lut);
+  _lut_cache_trim(gd);
+  dt_pthread_mutex_unlock(&gd->lut_lock);
+  return lut;
+}
+
+static void _lut_release(dt_iop_colorout_global_data_t *gd, dt_iop_colorout_cache_t *lut)
+{
+  if(!lut) return;
+  dt_pthread_mutex_lock(&gd->lut_lock);
+  lut->users--;
+  _lut_cache_trim(gd);
+  dt_pthread_mutex_unlock(&gd->lut_lock);
+}
+
 static void intent_changed(GtkWidget *widget, dt_iop_module_t *self)
 {
   if(darktable.gui->reset) return;
@@ -541,6 +639,10 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
     if(!_transform_cmatrix(d, out, (float*)ivoid, npixels))
       process_fastpath_apply_tonecurves(self, piece, ovoid, roi_out);
   }
+  else if(d->icc_lut)
+  {
+    dt_icc_lut_apply_Lab(d->icc_lut->lut, (float*)ivoid, out, npixels);
+  }
   else
   {
     _transform_lcms(d, out, (float*)ivoid, npixels);
@@ -574,6 +676,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     cmsDeleteTransform(d->xform);
     d->xform = NULL;
   }
+  _lut_release(self->global_data, d->icc_lut);
+  d->icc_lut = NULL;
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
   d->lut[0][0] = -1.0f;
   d->lut[1][0] = -1.0f;
@@ -730,6 +834,15 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     }
   }
 
+  // lcms is slow on LUT based profiles, unless the user asked for lcms use a sampled
+  // transform. Matrix profiles are unbounded in lcms and keep the exact path.
+  if(d->xform
+     && d->mode == DT_PROFILE_NORMAL
+     && !force_lcms2
+     && output_format == TYPE_RGBA_FLT
+     && !cmsIsMatrixShaper(output))
+    d->icc_lut = _lut_acquire(self->global_data, d->xform, output, out_intent);
+
   if(out_type == DT_COLORSPACE_DISPLAY || out_type == DT_COLORSPACE_DISPLAY2)
     pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
 
@@ -774,6 +887,8 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
     cmsDeleteTransform(d->xform);
     d->xform = NULL;
   }
+  _lut_release(self->global_data, d->icc_lut);
+  d->icc_lut = NULL;
 
   free(piece->data);
   piece->data = NULL;
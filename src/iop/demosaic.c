@@ -25,6 +25,7 @@
 #include "common/math.h"
 #include "common/imagebuf.h"
 #include "common/gaussian.h"
+#include "common/fft.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -27,6 +27,9 @@
         gaussian sigma.
       - Note: this is similar to the per-tile sigma in the RT implementation.
    2) It's currently not planned to increase the maximum sigma so we can stay with the 9x9 kernels.
+      The FFT backend used for large exports has a cost independent of the kernel size, but it uses the
+      same kernels. Larger radii via the FFT only are left out on purpose, the darkroom, OpenCL and
+      smaller exports would render differently from large exports then.
    3) Reminders and possibly left to do:
       - halo suppression at very strong gradients?
       - automatic noise detection or reduction?
@@ -45,6 +48,11 @@
 #define CAPTURE_YMIN 0.001f
 #define CAPTURE_CFACLIP 0.9f
 #define CAPTURE_SMALL 0.66f
+#define CAPTURE_FFT_SIZE 128
+#define CAPTURE_FFT_HALO 4
+#define CAPTURE_FFT_VALID (CAPTURE_FFT_SIZE - 2 * CAPTURE_FFT_HALO)
+#define CAPTURE_FFT_KERNELS 4
+#define CAPTURE_FFT_MPIXELS 24
 
 static float _get_variance_threshold(const dt_iop_module_t *self)
 {
@@ -506,6 +514,69 @@ static float _calc_auto_radius(float *const in,
 #undef lowerLimit
 #undef upperLimit
 
+// the gaussian of the 9x9 or, if small, 5x5 kernel at row/col, zero outside of the image
+static inline float _blur_pixel(const float *const in,
+                                const float *const kern,
+                                const gboolean small,
+                                const int row,
+                                const int col,
+                                const int w1,
+                                const int height)
+{
+  const int w2 = 2 * w1;
+  const int w3 = 3 * w1;
+  const int w4 = 4 * w1;
+  const int bd = small ? 2 : 4;
+  float val = 0.0f;
+  if(col >= bd && row >= bd && col < w1 - bd && row < height - bd)
+  {
+    const float *d = in + (size_t)row * w1 + col;
+    if(small)
+    {
+      val =
+        kern[ 5+2] * (d[-w2-1] + d[-w2+1] + d[-w1-2] + d[-w1+2] + d[w1-2] + d[w1+2] + d[w2-1] + d[w2+1]) +
+        kern[   2] * (d[-w2  ] + d[   -2] + d[    2] + d[ w2  ]) +
+        kern[ 5+1] * (d[-w1-1] + d[-w1+1] + d[ w1-1] + d[ w1+1]) +
+        kern[   1] * (d[-w1  ] + d[   -1] + d[    1] + d[ w1  ]) +
+        kern[   0] * (d[0]);
+    }
+    else
+    {
+      val =
+        kern[10+4] * (d[-w4-2] + d[-w4+2] + d[-w2-4] + d[-w2+4] + d[w2-4] + d[w2+4] + d[w4-2] + d[w4+2]) +
+        kern[5 +4] * (d[-w4-1] + d[-w4+1] + d[-w1-4] + d[-w1+4] + d[w1-4] + d[w1+4] + d[w4-1] + d[w4+1]) +
+        kern[4]    * (d[-w4  ] + d[   -4] + d[    4] + d[ w4  ]) +
+        kern[15+3] * (d[-w3-3] + d[-w3+3] + d[ w3-3] + d[ w3+3]) +
+        kern[10+3] * (d[-w3-2] + d[-w3+2] + d[-w2-3] + d[-w2+3] + d[w2-3] + d[w2+3] + d[w3-2] + d[w3+2]) +
+        kern[ 5+3] * (d[-w3-1] + d[-w3+1] + d[-w1-3] + d[-w1+3] + d[w1-3] + d[w1+3] + d[w3-1] + d[w3+1]) +
+        kern[   3] * (d[-w3  ] + d[   -3] + d[    3] + d[ w3  ]) +
+        kern[10+2] * (d[-w2-2] + d[-w2+2] + d[ w2-2] + d[ w2+2]) +
+        kern[ 5+2] * (d[-w2-1] + d[-w2+1] + d[-w1-2] + d[-w1+2] + d[w1-2] + d[w1+2] + d[w2-1] + d[w2+1]) +
+        kern[   2] * (d[-w2  ] + d[   -2] + d[    2] + d[ w2  ]) +
+        kern[ 5+1] * (d[-w1-1] + d[-w1+1] + d[ w1-1] + d[ w1+1]) +
+        kern[   1] * (d[-w1  ] + d[   -1] + d[    1] + d[ w1  ]) +
+        kern[   0] * (d[0]);
+    }
+  }
+  else
+  {
+    for(int ir = -bd; ir <= bd; ir++)
+    {
+      const int irow = row+ir;
+      if(irow >= 0 && irow < height)
+      {
+        for(int ic = -bd; ic <= bd; ic++)
+        {
+          const int icol = col+ic;
+          if(icol >=0 && icol < w1)
+            val += kern[5 * ABS(ir) + ABS(ic)] * in[(size_t)irow * w1 + icol];
+        }
+      }
+    }
+  }
+  return val;
+}
+
 DT_OMP_DECLARE_SIMD(aligned(in, out, blend, kernels:64))
 static inline void _blur_mul(const float *const in,
                              float *out,
@@ -515,9 +586,6 @@ static inline void _blur_mul(const float *const in,
                              const int w1,
                              const int height)
 {
-  const int w2 = 2 * w1;
-  const int w3 = 3 * w1;
-  const int w4 = 4 * w1;
   const uint8_t idx_small = _sigma_to_index(CAPTURE_SMALL);
 
   DT_OMP_FOR()
@@ -529,56 +597,7 @@ static inline void _blur_mul(const float *const in,
       if(blend[i] > 0.0f)
       {
         const float *kern = kernels + CAPTURE_KERNEL_ALIGN * table[i];
-        const gboolean small = table[i] < idx_small;
-        const int bd = small ? 2 : 4;
-        float val = 0.0f;
-        if(col >= bd && row >= bd && col < w1 - bd && row < height - bd)
-        {
-          const float *d = in + i;
-          if(small)
-          {
-            val =
-              kern[ 5+2] * (d[-w2-1] + d[-w2+1] + d[-w1-2] + d[-w1+2] + d[w1-2] + d[w1+2] + d[w2-1] + d[w2+1]) +
-              kern[   2] * (d[-w2  ] + d[   -2] + d[    2] + d[ w2  ]) +
-              kern[ 5+1] * (d[-w1-1] + d[-w1+1] + d[ w1-1] + d[ w1+1]) +
-              kern[   1] * (d[-w1  ] + d[   -1] + d[    1] + d[ w1  ]) +
-              kern[   0] * (d[0]);
-          }
-          else
-          {
-            val =
-              kern[10+4] * (d[-w4-2] + d[-w4+2] + d[-w2-4] + d[-w2+4] + d[w2-4] + d[w2+4] + d[w4-2] + d[w4+2]) +
-              kern[5 +4] * (d[-w4-1] + d[-w4+1] + d[-w1-4] + d[-w1+4] + d[w1-4] + d[w1+4] + d[w4-1] + d[w4+1]) +
-              kern[4]    * (d[-w4  ] + d[   -4] + d[    4] + d[ w4  ]) +
-              kern[15+3] * (d[-w3-3] + d[-w3+3] + d[ w3-3] + d[ w3+3]) +
-              kern[10+3] * (d[-w3-2] + d[-w3+2] + d[-w2-3] + d[-w2+3] + d[w2-3] + d[w2+3] + d[w3-2] + d[w3+2]) +
-              kern[ 5+3] * (d[-w3-1] + d[-w3+1] + d[-w1-3] + d[-w1+3] + d[w1-3] + d[w1+3] + d[w3-1] + d[w3+1]) +
-              kern[   3] * (d[-w3  ] + d[   -3] + d[    3] + d[ w3  ]) +
-              kern[10+2] * (d[-w2-2] + d[-w2+2] + d[ w2-2] + d[ w2+2]) +
-              kern[ 5+2] * (d[-w2-1] + d[-w2+1] + d[-w1-2] + d[-w1+2] + d[w1-2] + d[w1+2] + d[w2-1] + d[w2+1]) +
-              kern[   2] * (d[-w2  ] + d[   -2] + d[    2] + d[ w2  ]) +
-              kern[ 5+1] * (d[-w1-1] + d[-w1+1] + d[ w1-1] + d[ w1+1]) +
-              kern[   1] * (d[-w1  ] + d[   -1] + d[    1] + d[ w1  ]) +
-              kern[   0] * (d[0]);
-            }
-        }
-        else
-        {
-          for(int ir = -bd; ir <= bd; ir++)
-          {
-            const int irow = row+ir;
-            if(irow >= 0 && irow < height)
-            {
-              for(int ic = -bd; ic <= bd; ic++)
-              {
-                const int icol = col+ic;
-                if(icol >=0 && icol < w1)
-                  val += kern[5 * ABS(ir) + ABS(ic)] * in[(size_t)irow * w1 + icol];
-              }
-            }
-          }
-        }
-        out[i] *= val;
+        out[i] *= _blur_pixel(in, kern, table[i] < idx_small, row, col, w1, height);
       }
       // if blend value is too low we don't have to copy data as we also didn't in _blur_div
       // and we just keep the original
@@ -596,9 +615,6 @@ static inline void _blur_div(const float *const in,
                              const int w1,
                              const int height)
 {
-  const int w2 = 2 * w1;
-  const int w3 = 3 * w1;
-  const int w4 = 4 * w1;
   const uint8_t idx_small = _sigma_to_index(CAPTURE_SMALL);
 
   DT_OMP_FOR()
@@ -610,56 +626,241 @@ static inline void _blur_div(const float *const in,
       if(blend[i] > 0.0f)
       {
         const float *kern = kernels + CAPTURE_KERNEL_ALIGN * table[i];
-        const gboolean small = table[i] < idx_small;
-        const int bd = small ? 2 : 4;
-        float val = 0.0f;
-        if(col >= bd && row >= bd && col < w1 - bd && row < height - bd)
+        const float val = _blur_pixel(in, kern, table[i] < idx_small, row, col, w1, height);
+        out[i] = luminance[i] / MAX(val, CAPTURE_YMIN);
+      }
+    }
+  }
+}
+
+/* The FFT backend, same kernels and results as _blur_mul/_blur_div up to rounding.
+   - overlap-save on CAPTURE_FFT_SIZE tiles with a halo of the kernel radius, zero outside of the image
+   - two tiles are convolved by one complex transform as the kernel spectra are real
+   - per pair of tiles the kernels used by the most pixels are done via the FFT, the spectra are
+     calculated once and used for all iterations. Remaining pixels, like at image borders or with a
+     boosted radius, are convolved spatially.
+*/
+typedef struct capture_fft_t
+{
+  dt_fft_t *fft;
+  int tiles_x;
+  int tiles;
+  int pairs;
+  int *nkernels;                // per pair of tiles, number of kernels done via the fft
+  uint8_t *kernels;             // per pair of tiles, CAPTURE_FFT_KERNELS kernel indices
+  float *psf[UCHAR_MAX + 1];    // real spectra of the used kernels
+  float *scratch;               // per thread, a tile pair and the product
+  size_t padded;
+} capture_fft_t;
+
+static inline void _capture_fft_tile(const capture_fft_t *cf,
+                                     const int tile,
+                                     int *x0,
+                                     int *y0)
+{
+  *x0 = (tile % cf->tiles_x) * CAPTURE_FFT_VALID;
+  *y0 = (tile / cf->tiles_x) * CAPTURE_FFT_VALID;
+}
+
+static void _capture_fft_free(capture_fft_t *cf)
+{
+  if(!cf) return;
+  for(int k = 0; k <= UCHAR_MAX; k++)
+    dt_free_align(cf->psf[k]);
+  dt_fft_free(cf->fft);
+  dt_free_align(cf->nkernels);
+  dt_free_align(cf->kernels);
+  dt_free_align(cf->scratch);
+  free(cf);
+}
+
+static capture_fft_t *_capture_fft_new(const float *const blend,
+                                       const float *const kernels,
+                                       const unsigned char *const table,
+                                       const int w1,
+                                       const int height)
+{
+  const int n = CAPTURE_FFT_SIZE;
+  capture_fft_t *cf = calloc(1, sizeof(capture_fft_t));
+  if(!cf) return NULL;
+
+  cf->tiles_x = (w1 + CAPTURE_FFT_VALID - 1) / CAPTURE_FFT_VALID;
+  cf->tiles = cf->tiles_x * ((height + CAPTURE_FFT_VALID - 1) / CAPTURE_FFT_VALID);
+  cf->pairs = (cf->tiles + 1) / 2;
+  cf->fft = dt_fft_new(n);
+  cf->nkernels = dt_alloc_aligned(sizeof(int) * cf->pairs);
+  cf->kernels = dt_alloc_aligned((size_t)CAPTURE_FFT_KERNELS * cf->pairs);
+  cf->scratch = dt_alloc_perthread_float(4 * n * n, &cf->padded);
+  if(!cf->fft || !cf->nkernels || !cf->kernels || !cf->scratch)
+  {
+    _capture_fft_free(cf);
+    return NULL;
+  }
+
+  // a kernel is worth a transform if it's used by a quarter of a tile
+  const int min_count = CAPTURE_FFT_VALID * CAPTURE_FFT_VALID / 4;
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int pair = 0; pair < cf->pairs; pair++)
+  {
+    int count[UCHAR_MAX + 1] = { 0 };
+    for(int tile = 2 * pair; tile < MIN(2 * pair + 2, cf->tiles); tile++)
+    {
+      int x0, y0;
+      _capture_fft_tile(cf, tile, &x0, &y0);
+      for(int row = y0; row < MIN(y0 + CAPTURE_FFT_VALID, height); row++)
+      {
+        for(int col = x0; col < MIN(x0 + CAPTURE_FFT_VALID, w1); col++)
         {
-          const float *d = in + i;
-          if(small)
+          const size_t i = (size_t)row * w1 + col;
+          if(blend[i] > 0.0f) count[table[i]]++;
+        }
+      }
+    }
+
+    int nk = 0;
+    uint8_t *list = cf->kernels + (size_t)CAPTURE_FFT_KERNELS * pair;
+    while(nk < CAPTURE_FFT_KERNELS)
+    {
+      int best = 0;
+      for(int k = 1; k <= UCHAR_MAX; k++)
+        if(count[k] > count[best]) best = k;
+      if(count[best] < min_count) break;
+      list[nk++] = best;
+      count[best] = 0;
+    }
+    cf->nkernels[pair] = nk;
+  }
+
+  gboolean used[UCHAR_MAX + 1] = { FALSE };
+  for(int pair = 0; pair < cf->pairs; pair++)
+    for(int k = 0; k < cf->nkernels[pair]; k++)
+      used[cf->kernels[(size_t)CAPTURE_FFT_KERNELS * pair + k]] = TRUE;
+
+  gboolean error = FALSE;
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic) reduction(|: error))
+  for(int k = 0; k <= UCHAR_MAX; k++)
+  {
+    if(!used[k]) continue;
+    cf->psf[k] = dt_alloc_align_float((size_t)n * n);
+    if(!cf->psf[k])
+    {
+      error = TRUE;
+      continue;
+    }
+    float *scratch = dt_get_perthread(cf->scratch, cf->padded);
+    dt_fft_symmetric_kernel(cf->fft, kernels + CAPTURE_KERNEL_ALIGN * k, 4, 5, cf->psf[k], scratch);
+  }
+  if(error)
+  {
+    _capture_fft_free(cf);
+    return NULL;
+  }
+  return cf;
+}
+
+// _blur_div if luminance is given, _blur_mul otherwise
+static void _blur_fft(const capture_fft_t *const cf,
+                      const float *const in,
+                      float *out,
+                      const float *const luminance,
+                      const float *blend,
+                      const float *const kernels,
+                      const unsigned char *const table,
+                      const int w1,
+                      const int height)
+{
+  const int n = CAPTURE_FFT_SIZE;
+  const size_t nn = (size_t)n * n;
+  const uint8_t idx_small = _sigma_to_index(CAPTURE_SMALL);
+
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int pair = 0; pair < cf->pairs; pair++)
+  {
+    const int first = 2 * pair;
+    const int last = MIN(first + 2, cf->tiles);
+    const int nk = cf->nkernels[pair];
+    const uint8_t *list = cf->kernels + (size_t)CAPTURE_FFT_KERNELS * pair;
+    gboolean via_fft[UCHAR_MAX + 1] = { FALSE };
+    for(int k = 0; k < nk; k++) via_fft[list[k]] = TRUE;
+
+    if(nk)
+    {
+      float *const z = dt_get_perthread(cf->scratch, cf->padded);
+      float *const w = z + 2 * nn;
+      // first tile is the real part, second one the imaginary part
+      for(int tile = first; tile < first + 2; tile++)
+      {
+        float *const d = z + (tile - first) * nn;
+        if(tile == last)
+        {
+          memset(d, 0, sizeof(float) * nn);
+          break;
+        }
+        int x0, y0;
+        _capture_fft_tile(cf, tile, &x0, &y0);
+        for(int row = 0; row < n; row++)
+        {
+          const int irow = y0 - CAPTURE_FFT_HALO + row;
+          for(int col = 0; col < n; col++)
           {
-            val =
-              kern[ 5+2] * (d[-w2-1] + d[-w2+1] + d[-w1-2] + d[-w1+2] + d[w1-2] + d[w1+2] + d[w2-1] + d[w2+1]) +
-              kern[   2] * (d[-w2  ] + d[   -2] + d[    2] + d[ w2  ]) +
-              kern[ 5+1] * (d[-w1-1] + d[-w1+1] + d[ w1-1] + d[ w1+1]) +
-              kern[   1] * (d[-w1  ] + d[   -1] + d[    1] + d[ w1  ]) +
-              kern[   0] * (d[0]);
+            const int icol = x0 - CAPTURE_FFT_HALO + col;
+            d[row * n + col] = irow >= 0 && irow < height && icol >= 0 && icol < w1
+                               ? in[(size_t)irow * w1 + icol]
+                               : 0.0f;
           }
-          else
-          {
-            val =
-              kern[10+4] * (d[-w4-2] + d[-w4+2] + d[-w2-4] + d[-w2+4] + d[w2-4] + d[w2+4] + d[w4-2] + d[w4+2]) +
-              kern[5 +4] * (d[-w4-1] + d[-w4+1] + d[-w1-4] + d[-w1+4] + d[w1-4] + d[w1+4] + d[w4-1] + d[w4+1]) +
-              kern[4]    * (d[-w4  ] + d[   -4] + d[    4] + d[ w4  ]) +
-              kern[15+3] * (d[-w3-3] + d[-w3+3] + d[ w3-3] + d[ w3+3]) +
-              kern[10+3] * (d[-w3-2] + d[-w3+2] + d[-w2-3] + d[-w2+3] + d[w2-3] + d[w2+3] + d[w3-2] + d[w3+2]) +
-              kern[ 5+3] * (d[-w3-1] + d[-w3+1] + d[-w1-3] + d[-w1+3] + d[w1-3] + d[w1+3] + d[w3-1] + d[w3+1]) +
-              kern[   3] * (d[-w3  ] + d[   -3] + d[    3] + d[ w3  ]) +
-              kern[10+2] * (d[-w2-2] + d[-w2+2] + d[ w2-2] + d[ w2+2]) +
-              kern[ 5+2] * (d[-w2-1] + d[-w2+1] + d[-w1-2] + d[-w1+2] + d[w1-2] + d[w1+2] + d[w2-1] + d[w2+1]) +
-              kern[   2] * (d[-w2  ] + d[   -2] + d[    2] + d[ w2  ]) +
-              kern[ 5+1] * (d[-w1-1] + d[-w1+1] + d[ w1-1] + d[ w1+1]) +
-              kern[   1] * (d[-w1  ] + d[   -1] + d[    1] + d[ w1  ]) +
-              kern[   0] * (d[0]);
-            }
         }
-        else
+      }
+      dt_fft_2d(cf->fft, z, FALSE);
+
+      for(int k = 0; k < nk; k++)
+      {
+        const uint8_t idx = list[k];
+        const float *const psf = cf->psf[idx];
+        DT_OMP_SIMD()
+        for(size_t j = 0; j < nn; j++)
+        {
+          w[j] = z[j] * psf[j];
+          w[j + nn] = z[j + nn] * psf[j];
+        }
+        dt_fft_2d(cf->fft, w, TRUE);
+
+        for(int tile = first; tile < last; tile++)
         {
-          for(int ir = -bd; ir <= bd; ir++)
+          const float *const d = w + (tile - first) * nn;
+          int x0, y0;
+          _capture_fft_tile(cf, tile, &x0, &y0);
+          for(int row = y0; row < MIN(y0 + CAPTURE_FFT_VALID, height); row++)
           {
-            const int irow = row+ir;
-            if(irow >= 0 && irow < height)
+            for(int col = x0; col < MIN(x0 + CAPTURE_FFT_VALID, w1); col++)
             {
-              for(int ic = -bd; ic <= bd; ic++)
+              const size_t i = (size_t)row * w1 + col;
+              if(blend[i] > 0.0f && table[i] == idx)
               {
-                const int icol = col+ic;
-                if(icol >=0 && icol < w1)
-                  val += kern[5 * ABS(ir) + ABS(ic)] * in[(size_t)irow * w1 + icol];
+                const float val = d[(row - y0 + CAPTURE_FFT_HALO) * n + col - x0 + CAPTURE_FFT_HALO];
+                out[i] = luminance ? luminance[i] / MAX(val, CAPTURE_YMIN) : out[i] * val;
               }
             }
           }
         }
-        out[i] = luminance[i] / MAX(val, CAPTURE_YMIN);
+      }
+    }
+
+    for(int tile = first; tile < last; tile++)
+    {
+      int x0, y0;
+      _capture_fft_tile(cf, tile, &x0, &y0);
+      for(int row = y0; row < MIN(y0 + CAPTURE_FFT_VALID, height); row++)
+      {
+        for(int col = x0; col < MIN(x0 + CAPTURE_FFT_VALID, w1); col++)
+        {
+          const size_t i = (size_t)row * w1 + col;
+          if(blend[i] > 0.0f && !via_fft[table[i]])
+          {
+            const float *kern = kernels + CAPTURE_KERNEL_ALIGN * table[i];
+            const float val = _blur_pixel(in, kern, table[i] < idx_small, row, col, w1, height);
+            out[i] = luminance ? luminance[i] / MAX(val, CAPTURE_YMIN) : out[i] * val;
+          }
+        }
       }
     }
   }
@@ -948,11 +1149,30 @@ static void _capture_sharpen(dt_iop_module_t *self,
     goto finalize;
   }
 
+  // for large exports the per iteration cost of the fft backend is lower unless most kernels are small
+  const dt_image_t *img = &self->dev->image_storage;
+  const gboolean large = (size_t)img->p_width * img->p_height >= CAPTURE_FFT_MPIXELS * 1000000;
+  capture_fft_t *cf = large && (pipe->type & DT_DEV_PIXELPIPE_EXPORT) && d->cs_radius >= CAPTURE_SMALL
+                      ? _capture_fft_new(blendmask, gd->gauss_coeffs, gauss_idx, width, height)
+                      : NULL;
+  if(cf)
+    dt_print_pipe(DT_DEBUG_PIPE, "capture sharpen fft", pipe, self, DT_DEVICE_CPU, NULL, NULL,
+      "%d tiles of %dx%d", cf->tiles, CAPTURE_FFT_SIZE, CAPTURE_FFT_SIZE);
+
   for(int iter = 0; iter < d->cs_iter && !dt_pipe_shutdown(pipe); iter++)
   {
-    _blur_div(tmp1, tmp2, luminance, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
-    _blur_mul(tmp2, tmp1, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
+    if(cf)
+    {
+      _blur_fft(cf, tmp1, tmp2, luminance, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
+      _blur_fft(cf, tmp2, tmp1, NULL, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
+    }
+    else
+    {
+      _blur_div(tmp1, tmp2, luminance, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
+      _blur_mul(tmp2, tmp1, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
+    }
   }
+  _capture_fft_free(cf);
 
   DT_OMP_FOR_SIMD()
   for(size_t k = 0; k < pixels; k++)
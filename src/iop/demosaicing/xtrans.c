@@ -40,6 +40,63 @@ static inline const short *_hexmap(const int row,
   return allhex[irow % 3][icol % 3];
 }
 
+/** Homogeneity maps of the ndir directions from their derivatives and
+    the 5x5 sums of those, for rows and columns pad_homo and pad_tile
+    inside a tile of mrow x mcol. homosum may overlap drv as in the tile
+    buffer, drv isn't read any more once homosum is written. **/
+static void _markesteijn_homogeneity(float (*const drv)[TS][TS],
+                                     uint8_t (*const homo)[TS][TS],
+                                     uint8_t (*const homosum)[TS][TS],
+                                     const unsigned ndir,
+                                     const int mrow,
+                                     const int mcol,
+                                     const int pad_homo,
+                                     const int pad_tile)
+{
+  // done row by row with the threshold of each column precomputed,
+  // so the inner loops run over contiguous columns and vectorize
+  memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
+  for(int row = pad_homo; row < mrow - pad_homo; row++)
+  {
+    float tr[TS];
+    for(int col = pad_homo; col < mcol - pad_homo; col++)
+      tr[col] = FLT_MAX;
+    for(unsigned d = 0; d < ndir; ++d)
+      for(int col = pad_homo; col < mcol - pad_homo; col++)
+        tr[col] = (tr[col] > drv[d][row][col]) ? drv[d][row][col] : tr[col];
+    for(int col = pad_homo; col < mcol - pad_homo; col++)
+      tr[col] *= 8;
+    for(unsigned d = 0; d < ndir; ++d)
+      for(int v = -1; v <= 1; v++)
+        for(int h = -1; h <= 1; h++)
+        {
+          const float *const dx = &drv[d][row + v][h];
+          uint8_t *const hx = homo[d][row];
+          for(int col = pad_homo; col < mcol - pad_homo; col++)
+            hx[col] += ((dx[col] <= tr[col]) ? 1 : 0);
+        }
+  }
+
+  // separable, first the vertical sums of 5 rows for each column
+  // then 5 of those horizontally. Max 225 so uint8_t is enough.
+  for(unsigned d = 0; d < ndir; ++d)
+    for(int row = pad_tile; row < mrow - pad_tile; row++)
+    {
+      uint8_t colsum[TS];
+      for(int col = pad_tile - 2; col < mcol - pad_tile + 2; col++)
+        colsum[col] = 0;
+      for(int v = -2; v <= 2; v++)
+      {
+        const uint8_t *const hx = homo[d][row + v];
+        for(int col = pad_tile - 2; col < mcol - pad_tile + 2; col++)
+          colsum[col] += hx[col];
+      }
+      for(int col = pad_tile; col < mcol - pad_tile; col++)
+        homosum[d][row][col] = colsum[col - 2] + colsum[col - 1] + colsum[col]
+                               + colsum[col + 1] + colsum[col + 2];
+    }
+}
+
 /*
    Frank Markesteijn's algorithm for Fuji X-Trans sensors
 */
@@ -99,11 +156,18 @@ static void xtrans_markesteijn_interpolate(float *out,
 
   // extra passes propagates out errors at edges, hence need more padding
   const int pad_tile = (passes == 1) ? 12 : 17;
-  DT_OMP_FOR()
   // step through TSxTS cells of image, each tile overlapping the
   // prior as interpolation needs a substantial border
-  for(int top = -pad_tile; top < height - pad_tile; top += TS - (pad_tile*2))
+  const int tile_step = TS - (pad_tile*2);
+  const int tiles_x = (width + tile_step - 1) / tile_step;
+  const int tiles_y = (height + tile_step - 1) / tile_step;
+  // tiles at the image borders do more work for mirroring, so hand
+  // them out one by one instead of in rows per thread
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int tile = 0; tile < tiles_x * tiles_y; tile++)
   {
+    const int top = (tile / tiles_x) * tile_step - pad_tile;
+    const int left = (tile % tiles_x) * tile_step - pad_tile;
     char *const buffer = dt_get_perthread(all_buffers, padded_buffer_size);
     // rgb points to ndir TSxTS tiles of 3 channels (R, G, and B)
     float(*rgb)[TS][TS][3] = (float(*)[TS][TS][3])buffer;
@@ -123,396 +187,359 @@ static void xtrans_markesteijn_interpolate(float *out,
     uint8_t (*const homosum)[TS][TS] = (uint8_t(*)[TS][TS])(buffer + TS * TS * (ndir * 3) * sizeof(float)
                                                             + TS * TS * ndir * sizeof(uint8_t));
 
-    for(int left = -pad_tile; left < width - pad_tile; left += TS - (pad_tile*2))
-    {
-      int mrow = MIN(top + TS, height + pad_tile);
-      int mcol = MIN(left + TS, width + pad_tile);
+    int mrow = MIN(top + TS, height + pad_tile);
+    int mcol = MIN(left + TS, width + pad_tile);
 
-      // Copy current tile from in to image buffer. If border goes
-      // beyond edges of image, fill with mirrored/interpolated edges.
-      // The extra border avoids discontinuities at image edges.
-      for(int row = top; row < mrow; row++)
-        for(int col = left; col < mcol; col++)
+    // Copy current tile from in to image buffer. If border goes
+    // beyond edges of image, fill with mirrored/interpolated edges.
+    // The extra border avoids discontinuities at image edges.
+    for(int row = top; row < mrow; row++)
+      for(int col = left; col < mcol; col++)
+      {
+        float(*const pix) = rgb[0][row - top][col - left];
+        if((col >= 0) && (row >= 0) && (col < width) && (row < height))
         {
-          float(*const pix) = rgb[0][row - top][col - left];
-          if((col >= 0) && (row >= 0) && (col < width) && (row < height))
-          {
-            const int f = FCNxtrans(row, col, xtrans);
-            for(int c = 0; c < 3; c++) pix[c] = (c == f) ? in[width * row + col] : 0.f;
-          }
-          else
+          const int f = FCNxtrans(row, col, xtrans);
+          for(int c = 0; c < 3; c++) pix[c] = (c == f) ? in[width * row + col] : 0.f;
+        }
+        else
+        {
+          // mirror a border pixel if beyond image edge
+          const int c = FCNxtrans(row, col, xtrans);
+          for(int cc = 0; cc < 3; cc++)
           {
-            // mirror a border pixel if beyond image edge
-            const int c = FCNxtrans(row, col, xtrans);
-            for(int cc = 0; cc < 3; cc++)
+            if(cc != c)
+              pix[cc] = 0.0f;
+            else
             {
-              if(cc != c)
-                pix[cc] = 0.0f;
+#define TRANSLATE(n, size) ((n >= size) ? (2 * size - n - 2) : abs(n))
+              const int cy = TRANSLATE(row, height), cx = TRANSLATE(col, width);
+              if(c == FCNxtrans(cy, cx, xtrans))
+                pix[c] = in[width * cy + cx];
               else
               {
-#define TRANSLATE(n, size) ((n >= size) ? (2 * size - n - 2) : abs(n))
-                const int cy = TRANSLATE(row, height), cx = TRANSLATE(col, width);
-                if(c == FCNxtrans(cy, cx, xtrans))
-                  pix[c] = in[width * cy + cx];
-                else
-                {
-                  // interpolate if mirror pixel is a different color
-                  float sum = 0.0f;
-                  uint8_t count = 0;
-                  for(int y = row - 1; y <= row + 1; y++)
-                    for(int x = col - 1; x <= col + 1; x++)
+                // interpolate if mirror pixel is a different color
+                float sum = 0.0f;
+                uint8_t count = 0;
+                for(int y = row - 1; y <= row + 1; y++)
+                  for(int x = col - 1; x <= col + 1; x++)
+                  {
+                    const int yy = TRANSLATE(y, height), xx = TRANSLATE(x, width);
+                    const int ff = FCNxtrans(yy, xx, xtrans);
+                    if(ff == c)
                     {
-                      const int yy = TRANSLATE(y, height), xx = TRANSLATE(x, width);
-                      const int ff = FCNxtrans(yy, xx, xtrans);
-                      if(ff == c)
-                      {
-                        sum += in[width * yy + xx];
-                        count++;
-                      }
+                      sum += in[width * yy + xx];
+                      count++;
                     }
-                  pix[c] = sum / count;
-                }
+                  }
+                pix[c] = sum / count;
               }
             }
           }
         }
+      }
 
-      // duplicate rgb[0] to rgb[1], rgb[2], and rgb[3]
-      for(int c = 1; c <= 3; c++) memcpy(rgb[c], rgb[0], sizeof(*rgb));
+    // duplicate rgb[0] to rgb[1], rgb[2], and rgb[3]
+    for(int c = 1; c <= 3; c++) memcpy(rgb[c], rgb[0], sizeof(*rgb));
 
-      // note that successive calculations are inset within the tile
-      // so as to give enough border data, and there needs to be a 6
-      // pixel border initially to allow allhex to find neighboring
-      // pixels
+    // note that successive calculations are inset within the tile
+    // so as to give enough border data, and there needs to be a 6
+    // pixel border initially to allow allhex to find neighboring
+    // pixels
 
-      /* Set green1 and green3 to the minimum and maximum allowed values:   */
-      // Run through each red/blue or blue/red pair, setting their g1
-      // and g3 values to the min/max of green pixels surrounding the
-      // pair. Use a 3 pixel border as gmin/gmax is used by
-      // interpolate green which has a 3 pixel border.
-      for(int row = top + PAD_G1_G3; row < mrow - PAD_G1_G3; row++)
+    /* Set green1 and green3 to the minimum and maximum allowed values:   */
+    // Run through each red/blue or blue/red pair, setting their g1
+    // and g3 values to the min/max of green pixels surrounding the
+    // pair. Use a 3 pixel border as gmin/gmax is used by
+    // interpolate green which has a 3 pixel border.
+    for(int row = top + PAD_G1_G3; row < mrow - PAD_G1_G3; row++)
+    {
+      // setting max to 0.0f signifies that this is a new pair, which
+      // requires a new min/max calculation of its neighboring greens
+      float min = FLT_MAX, max = 0.0f;
+      for(int col = left + PAD_G1_G3; col < mcol - PAD_G1_G3; col++)
       {
-        // setting max to 0.0f signifies that this is a new pair, which
-        // requires a new min/max calculation of its neighboring greens
-        float min = FLT_MAX, max = 0.0f;
-        for(int col = left + PAD_G1_G3; col < mcol - PAD_G1_G3; col++)
+        // if in row of horizontal red & blue pairs (or processing
+        // vertical red & blue pairs near image bottom), reset min/max
+        // between each pair
+        if(FCNxtrans(row, col, xtrans) == 1)
         {
-          // if in row of horizontal red & blue pairs (or processing
-          // vertical red & blue pairs near image bottom), reset min/max
-          // between each pair
-          if(FCNxtrans(row, col, xtrans) == 1)
-          {
-            min = FLT_MAX, max = 0.0f;
-            continue;
-          }
-          // if at start of red & blue pair, calculate min/max of green
-          // pixels surrounding it; note that while normally using == to
-          // compare floats is suspect, here the check is if 0.0f has
-          // explicitly been assigned to max (which signifies a new
-          // red/blue pair)
-          if(max == 0.0f)
-          {
-            float (*const pix)[3] = &rgb[0][row - top][col - left];
-            const short *const hex = _hexmap(row,col,allhex);
-            for(int c = 0; c < 6; c++)
-            {
-              const float val = pix[hex[c]][1];
-              if(min > val) min = val;
-              if(max < val) max = val;
-            }
-          }
-          gmin[row - top][col - left] = min;
-          gmax[row - top][col - left] = max;
-          // handle vertical red/blue pairs
-          switch((row - sgrow) % 3)
-          {
-            // hop down a row to second pixel in vertical pair
-            case 1:
-              if(row < mrow - 4) row++, col--;
-              break;
-            // then if not done with the row hop up and right to next
-            // vertical red/blue pair, resetting min/max
-            case 2:
-              min = FLT_MAX, max = 0.0f;
-              if((col += 2) < mcol - 4 && row > top + 3) row--;
-          }
+          min = FLT_MAX, max = 0.0f;
+          continue;
         }
-      }
-
-      /* Interpolate green horizontally, vertically, and along both diagonals: */
-      // need a 3 pixel border here as 3*hex[] can have a 3 unit offset
-      for(int row = top + PAD_G_INTERP; row < mrow - PAD_G_INTERP; row++)
-        for(int col = left + PAD_G_INTERP; col < mcol - PAD_G_INTERP; col++)
+        // if at start of red & blue pair, calculate min/max of green
+        // pixels surrounding it; note that while normally using == to
+        // compare floats is suspect, here the check is if 0.0f has
+        // explicitly been assigned to max (which signifies a new
+        // red/blue pair)
+        if(max == 0.0f)
         {
-          float color[8];
-          const int f = FCNxtrans(row, col, xtrans);
-          if(f == 1) continue;
           float (*const pix)[3] = &rgb[0][row - top][col - left];
           const short *const hex = _hexmap(row,col,allhex);
-          // TODO: these constants come from integer math constants in
-          // dcraw -- calculate them instead from interpolation math
-          color[0] = 0.6796875f * (pix[hex[1]][1] + pix[hex[0]][1])
-                     - 0.1796875f * (pix[2 * hex[1]][1] + pix[2 * hex[0]][1]);
-          color[1] = 0.87109375f * pix[hex[3]][1] + pix[hex[2]][1] * 0.13f
-                     + 0.359375f * (pix[0][f] - pix[-hex[2]][f]);
-          for(int c = 0; c < 2; c++)
-            color[2 + c] = 0.640625f * pix[hex[4 + c]][1] + 0.359375f * pix[-2 * hex[4 + c]][1]
-                           + 0.12890625f * (2 * pix[0][f] - pix[3 * hex[4 + c]][f] - pix[-3 * hex[4 + c]][f]);
-          for(int c = 0; c < 4; c++)
-            rgb[c ^ !((row - sgrow) % 3)][row - top][col - left][1]
-                = CLAMPS(color[c], gmin[row - top][col - left], gmax[row - top][col - left]);
+          for(int c = 0; c < 6; c++)
+          {
+            const float val = pix[hex[c]][1];
+            if(min > val) min = val;
+            if(max < val) max = val;
+          }
         }
-
-      for(int pass = 0; pass < passes; pass++)
-      {
-        if(pass == 1)
+        gmin[row - top][col - left] = min;
+        gmax[row - top][col - left] = max;
+        // handle vertical red/blue pairs
+        switch((row - sgrow) % 3)
         {
-          // if on second pass, copy rgb[0] to [3] into rgb[4] to [7],
-          // and process that second set of buffers
-          memcpy(rgb + 4, rgb, sizeof(*rgb) * 4);
-          rgb += 4;
+          // hop down a row to second pixel in vertical pair
+          case 1:
+            if(row < mrow - 4) row++, col--;
+            break;
+          // then if not done with the row hop up and right to next
+          // vertical red/blue pair, resetting min/max
+          case 2:
+            min = FLT_MAX, max = 0.0f;
+            if((col += 2) < mcol - 4 && row > top + 3) row--;
         }
+      }
+    }
 
-        /* Recalculate green from interpolated values of closer pixels: */
-        if(pass)
-        {
-          for(int row = top + PAD_G_RECALC; row < mrow - PAD_G_RECALC; row++)
-            for(int col = left + PAD_G_RECALC; col < mcol - PAD_G_RECALC; col++)
-            {
-              const int f = FCNxtrans(row, col, xtrans);
-              if(f == 1) continue;
-              const short *const hex = _hexmap(row,col,allhex);
-              for(int d = 3; d < 6; d++)
-              {
-                float(*rfx)[3] = &rgb[(d - 2) ^ !((row - sgrow) % 3)][row - top][col - left];
-                const float val = rfx[-2 * hex[d]][1]
-                            + 2 * rfx[hex[d]][1] - rfx[-2 * hex[d]][f]
-                            - 2 * rfx[hex[d]][f] + 3 * rfx[0][f];
-                rfx[0][1] = CLAMPS(val / 3.0f, gmin[row - top][col - left], gmax[row - top][col - left]);
-              }
-            }
-        }
+    /* Interpolate green horizontally, vertically, and along both diagonals: */
+    // need a 3 pixel border here as 3*hex[] can have a 3 unit offset
+    for(int row = top + PAD_G_INTERP; row < mrow - PAD_G_INTERP; row++)
+      for(int col = left + PAD_G_INTERP; col < mcol - PAD_G_INTERP; col++)
+      {
+        float color[8];
+        const int f = FCNxtrans(row, col, xtrans);
+        if(f == 1) continue;
+        float (*const pix)[3] = &rgb[0][row - top][col - left];
+        const short *const hex = _hexmap(row,col,allhex);
+        // TODO: these constants come from integer math constants in
+        // dcraw -- calculate them instead from interpolation math
+        color[0] = 0.6796875f * (pix[hex[1]][1] + pix[hex[0]][1])
+                   - 0.1796875f * (pix[2 * hex[1]][1] + pix[2 * hex[0]][1]);
+        color[1] = 0.87109375f * pix[hex[3]][1] + pix[hex[2]][1] * 0.13f
+                   + 0.359375f * (pix[0][f] - pix[-hex[2]][f]);
+        for(int c = 0; c < 2; c++)
+          color[2 + c] = 0.640625f * pix[hex[4 + c]][1] + 0.359375f * pix[-2 * hex[4 + c]][1]
+                         + 0.12890625f * (2 * pix[0][f] - pix[3 * hex[4 + c]][f] - pix[-3 * hex[4 + c]][f]);
+        for(int c = 0; c < 4; c++)
+          rgb[c ^ !((row - sgrow) % 3)][row - top][col - left][1]
+              = CLAMPS(color[c], gmin[row - top][col - left], gmax[row - top][col - left]);
+      }
+
+    for(int pass = 0; pass < passes; pass++)
+    {
+      if(pass == 1)
+      {
+        // if on second pass, copy rgb[0] to [3] into rgb[4] to [7],
+        // and process that second set of buffers
+        memcpy(rgb + 4, rgb, sizeof(*rgb) * 4);
+        rgb += 4;
+      }
 
-        /* Interpolate red and blue values for solitary green pixels:   */
-        const int pad_rb_g = (passes == 1) ? 6 : 5;
-        for(int row = (top - sgrow + pad_rb_g + 2) / 3 * 3 + sgrow; row < mrow - pad_rb_g; row += 3)
-          for(int col = (left - sgcol + pad_rb_g + 2) / 3 * 3 + sgcol; col < mcol - pad_rb_g; col += 3)
+      /* Recalculate green from interpolated values of closer pixels: */
+      if(pass)
+      {
+        for(int row = top + PAD_G_RECALC; row < mrow - PAD_G_RECALC; row++)
+          for(int col = left + PAD_G_RECALC; col < mcol - PAD_G_RECALC; col++)
           {
-            float(*rfx)[3] = &rgb[0][row - top][col - left];
-            int h = FCNxtrans(row, col + 1, xtrans);
-            float diff[6] = { 0.0f };
-            // interplated color: first index is red/blue, second is
-            // pass, is double actual result
-            float color[2][6];
-            // Six passes, alternating hori/vert interp (i),
-            // starting with R or B (h) depending on which is closest.
-            // Passes 0,1 to rgb[0], rgb[1] of hori/vert interp. Pass
-            // 3,5 to rgb[2], rgb[3] of best of interp hori/vert
-            // results. Each pass which outputs moves on to the next
-            // rgb[] for input of interp greens.
-            for(int i = 1, d = 0; d < 6; d++, i ^= TS ^ 1, h ^= 2)
+            const int f = FCNxtrans(row, col, xtrans);
+            if(f == 1) continue;
+            const short *const hex = _hexmap(row,col,allhex);
+            for(int d = 3; d < 6; d++)
             {
-              // look 1 and 2 pixels distance from solitary green to
-              // red then blue or blue then red
-              for(int c = 0; c < 2; c++, h ^= 2)
-              {
-                // rate of change in greens between current pixel and
-                // interpolated pixels 1 or 2 distant: a quick
-                // derivative which will be divided by two later to be
-                // rate of luminance change for red/blue between known
-                // red/blue neighbors and the current unknown pixel
-                const float g = 2 * rfx[0][1] - rfx[i << c][1] - rfx[-(i << c)][1];
-                // color is halved before being stored in rgb, hence
-                // this becomes green rate of change plus the average
-                // of the near red or blue pixels on current axis
-                color[h != 0][d] = g + rfx[i << c][h] + rfx[-(i << c)][h];
-                // Note that diff will become the slope for both red
-                // and blue differentials in the current direction.
-                // For 2nd and 3rd hori+vert passes, create a sum of
-                // steepness for both cardinal directions.
-                if(d > 1)
-                  diff[d] += sqrf(rfx[i << c][1] - rfx[-(i << c)][1] - rfx[i << c][h] + rfx[-(i << c)][h])
-                             + sqrf(g);
-              }
-              if((d < 2) || (d & 1))
-              { // output for passes 0, 1, 3, 5
-                // for 0, 1 just use hori/vert, for 3, 5 use best of x/y dir
-                const int d_out = d - ((d > 1) && (diff[d-1] < diff[d]));
-                rfx[0][0] = color[0][d_out] / 2.f;
-                rfx[0][2] = color[1][d_out] / 2.f;
-                rfx += TS * TS;
-              }
+              float(*rfx)[3] = &rgb[(d - 2) ^ !((row - sgrow) % 3)][row - top][col - left];
+              const float val = rfx[-2 * hex[d]][1]
+                          + 2 * rfx[hex[d]][1] - rfx[-2 * hex[d]][f]
+                          - 2 * rfx[hex[d]][f] + 3 * rfx[0][f];
+              rfx[0][1] = CLAMPS(val / 3.0f, gmin[row - top][col - left], gmax[row - top][col - left]);
             }
           }
+      }
 
-        /* Interpolate red for blue pixels and vice versa:              */
-        const int pad_rb_br = (passes == 1) ? 6 : 5;
-        for(int row = top + pad_rb_br; row < mrow - pad_rb_br; row++)
-          for(int col = left + pad_rb_br; col < mcol - pad_rb_br; col++)
+      /* Interpolate red and blue values for solitary green pixels:   */
+      const int pad_rb_g = (passes == 1) ? 6 : 5;
+      for(int row = (top - sgrow + pad_rb_g + 2) / 3 * 3 + sgrow; row < mrow - pad_rb_g; row += 3)
+        for(int col = (left - sgcol + pad_rb_g + 2) / 3 * 3 + sgcol; col < mcol - pad_rb_g; col += 3)
+        {
+          float(*rfx)[3] = &rgb[0][row - top][col - left];
+          int h = FCNxtrans(row, col + 1, xtrans);
+          float diff[6] = { 0.0f };
+          // interplated color: first index is red/blue, second is
+          // pass, is double actual result
+          float color[2][6];
+          // Six passes, alternating hori/vert interp (i),
+          // starting with R or B (h) depending on which is closest.
+          // Passes 0,1 to rgb[0], rgb[1] of hori/vert interp. Pass
+          // 3,5 to rgb[2], rgb[3] of best of interp hori/vert
+          // results. Each pass which outputs moves on to the next
+          // rgb[] for input of interp greens.
+          for(int i = 1, d = 0; d < 6; d++, i ^= TS ^ 1, h ^= 2)
           {
-            const int f = 2 - FCNxtrans(row, col, xtrans);
-            if(f == 1) continue;
-            float(*rfx)[3] = &rgb[0][row - top][col - left];
-            const int c = (row - sgrow) % 3 ? TS : 1;
-            const int h = 3 * (c ^ TS ^ 1);
-            for(int d = 0; d < 4; d++, rfx += TS * TS)
+            // look 1 and 2 pixels distance from solitary green to
+            // red then blue or blue then red
+            for(int c = 0; c < 2; c++, h ^= 2)
             {
-              const int i = d > 1 || ((d ^ c) & 1) ||
-                ((fabsf(rfx[0][1]-rfx[c][1]) + fabsf(rfx[0][1]-rfx[-c][1])) <
-                 2.f*(fabsf(rfx[0][1]-rfx[h][1]) + fabsf(rfx[0][1]-rfx[-h][1]))) ? c:h;
-              rfx[0][f] = (rfx[i][f] + rfx[-i][f] + 2.f * rfx[0][1] - rfx[i][1] - rfx[-i][1]) / 2.f;
+              // rate of change in greens between current pixel and
+              // interpolated pixels 1 or 2 distant: a quick
+              // derivative which will be divided by two later to be
+              // rate of luminance change for red/blue between known
+              // red/blue neighbors and the current unknown pixel
+              const float g = 2 * rfx[0][1] - rfx[i << c][1] - rfx[-(i << c)][1];
+              // color is halved before being stored in rgb, hence
+              // this becomes green rate of change plus the average
+              // of the near red or blue pixels on current axis
+              color[h != 0][d] = g + rfx[i << c][h] + rfx[-(i << c)][h];
+              // Note that diff will become the slope for both red
+              // and blue differentials in the current direction.
+              // For 2nd and 3rd hori+vert passes, create a sum of
+              // steepness for both cardinal directions.
+              if(d > 1)
+                diff[d] += sqrf(rfx[i << c][1] - rfx[-(i << c)][1] - rfx[i << c][h] + rfx[-(i << c)][h])
+                           + sqrf(g);
+            }
+            if((d < 2) || (d & 1))
+            { // output for passes 0, 1, 3, 5
+              // for 0, 1 just use hori/vert, for 3, 5 use best of x/y dir
+              const int d_out = d - ((d > 1) && (diff[d-1] < diff[d]));
+              rfx[0][0] = color[0][d_out] / 2.f;
+              rfx[0][2] = color[1][d_out] / 2.f;
+              rfx += TS * TS;
             }
           }
+        }
 
-        /* Fill in red and blue for 2x2 blocks of green:                */
-        const int pad_g22 = (passes == 1) ? 8 : 4;
-        for(int row = top + pad_g22; row < mrow - pad_g22; row++)
+      /* Interpolate red for blue pixels and vice versa:              */
+      const int pad_rb_br = (passes == 1) ? 6 : 5;
+      for(int row = top + pad_rb_br; row < mrow - pad_rb_br; row++)
+        for(int col = left + pad_rb_br; col < mcol - pad_rb_br; col++)
         {
-          if((row - sgrow) % 3)
-            for(int col = left + pad_g22; col < mcol - pad_g22; col++)
-              if((col - sgcol) % 3)
-              {
-                float(*rfx)[3] = &rgb[0][row - top][col - left];
-                const short *const hex = _hexmap(row,col,allhex);
-                for(unsigned d = 0; d < ndir; d += 2, rfx += TS * TS)
-                  if(hex[d] + hex[d + 1])
-                  {
-                    const float g = 3.f * rfx[0][1] - 2.f * rfx[hex[d]][1] - rfx[hex[d + 1]][1];
-                    for(int c = 0; c < 4; c += 2)
-                      rfx[0][c] = (g + 2.f * rfx[hex[d]][c] + rfx[hex[d + 1]][c]) / 3.f;
-                  }
-                  else
-                  {
-                    const float g = 2.f * rfx[0][1] - rfx[hex[d]][1] - rfx[hex[d + 1]][1];
-                    for(int c = 0; c < 4; c += 2)
-                      rfx[0][c] = (g + rfx[hex[d]][c] + rfx[hex[d + 1]][c]) / 2.f;
-                  }
-              }
+          const int f = 2 - FCNxtrans(row, col, xtrans);
+          if(f == 1) continue;
+          float(*rfx)[3] = &rgb[0][row - top][col - left];
+          const int c = (row - sgrow) % 3 ? TS : 1;
+          const int h = 3 * (c ^ TS ^ 1);
+          for(int d = 0; d < 4; d++, rfx += TS * TS)
+          {
+            const int i = d > 1 || ((d ^ c) & 1) ||
+              ((fabsf(rfx[0][1]-rfx[c][1]) + fabsf(rfx[0][1]-rfx[-c][1])) <
+               2.f*(fabsf(rfx[0][1]-rfx[h][1]) + fabsf(rfx[0][1]-rfx[-h][1]))) ? c:h;
+            rfx[0][f] = (rfx[i][f] + rfx[-i][f] + 2.f * rfx[0][1] - rfx[i][1] - rfx[-i][1]) / 2.f;
+          }
         }
-      } // end of multipass loop
-
-      // jump back to the first set of rgb buffers (this is a nop
-      // unless on the second pass)
-      rgb = (float(*)[TS][TS][3])buffer;
-      // from here on out, mainly are working within the current tile
-      // rather than in reference to the image, so don't offset
-      // mrow/mcol by top/left of tile
-      mrow -= top;
-      mcol -= left;
 
-      /* Convert to perceptual colorspace and differentiate in all directions:  */
-      // Original dcraw algorithm uses CIELab as perceptual space
-      // (presumably coming from original AHD) and converts taking
-      // camera matrix into account. Now use YPbPr which requires much
-      // less code and is nearly indistinguishable. It assumes the
-      // camera RGB is roughly linear.
-      for(unsigned d = 0; d < ndir; ++d)
+      /* Fill in red and blue for 2x2 blocks of green:                */
+      const int pad_g22 = (passes == 1) ? 8 : 4;
+      for(int row = top + pad_g22; row < mrow - pad_g22; row++)
       {
-        const int pad_yuv = (passes == 1) ? 8 : 13;
-        for(int row = pad_yuv; row < mrow - pad_yuv; row++)
-          for(int col = pad_yuv; col < mcol - pad_yuv; col++)
-          {
-            const float *rx = rgb[d][row][col];
-            // use ITU-R BT.2020 YPbPr, which is great, but could use
-            // a better/simpler choice? note that imageop.h provides
-            // dt_iop_RGB_to_YCbCr which uses Rec. 601 conversion,
-            // which appears less good with specular highlights
-            const float y = 0.2627f * rx[0] + 0.6780f * rx[1] + 0.0593f * rx[2];
-            yuv[0][row][col] = y;
-            yuv[1][row][col] = (rx[2] - y) * 0.56433f;
-            yuv[2][row][col] = (rx[0] - y) * 0.67815f;
-          }
-        // Note that f can offset by a column (-1 or +1) and by a row
-        // (-TS or TS). The row-wise offsets cause the undefined
-        // behavior sanitizer to warn of an out of bounds index, but
-        // as yfx is multi-dimensional and there is sufficient
-        // padding, that is not actually so.
-        const int f = dir[d & 3];
-        const int pad_drv = (passes == 1) ? 9 : 14;
-        for(int row = pad_drv; row < mrow - pad_drv; row++)
-          for(int col = pad_drv; col < mcol - pad_drv; col++)
-          {
-            const float(*yfx)[TS][TS] = (float(*)[TS][TS]) & yuv[0][row][col];
-            drv[d][row][col] = sqrf(2 * yfx[0][0][0] - yfx[0][0][f] - yfx[0][0][-f])
-                               + sqrf(2 * yfx[1][0][0] - yfx[1][0][f] - yfx[1][0][-f])
-                               + sqrf(2 * yfx[2][0][0] - yfx[2][0][f] - yfx[2][0][-f]);
-          }
+        if((row - sgrow) % 3)
+          for(int col = left + pad_g22; col < mcol - pad_g22; col++)
+            if((col - sgcol) % 3)
+            {
+              float(*rfx)[3] = &rgb[0][row - top][col - left];
+              const short *const hex = _hexmap(row,col,allhex);
+              for(unsigned d = 0; d < ndir; d += 2, rfx += TS * TS)
+                if(hex[d] + hex[d + 1])
+                {
+                  const float g = 3.f * rfx[0][1] - 2.f * rfx[hex[d]][1] - rfx[hex[d + 1]][1];
+                  for(int c = 0; c < 4; c += 2)
+                    rfx[0][c] = (g + 2.f * rfx[hex[d]][c] + rfx[hex[d + 1]][c]) / 3.f;
+                }
+                else
+                {
+                  const float g = 2.f * rfx[0][1] - rfx[hex[d]][1] - rfx[hex[d + 1]][1];
+                  for(int c = 0; c < 4; c += 2)
+                    rfx[0][c] = (g + rfx[hex[d]][c] + rfx[hex[d + 1]][c]) / 2.f;
+                }
+            }
       }
-
-      /* Build homogeneity maps from the derivatives:                   */
-      memset(homo, 0, sizeof(uint8_t) * ndir * TS * TS);
-      const int pad_homo = (passes == 1) ? 10 : 15;
-      for(int row = pad_homo; row < mrow - pad_homo; row++)
-        for(int col = pad_homo; col < mcol - pad_homo; col++)
+    } // end of multipass loop
+
+    // jump back to the first set of rgb buffers (this is a nop
+    // unless on the second pass)
+    rgb = (float(*)[TS][TS][3])buffer;
+    // from here on out, mainly are working within the current tile
+    // rather than in reference to the image, so don't offset
+    // mrow/mcol by top/left of tile
+    mrow -= top;
+    mcol -= left;
+
+    /* Convert to perceptual colorspace and differentiate in all directions:  */
+    // Original dcraw algorithm uses CIELab as perceptual space
+    // (presumably coming from original AHD) and converts taking
+    // camera matrix into account. Now use YPbPr which requires much
+    // less code and is nearly indistinguishable. It assumes the
+    // camera RGB is roughly linear.
+    for(unsigned d = 0; d < ndir; ++d)
+    {
+      const int pad_yuv = (passes == 1) ? 8 : 13;
+      for(int row = pad_yuv; row < mrow - pad_yuv; row++)
+        for(int col = pad_yuv; col < mcol - pad_yuv; col++)
         {
-          float tr = FLT_MAX;
-          for(unsigned d = 0; d < ndir; ++d)
-            if(tr > drv[d][row][col]) tr = drv[d][row][col];
-          tr *= 8;
-          for(unsigned d = 0; d < ndir; ++d)
-            for(int v = -1; v <= 1; v++)
-              for(int h = -1; h <= 1; h++)
-                homo[d][row][col] += ((drv[d][row + v][col + h] <= tr) ? 1 : 0);
+          const float *rx = rgb[d][row][col];
+          // use ITU-R BT.2020 YPbPr, which is great, but could use
+          // a better/simpler choice? note that imageop.h provides
+          // dt_iop_RGB_to_YCbCr which uses Rec. 601 conversion,
+          // which appears less good with specular highlights
+          const float y = 0.2627f * rx[0] + 0.6780f * rx[1] + 0.0593f * rx[2];
+          yuv[0][row][col] = y;
+          yuv[1][row][col] = (rx[2] - y) * 0.56433f;
+          yuv[2][row][col] = (rx[0] - y) * 0.67815f;
         }
-
-      /* Build 5x5 sum of homogeneity maps for each pixel & direction */
-      for(unsigned d = 0; d < ndir; ++d)
-        for(int row = pad_tile; row < mrow - pad_tile; row++)
+      // Note that f can offset by a column (-1 or +1) and by a row
+      // (-TS or TS). The row-wise offsets cause the undefined
+      // behavior sanitizer to warn of an out of bounds index, but
+      // as yfx is multi-dimensional and there is sufficient
+      // padding, that is not actually so.
+      const int f = dir[d & 3];
+      const int pad_drv = (passes == 1) ? 9 : 14;
+      for(int row = pad_drv; row < mrow - pad_drv; row++)
+        for(int col = pad_drv; col < mcol - pad_drv; col++)
         {
-          // start before first column where homo[d][row][col+2] != 0,
-          // so can know v5sum and homosum[d][row][col] will be 0
-          int col = pad_tile-5;
-          uint8_t v5sum[5] = { 0 };
-          homosum[d][row][col] = 0;
-          // calculate by rolling through column sums
-          for(col++; col < mcol - pad_tile; col++)
-          {
-            uint8_t colsum = 0;
-            for(int v = -2; v <= 2; v++) colsum += homo[d][row + v][col + 2];
-            homosum[d][row][col] = homosum[d][row][col - 1] - v5sum[col % 5] + colsum;
-            v5sum[col % 5] = colsum;
-          }
+          const float(*yfx)[TS][TS] = (float(*)[TS][TS]) & yuv[0][row][col];
+          drv[d][row][col] = sqrf(2 * yfx[0][0][0] - yfx[0][0][f] - yfx[0][0][-f])
+                             + sqrf(2 * yfx[1][0][0] - yfx[1][0][f] - yfx[1][0][-f])
+                             + sqrf(2 * yfx[2][0][0] - yfx[2][0][f] - yfx[2][0][-f]);
         }
+    }
 
-      /* Average the most homogeneous pixels for the final result:       */
-      for(int row = pad_tile; row < mrow - pad_tile; row++)
-        for(int col = pad_tile; col < mcol - pad_tile; col++)
+    /* Build homogeneity maps and their 5x5 sums from the derivatives: */
+    const int pad_homo = (passes == 1) ? 10 : 15;
+    _markesteijn_homogeneity(drv, homo, homosum, ndir, mrow, mcol, pad_homo, pad_tile);
+
+    /* Average the most homogeneous pixels for the final result:       */
+    for(int row = pad_tile; row < mrow - pad_tile; row++)
+      for(int col = pad_tile; col < mcol - pad_tile; col++)
+      {
+        uint8_t hm[8] = { 0 };
+        uint8_t maxval = 0;
+        for(unsigned d = 0; d < ndir; ++d)
         {
-          uint8_t hm[8] = { 0 };
-          uint8_t maxval = 0;
-          for(unsigned d = 0; d < ndir; ++d)
-          {
-            hm[d] = homosum[d][row][col];
-            maxval = (maxval < hm[d] ? hm[d] : maxval);
-          }
-          maxval -= maxval >> 3;
-          for(unsigned d = 0; d < ndir - 4; ++d)
-          {
-            if(hm[d] < hm[d + 4])
-              hm[d] = 0;
-            else if(hm[d] > hm[d + 4])
-              hm[d + 4] = 0;
-          }
-          dt_aligned_pixel_t avg = { 0.0f };
-          for(unsigned d = 0; d < ndir; ++d)
+          hm[d] = homosum[d][row][col];
+          maxval = (maxval < hm[d] ? hm[d] : maxval);
+        }
+        maxval -= maxval >> 3;
+        for(unsigned d = 0; d < ndir - 4; ++d)
+        {
+          if(hm[d] < hm[d + 4])
+            hm[d] = 0;
+          else if(hm[d] > hm[d + 4])
+            hm[d + 4] = 0;
+        }
+        dt_aligned_pixel_t avg = { 0.0f };
+        for(unsigned d = 0; d < ndir; ++d)
+        {
+          if(hm[d] >= maxval)
           {
-            if(hm[d] >= maxval)
-            {
-              for(int c = 0; c < 3; c++) avg[c] += rgb[d][row][col][c];
-              avg[3]++;
-            }
+            for(int c = 0; c < 3; c++) avg[c] += rgb[d][row][col][c];
+            avg[3]++;
           }
-          for(int c = 0; c < 3; c++)
-            out[4 * (width * (row + top) + col + left) + c] = MAX(0.0f, avg[c]/avg[3]);
         }
-    }
+        for(int c = 0; c < 3; c++)
+          out[4 * (width * (row + top) + col + left) + c] = MAX(0.0f, avg[c]/avg[3]);
+      }
   }
   dt_free_align(all_buffers);
 }
 
-#undef TS
-
-#define TS 122
 static void xtrans_fdc_interpolate(float *out,
                                    const float *const in,
                                    const int width,
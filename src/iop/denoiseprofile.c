@@ -899,7 +899,7 @@ void tiling_callback(dt_iop_module_t *self,
 
     const int max_filter_radius = (1u << max_scale); // 2 * 2^max_scale
 
-    tiling->factor = 5.0f; // in + out + precond + tmp + reducebuffer
+    tiling->factor = 4.0f; // in + out + precond + tmp
     tiling->factor_cl = 3.5f + max_scale; // in + out + tmp + reducebuffer + scale buffers
     tiling->maxbuf = 1.0f;
     tiling->maxbuf_cl = 1.0f;
@@ -1430,8 +1430,7 @@ static void process_wavelets(dt_iop_module_t *self,
                              void *const ovoid,
                              const dt_iop_roi_t *const roi_in,
                              const dt_iop_roi_t *const roi_out,
-                             const eaw_dn_decompose_t decompose,
-                             const eaw_synthesize_t synthesize)
+                             const eaw_dn_decompose_and_synthesize_t decompose)
 {
   // this is called for preview and full pipe separately, each with
   // its own pixelpipe piece.  get our data struct:
@@ -1473,11 +1472,10 @@ static void process_wavelets(dt_iop_module_t *self,
     return;
   }
 
-  float *buf = NULL;
   float *restrict precond = NULL;
   float *restrict tmp = NULL;
 
-  if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out, 4, &precond, 4, &tmp, 4, &buf, 0, NULL))
+  if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out, 4, &precond, 4, &tmp, 0, NULL))
   {
     dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out);
     return;
@@ -1556,34 +1554,33 @@ static void process_wavelets(dt_iop_module_t *self,
   float *restrict buf1 = precond;
   float *restrict buf2 = tmp;
 
-  // clear the output buffer, which will be accumulating all of the detail scales
-  dt_iop_image_fill(out, 0.0f, width, height, 4);
-
+  // The detail bands are never stored. Their thresholds depend on the energy of
+  // the whole band, so each scale shrinks the detail of the previous one while
+  // decomposing, recomputed as its input minus its coarse image. The output
+  // buffer accumulates the shrunk details, the first one initializes it.
+  const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
+  dt_aligned_pixel_t thrs = { 0.0f, 0.0f, 0.0f, 0.0f };
   for(int scale = 0; scale < max_scale; scale++)
   {
     const float sigma = 1.0f;
     const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
     const float sigma_band = powf(varf, scale) * sigma;
     dt_aligned_pixel_t sum_y2;
-    decompose(buf2, buf1, buf, sum_y2,
+    decompose(buf2, buf1, out, thrs, boost, sum_y2,
               scale, 1.0f / (sigma_band * sigma_band), width, height);
     debug_dump_PFM(piece, "coarse_%d", buf2, width, height, scale);
-    debug_dump_PFM(piece, "detail_%d", buf, width, height, scale);
 
-    const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
-    dt_aligned_pixel_t thrs;
     variance_stabilizing_xform(thrs, scale, max_scale, npixels, sum_y2, d);
-    synthesize(out, out, buf, thrs, boost, width, height);
 
     float *buf3 = buf2;
     buf2 = buf1;
     buf1 = buf3;
   }
 
-  // add in the final residue
-  DT_OMP_SIMD(aligned(buf1, out : 64))
-  for(size_t k = 0; k < 4U * npixels; k++)
-    out[k] += buf1[k];
+  // shrink the last detail band and add in the final residue, without any
+  // scale the residue is the preconditioned input
+  eaw_dn_synthesize_residue(out, max_scale ? buf2 : buf1, buf1, thrs, boost, MAX(max_scale - 1, 0),
+                            width, height);
 
   if(!d->use_new_vst)
   {
@@ -1600,7 +1597,6 @@ static void process_wavelets(dt_iop_module_t *self,
                          p, d->b[1], d->bias - 0.5 * logf(in_scale), wb, toRGB_trans);
   }
 
-  dt_free_align(buf);
   dt_free_align(tmp);
   dt_free_align(precond);
 
@@ -2642,7 +2638,7 @@ void process(dt_iop_module_t *self,
   else if(d->mode == MODE_WAVELETS
           || d->mode == MODE_WAVELETS_AUTO)
     process_wavelets(self, piece, ivoid, ovoid, roi_in, roi_out,
-                     eaw_dn_decompose, eaw_synthesize);
+                     eaw_dn_decompose_and_synthesize);
   else
     process_variance(self, piece, ivoid, ovoid, roi_in, roi_out);
 }
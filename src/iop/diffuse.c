@@ -43,7 +43,7 @@
 #include "gui/presets.h"
 #include "iop/iop_api.h"
 
-DT_MODULE_INTROSPECTION(2, dt_iop_diffuse_params_t)
+DT_MODULE_INTROSPECTION(3, dt_iop_diffuse_params_t)
 
 #define MAX_NUM_SCALES 10
 typedef struct dt_iop_diffuse_params_t
@@ -70,6 +70,11 @@ typedef struct dt_iop_diffuse_params_t
   // v2
   int radius_center;        // $MIN: 0    $MAX: 1024 $DEFAULT: 0  $DESCRIPTION: "central radius"
 
+  // v3
+  float convergence;        // $MIN: 0.   $MAX: 0.1  $DEFAULT: 0. $DESCRIPTION: "convergence threshold"
+  // iterations the diffusion needs to converge, measured in darkroom. 0 runs all iterations
+  int converged_iterations; // $MIN: 0    $MAX: 500  $DEFAULT: 0
+
   // new versions add params mandatorily at the end, so we can memcpy old parameters at the beginning
 
 } dt_iop_diffuse_params_t;
@@ -77,8 +82,9 @@ typedef struct dt_iop_diffuse_params_t
 
 typedef struct dt_iop_diffuse_gui_data_t
 {
-  GtkWidget *iterations, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
+  GtkWidget *iterations, *convergence, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
       *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold;
+  int converged;  // iterations the preview pipe needed to converge, 0 if not measured
 } dt_iop_diffuse_gui_data_t;
 
 typedef struct dt_iop_diffuse_global_data_t
@@ -90,6 +96,7 @@ typedef struct dt_iop_diffuse_global_data_t
   int kernel_diffuse_build_mask;
   int kernel_diffuse_inpaint_mask;
   int kernel_diffuse_pde;
+  int kernel_diffuse_reconstruct;
 } dt_iop_diffuse_global_data_t;
 
 
@@ -166,6 +173,35 @@ int legacy_params(dt_iop_module_t *self,
                   int32_t *new_params_size,
                   int *new_version)
 {
+  typedef struct dt_iop_diffuse_params_v3_t
+  {
+    // global parameters
+    int iterations;
+    float sharpness;
+    int radius;
+    float regularization;
+    float variance_threshold;
+
+    float anisotropy_first;
+    float anisotropy_second;
+    float anisotropy_third;
+    float anisotropy_fourth;
+
+    float threshold;
+
+    float first;
+    float second;
+    float third;
+    float fourth;
+
+    // v2
+    int radius_center;
+
+    // v3
+    float convergence;
+    int converged_iterations;
+  } dt_iop_diffuse_params_v3_t;
+
   typedef struct dt_iop_diffuse_params_v2_t
   {
     // global parameters
@@ -229,6 +265,23 @@ int legacy_params(dt_iop_module_t *self,
     *new_version = 2;
     return 0;
   }
+  if(old_version == 2)
+  {
+    const dt_iop_diffuse_params_v2_t *o = (dt_iop_diffuse_params_v2_t *)old_params;
+    dt_iop_diffuse_params_v3_t *n = malloc(sizeof(dt_iop_diffuse_params_v3_t));
+
+    // copy common parameters
+    memcpy(n, o, sizeof(dt_iop_diffuse_params_v2_t));
+
+    // init only new parameters, always run all iterations as before
+    n->convergence = 0.f;
+    n->converged_iterations = 0;
+
+    *new_params = n;
+    *new_params_size = sizeof(dt_iop_diffuse_params_v3_t);
+    *new_version = 3;
+    return 0;
+  }
   return 1;
 }
 
@@ -1148,6 +1201,56 @@ static inline float compute_anisotropy_factor(const float user_param)
   return sqf(user_param);
 }
 
+// weight of the diffusion at the wavelet scale s for the current zoom
+static inline float scale_weight(const dt_iop_diffuse_data_t *const data,
+                                 const int s,
+                                 const float zoom)
+{
+  const float real_radius = equivalent_sigma_at_step(B_SPLINE_SIGMA, s) * zoom;
+  return expf(-sqf(real_radius - (float)data->radius_center) / sqf(data->radius));
+}
+
+// scales weighted below this summed over all iterations are not diffused, only recomposed.
+// That's an approximation, their change is below that weight and not visible
+#define MIN_SCALE_WEIGHT 1e-6f
+
+static inline void wavelets_reconstruct(const float *const restrict high_freq,
+                                        const float *const restrict low_freq,
+                                        const uint8_t *const restrict mask,
+                                        const gboolean has_mask,
+                                        float *const restrict output,
+                                        const size_t width,
+                                        const size_t height)
+{
+  // heat_PDE_diffusion() with a zero update
+  DT_OMP_FOR_SIMD(aligned(output, high_freq, low_freq : 64))
+  for(size_t k = 0; k < width * height * 4; k++)
+  {
+    const float v = high_freq[k] + low_freq[k];
+    output[k] = (has_mask && !mask[k / 4]) ? v : fmaxf(v, 0.f);
+  }
+}
+
+// relative L1 norm of the change done by one iteration. Only run on the small image the
+// convergence is measured on, serially so the sum doesn't depend on the number of threads
+static inline float update_norm(const float *const restrict before,
+                                const float *const restrict after,
+                                const size_t width,
+                                const size_t height)
+{
+  double delta = 0.0;
+  double total = 0.0;
+  for(size_t k = 0; k < width * height * 4; k += 4)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      delta += fabsf(after[k + c] - before[k + c]);
+      total += fabsf(before[k + c]);
+    }
+  }
+  return total > 0.0 ? delta / total : 0.f;
+}
+
 static inline gboolean wavelets_process(const float *const restrict in,
                                     float *const restrict reconstructed,
                                     const uint8_t *const restrict mask,
@@ -1157,6 +1260,7 @@ static inline gboolean wavelets_process(const float *const restrict in,
                                     const float final_radius,
                                     const float zoom,
                                     const int scales,
+                                    const float min_weight,
                                     const gboolean has_mask,
                                     float *const restrict HF[MAX_NUM_SCALES],
                                     float *const restrict LF_odd,
@@ -1273,9 +1377,12 @@ static inline gboolean wavelets_process(const float *const restrict in,
     if(s == 0) buffer_out = reconstructed;
 
     // Compute wavelets low-frequency scales
-    heat_PDE_diffusion(HF[s], buffer_in, mask, has_mask, buffer_out, width, height,
-                       anisotropy, isotropy_type, regularization,
-                       variance_threshold, sqf(current_radius), mult, ABCD, strength);
+    if(norm < min_weight)
+      wavelets_reconstruct(HF[s], buffer_in, mask, has_mask, buffer_out, width, height);
+    else
+      heat_PDE_diffusion(HF[s], buffer_in, mask, has_mask, buffer_out, width, height,
+                         anisotropy, isotropy_type, regularization,
+                         variance_threshold, sqf(current_radius), mult, ABCD, strength);
 
     if(darktable.dump_pfm_module)
     {
@@ -1338,57 +1445,43 @@ static inline void inpaint_mask(float *const restrict inpainted,
   }
 }
 
-void process(dt_iop_module_t *self,
-             dt_dev_pixelpipe_iop_t *piece,
-             const void *const restrict ivoid,
-             void *const restrict ovoid,
-             const dt_iop_roi_t *const roi_in,
-             const dt_iop_roi_t *const roi_out)
+// the convergence stop must not depend on the roi, the zoom level or tiling, so pipes never
+// measure it while rendering. They all run the number of iterations kept in the params.
+static inline int _iterations(const dt_iop_diffuse_data_t *const data)
 {
-  const gboolean fastmode = piece->pipe->type & DT_DEV_PIXELPIPE_FAST;
-
-  const dt_iop_diffuse_data_t *const data = piece->data;
-
-  const size_t width = roi_out->width;
-  const size_t height = roi_out->height;
+  const int iterations = MAX(data->iterations, 1);
+  return (data->convergence > 0.f && data->converged_iterations > 0)
+    ? MIN(data->converged_iterations, iterations)
+    : iterations;
+}
 
-  // allow fast mode, just copy input to output
-  if(fastmode)
-  {
-    const size_t ch = piece->colors;
-    dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out);
-    return;
-  }
+// run the diffusion from input to out. With a positive convergence the iterations stop once
+// one of them changes the image less than that. Returns FALSE if out of memory.
+static gboolean _diffuse_image(const dt_iop_diffuse_data_t *const data,
+                               const float *const restrict input,
+                               float *const restrict out,
+                               const size_t width,
+                               const size_t height,
+                               const float zoom,
+                               const int iterations,
+                               const float convergence,
+                               int *done)
+{
+  const float final_radius = (data->radius + data->radius_center) * 2.f / zoom;
+  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
+  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
 
   uint8_t *const restrict mask = dt_alloc_align_uint8(width * height);
+  // temp buffers for blurs. We will need to cycle between them for memory efficiency
+  float *const restrict temp1 = dt_alloc_align_float(width * height * 4);
+  float *const restrict temp2 = dt_alloc_align_float(width * height * 4);
+  float *const restrict LF_odd = dt_alloc_align_float(width * height * 4);
+  float *const restrict LF_even = dt_alloc_align_float(width * height * 4);
 
-  float *restrict in = DT_IS_ALIGNED((float *const restrict)ivoid);
-  float *const restrict out = DT_IS_ALIGNED((float *const restrict)ovoid);
-
-  float *restrict temp1, *restrict temp2;
-  // temp buffer for blurs. We will need to cycle between them for memory efficiency
-  float *restrict LF_odd, *restrict LF_even;
-
-  float *restrict temp_in = NULL;
-  float *restrict temp_out = NULL;
-
-  gboolean out_of_memory = !mask
-    || !dt_iop_alloc_image_buffers(self, roi_in, roi_out,
-                                 4 | DT_IMGSZ_OUTPUT, &temp1,
-                                 4 | DT_IMGSZ_OUTPUT, &temp2,
-                                 4 | DT_IMGSZ_OUTPUT, &LF_odd,
-                                 4 | DT_IMGSZ_OUTPUT, &LF_even,
-                                 0, NULL); // if failing all pointers are NULL
-
-  const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
-  const float final_radius = (data->radius + data->radius_center) * 2.f / scale;
-
-  const int iterations = MAX(ceilf((float)data->iterations), 1);
-  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
-  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+  gboolean out_of_memory = !mask || !temp1 || !temp2 || !LF_odd || !LF_even;
 
   // wavelets scales buffers
-  float *restrict HF[MAX_NUM_SCALES];
+  float *restrict HF[MAX_NUM_SCALES] = { NULL };
   for(int s = 0; s < scales; s++)
   {
     HF[s] = out_of_memory ? NULL : dt_alloc_align_float(width * height * 4);
@@ -1396,27 +1489,33 @@ void process(dt_iop_module_t *self,
   }
 
   // check that all buffers exist before processing because we use a lot of memory here.
-  if(out_of_memory)
-  {
-    dt_iop_copy_image_roi(ovoid, ivoid, piece->colors, roi_in, roi_out);
-    dt_control_log(_("diffuse/sharpen failed to allocate memory, check your RAM settings"));
-    goto finish;
-  }
+  if(out_of_memory) goto finish;
 
+  const float *restrict in = input;
   const gboolean has_mask = (data->threshold > 0.f);
   if(has_mask)
   {
     // build a boolean mask, TRUE where image is above threshold, FALSE otherwise
-    build_mask(in, mask, data->threshold, roi_out->width, roi_out->height);
+    build_mask(in, mask, data->threshold, width, height);
 
     // init the inpainting area with noise
-    inpaint_mask(temp1, in, mask, roi_out->width, roi_out->height);
+    inpaint_mask(temp1, in, mask, width, height);
 
     in = temp1;
   }
 
+  const float min_weight = MIN_SCALE_WEIGHT / iterations;
+  int skipped = 0;
+  for(int s = 0; s < scales; s++)
+    if(scale_weight(data, s, zoom) < min_weight) skipped++;
+
+  const double start = dt_get_debug_wtime();
+  *done = iterations;
   for(int it = 0; it < iterations; it++)
   {
+    const float *restrict temp_in;
+    float *restrict temp_out;
+
     if(it == 0)
     {
       temp_in = in;
@@ -1436,11 +1535,25 @@ void process(dt_iop_module_t *self,
     if(it == iterations - 1)
       temp_out = out;
 
-    wavelets_process(temp_in, temp_out, mask,
-                     roi_out->width, roi_out->height,
-                     data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
+    wavelets_process(temp_in, temp_out, mask, width, height,
+                     data, final_radius, zoom, scales, min_weight, has_mask, HF, LF_odd, LF_even);
+
+    // stop once the solution doesn't change anymore
+    if(convergence > 0.f
+       && it < iterations - 1
+       && update_norm(temp_in, temp_out, width, height) < convergence)
+    {
+      dt_iop_image_copy_by_size(out, temp_out, width, height, 4);
+      *done = it + 1;
+      break;
+    }
   }
 
+  dt_print(DT_DEBUG_PERF,
+           "[diffuse] %zux%zu, %d of %d iterations, %d of %d scales diffused, took %0.04f sec",
+           width, height, *done, iterations, scales - skipped, scales,
+           dt_get_debug_wtime() - start);
+
 finish:
   dt_free_align(mask);
   dt_free_align(temp1);
@@ -1448,7 +1561,122 @@ finish:
   dt_free_align(LF_even);
   dt_free_align(LF_odd);
   for(int s = 0; s < scales; s++)
-    if(HF[s]) dt_free_align(HF[s]);
+    dt_free_align(HF[s]);
+  return !out_of_memory;
+}
+
+// longest side of the image the convergence is measured on
+#define CONVERGENCE_SIZE 256
+
+// number of iterations the diffusion of the whole image needs to converge. It is measured on
+// a downscale to a fixed size so it doesn't depend on the size of the input. zoom is the
+// scale of the input relative to the full image. Returns 0 if out of memory.
+static int _measure_convergence(const dt_iop_diffuse_data_t *const data,
+                                const float *const restrict in,
+                                const size_t width,
+                                const size_t height,
+                                const float zoom)
+{
+  const float factor = fmaxf((float)MAX(width, height) / CONVERGENCE_SIZE, 1.f);
+  const size_t small_width = MAX((size_t)roundf(width / factor), 1);
+  const size_t small_height = MAX((size_t)roundf(height / factor), 1);
+
+  float *const restrict small = dt_alloc_align_float(small_width * small_height * 4);
+  float *const restrict diffused = dt_alloc_align_float(small_width * small_height * 4);
+  int done = 0;
+  if(small && diffused)
+  {
+    // box downscale, every input pixel falls into exactly one output pixel
+    DT_OMP_FOR()
+    for(size_t i = 0; i < small_height; i++)
+    {
+      const size_t y0 = i * height / small_height;
+      const size_t y1 = (i + 1) * height / small_height;
+      for(size_t j = 0; j < small_width; j++)
+      {
+        const size_t x0 = j * width / small_width;
+        const size_t x1 = (j + 1) * width / small_width;
+        dt_aligned_pixel_t sum = { 0.f, 0.f, 0.f, 0.f };
+        for(size_t y = y0; y < y1; y++)
+          for(size_t x = x0; x < x1; x++)
+            for_four_channels(c) sum[c] += in[(y * width + x) * 4 + c];
+        const float norm = 1.f / ((y1 - y0) * (x1 - x0));
+        for_four_channels(c) small[(i * small_width + j) * 4 + c] = sum[c] * norm;
+      }
+    }
+
+    if(!_diffuse_image(data, small, diffused, small_width, small_height,
+                       zoom * width / small_width, MAX(data->iterations, 1),
+                       data->convergence, &done))
+      done = 0;
+  }
+  dt_free_align(small);
+  dt_free_align(diffused);
+  return done;
+}
+
+// in darkroom the preview pipe sees the whole image, it measures the convergence for the
+// gui to keep it in the params
+static inline gboolean _measures_convergence(dt_iop_module_t *self,
+                                             dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_diffuse_data_t *const data = piece->data;
+  return self->dev->gui_attached && self->gui_data
+    && data->convergence > 0.f
+    && (piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+    && !piece->pipe->tiling;
+}
+
+static void _store_convergence(dt_iop_module_t *self,
+                               dt_dev_pixelpipe_iop_t *piece,
+                               const float *const restrict in,
+                               const size_t width,
+                               const size_t height,
+                               const float zoom)
+{
+  dt_iop_diffuse_gui_data_t *g = self->gui_data;
+  const int converged = _measure_convergence(piece->data, in, width, height, zoom);
+  dt_iop_gui_enter_critical_section(self);
+  g->converged = converged;
+  dt_iop_gui_leave_critical_section(self);
+}
+
+void process(dt_iop_module_t *self,
+             dt_dev_pixelpipe_iop_t *piece,
+             const void *const restrict ivoid,
+             void *const restrict ovoid,
+             const dt_iop_roi_t *const roi_in,
+             const dt_iop_roi_t *const roi_out)
+{
+  const gboolean fastmode = piece->pipe->type & DT_DEV_PIXELPIPE_FAST;
+
+  const dt_iop_diffuse_data_t *const data = piece->data;
+
+  const size_t width = roi_out->width;
+  const size_t height = roi_out->height;
+
+  // allow fast mode, just copy input to output
+  if(fastmode)
+  {
+    const size_t ch = piece->colors;
+    dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out);
+    return;
+  }
+
+  const float *const restrict in = DT_IS_ALIGNED((const float *const restrict)ivoid);
+  float *const restrict out = DT_IS_ALIGNED((float *const restrict)ovoid);
+
+  const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
+
+  if(_measures_convergence(self, piece))
+    _store_convergence(self, piece, in, width, height, scale);
+
+  int done = 0;
+  if(!_diffuse_image(data, in, out, width, height, scale, _iterations(data), 0.f, &done))
+  {
+    dt_iop_copy_image_roi(ovoid, ivoid, piece->colors, roi_in, roi_out);
+    dt_control_log(_("diffuse/sharpen failed to allocate memory, check your RAM settings"));
+  }
 }
 
 #if HAVE_OPENCL
@@ -1463,6 +1691,7 @@ static inline cl_int wavelets_process_cl(const int devid,
                                          dt_iop_diffuse_global_data_t *const gd,
                                          const float final_radius,
                                          const float zoom, const int scales,
+                                         const float min_weight,
                                          const int has_mask,
                                          cl_mem HF[MAX_NUM_SCALES],
                                          cl_mem LF_odd,
@@ -1589,15 +1818,26 @@ static inline cl_int wavelets_process_cl(const int devid,
     if(s == 0) buffer_out = reconstructed;
 
     // Compute wavelets low-frequency scales
-    dt_opencl_set_kernel_args(devid, gd->kernel_diffuse_pde, 0,
-                              CLARG(HF[s]), CLARG(buffer_in), CLARG(mask),
-                              CLARG(has_mask), CLARG(buffer_out),
-                              CLARG(width), CLARG(height),
-                              CLARG(anisotropy), CLARG(isotropy_type),
-                              CLARG(regularization), CLARG(variance_threshold),
-                              CLARG(current_radius_square), CLARG(mult), CLARG(ABCD),
-                              CLARG(strength));
-    err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_diffuse_pde, sizes);
+    if(norm < min_weight)
+    {
+      dt_opencl_set_kernel_args(devid, gd->kernel_diffuse_reconstruct, 0,
+                                CLARG(HF[s]), CLARG(buffer_in), CLARG(mask),
+                                CLARG(has_mask), CLARG(buffer_out),
+                                CLARG(width), CLARG(height));
+      err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_diffuse_reconstruct, sizes);
+    }
+    else
+    {
+      dt_opencl_set_kernel_args(devid, gd->kernel_diffuse_pde, 0,
+                                CLARG(HF[s]), CLARG(buffer_in), CLARG(mask),
+                                CLARG(has_mask), CLARG(buffer_out),
+                                CLARG(width), CLARG(height),
+                                CLARG(anisotropy), CLARG(isotropy_type),
+                                CLARG(regularization), CLARG(variance_threshold),
+                                CLARG(current_radius_square), CLARG(mult), CLARG(ABCD),
+                                CLARG(strength));
+      err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_diffuse_pde, sizes);
+    }
     if(err != CL_SUCCESS) return err;
 
     count++;
@@ -1646,10 +1886,22 @@ int process_cl(dt_iop_module_t *self,
   cl_mem LF_even = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
   cl_mem LF_odd = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
 
+  const int iterations = _iterations(data);
+
   const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
+
+  // the convergence is measured on the cpu, the preview is small enough
+  if(_measures_convergence(self, piece))
+  {
+    float *host_in = dt_alloc_align_float((size_t)width * height * 4);
+    if(host_in
+       && dt_opencl_copy_device_to_host(devid, host_in, dev_in, width, height,
+                                        sizeof(float) * 4) == CL_SUCCESS)
+      _store_convergence(self, piece, host_in, width, height, scale);
+    dt_free_align(host_in);
+  }
   const float final_radius = (data->radius + data->radius_center) * 2.f / scale;
 
-  const int iterations = MAX(ceilf((float)data->iterations), 1);
   const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
   const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
 
@@ -1690,6 +1942,12 @@ int process_cl(dt_iop_module_t *self,
     in = temp1;
   }
 
+  const float min_weight = MIN_SCALE_WEIGHT / iterations;
+  int skipped = 0;
+  for(int s = 0; s < scales; s++)
+    if(scale_weight(data, s, scale) < min_weight) skipped++;
+
+  const double start = dt_get_debug_wtime();
   for(int it = 0; it < iterations; it++)
   {
     if(it == 0)
@@ -1712,9 +1970,15 @@ int process_cl(dt_iop_module_t *self,
       temp_out = dev_out;
     err = wavelets_process_cl(devid, temp_in, temp_out, mask, sizes,
                               width, height, data, gd, final_radius,
-                              scale, scales, has_mask, HF, LF_odd, LF_even);
+                              scale, scales, min_weight, has_mask, HF, LF_odd, LF_even);
+    if(err != CL_SUCCESS) goto error;
   }
 
+  dt_print(DT_DEBUG_PERF,
+           "[diffuse] %ix%i, %d iterations, %d of %d scales diffused, took %0.04f sec",
+           width, height, iterations, scales - skipped, scales,
+           dt_get_debug_wtime() - start);
+
 error:
   dt_opencl_release_mem_object(temp1);
   dt_opencl_release_mem_object(temp2);
@@ -1735,6 +1999,7 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_diffuse_build_mask = dt_opencl_create_kernel(program, "build_mask");
   gd->kernel_diffuse_inpaint_mask = dt_opencl_create_kernel(program, "inpaint_mask");
   gd->kernel_diffuse_pde = dt_opencl_create_kernel(program, "diffuse_pde");
+  gd->kernel_diffuse_reconstruct = dt_opencl_create_kernel(program, "diffuse_reconstruct");
 
   const int wavelets = 35; // bspline.cl, from programs.conf
   gd->kernel_filmic_bspline_horizontal =
@@ -1752,6 +2017,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_diffuse_build_mask);
   dt_opencl_free_kernel(gd->kernel_diffuse_inpaint_mask);
   dt_opencl_free_kernel(gd->kernel_diffuse_pde);
+  dt_opencl_free_kernel(gd->kernel_diffuse_reconstruct);
 
   dt_opencl_free_kernel(gd->kernel_filmic_bspline_vertical);
   dt_opencl_free_kernel(gd->kernel_filmic_bspline_horizontal);
@@ -1762,10 +2028,33 @@ void cleanup_global(dt_iop_module_so_t *self)
 #endif
 
 
+static void _preview_pipe_finished_callback(gpointer instance, dt_iop_module_t *self)
+{
+  dt_iop_diffuse_params_t *p = self->params;
+  dt_iop_diffuse_gui_data_t *g = self->gui_data;
+
+  if(g == NULL) return;
+
+  dt_iop_gui_enter_critical_section(self);
+  const int converged = g->converged;
+  g->converged = 0;
+  dt_iop_gui_leave_critical_section(self);
+
+  // keep the measured iterations in the history so all pipes, export included, run as many
+  if(converged > 0 && p->convergence > 0.f && converged != p->converged_iterations)
+  {
+    p->converged_iterations = converged;
+    dt_dev_add_history_item(darktable.develop, self, TRUE);
+  }
+}
+
 void gui_init(dt_iop_module_t *self)
 {
   dt_iop_diffuse_gui_data_t *g = IOP_GUI_ALLOC(diffuse);
 
+  g->converged = 0;
+  DT_CONTROL_SIGNAL_HANDLE(DT_SIGNAL_DEVELOP_PREVIEW_PIPE_FINISHED, _preview_pipe_finished_callback);
+
   self->widget = dt_gui_vbox(dt_ui_section_label_new(C_("section", "properties")));
 
   g->iterations = dt_bauhaus_slider_from_params(self, "iterations");
@@ -1777,6 +2066,17 @@ void gui_init(dt_iop_module_t *self)
        "if you plan on sharpening or inpainting, \n"
        "more iterations help reconstruction."));
 
+  g->convergence = dt_bauhaus_slider_from_params(self, "convergence");
+  dt_bauhaus_slider_set_digits(g->convergence, 3);
+  dt_bauhaus_slider_set_format(g->convergence, "%");
+  gtk_widget_set_tooltip_text
+    (g->convergence,
+     _("stop iterating once an iteration changes the image less than this.\n"
+       "saves time with many iterations when the diffusion settles early.\n"
+       "the iterations needed are measured on the whole image in darkroom\n"
+       "and kept with the edit, until then all iterations are run.\n"
+       "0 always runs all iterations."));
+
   g->radius_center = dt_bauhaus_slider_from_params(self, "radius_center");
   dt_bauhaus_slider_set_soft_range(g->radius_center, 0., 512.);
   dt_bauhaus_slider_set_format(g->radius_center, _(" px"));
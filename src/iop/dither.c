@@ -26,6 +26,7 @@
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
+#include "develop/noise_generator.h"
 #include "develop/tiling.h"
 #include "dtgtk/gradientslider.h"
 #include "gui/accelerators.h"
@@ -66,6 +67,9 @@ typedef enum dt_iop_dither_type_t
 
 #define POSTERIZE_FLAG 0x100
 
+// key of the random dither noise
+#define DITHER_SEED 0xa341316cu
+
 typedef struct dt_iop_dither_params_t
 {
   dt_iop_dither_type_t dither_type; // $DEFAULT: DITHER_FSAUTO $DESCRIPTION: "method"
@@ -587,32 +591,25 @@ static void _process_random(
 
   const float dither = powf(2.0f, data->random.damping / 10.0f);
 
-  unsigned int *const tea_states = alloc_tea_states(dt_get_num_threads());
-
-  DT_OMP_PRAGMA(parallel default(firstprivate))
+  // the noise is a function of the pixel position in the full pipe, so it
+  // doesn't depend on threads or tiling
+  DT_OMP_FOR()
+  for(int j = 0; j < height; j++)
   {
-    // get a pointer to each thread's private buffer *outside* the for loop, to avoid a function call per iteration
-    unsigned int *const tea_state = get_tea_state(tea_states,dt_get_thread_num());
-    DT_OMP_PRAGMA(for schedule(static))
-    for(int j = 0; j < height; j++)
+    const size_t k = (size_t)4 * width * j;
+    const float *const in = (const float *)ivoid + k;
+    float *const out = (float *)ovoid + k;
+    const uint32_t y = roi_in->y + j;
+    for(int i = 0; i < width; i++)
     {
-      const size_t k = (size_t)4 * width * j;
-      const float *const in = (const float *)ivoid + k;
-      float *const out = (float *)ovoid + k;
-      tea_state[0] = j * height; /* + dt_get_thread_num() -- do not include, makes results unreproducible */
-      for(int i = 0; i < width; i++)
-      {
-        encrypt_tea(tea_state);
-        float dith = dither * tpdf(tea_state[0]);
+      const float dith = dither * tpdf((uint32_t)(philox2x32(roi_in->x + i, y, DITHER_SEED) >> 32));
 
-        for_each_channel(c,aligned(in,out:64))
-        {
-          out[4*i+c] = CLIP(in[4*i+c] + dith);
-        }
+      for_each_channel(c,aligned(in,out:64))
+      {
+        out[4*i+c] = CLIP(in[4*i+c] + dith);
       }
     }
   }
-  free_tea_states(tea_states);
 }
 
 static void _process_posterize(
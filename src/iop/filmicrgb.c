@@ -28,6 +28,7 @@
 #include "common/colorspaces_inline_conversions.h"
 #include "common/chromatic_adaptation.h"
 #include "common/bspline.h"
+#include "common/curve_baker.h"
 #include "common/gamut_mapping.h"
 #include "common/image.h"
 #include "common/dttypes.h"
@@ -312,6 +313,7 @@ typedef struct dt_iop_filmicrgb_data_t
   struct dt_iop_filmic_rgb_spline_t spline DT_ALIGNED_ARRAY;
   dt_noise_distribution_t noise_distribution;
   gboolean enable_highlight_reconstruction;
+  dt_baked_curve_t curve_rgb, curve_norm; // v4 and v5 tone mapping per channel and on the norm
 } dt_iop_filmicrgb_data_t;
 
 
@@ -1782,6 +1784,37 @@ static int filmic_v4_prepare_matrices(dt_colormatrix_t input_matrix_trans,
   return use_output_profile;
 }
 
+// the single channel transfer functions of norm_tone_mapping_v4() and
+// RGB_tone_mapping_v4(), baked in commit_params()
+static float _baked_curve_norm(const float x, const void *const data)
+{
+  const dt_iop_filmicrgb_data_t *const d = data;
+  const dt_iop_filmic_rgb_spline_t *const spline = &d->spline;
+  const float display_black = powf(spline->y[0], d->output_power);
+  const float display_white = powf(spline->y[4], d->output_power);
+  const float norm = log_tonemapping_v2_1ch(x, d->grey_source, d->black_source, d->dynamic_range);
+  return powf(CLAMP(filmic_spline(norm, spline->M1, spline->M2, spline->M3, spline->M4, spline->M5,
+                                  spline->latitude_min, spline->latitude_max, spline->type),
+                    display_black,
+                    display_white),
+              d->output_power);
+}
+
+static float _baked_curve_rgb(const float x, const void *const data)
+{
+  const dt_iop_filmicrgb_data_t *const d = data;
+  const dt_iop_filmic_rgb_spline_t *const spline = &d->spline;
+  const float display_white = powf(spline->y[4], d->output_power);
+  const float mapped = filmic_spline(log_tonemapping_v2_1ch(x, d->grey_source, d->black_source, d->dynamic_range),
+                                     spline->M1, spline->M2, spline->M3, spline->M4, spline->M5,
+                                     spline->latitude_min, spline->latitude_max, spline->type);
+  // same vectorized power as the analytic path
+  const dt_aligned_pixel_t clamped = { CLAMP(mapped, 0.0f, display_white) };
+  dt_aligned_pixel_t out;
+  dt_vector_pow1(clamped, d->output_power, out);
+  return out[0];
+}
+
 DT_OMP_DECLARE_SIMD(
   uniform(work_profile, data, spline, norm_min, norm_max, display_black, display_white, type)
   aligned(pix_in, pix_out:16))
@@ -1807,16 +1840,23 @@ static inline void norm_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
   for_each_channel(c,aligned(pix_in))
     ratios[c] = pix_in[c] / norm;
 
-  // Log tone-mapping
-  norm = log_tonemapping_v2_1ch(norm, data->grey_source, data->black_source, data->dynamic_range);
+  if(dt_baked_curve_valid(&data->curve_norm))
+  {
+    norm = dt_baked_curve_eval(&data->curve_norm, norm);
+  }
+  else
+  {
+    // Log tone-mapping
+    norm = log_tonemapping_v2_1ch(norm, data->grey_source, data->black_source, data->dynamic_range);
 
-  // Filmic S curve on the max RGB
-  // Apply the transfer function of the display
-  norm = powf(CLAMP(filmic_spline(norm, spline.M1, spline.M2, spline.M3, spline.M4, spline.M5,
-                                        spline.latitude_min, spline.latitude_max, spline.type),
-                    display_black,
-                    display_white),
-              data->output_power);
+    // Filmic S curve on the max RGB
+    // Apply the transfer function of the display
+    norm = powf(CLAMP(filmic_spline(norm, spline.M1, spline.M2, spline.M3, spline.M4, spline.M5,
+                                          spline.latitude_min, spline.latitude_max, spline.type),
+                      display_black,
+                      display_white),
+                data->output_power);
+  }
 
   // Restore RGB
   for_each_channel(c,aligned(pix_out))
@@ -1831,6 +1871,13 @@ static inline void RGB_tone_mapping_v4(const dt_aligned_pixel_t pix_in,
                                        const float display_black,
                                        const float display_white)
 {
+  if(dt_baked_curve_valid(&data->curve_rgb))
+  {
+    for_each_channel(c, aligned(pix_in, pix_out))
+      pix_out[c] = dt_baked_curve_eval(&data->curve_rgb, pix_in[c]);
+    return;
+  }
+
   dt_aligned_pixel_t mapped;
   log_tonemapping_v2(mapped, pix_in, data->grey_source, data->black_source, data->dynamic_range);
 //  for_each_channel(c,aligned(mapped))
@@ -3118,6 +3165,19 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   d->reconstruct_grey_vs_color = (p->reconstruct_grey_vs_color / 100.0f + 1.f) / 2.f;
 
   d->enable_highlight_reconstruction = p->enable_highlight_reconstruction;
+
+  // the log encoding clips outside of [norm_min, norm_max] so the curves are flat there
+  dt_baked_curve_cleanup(&d->curve_rgb);
+  dt_baked_curve_cleanup(&d->curve_norm);
+  if(p->version >= DT_FILMIC_COLORSCIENCE_V4)
+  {
+    const float norm_min = exp_tonemapping_v2(0.f, d->grey_source, d->black_source, d->dynamic_range);
+    const float norm_max = exp_tonemapping_v2(1.f, d->grey_source, d->black_source, d->dynamic_range);
+    dt_baked_curve_init(&d->curve_rgb, _baked_curve_rgb, d, 0.5f * norm_min, 4.0f * norm_max,
+                        DT_CURVE_BAKER_TOLERANCE);
+    dt_baked_curve_init(&d->curve_norm, _baked_curve_norm, d, 0.5f * norm_min, 4.0f * norm_max,
+                        DT_CURVE_BAKER_TOLERANCE);
+  }
 }
 
 void gui_focus(dt_iop_module_t *self, gboolean in)
@@ -3141,6 +3201,9 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_filmicrgb_data_t *d = piece->data;
+  dt_baked_curve_cleanup(&d->curve_rgb);
+  dt_baked_curve_cleanup(&d->curve_norm);
   dt_free_align(piece->data);
   piece->data = NULL;
 }
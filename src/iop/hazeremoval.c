@@ -35,6 +35,7 @@
 #include "common/box_filters.h"
 #include "common/darktable.h"
 #include "common/guided_filter.h"
+#include "common/pipe_stats.h"
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
@@ -57,7 +58,7 @@
 // implement the module api
 //----------------------------------------------------------------------
 
-DT_MODULE_INTROSPECTION(3, dt_iop_hazeremoval_params_t)
+DT_MODULE_INTROSPECTION(4, dt_iop_hazeremoval_params_t)
 
 typedef dt_aligned_pixel_t rgb_pixel;
 
@@ -67,6 +68,7 @@ typedef struct dt_iop_hazeremoval_params_t
   float distance; // $MIN:  0.0 $MAX: 1.0 $DEFAULT: 0.2
   gboolean compatibility_mode; // $DEFAULT: FALSE
   gboolean adaptive; // $DEFAULT: TRUE
+  gboolean sampled; // $DEFAULT: TRUE
 } dt_iop_hazeremoval_params_t;
 
 // types  dt_iop_hazeremoval_params_t and dt_iop_hazeremoval_data_t are
@@ -90,6 +92,7 @@ typedef struct dt_iop_hazeremoval_global_data_t
   int kernel_hazeremoval_box_max_x;
   int kernel_hazeremoval_box_max_y;
   int kernel_hazeremoval_dehaze;
+  dt_pipe_stats_cache_t ambient_light; // distance_max and A0 of recent inputs
 } dt_iop_hazeremoval_global_data_t;
 
 
@@ -156,6 +159,14 @@ int legacy_params(dt_iop_module_t *self,
                   int32_t *new_params_size,
                   int *new_version)
 {
+  typedef struct dt_iop_hazeremoval_params_v3_t
+  {
+    float strength;
+    float distance;
+    gboolean compatibility_mode;
+    gboolean adaptive;
+  } dt_iop_hazeremoval_params_v3_t;
+
   if(old_version == 1)
   {
     typedef struct dt_iop_hazeremoval_params_v1_t
@@ -165,14 +176,14 @@ int legacy_params(dt_iop_module_t *self,
     } dt_iop_hazeremoval_params_v1_t;
     const dt_iop_hazeremoval_params_v1_t *o = old_params;
 
-    dt_iop_hazeremoval_params_t *n = malloc(sizeof(dt_iop_hazeremoval_params_t));
+    dt_iop_hazeremoval_params_v3_t *n = malloc(sizeof(dt_iop_hazeremoval_params_v3_t));
     memcpy(n, o, sizeof(dt_iop_hazeremoval_params_v1_t));
 
     n->compatibility_mode = TRUE;
     n->adaptive = FALSE;
 
     *new_params = n;
-    *new_params_size = sizeof(dt_iop_hazeremoval_params_t);
+    *new_params_size = sizeof(dt_iop_hazeremoval_params_v3_t);
     *new_version = 3;
     return 0;
   }
@@ -187,16 +198,31 @@ int legacy_params(dt_iop_module_t *self,
     } dt_iop_hazeremoval_params_v2_t;
     const dt_iop_hazeremoval_params_v2_t *o = old_params;
 
-    dt_iop_hazeremoval_params_t *n = malloc(sizeof(dt_iop_hazeremoval_params_t));
+    dt_iop_hazeremoval_params_v3_t *n = malloc(sizeof(dt_iop_hazeremoval_params_v3_t));
     memcpy(n, o, sizeof(dt_iop_hazeremoval_params_v2_t));
 
     n->adaptive = FALSE;
     *new_params = n;
-    *new_params_size = sizeof(dt_iop_hazeremoval_params_t);
+    *new_params_size = sizeof(dt_iop_hazeremoval_params_v3_t);
     *new_version = 3;
     return 0;
   }
 
+  if(old_version == 3)
+  {
+    const dt_iop_hazeremoval_params_v3_t *o = old_params;
+
+    dt_iop_hazeremoval_params_t *n = malloc(sizeof(dt_iop_hazeremoval_params_t));
+    memcpy(n, o, sizeof(dt_iop_hazeremoval_params_v3_t));
+
+    // ambient light from all pixels as before
+    n->sampled = FALSE;
+    *new_params = n;
+    *new_params_size = sizeof(dt_iop_hazeremoval_params_t);
+    *new_version = 4;
+    return 0;
+  }
+
   return 1;
 }
 
@@ -216,6 +242,7 @@ void init_global(dt_iop_module_so_t *self)
     dt_opencl_create_kernel(program, "hazeremoval_box_max_y");
   gd->kernel_hazeremoval_dehaze =
     dt_opencl_create_kernel(program, "hazeremoval_dehaze");
+  dt_pipe_stats_cache_init(&gd->ambient_light);
   self->data = gd;
 }
 
@@ -229,6 +256,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_hazeremoval_box_max_x);
   dt_opencl_free_kernel(gd->kernel_hazeremoval_box_max_y);
   dt_opencl_free_kernel(gd->kernel_hazeremoval_dehaze);
+  dt_pipe_stats_cache_cleanup(&gd->ambient_light);
   free(self->data);
   self->data = NULL;
 }
@@ -256,6 +284,7 @@ void gui_changed(dt_iop_module_t *self,
   {
     p->compatibility_mode = FALSE;
     p->adaptive = TRUE;
+    p->sampled = TRUE;
   }
 }
 
@@ -442,6 +471,104 @@ void _quick_select(float *first,
   }
 }
 
+// the maximal depth from the haze level of the most hazy pixels
+static inline float _max_depth(const float crit_haze_level)
+{
+  // for almost haze free images it may happen that crit_haze_level=0, this means
+  // there is a very large image depth, in this case a large number is returned, that
+  // is small enough to avoid overflow in later processing
+  // the critical haze level is at dark_channel_quantil (not 100%) to be insensitive
+  // to extreme outliners, compensate for that by some factor slightly larger than
+  // unity when calculating the maximal image depth
+  return crit_haze_level > 0
+    ? -1.125f * logf(crit_haze_level)
+    : logf(FLT_MAX) / 2; // return the maximal depth
+}
+
+// as _ambient_light() below but from a sample of the pixels, the dark channel
+// is evaluated at the sampled pixels only. The quantiles are within the rank
+// error of common/pipe_stats.h. Returns NAN if buffers can't be allocated.
+static float _ambient_light_sampled(const const_rgb_image img,
+                                    const int w1,
+                                    rgb_pixel *pA0)
+{
+  const float dark_channel_quantil = 0.95f;
+  const float bright_quantil = 0.95f;
+  const int width = img.width;
+  const int height = img.height;
+  const int stride = img.stride;
+  const float *const restrict img_data = img.data;
+
+  size_t *const idx = dt_alloc_aligned(sizeof(size_t) * DT_PIPE_STATS_SAMPLES);
+  float *const dark = dt_alloc_align_float(DT_PIPE_STATS_SAMPLES);
+  float *const hazy = dt_alloc_align_float(DT_PIPE_STATS_SAMPLES);
+  if(!idx || !dark || !hazy)
+  {
+    dt_free_align(idx);
+    dt_free_align(dark);
+    dt_free_align(hazy);
+    return NAN;
+  }
+
+  const size_t n = dt_pipe_stats_sample(width, height, DT_PIPE_STATS_SAMPLES, idx);
+  DT_OMP_FOR()
+  for(size_t k = 0; k < n; k++)
+  {
+    const int x = idx[k] % width;
+    const int y = idx[k] / width;
+    float m = FLT_MAX;
+    for(int j = MAX(y - w1, 0); j <= MIN(y + w1, height - 1); j++)
+      for(int i = MAX(x - w1, 0); i <= MIN(x + w1, width - 1); i++)
+      {
+        const float *pixel = img_data + stride * ((size_t)j * width + i);
+        m = MIN(m, MIN(MIN(pixel[0], pixel[1]), pixel[2]));
+      }
+    dark[k] = m;
+  }
+
+  // the most hazy pixels, and the brightest among those
+  memcpy(hazy, dark, sizeof(float) * n);
+  const float crit_haze_level = dt_pipe_stats_quantile(hazy, n, dark_channel_quantil);
+  size_t n_hazy = 0;
+  for(size_t k = 0; k < n; k++)
+    if(dark[k] >= crit_haze_level)
+    {
+      const float *pixel = img_data + stride * idx[k];
+      hazy[n_hazy++] = pixel[0] + pixel[1] + pixel[2];
+    }
+  const float crit_brightness = dt_pipe_stats_quantile(hazy, n_hazy, bright_quantil);
+
+  dt_aligned_pixel_t A0 = { 0.0f, 0.0f, 0.0f, 0.0f };
+  size_t N_bright_hazy = 0;
+  for(size_t k = 0; k < n; k++)
+  {
+    const float *pixel = img_data + stride * idx[k];
+    if(dark[k] >= crit_haze_level
+       && pixel[0] + pixel[1] + pixel[2] >= crit_brightness)
+    {
+      for_each_channel(c)
+        A0[c] += pixel[c];
+      N_bright_hazy++;
+    }
+  }
+  if(N_bright_hazy > 0)
+  {
+    for_each_channel(c)
+      A0[c] /= N_bright_hazy;
+  }
+  (*pA0)[0] = A0[0];
+  (*pA0)[1] = A0[1];
+  (*pA0)[2] = A0[2];
+
+  dt_print(DT_DEBUG_VERBOSE, "[hazeremoval] ambient light from %zu of %dx%d pixels, quantil error %.4f",
+           n, width, height, dt_pipe_stats_rank_error(n, 1e-3f));
+
+  dt_free_align(idx);
+  dt_free_align(dark);
+  dt_free_align(hazy);
+  return _max_depth(crit_haze_level);
+}
+
 // calculate diffusive ambient light and the maximal depth in the image
 // depth is estimated by the local amount of haze and given in units of the
 // characteristic haze depth, i.e., the distance over which object light is
@@ -449,7 +576,8 @@ void _quick_select(float *first,
 static float _ambient_light(const const_rgb_image img,
                             const int w1,
                             rgb_pixel *pA0,
-                            const gboolean compatibility_mode)
+                            const gboolean compatibility_mode,
+                            const gboolean sampled)
 {
   const float dark_channel_quantil = 0.95f; // quantil for determining the most hazy pixels
   const float bright_quantil = 0.95f; // quantil for determining the
@@ -458,6 +586,12 @@ static float _ambient_light(const const_rgb_image img,
   const int width = img.width;
   const int height = img.height;
   const size_t size = (size_t)width * height;
+  // large images are sampled, edits from before version 4 keep using all pixels
+  if(sampled && size > 4 * DT_PIPE_STATS_SAMPLES)
+  {
+    const float max_depth = _ambient_light_sampled(img, w1, pA0);
+    if(!dt_isnan(max_depth)) return max_depth;
+  }
   // calculate dark channel, which is an estimate for local amount of haze
   gray_image dark_ch = new_gray_image(width, height);
   _dark_channel(img, dark_ch, w1);
@@ -545,15 +679,45 @@ static float _ambient_light(const const_rgb_image img,
   (*pA0)[1] = A0[1];
   (*pA0)[2] = A0[2];
   free_gray_image(&dark_ch);
-  // for almost haze free images it may happen that crit_haze_level=0, this means
-  // there is a very large image depth, in this case a large number is returned, that
-  // is small enough to avoid overflow in later processing
-  // the critical haze level is at dark_channel_quantil (not 100%) to be insensitive
-  // to extreme outliners, compensate for that by some factor slightly larger than
-  // unity when calculating the maximal image depth
-  return crit_haze_level > 0
-    ? -1.125f * logf(crit_haze_level)
-    : logf(FLT_MAX) / 2; // return the maximal depth
+  return _max_depth(crit_haze_level);
+}
+
+// distance_max and A0 are kept for the input of the module, so re-running
+// the pipe with other parameters of this or later modules doesn't redo them
+static dt_hash_t _ambient_light_key(dt_iop_module_t *self,
+                                    dt_dev_pixelpipe_iop_t *piece,
+                                    const dt_iop_roi_t *const roi_in,
+                                    const int w1,
+                                    const gboolean compatibility_mode,
+                                    const gboolean sampled)
+{
+  dt_hash_t hash = dt_pipe_stats_key(self, piece, roi_in);
+  hash = dt_hash(hash, &w1, sizeof(w1));
+  hash = dt_hash(hash, &compatibility_mode, sizeof(compatibility_mode));
+  return dt_hash(hash, &sampled, sizeof(sampled));
+}
+
+static gboolean _ambient_light_get(dt_iop_hazeremoval_global_data_t *gd,
+                                   const dt_hash_t key,
+                                   rgb_pixel *pA0,
+                                   float *distance_max)
+{
+  float values[4];
+  if(!dt_pipe_stats_cache_get(&gd->ambient_light, key, values, 4)) return FALSE;
+  *distance_max = values[0];
+  for(int c = 0; c < 3; c++) (*pA0)[c] = values[c + 1];
+  return TRUE;
+}
+
+static void _ambient_light_put(dt_iop_hazeremoval_global_data_t *gd,
+                               const dt_hash_t key,
+                               const rgb_pixel A0,
+                               const float distance_max)
+{
+  // failures aren't kept
+  if(!(distance_max > 0.0f)) return;
+  const float values[4] = { distance_max, A0[0], A0[1], A0[2] };
+  dt_pipe_stats_cache_put(&gd->ambient_light, key, values, 4);
 }
 
 void process(dt_iop_module_t *self,
@@ -644,7 +808,16 @@ void process(dt_iop_module_t *self,
 
   // In all other cases we calculate distance_max and A0 here.
   if(dt_isnan(distance_max))
-    distance_max = _ambient_light(img_in, w1, &A0, compatibility_mode);
+  {
+    dt_iop_hazeremoval_global_data_t *gd = self->global_data;
+    const dt_hash_t key = _ambient_light_key(self, piece, roi_in, w1,
+                                             compatibility_mode, d->sampled);
+    if(!_ambient_light_get(gd, key, &A0, &distance_max))
+    {
+      distance_max = _ambient_light(img_in, w1, &A0, compatibility_mode, d->sampled);
+      _ambient_light_put(gd, key, A0, distance_max);
+    }
+  }
 
   if(storing)
   {
@@ -709,7 +882,8 @@ static float _ambient_light_cl(dt_iop_module_t *self,
                                cl_mem img,
                                const int w1,
                                rgb_pixel *pA0,
-                               const gboolean compatibility_mode)
+                               const gboolean compatibility_mode,
+                               const gboolean sampled)
 {
   const int width = dt_opencl_get_image_width(img);
   const int height = dt_opencl_get_image_height(img);
@@ -719,7 +893,7 @@ static float _ambient_light_cl(dt_iop_module_t *self,
   if(err != CL_SUCCESS) goto error;
 
   const const_rgb_image img_in = (const_rgb_image) {in, width, height, element_size / sizeof(float)};
-  const float max_depth = _ambient_light(img_in, w1, pA0, compatibility_mode);
+  const float max_depth = _ambient_light(img_in, w1, pA0, compatibility_mode, sampled);
   dt_free_align(in);
   return max_depth;
 error:
@@ -915,7 +1089,17 @@ int process_cl(dt_iop_module_t *self,
 
   // In all other cases we calculate distance_max and A0 here.
   if(dt_isnan(distance_max))
-    distance_max = _ambient_light_cl(self, devid, img_in, w1, &A0, compatibility_mode);
+  {
+    dt_iop_hazeremoval_global_data_t *gd = self->global_data;
+    const dt_hash_t key = _ambient_light_key(self, piece, roi_in, w1,
+                                             compatibility_mode, d->sampled);
+    if(!_ambient_light_get(gd, key, &A0, &distance_max))
+    {
+      distance_max = _ambient_light_cl(self, devid, img_in, w1, &A0,
+                                       compatibility_mode, d->sampled);
+      _ambient_light_put(gd, key, A0, distance_max);
+    }
+  }
 
   if(storing)
   {
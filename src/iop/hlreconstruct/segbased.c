@@ -577,18 +577,7 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   for(int p = 0; p < HL_RGB_PLANES; p++)
     dt_segments_combine(&isegments[p], d->combine);
 
-  if(dt_get_num_threads() >= HL_RGB_PLANES)
-  {
-    DT_OMP_PRAGMA(parallel num_threads(HL_RGB_PLANES))
-    {
-      dt_segmentize_plane(&isegments[dt_get_thread_num()]);
-    }
-  }
-  else
-  {
-    for(int p = 0; p < HL_RGB_PLANES; p++)
-      dt_segmentize_plane(&isegments[p]);
-  }
+  dt_segmentize_planes(isegments, HL_RGB_PLANES);
 
   for(int p = 0; p < HL_RGB_PLANES; p++)
     _calc_plane_candidates(plane[p], refavg[p], &isegments[p], cube_coeffs[p], d->candidating);
@@ -19,27 +19,28 @@
 /* Internal segmentation algorithms
    All segmentation stuff works on int32 arrays, to allow performant operations we use an additional border.
 
-   Morphological closing operation supporting radius up to 8, tuned for performance
+   Morphological closing operation supporting radius up to 8, tuned for performance.
+   Dilating and eroding are fused, both are done per block of rows in a single pass over the image.
 
-   The segmentation algorithm uses a modified floodfill, while floddfilling it
-   - also takes keeps track of the surrounding rectangle of every segment and
+   The segmentation is a block parallel connected component labelling using union-find, the blocks of
+   rows are labelled independently and merged along their borders afterwards. While segmentizing it
+   - keeps track of the surrounding rectangle of every segment and
    - marks the segment border locations.
+   Segment id's are given in scan order of a segment's first location so they don't depend on the
+   number of threads.
 
    Hanno Schwalm 2022/05
 */
 
 #define DT_SEG_ID_MASK 0x40000
 
-typedef struct dt_pos_t
-{
-  int xpos;
-  int ypos;
-} dt_pos_t;
+// rows per block for the block parallel labelling and the fused morphological closing
+#define DT_SEG_BLOCK_ROWS 64
 
 typedef struct dt_iop_segmentation_t
 {
   uint32_t *data; // holding segment id's for every location
-  uint32_t *tmp;  // pointer to temporary buffer used for morphological operations
+  uint32_t *tmp;  // pointer to temporary buffer used for morphological operations and labelling
   int *size;      // size of each segment
   int *xmin;      // bounding rectangle for each segment
   int *xmax;
@@ -54,26 +55,6 @@ typedef struct dt_iop_segmentation_t
   int height;
 } dt_iop_segmentation_t;
 
-typedef struct dt_ff_stack_t
-{
-  int pos;
-  int size;
-  dt_pos_t *el;
-} dt_ff_stack_t;
-
-static inline void _push_stack(int xpos, int ypos, dt_ff_stack_t *stack)
-{
-  const int i = stack->pos;
-  if(i >= stack->size - 1)
-  {
-    dt_print(DT_DEBUG_ALWAYS, "[segmentation stack overflow] %i", stack->size);
-    return;
-  }
-  stack->el[i].xpos = xpos;
-  stack->el[i].ypos = ypos;
-  stack->pos++;
-}
-
 static inline void _clear_segment_slot(dt_iop_segmentation_t *seg, uint32_t id)
 {
   if(id > seg->slots-1)
@@ -83,15 +64,6 @@ static inline void _clear_segment_slot(dt_iop_segmentation_t *seg, uint32_t id)
   seg->val1[id] = seg->val2[id] = 0.0f;
 }
 
-static inline dt_pos_t * _pop_stack(dt_ff_stack_t *stack)
-{
-  if(stack->pos > 0)
-    stack->pos--;
-  else
-    dt_print(DT_DEBUG_ALWAYS, "[segmentation stack underflow]");
-  return &stack->el[stack->pos];
-}
-
 static inline uint32_t _get_segment_id(dt_iop_segmentation_t *seg, const size_t loc)
 {
   if(loc >= (size_t)(seg->width * (seg->height-seg->border)))
@@ -208,24 +180,6 @@ static inline int _test_dilate(const uint32_t *img, const size_t i, const size_t
   return retval;
 }
 
-static inline void _dilating(const uint32_t *img,
-                             uint32_t *o,
-                             const int w1,
-                             const int height,
-                             const int border,
-                             const int radius)
-{
-  DT_OMP_FOR(collapse(2))
-  for(int row = border; row < height - border; row++)
-  {
-    for(int col = border; col < w1 - border; col++)
-    {
-      const size_t i = (size_t)row*w1 + col;
-      o[i] = _test_dilate(img, i, w1, radius) ? 1 : 0;
-    }
-  }
-}
-
 static inline int _test_erode(const uint32_t *img, const size_t i, const size_t w1, const int radius)
 {
   int retval = 1;
@@ -279,24 +233,6 @@ static inline int _test_erode(const uint32_t *img, const size_t i, const size_t
   return retval;
 }
 
-static inline void _eroding(const uint32_t *img,
-                            uint32_t *o,
-                            const int w1,
-                            const int height,
-                            const int border,
-                            const int radius)
-{
-  DT_OMP_FOR(collapse(2))
-  for(int row = border; row < height - border; row++)
-  {
-    for(int col = border; col < w1 - border; col++)
-    {
-      const size_t i = (size_t)row*w1 + col;
-      o[i] = _test_erode(img, i, w1, radius) ? 1 : 0;
-    }
-  }
-}
-
 static inline void _intimage_borderfill(uint32_t *d,
                                         const int width,
                                         const int height,
@@ -316,290 +252,435 @@ static inline void _intimage_borderfill(uint32_t *d,
   }
 }
 
-static gboolean _floodfill_segmentize(int yin,
-                                      int xin,
-                                      dt_iop_segmentation_t *seg,
-                                      const int w,
-                                      const int h,
-                                      const int id,
-                                      dt_ff_stack_t *stack)
+// union-find over the runs of a plane with the lower run index always being the root, runs are
+// indexed in scan order so the root of a segment is its first run. Path halving keeps parents lower
+// than the run itself. The size of a segment is accumulated in count at the root.
+static inline uint32_t _uf_find(uint32_t *parent, uint32_t i)
+{
+  while(parent[i] != i)
+  {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+static inline void _uf_union(uint32_t *parent, int *count, const uint32_t a, const uint32_t b)
+{
+  const uint32_t ra = _uf_find(parent, a);
+  const uint32_t rb = _uf_find(parent, b);
+  if(ra == rb) return;
+
+  const uint32_t r = MIN(ra, rb);
+  const uint32_t c = MAX(ra, rb);
+  parent[c] = r;
+  count[r] += count[c];
+}
+
+// read-only variant used while other threads access the parent buffer
+static inline uint32_t _uf_root(const uint32_t *parent, uint32_t i)
+{
+  while(parent[i] != i)
+    i = parent[i];
+  return i;
+}
+
+// merge the runs of a row with the runs they touch in the row above, both are in column order
+static inline void _merge_runs(uint32_t *parent,
+                               int *count,
+                               const uint32_t *starts,
+                               const int *lengths,
+                               const uint32_t up,
+                               const int nup,
+                               const uint32_t cur,
+                               const int n,
+                               const int width)
+{
+  uint32_t i = up;
+  uint32_t j = cur;
+  while(i < up + nup && j < cur + n)
+  {
+    const uint32_t ufirst = starts[i] + width;
+    const uint32_t uend = ufirst + lengths[i];
+    const uint32_t end = starts[j] + lengths[j];
+    if(ufirst < end && starts[j] < uend)
+      _uf_union(parent, count, j, i);
+    if(uend <= end) i++;
+    else j++;
+  }
+}
+
+// the id of a segment at a location once the id's are written, 0 if there is none
+static inline uint32_t _segment_at(const uint32_t *d, const size_t i)
+{
+  const uint32_t v = d[i];
+  return (v > 1 && v < DT_SEG_ID_MASK) ? v : 0;
+}
+
+// the lowest id of the segments next to a location, the conditions restrict marking to the inner
+// part of the segmentation area
+static inline uint32_t _lowest_adjacent(const uint32_t *d,
+                                        const int row,
+                                        const int col,
+                                        const int width,
+                                        const int height,
+                                        const int border)
+{
+  const size_t i = (size_t)row * width + col;
+  uint32_t mark = DT_SEG_ID_MASK;
+  uint32_t nid;
+  if(row > border + 1 && (nid = _segment_at(d, i+width)))          mark = MIN(mark, nid);
+  if(row < height - border - 2 && (nid = _segment_at(d, i-width))) mark = MIN(mark, nid);
+  if(col > border + 1 && (nid = _segment_at(d, i+1)))              mark = MIN(mark, nid);
+  if(col < width - border - 2 && (nid = _segment_at(d, i-1)))      mark = MIN(mark, nid);
+  return mark;
+}
+
+// per plane buffers while segmentizing
+typedef struct _seg_work_t
+{
+  int *count;        // size of the segment at a root run, later its id
+  uint32_t *starts;  // locations of all runs per block of rows
+  int *lengths;      // and their lengths
+  int *runs;         // number of runs per block
+  int *head;         // number of runs in the first row of a block
+  int *tail;         // index of the first run in the last row of a block
+  int *rect;         // surrounding rectangles per thread
+  size_t padded;
+  int blocks;        // blocks of rows
+  int first;         // index of the first block over all planes
+} _seg_work_t;
+
+static inline int _seg_blocks(const dt_iop_segmentation_t *seg)
+{
+  return MAX(0, (seg->height - 2 * seg->border + DT_SEG_BLOCK_ROWS - 1) / DT_SEG_BLOCK_ROWS);
+}
+
+// the runs of a block start at this index, there can't be more than half the locations
+static inline size_t _seg_block_runs(const dt_iop_segmentation_t *seg, const int block)
 {
-  if(id >= seg->slots - 2) return FALSE;
+  return (size_t)block * DT_SEG_BLOCK_ROWS * seg->width / 2;
+}
+
+// the plane and block of a job index running over the blocks of all planes
+static inline int _seg_job(const _seg_work_t *work, const int planes, const int job, int *block)
+{
+  int p = 0;
+  while(p < planes - 1 && job >= work[p+1].first) p++;
+  *block = job - work[p].first;
+  return p;
+}
 
+// collect the runs of a block of rows and merge them with the runs they touch in the row above
+static void _label_block(dt_iop_segmentation_t *seg, _seg_work_t *w, const int block)
+{
+  const int width = seg->width;
+  const int height = seg->height;
   const int border = seg->border;
-  uint32_t *d = seg->data;
-  int xp = 0;
-  int yp = 0;
-  size_t rp = 0;
-  int min_x = xin;
-  int max_x = xin;
-  int min_y = yin;
-  int max_y = yin;
-  int cnt = 0;
-  stack->pos = 0;
-  _clear_segment_slot(seg, id);
-
-  _push_stack(xin, yin, stack);
-  while(stack->pos)
+  const uint32_t *d = seg->data;
+  uint32_t *parent = seg->tmp;
+  const int rmin = border + block * DT_SEG_BLOCK_ROWS;
+  const int rmax = MIN(rmin + DT_SEG_BLOCK_ROWS, height - border);
+  const uint32_t base = _seg_block_runs(seg, block);
+  uint32_t nruns = base;
+  uint32_t up = base;
+  for(int row = rmin; row < rmax; row++)
   {
-    dt_pos_t *coord = _pop_stack(stack);
-    const int x = coord->xpos;
-    const int y = coord->ypos;
-    if(d[y*w+x] == 1)
+    const size_t rowstart = (size_t)row * width;
+    const uint32_t *drow = d + rowstart;
+    const uint32_t cur = nruns;
+    int col = border;
+    while(col < width - border)
     {
-      int yUp = y - 1, yDown = y + 1;
-      gboolean lastXUp = FALSE, lastXDown = FALSE, firstXUp = FALSE, firstXDown = FALSE;
-      d[y*w+x] = id;
-      cnt++;
-      if(yUp >= border && d[yUp*w+x] == 1)
-      {
-        _push_stack(x, yUp, stack); firstXUp = lastXUp = TRUE;
-      }
-      else
-      {
-        xp = x;
-        yp = yUp;
-        rp = yp*w + xp;
-        if(xp > border+1 && d[rp] == 0)
-        {
-          min_x = MIN(min_x, xp);
-          max_x = MAX(max_x, xp);
-          min_y = MIN(min_y, yp);
-          max_y = MAX(max_y, yp);
-          d[rp] = DT_SEG_ID_MASK | id;
-        }
-      }
+      while(col < width - border && drow[col] != 1) col++;
+      if(col == width - border) break;
+
+      const int first = col;
+      while(col < width - border && drow[col] == 1) col++;
+      parent[nruns] = nruns;
+      w->count[nruns] = col - first;
+      w->starts[nruns] = rowstart + first;
+      w->lengths[nruns++] = col - first;
+    }
+
+    if(row > rmin)
+      _merge_runs(parent, w->count, w->starts, w->lengths, up, cur - up, cur, nruns - cur, width);
+    else
+      w->head[block] = nruns - base;
+    up = cur;
+  }
+  w->runs[block] = nruns - base;
+  w->tail[block] = up - base;
+}
+
+// merge the blocks along their borders and give the segment id's in scan order of the roots. To avoid
+// oversegmentizing we only use segments with a minimum size of 4. From now on the root location holds
+// the id instead of the size, 1 for dropped segments.
+static void _number_segments(dt_iop_segmentation_t *seg, _seg_work_t *w)
+{
+  const int width = seg->width;
+  uint32_t *parent = seg->tmp;
+  int *count = w->count;
+
+  for(int block = 1; block < w->blocks; block++)
+  {
+    const uint32_t above = _seg_block_runs(seg, block - 1) + w->tail[block-1];
+    _merge_runs(parent, count, w->starts, w->lengths, above, w->runs[block-1] - w->tail[block-1],
+                _seg_block_runs(seg, block), w->head[block], width);
+  }
 
-      if(yDown < h-border && d[yDown*w+x] == 1)
+  int *id = count;
+  int nr = 2;
+  gboolean exceeded = FALSE;
+  for(int block = 0; block < w->blocks; block++)
+  {
+    const uint32_t base = _seg_block_runs(seg, block);
+    for(uint32_t i = base; i < base + w->runs[block]; i++)
+    {
+      if(parent[i] != i) continue;
+
+      if(count[i] > 3 && nr < seg->slots - 2)
       {
-        _push_stack(x, yDown, stack); firstXDown = lastXDown = TRUE;
+        seg->size[nr] = count[i];
+        seg->xmin[nr] = seg->xmax[nr] = w->starts[i] % width;
+        seg->ymin[nr] = seg->ymax[nr] = w->starts[i] / width;
+        seg->val1[nr] = seg->val2[nr] = 0.0f;
+        id[i] = nr++;
       }
       else
       {
-        xp = x;
-        yp = yDown;
-        rp = yp*w + xp;
-        if(yp < h-border-2 && d[rp] == 0)
-        {
-          min_x = MIN(min_x, xp);
-          max_x = MAX(max_x, xp);
-          min_y = MIN(min_y, yp);
-          max_y = MAX(max_y, yp);
-          d[rp] = DT_SEG_ID_MASK | id;
-        }
+        exceeded |= count[i] > 3;
+        id[i] = 1;
       }
+    }
+  }
+  seg->nr = nr;
+  _clear_segment_slot(seg, nr);
 
-      int xr = x + 1;
-      while(xr < w-border && d[y*w+xr] == 1)
-      {
-        d[y*w+xr] = id;
-        cnt++;
-        if(yUp >= border && d[yUp*w + xr] == 1)
-        {
-          if(!lastXUp) { _push_stack(xr, yUp, stack); lastXUp = TRUE; }
-        }
-        else
-        {
-          xp = xr;
-          yp = yUp;
-          rp = yp*w + xp;
-          if(yp > border+1 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXUp = FALSE;
-        }
-
-        if(yDown < h-border && d[yDown*w+xr] == 1)
-        {
-          if(!lastXDown) { _push_stack(xr, yDown, stack); lastXDown = TRUE; }
-        }
-        else
-        {
-          xp = xr;
-          yp = yDown;
-          rp = yp*w + xp;
-          if(yp < h-border-2 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXDown = FALSE;
-        }
-        xr++;
-      }
+  if(exceeded)
+    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] %ix%i number of segments exceeds maximum=%i",
+             width, seg->height, seg->slots);
 
-      xp = xr;
-      yp = y;
-      rp = yp*w + xp;
-      if(xp < w-border-2 && d[rp] == 0)
-      {
-        min_x = MIN(min_x, xp);
-        max_x = MAX(max_x, xp);
-        min_y = MIN(min_y, yp);
-        max_y = MAX(max_y, yp);
-        d[rp] = DT_SEG_ID_MASK | id;
-      }
+  for(int t = 0; t < dt_get_num_threads(); t++)
+  {
+    int *r = dt_get_bythread(w->rect, w->padded, t);
+    for(int k = 0; k < nr; k++)
+    {
+      r[4*k] = r[4*k+2] = INT_MAX;
+      r[4*k+1] = r[4*k+3] = INT_MIN;
+    }
+  }
+}
 
-      int xl = x - 1;
-      lastXUp = firstXUp;
-      lastXDown = firstXDown;
-      while(xl >= border && d[y*w+xl] == 1)
-      {
-        d[y*w+xl] = id;
-        cnt++;
-        if(yUp >= border && d[yUp*w+xl] == 1)
-        {
-          if(!lastXUp) { _push_stack(xl, yUp, stack); lastXUp = TRUE; }
-        }
-        else
-        {
-          xp = xl;
-          yp = yUp;
-          rp = yp*w + xp;
-          if(yp > border+1 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXUp = FALSE;
-        }
-
-        if(yDown < h-border && d[yDown*w+xl] == 1)
-        {
-          if(!lastXDown) { _push_stack(xl, yDown, stack); lastXDown = TRUE; }
-        }
-        else
-        {
-          xp = xl;
-          yp = yDown;
-          rp = yp*w + xp;
-          if(yp < h-border-2 && d[rp] == 0)
-          {
-            min_x = MIN(min_x, xp);
-            max_x = MAX(max_x, xp);
-            min_y = MIN(min_y, yp);
-            max_y = MAX(max_y, yp);
-            d[rp] = DT_SEG_ID_MASK | id;
-          }
-          lastXDown = FALSE;
-        }
-        xl--;
-      }
+// write the segment id's of a block run by run
+static void _write_block(dt_iop_segmentation_t *seg, _seg_work_t *w, const int block)
+{
+  uint32_t *d = seg->data;
+  const uint32_t *parent = seg->tmp;
+  const int *id = w->count;
+  const uint32_t base = _seg_block_runs(seg, block);
+  for(uint32_t k = base; k < base + w->runs[block]; k++)
+  {
+    const uint32_t sid = id[_uf_root(parent, k)];
+    for(int i = 0; i < w->lengths[k]; i++)
+      d[w->starts[k] + i] = sid;
+  }
+}
 
-      d[y*w+x] = id;
+// a free location next to a segment gets marked with the lowest adjacent id. The surrounding
+// rectangle of a segment spans its first location and its border locations.
+static void _mark_block(dt_iop_segmentation_t *seg, _seg_work_t *w, const int block)
+{
+  const int width = seg->width;
+  const int height = seg->height;
+  const int border = seg->border;
+  uint32_t *d = seg->data;
+  int *r = dt_get_perthread(w->rect, w->padded);
+  const int rmin = border + block * DT_SEG_BLOCK_ROWS;
+  const int rmax = MIN(rmin + DT_SEG_BLOCK_ROWS, height - border);
+  for(int row = rmin; row < rmax; row++)
+  {
+    for(int col = border; col < width - border; col++)
+    {
+      const size_t i = (size_t)row * width + col;
+      if(d[i] != 0 || (d[i-1] | d[i+1] | d[i-width] | d[i+width]) == 0) continue;
 
-      xp = xl;
-      yp = y;
-      rp = yp*w + xp;
-      if(xp > border+1 && d[rp] == 0)
-      {
-        min_x = MIN(min_x, xp);
-        max_x = MAX(max_x, xp);
-        min_y = MIN(min_y, yp);
-        max_y = MAX(max_y, yp);
-        d[rp] = DT_SEG_ID_MASK | id;
-      }
+      const uint32_t sid = _lowest_adjacent(d, row, col, width, height, border);
+      if(sid == DT_SEG_ID_MASK) continue;
+
+      d[i] = DT_SEG_ID_MASK | sid;
+      r[4*sid]   = MIN(r[4*sid], col);
+      r[4*sid+1] = MAX(r[4*sid+1], col);
+      r[4*sid+2] = MIN(r[4*sid+2], row);
+      r[4*sid+3] = MAX(r[4*sid+3], row);
     }
   }
+}
 
-  const gboolean success = cnt > 3;
-  if(!success) // To avoid oversegmentizing we only use segments with a minimum size of 4
+static void _collect_rectangles(dt_iop_segmentation_t *seg, const _seg_work_t *w)
+{
+  for(int t = 0; t < dt_get_num_threads(); t++)
   {
-    // data in too In any case we want to revert border markings too
-    for(int row = min_y; row <= max_y; row++)
+    const int *r = dt_get_bythread(w->rect, w->padded, t);
+    for(int k = 2; k < seg->nr; k++)
     {
-      for(int col = min_x; col <= max_x; col++)
-      {
-        size_t loc = (size_t)w*row + col;
-        if(d[loc] == id)
-          d[loc] = 1;
-        else if(d[loc] == (id | DT_SEG_ID_MASK))
-          d[loc] = 0;
-      }
+      seg->xmin[k] = MIN(seg->xmin[k], r[4*k]);
+      seg->xmax[k] = MAX(seg->xmax[k], r[4*k+1]);
+      seg->ymin[k] = MIN(seg->ymin[k], r[4*k+2]);
+      seg->ymax[k] = MAX(seg->ymax[k], r[4*k+3]);
     }
   }
-  else
+}
+
+static void _free_work(_seg_work_t *work, const int planes)
+{
+  for(int p = 0; p < planes; p++)
   {
-    seg->size[id] = cnt;
-    seg->xmin[id] = min_x;
-    seg->xmax[id] = max_x;
-    seg->ymin[id] = min_y;
-    seg->ymax[id] = max_y;
-
-    seg->nr += 1;
-    _clear_segment_slot(seg, id+1);
+    dt_free_align(work[p].count);
+    dt_free_align(work[p].starts);
+    dt_free_align(work[p].lengths);
+    dt_free_align(work[p].runs);
+    dt_free_align(work[p].head);
+    dt_free_align(work[p].tail);
+    dt_free_align(work[p].rect);
   }
-
-  return success;
+  free(work);
 }
 
 // User interface
-void dt_segmentize_plane(dt_iop_segmentation_t *seg)
+
+// Segmentize a number of planes. The blocks of all planes are labelled by one team of threads,
+// so also small planes keep all threads busy.
+void dt_segmentize_planes(dt_iop_segmentation_t *segs, const int planes)
 {
-  dt_ff_stack_t stack;
-  const int width = seg->width;
-  const int height = seg->height;
-  stack.size = (size_t)width * height / 32;
-  stack.el = dt_alloc_align_type(dt_pos_t, stack.size);
-  if(!stack.el)
+  _seg_work_t *work = calloc(planes, sizeof(_seg_work_t));
+  gboolean failed = !work;
+  int jobs = 0;
+  for(int p = 0; p < planes && !failed; p++)
+  {
+    const dt_iop_segmentation_t *seg = &segs[p];
+    const size_t nruns = (size_t)seg->width * seg->height / 2 + 1;
+    _seg_work_t *w = &work[p];
+    w->blocks = _seg_blocks(seg);
+    w->first = jobs;
+    jobs += w->blocks;
+    w->count = dt_alloc_align_int(nruns);
+    w->starts = dt_alloc_align_type(uint32_t, nruns);
+    w->lengths = dt_alloc_align_int(nruns);
+    w->runs = dt_alloc_align_int(MAX(1, w->blocks));
+    w->head = dt_alloc_align_int(MAX(1, w->blocks));
+    w->tail = dt_alloc_align_int(MAX(1, w->blocks));
+    w->rect = dt_alloc_perthread(4 * seg->slots, sizeof(int), &w->padded);
+    failed = !w->count || !w->starts || !w->lengths || !w->runs || !w->head || !w->tail || !w->rect;
+  }
+  if(failed)
   {
-    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] can't allocate segmentation stack");
+    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] can't allocate segmentation buffers");
+    if(work) _free_work(work, planes);
     return;
   }
-  const int border = seg->border;
-  int id = 2;
-  for(int row = border; row < height - border; row++)
+
+  DT_OMP_FOR()
+  for(int job = 0; job < jobs; job++)
   {
-    for(int col = border; col < width - border; col++)
+    int block;
+    const int p = _seg_job(work, planes, job, &block);
+    _label_block(&segs[p], &work[p], block);
+  }
+
+  DT_OMP_FOR()
+  for(int p = 0; p < planes; p++)
+    _number_segments(&segs[p], &work[p]);
+
+  DT_OMP_FOR()
+  for(int job = 0; job < jobs; job++)
+  {
+    int block;
+    const int p = _seg_job(work, planes, job, &block);
+    _write_block(&segs[p], &work[p], block);
+  }
+
+  // marking reads the rows next to a block so we do even and odd blocks one after the other.
+  // The rectangles are collected per thread.
+  for(int parity = 0; parity < 2; parity++)
+  {
+    DT_OMP_FOR()
+    for(int job = 0; job < jobs; job++)
     {
-      if(id >= (seg->slots - 2))
-        goto finish;
-      if(seg->data[(size_t)width * row + col] == 1)
-      {
-        if(_floodfill_segmentize(row, col, seg, width, height, id, &stack))
-          id++;
-      }
+      int block;
+      const int p = _seg_job(work, planes, job, &block);
+      if((block & 1) == parity)
+        _mark_block(&segs[p], &work[p], block);
     }
   }
 
-  finish:
+  for(int p = 0; p < planes; p++)
+    _collect_rectangles(&segs[p], &work[p]);
 
-  if(id >= (seg->slots - 2))
-    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] %ix%i number of segments exceeds maximum=%i",
-             (int)width, (int)height, seg->slots);
+  _free_work(work, planes);
+}
 
-  dt_free_align(stack.el);
+void dt_segmentize_plane(dt_iop_segmentation_t *seg)
+{
+  dt_segmentize_planes(seg, 1);
 }
 
 void dt_segments_combine(dt_iop_segmentation_t *seg, const int radius)
 {
   uint32_t *img = seg->data;
+  uint32_t *out = seg->tmp;
   const int width = seg->width;
   const int height = seg->height;
   const int border = seg->border;
+  const int erode = radius > 3 ? radius - 3 : 0;
   _intimage_borderfill(img, width, height, 0, border);
 
-  _dilating(img, seg->tmp, width, height, border, radius);
-  if(radius > 3)
+  // every block of rows is dilated including the rows eroding needs around it into a per thread
+  // buffer, outside the segmentation area the dilated data is 1 so eroding doesn't shrink there
+  const int blocks = (height - 2 * border + DT_SEG_BLOCK_ROWS - 1) / DT_SEG_BLOCK_ROWS;
+  size_t padded;
+  uint32_t *dilated = dt_alloc_perthread((size_t)(DT_SEG_BLOCK_ROWS + 2 * erode) * width,
+                                         sizeof(uint32_t), &padded);
+  if(!dilated)
   {
-    _intimage_borderfill(seg->tmp, width, height, 1, border);
-    _eroding(seg->tmp, img, width, height, border, radius-3);
+    dt_print(DT_DEBUG_ALWAYS, "[segments_combine] can't allocate buffers");
+    return;
   }
-  else
-    memcpy(img, seg->tmp, (size_t) width * height * sizeof(uint32_t));
 
-  _intimage_borderfill(img, width, height, 0, border);
+  DT_OMP_FOR()
+  for(int block = 0; block < blocks; block++)
+  {
+    uint32_t *dil = dt_get_perthread(dilated, padded);
+    const int rmin = border + block * DT_SEG_BLOCK_ROWS;
+    const int rmax = MIN(rmin + DT_SEG_BLOCK_ROWS, height - border);
+    const int dmin = rmin - erode;
+    for(int row = dmin; row < rmax + erode; row++)
+    {
+      uint32_t *drow = dil + (size_t)(row - dmin) * width;
+      const gboolean inside = row >= border && row < height - border - 1;
+      for(int col = 0; col < width; col++)
+      {
+        const size_t i = (size_t)row * width + col;
+        drow[col] = (inside && col >= border && col < width - border)
+                    ? (_test_dilate(img, i, width, radius) ? 1 : 0)
+                    : 1;
+      }
+    }
+
+    for(int row = rmin; row < rmax; row++)
+    {
+      for(int col = border; col < width - border; col++)
+      {
+        const size_t k = (size_t)(row - dmin) * width + col;
+        out[(size_t)row * width + col] = erode ? (_test_erode(dil, k, width, erode) ? 1 : 0) : dil[k];
+      }
+    }
+  }
+  dt_free_align(dilated);
+
+  _intimage_borderfill(out, width, height, 0, border);
+  seg->data = out;
+  seg->tmp = img;
 }
 
 void dt_segmentation_free_struct(dt_iop_segmentation_t *seg)
@@ -637,9 +718,9 @@ gboolean dt_segmentation_init_struct(dt_iop_segmentation_t *seg,
   seg->val1 =   dt_alloc_align_float(slots);
   seg->val2 =   dt_alloc_align_float(slots);
 
-  if(!seg->data || !seg->size
+  if(!seg->data || !seg->tmp || !seg->size
                 || !seg->xmin || !seg->xmax || !seg->ymin || !seg->ymax
-                || !seg->val2 || !seg->val2)
+                || !seg->val1 || !seg->val2)
   {
     dt_segmentation_free_struct(seg);
     return TRUE;
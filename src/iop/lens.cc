@@ -54,6 +54,14 @@
 #define MAXKNOTS 16
 #define VIGSPLINES 512
 
+// sparse distortion grids: initial distance between the nodes, smallest
+// distance tried before falling back to per-pixel evaluation, maximum
+// interpolation error in pixels and number of cached grids
+#define LENS_GRID_STEP 16
+#define LENS_GRID_MIN_STEP 2
+#define LENS_GRID_TOLERANCE 0.02f
+#define LENS_GRID_CACHE 4
+
 G_BEGIN_DECLS
 
 #if LF_VERSION < ((0 << 24) | (2 << 16) | (9 << 8) | 0)
@@ -204,6 +212,10 @@ typedef struct dt_iop_lens_global_data_t
   int kernel_md_vignette;
   int kernel_md_correct;
   lfDatabase *db;
+  // process-wide cache of sparse distortion grids, see _grid_get()
+  dt_pthread_mutex_t grid_lock;
+  struct dt_iop_lens_grid_t *grids[LENS_GRID_CACHE];
+  uint64_t grid_clock;
 } dt_iop_lens_global_data_t;
 
 typedef struct dt_iop_lens_data_t
@@ -244,6 +256,9 @@ typedef struct dt_iop_lens_data_t
   float reserved[2];
   float vigspline[VIGSPLINES];
   dt_hash_t vighash;
+
+  /* hash of all parameters defining the distortion, key for the distortion grids */
+  dt_hash_t grid_hash;
 } dt_iop_lens_data_t;
 
 
@@ -1041,6 +1056,220 @@ static float _get_autoscale_lf(dt_iop_module_t *self,
   return scale;
 }
 
+/* Sparse distortion grids
+
+   Lens correction evaluates the distortion model (Lensfun modifier or the
+   splines from embedded metadata) for every output pixel on every pipe
+   run. As the distortion is smooth it is evaluated on a grid of nodes
+   every 'step' pixels instead and interpolated bilinearly in between.
+   When a grid is built the interpolation error is measured at the
+   centre of every cell, the step is halved until the error is below
+   LENS_GRID_TOLERANCE pixels and if that fails the caller uses the exact
+   per-pixel evaluation.
+
+   The grids are cached in the global data keyed by the correction
+   parameters and the roi, so exports and thumbnails of images shot with
+   the same lens settings compute them only once.
+*/
+typedef struct dt_iop_lens_grid_t
+{
+  dt_hash_t hash;
+  int width, height;  // size of the roi
+  int step;           // distance in pixels between the nodes
+  int gw, gh;         // number of nodes per row and column
+  int users;          // number of callers currently interpolating
+  gboolean cached;    // owned by the cache, else freed by the last user
+  uint64_t last_used;
+  float *coords;      // 6 floats per node, layout as ApplySubpixelGeometryDistortion()
+} dt_iop_lens_grid_t;
+
+// evaluates the source coordinates (x, y for red, green and blue) of the
+// roi pixel at (x, y), the function must be callable from several threads
+typedef void (*_grid_coords_t)(const void *data,
+                               const float x,
+                               const float y,
+                               float *coords);
+
+static void _grid_free(dt_iop_lens_grid_t *g)
+{
+  if(!g) return;
+  dt_free_align(g->coords);
+  free(g);
+}
+
+static inline void _grid_interpolate_row(const dt_iop_lens_grid_t *const g,
+                                         const int y,
+                                         float *const restrict row)
+{
+  const float inv_step = 1.0f / g->step;
+  const int j = MIN(y / g->step, g->gh - 2);
+  const float fy = (y - j * g->step) * inv_step;
+  const float *const restrict top = g->coords + (size_t)6 * j * g->gw;
+  const float *const restrict bottom = top + (size_t)6 * g->gw;
+
+  for(int x = 0; x < g->width; x++)
+  {
+    const int i = MIN(x / g->step, g->gw - 2);
+    const float fx = (x - i * g->step) * inv_step;
+    DT_OMP_SIMD()
+    for(int k = 0; k < 6; k++)
+    {
+      const float t = top[6*i + k] + fx * (top[6*(i+1) + k] - top[6*i + k]);
+      const float b = bottom[6*i + k] + fx * (bottom[6*(i+1) + k] - bottom[6*i + k]);
+      row[6*x + k] = t + fy * (b - t);
+    }
+  }
+}
+
+static dt_iop_lens_grid_t *_grid_build(const dt_iop_roi_t *const roi,
+                                       _grid_coords_t coords_func,
+                                       const void *data)
+{
+  for(int step = LENS_GRID_STEP; step >= LENS_GRID_MIN_STEP; step /= 2)
+  {
+    // a grid that is not substantially smaller than the roi is useless
+    if((size_t)roi->width * roi->height < (size_t)16 * step * step)
+      return NULL;
+
+    dt_iop_lens_grid_t *g = (dt_iop_lens_grid_t *)calloc(1, sizeof(dt_iop_lens_grid_t));
+    if(!g) return NULL;
+    g->width = roi->width;
+    g->height = roi->height;
+    g->step = step;
+    g->gw = (roi->width - 1) / step + 2;
+    g->gh = (roi->height - 1) / step + 2;
+    g->coords = dt_alloc_align_float((size_t)6 * g->gw * g->gh);
+    if(!g->coords)
+    {
+      free(g);
+      return NULL;
+    }
+
+    const int gw = g->gw;
+    const int gh = g->gh;
+    float *const coords = g->coords;
+    DT_OMP_FOR(collapse(2))
+    for(int j = 0; j < gh; j++)
+      for(int i = 0; i < gw; i++)
+        coords_func(data, roi->x + i * step, roi->y + j * step, coords + (size_t)6 * (j * gw + i));
+
+    // compare the interpolation against the exact value at the cell centres,
+    // any non-finite coordinate rules out interpolation as well
+    float err = 0.0f;
+    DT_OMP_FOR(reduction(max : err) collapse(2))
+    for(int j = 0; j < gh - 1; j++)
+      for(int i = 0; i < gw - 1; i++)
+      {
+        float exact[6];
+        coords_func(data, roi->x + (i + 0.5f) * step, roi->y + (j + 0.5f) * step, exact);
+        const float *c = coords + (size_t)6 * (j * gw + i);
+        for(int k = 0; k < 6; k++)
+        {
+          const float interp = 0.25f * (c[k] + c[6 + k] + c[6 * gw + k] + c[6 * gw + 6 + k]);
+          const float diff = fabsf(interp - exact[k]);
+          // written such that NaN differences end up as an infinite error
+          err = fmaxf(err, (diff <= FLT_MAX) ? diff : INFINITY);
+        }
+      }
+
+    dt_print(DT_DEBUG_PERF,
+             "[lens grid] %dx%d roi, step %d, max interpolation error %.4f px",
+             roi->width, roi->height, step, err);
+
+    if(err <= LENS_GRID_TOLERANCE)
+      return g;
+
+    _grid_free(g);
+    if(!isfinite(err)) return NULL;
+  }
+  return NULL;
+}
+
+// returns the grid for 'hash' and 'roi', building it if not cached.
+// the grid must be returned with _grid_release(), NULL means that
+// the caller has to evaluate the distortion per pixel
+static dt_iop_lens_grid_t *_grid_get(dt_iop_lens_global_data_t *gd,
+                                     const dt_hash_t hash,
+                                     const dt_iop_roi_t *const roi,
+                                     _grid_coords_t coords_func,
+                                     const void *data)
+{
+  if(hash == DT_INVALID_HASH) return NULL;
+
+  dt_pthread_mutex_lock(&gd->grid_lock);
+  for(int k = 0; k < LENS_GRID_CACHE; k++)
+  {
+    dt_iop_lens_grid_t *g = gd->grids[k];
+    if(g && g->hash == hash)
+    {
+      g->users++;
+      g->last_used = ++gd->grid_clock;
+      dt_pthread_mutex_unlock(&gd->grid_lock);
+      return g;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->grid_lock);
+
+  dt_iop_lens_grid_t *g = _grid_build(roi, coords_func, data);
+  if(!g) return NULL;
+  g->hash = hash;
+  g->users = 1;
+
+  // replace the least recently used grid not in use, if all are in use
+  // the new grid is freed by its last user
+  dt_pthread_mutex_lock(&gd->grid_lock);
+  int slot = -1;
+  for(int k = 0; k < LENS_GRID_CACHE; k++)
+  {
+    const dt_iop_lens_grid_t *c = gd->grids[k];
+    if(!c) { slot = k; break; }
+    if(c->users == 0 && (slot < 0 || c->last_used < gd->grids[slot]->last_used))
+      slot = k;
+  }
+  if(slot >= 0)
+  {
+    _grid_free(gd->grids[slot]);
+    gd->grids[slot] = g;
+    g->cached = TRUE;
+    g->last_used = ++gd->grid_clock;
+  }
+  dt_pthread_mutex_unlock(&gd->grid_lock);
+  return g;
+}
+
+static void _grid_release(dt_iop_lens_global_data_t *gd,
+                          dt_iop_lens_grid_t *g)
+{
+  if(!g) return;
+  dt_pthread_mutex_lock(&gd->grid_lock);
+  g->users--;
+  const gboolean drop = !g->cached && g->users == 0;
+  dt_pthread_mutex_unlock(&gd->grid_lock);
+  if(drop) _grid_free(g);
+}
+
+static inline dt_hash_t _grid_hash(const dt_hash_t params_hash,
+                                   const int lf_mask,
+                                   const float orig_w,
+                                   const float orig_h,
+                                   const dt_iop_roi_t *const roi_out)
+{
+  if(params_hash == DT_INVALID_HASH) return DT_INVALID_HASH;
+  const float key[] = { (float)lf_mask, orig_w, orig_h,
+                        (float)roi_out->x, (float)roi_out->y,
+                        (float)roi_out->width, (float)roi_out->height };
+  return dt_hash(params_hash, key, sizeof(key));
+}
+
+static void _grid_coords_lf(const void *data,
+                            const float x,
+                            const float y,
+                            float *coords)
+{
+  const lfModifier *modifier = (const lfModifier *)data;
+  modifier->ApplySubpixelGeometryDistortion(x, y, 1, 1, coords);
+}
+
 static void _process_lf(dt_iop_module_t *self,
                         dt_dev_pixelpipe_iop_t *piece,
                         const void *const ivoid,
@@ -1085,6 +1314,13 @@ static void _process_lf(dt_iop_module_t *self,
 
   const dt_interpolation_t *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  dt_iop_lens_grid_t *grid =
+    (modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    ? _grid_get(gd, _grid_hash(d->grid_hash, used_lf_mask, orig_w, orig_h, roi_out),
+                roi_out, _grid_coords_lf, modifier)
+    : NULL;
+
   if(d->inverse)
   {
     // reverse direction (useful for renderings)
@@ -1103,8 +1339,11 @@ static void _process_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                                  roi_out->width, 1, bufptr);
+        if(grid)
+          _grid_interpolate_row(grid, y, bufptr);
+        else
+          modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
+                                                    roi_out->width, 1, bufptr);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -1213,10 +1452,13 @@ static void _process_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = (float*)dt_get_perthread(buf2, padded_buf2size);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width,
-                                                  1, buf2ptr);
+        if(grid)
+          _grid_interpolate_row(grid, y, buf2ptr);
+        else
+          modifier->ApplySubpixelGeometryDistortion(roi_out->x,
+                                                    roi_out->y + y,
+                                                    roi_out->width,
+                                                    1, buf2ptr);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -1274,6 +1516,7 @@ static void _process_lf(dt_iop_module_t *self,
     }
     dt_free_align(buf);
   }
+  _grid_release(gd, grid);
   delete modifier;
 }
 
@@ -1661,6 +1904,13 @@ static void _distort_mask_lf(dt_iop_module_t *self,
 
   const dt_interpolation_t *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  dt_iop_lens_grid_t *grid =
+    _grid_get(gd, _grid_hash(d->grid_hash,
+                             LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE,
+                             orig_w, orig_h, roi_out),
+              roi_out, _grid_coords_lf, modifier);
+
   // acquire temp memory for distorted pixel coords
   const size_t bufsize = (size_t)roi_out->width * 2 * 3;
   size_t padded_bufsize;
@@ -1670,8 +1920,11 @@ static void _distort_mask_lf(dt_iop_module_t *self,
   for(int y = 0; y < roi_out->height; y++)
   {
     float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                              roi_out->width, 1, bufptr);
+    if(grid)
+      _grid_interpolate_row(grid, y, bufptr);
+    else
+      modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
+                                                roi_out->width, 1, bufptr);
 
     // reverse transform the global coords from lf to our buffer
     float *_out = out + (size_t)y * roi_out->width;
@@ -1692,6 +1945,7 @@ static void _distort_mask_lf(dt_iop_module_t *self,
     }
   }
   dt_free_align(buf);
+  _grid_release(gd, grid);
   delete modifier;
 }
 
@@ -1884,6 +2138,20 @@ static void _commit_params_lf(dt_iop_module_t *self,
   d->do_nan_checks = TRUE;
   d->tca_override = p->tca_override;
 
+  d->grid_hash = dt_hash(DT_INITHASH, &d->method, sizeof(d->method));
+  d->grid_hash = dt_hash(d->grid_hash, &d->modify_flags, sizeof(d->modify_flags));
+  d->grid_hash = dt_hash(d->grid_hash, &p->inverse, sizeof(p->inverse));
+  d->grid_hash = dt_hash(d->grid_hash, &p->scale, sizeof(float) * 5);  // scale .. distance
+  d->grid_hash = dt_hash(d->grid_hash, &p->target_geom, sizeof(p->target_geom));
+  d->grid_hash = dt_hash(d->grid_hash, p->camera, sizeof(p->camera));
+  d->grid_hash = dt_hash(d->grid_hash, p->lens, sizeof(p->lens));
+  d->grid_hash = dt_hash(d->grid_hash, &p->tca_override, sizeof(p->tca_override));
+  d->grid_hash = dt_hash(d->grid_hash, &p->tca_r, sizeof(float) * 2); // tca_r, tca_b
+  d->grid_hash = dt_hash(d->grid_hash, &d->crop, sizeof(d->crop));
+  // the custom TCA calibration depends on the aspect ratio of the image
+  d->grid_hash = dt_hash(d->grid_hash, &self->dev->image_storage.width, sizeof(int32_t));
+  d->grid_hash = dt_hash(d->grid_hash, &self->dev->image_storage.height, sizeof(int32_t));
+
   /*
    * there are certain situations when Lensfun can return NAN coordinated.
    * most common case would be when the FOV is increased.
@@ -2563,6 +2831,12 @@ static void _commit_params_md(dt_iop_module_t *self,
      || (d->scale_md > 2.0f)) // reset image scale if unproper data
     d->scale_md = 1.0f;
 
+  d->grid_hash = dt_hash(DT_INITHASH, &d->method, sizeof(d->method));
+  d->grid_hash = dt_hash(d->grid_hash, &d->nc, sizeof(d->nc));
+  d->grid_hash = dt_hash(d->grid_hash, d->knots_dist, sizeof(d->knots_dist));
+  d->grid_hash = dt_hash(d->grid_hash, d->cor_rgb, sizeof(d->cor_rgb));
+  d->grid_hash = dt_hash(d->grid_hash, &d->scale_md, sizeof(d->scale_md));
+
   if(self->dev->gui_attached && g
      && (piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW))
   {
@@ -2692,6 +2966,31 @@ static gboolean _distort_backtransform_md(dt_iop_module_t *self,
   return TRUE;
 }
 
+typedef struct dt_iop_lens_md_coords_t
+{
+  const dt_iop_lens_data_t *d;
+  float w2, h2, r, inv_scale_md;
+} dt_iop_lens_md_coords_t;
+
+static void _grid_coords_md(const void *data,
+                            const float x,
+                            const float y,
+                            float *coords)
+{
+  const dt_iop_lens_md_coords_t *md = (const dt_iop_lens_md_coords_t *)data;
+  const dt_iop_lens_data_t *d = md->d;
+  const float cx = (x - md->w2) * md->inv_scale_md;
+  const float cy = (y - md->h2) * md->inv_scale_md;
+  const float radius = md->r*sqrtf(cx*cx + cy*cy);
+  for(int plane = 0; plane < 3; plane++)
+  {
+    const float dr =
+      _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
+    coords[2 * plane] = dr*cx + md->w2;
+    coords[2 * plane + 1] = dr*cy + md->h2;
+  }
+}
+
 static void _distort_mask_md(dt_iop_module_t *self,
                              dt_dev_pixelpipe_iop_t *piece,
                              const float *const in,
@@ -2716,23 +3015,43 @@ static void _distort_mask_md(dt_iop_module_t *self,
 
   const dt_interpolation_t *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
-  DT_OMP_FOR(collapse(2))
+  const dt_iop_lens_md_coords_t md = { d, w2, h2, r, inv_scale_md };
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  dt_iop_lens_grid_t *grid =
+    _grid_get(gd, _grid_hash(d->grid_hash, 0, w2, h2, roi_out), roi_out, _grid_coords_md, &md);
+
+  size_t padded_bufsize;
+  float *const buf = dt_alloc_perthread_float((size_t)6 * roi_out->width, &padded_bufsize);
+  if(!buf)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[lens] out of memory, skipping mask distortion");
+    dt_iop_image_copy_by_size(out, in, roi_out->width, roi_out->height, 1);
+    _grid_release(gd, grid);
+    return;
+  }
+
+  DT_OMP_FOR()
   for(int y = 0; y < roi_out->height; y++)
   {
+    float *coords = (float*)dt_get_perthread(buf, padded_bufsize);
+    if(grid)
+      _grid_interpolate_row(grid, y, coords);
+    else
+      for(int x = 0; x < roi_out->width; x++)
+        _grid_coords_md(&md, roi_out->x + x, roi_out->y + y, coords + 6 * x);
+
     for(int x = 0; x < roi_out->width; x++)
     {
-      const float cx = (roi_out->x + x - w2) * inv_scale_md;
-      const float cy = (roi_out->y + y - h2) * inv_scale_md;
-      const float dr =
-        _interpolate_linear_spline(d->knots_dist, d->cor_rgb[1],
-                                   d->nc, r*sqrtf(cx*cx + cy*cy));
-      const float xs = CLAMP(dr*cx + w2 - roi_in->x, 0.0f, limw);
-      const float ys = CLAMP(dr*cy + h2 - roi_in->y, 0.0f, limh);
+      // use green data for the mask
+      const float xs = CLAMP(coords[6 * x + 2] - roi_in->x, 0.0f, limw);
+      const float ys = CLAMP(coords[6 * x + 3] - roi_in->y, 0.0f, limh);
       out[y * roi_out->width + x] = CLIP(dt_interpolation_compute_sample(interpolation, in,
                                                                          xs, ys,
                                                                          roi_in->width, roi_in->height, 1, roi_in->width));
     }
   }
+  dt_free_align(buf);
+  _grid_release(gd, grid);
 }
 
 static void _process_md(dt_iop_module_t *self,
@@ -2792,31 +3111,51 @@ static void _process_md(dt_iop_module_t *self,
 
   const float limw = roi_in->width - 1;
   const float limh = roi_in->height - 1;
-  DT_OMP_FOR(collapse(2))
+
+  const dt_iop_lens_md_coords_t md = { d, w2, h2, r, inv_scale_md };
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  dt_iop_lens_grid_t *grid =
+    _grid_get(gd, _grid_hash(d->grid_hash, 0, w2, h2, roi_out), roi_out, _grid_coords_md, &md);
+
+  size_t padded_bufsize;
+  float *const coordsbuf = dt_alloc_perthread_float((size_t)6 * roi_out->width, &padded_bufsize);
+  if(!coordsbuf)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[lens] out of memory, skipping distortion correction");
+    dt_iop_copy_image_roi(out, buf, 4, roi_in, roi_out);
+    _grid_release(gd, grid);
+    if(!backbuf)
+      dt_free_align(buf);
+    return;
+  }
+
+  DT_OMP_FOR()
   for(int y = 0; y < roi_out->height; y++)
   {
+    float *coords = (float*)dt_get_perthread(coordsbuf, padded_bufsize);
+    if(grid)
+      _grid_interpolate_row(grid, y, coords);
+    else
+      for(int x = 0; x < roi_out->width; x++)
+        _grid_coords_md(&md, roi_out->x + x, roi_out->y + y, coords + 6 * x);
+
     for(int x = 0; x < roi_out->width; x++)
     {
-      const size_t odx = 4 * (y * roi_out->width + x);
-      const float cx = (roi_out->x + x - w2) * inv_scale_md;
-      const float cy = (roi_out->y + y - h2) * inv_scale_md;
-
-      const float radius = r*sqrtf(cx*cx + cy*cy);
-
+      const size_t odx = 4 * ((size_t)y * roi_out->width + x);
       for_each_channel(c)
       {
         // use green data for alpha channel
         const int plane = (c == 3 || pass_mode) ? 1 : c;
-        const float dr =
-          _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
-        const float xs = CLAMP(dr*cx + w2 - roi_in->x, 0.0f, limw);
-        const float ys = CLAMP(dr*cy + h2 - roi_in->y, 0.0f, limh);
+        const float xs = CLAMP(coords[6 * x + 2 * plane] - roi_in->x, 0.0f, limw);
+        const float ys = CLAMP(coords[6 * x + 2 * plane + 1] - roi_in->y, 0.0f, limh);
         out[odx+c] = dt_interpolation_compute_sample(interpolation, buf + c,
                                                      xs, ys,
                                                      roi_in->width, roi_in->height, 4, 4*roi_in->width);
       }
     }
   }
+  dt_free_align(coordsbuf);
+  _grid_release(gd, grid);
 
   if(!backbuf)
     dt_free_align(buf);
@@ -3331,6 +3670,7 @@ void init_global(dt_iop_module_so_t *self)
   dt_iop_lens_global_data_t *gd =
     (dt_iop_lens_global_data_t *)calloc(1, sizeof(dt_iop_lens_global_data_t));
   self->data = gd;
+  dt_pthread_mutex_init(&gd->grid_lock, NULL);
   gd->kernel_lens_distort_bilinear =
     dt_opencl_create_kernel(program, "lens_distort_bilinear");
   gd->kernel_lens_distort_bicubic =
@@ -3596,6 +3936,11 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_lens_man_vignette);
   dt_opencl_free_kernel(gd->kernel_md_vignette);
   dt_opencl_free_kernel(gd->kernel_md_correct);
+
+  for(int k = 0; k < LENS_GRID_CACHE; k++)
+    _grid_free(gd->grids[k]);
+  dt_pthread_mutex_destroy(&gd->grid_lock);
+
   free(self->data);
   self->data = NULL;
 }
@@ -50,6 +50,8 @@ const int   INTERPOLATION_POINTS = 100; // when interpolating bezier
 const float STAMP_RELOCATION = 0.1;     // how many radii to move
                                         // stamp forward when
                                         // following a path
+const size_t CACHE_MAX_PIXELS = 1 << 23; // largest distortion map kept
+                                         // for point transforms
 
 #define CONF_RADIUS "plugins/darkroom/liquify/radius"
 #define CONF_ANGLE "plugins/darkroom/liquify/angle"
@@ -255,6 +257,27 @@ typedef struct
   dt_liquify_path_data_t nodes[MAX_NODES];
 } dt_iop_liquify_params_t;
 
+// Point transforms are used for masks and the color picker and may
+// come in large numbers, so the distortion map of all warps is kept
+// between calls and only redrawn where warps changed.
+
+typedef struct
+{
+  float scale;                  ///< scale of the warps and maps
+  dt_liquify_warp_t *warps;     ///< interpolated warps the maps were built from
+  int n_warps;
+  cairo_rectangle_int_t extent; ///< union of all stamps
+  float complex *map;           ///< distortion map
+  float complex *imap;          ///< inverted distortion map, built on demand
+} dt_liquify_map_cache_t;
+
+typedef struct
+{
+  dt_iop_liquify_params_t params;
+  dt_pthread_mutex_t lock;      ///< protects the cache, transforms can run in parallel
+  dt_liquify_map_cache_t cache;
+} dt_iop_liquify_data_t;
+
 typedef struct
 {
   int warp_kernel;
@@ -1094,6 +1117,64 @@ static GSList *_get_map_extent(const dt_iop_roi_t *roi_out,
   return g_slist_reverse(in_roi);
 }
 
+static float complex *_invert_distortion_map(const float complex *const map,
+                                             const cairo_rectangle_int_t *map_extent)
+{
+  const int mapsize = map_extent->width * map_extent->height;
+  float complex *const imap = dt_alloc_align_type(float complex, mapsize);
+  if(!imap)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[liquify] out of memory, inverted distortion map not built");
+    return NULL;
+  }
+  memset(imap, 0, sizeof(float complex) * mapsize);
+
+  // copy map into imap(inverted map).
+  // imap [ n + dx(map[n]) , n + dy(map[n]) ] = -map[n]
+
+  DT_OMP_FOR()
+  for(int y = 0; y <  map_extent->height; y++)
+  {
+    const float complex *const row = map + y * map_extent->width;
+    for(int x = 0; x < map_extent->width; x++)
+    {
+      const float complex d = row[x];
+      // compute new position (nx,ny) given the displacement d
+      const int nx = x + (int)crealf(d);
+      const int ny = y + (int)cimagf(d);
+
+      // if the point falls into the extent, set it
+      if(nx>0 && nx<map_extent->width && ny>0 && ny<map_extent->height)
+        imap[nx + ny * map_extent->width] = -d;
+    }
+  }
+
+  // now just do a pass to avoid gap with a displacement of zero,
+  // note that we do not need high precision here as the inverted
+  // distortion mask is only used to compute a final displacement of
+  // points.
+
+  DT_OMP_FOR()
+  for(int y = 0; y <  map_extent->height; y++)
+  {
+    float complex *const row = imap + y * map_extent->width;
+    float complex last[2] = { 0, 0 };
+    for(int x = 0; x < map_extent->width / 2 + 1; x++)
+    {
+      float complex *cl = row + x;
+      float complex *cr = row + map_extent->width - x;
+      if(x!=0)
+      {
+        if(*cl == 0) *cl = last[0];
+        if(*cr == 0) *cr = last[1];
+      }
+      last[0] = *cl; last[1] = *cr;
+    }
+  }
+
+  return imap;
+}
+
 static float complex *create_global_distortion_map(const cairo_rectangle_int_t *map_extent,
                                                    const GSList *interpolated,
                                                    const gboolean inverted)
@@ -1120,59 +1201,28 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
 
   if(inverted)
   {
-    float complex * const imap = dt_alloc_align_type(float complex, mapsize);
-    memset(imap, 0, sizeof(float complex) * mapsize);
-
-    // copy map into imap(inverted map).
-    // imap [ n + dx(map[n]) , n + dy(map[n]) ] = -map[n]
-
-    DT_OMP_FOR()
-    for(int y = 0; y <  map_extent->height; y++)
-    {
-      const float complex *const row = map + y * map_extent->width;
-      for(int x = 0; x < map_extent->width; x++)
-      {
-        const float complex d = row[x];
-        // compute new position (nx,ny) given the displacement d
-        const int nx = x + (int)crealf(d);
-        const int ny = y + (int)cimagf(d);
-
-        // if the point falls into the extent, set it
-        if(nx>0 && nx<map_extent->width && ny>0 && ny<map_extent->height)
-          imap[nx + ny * map_extent->width] = -d;
-      }
-    }
-
+    float complex *const imap = _invert_distortion_map(map, map_extent);
     dt_free_align((void *) map);
-
-    // now just do a pass to avoid gap with a displacement of zero,
-    // note that we do not need high precision here as the inverted
-    // distortion mask is only used to compute a final displacement of
-    // points.
-
-    DT_OMP_FOR()
-    for(int y = 0; y <  map_extent->height; y++)
-    {
-      float complex *const row = imap + y * map_extent->width;
-      float complex last[2] = { 0, 0 };
-      for(int x = 0; x < map_extent->width / 2 + 1; x++)
-      {
-        float complex *cl = row + x;
-        float complex *cr = row + map_extent->width - x;
-        if(x!=0)
-        {
-          if(*cl == 0) *cl = last[0];
-          if(*cr == 0) *cr = last[1];
-        }
-        last[0] = *cl; last[1] = *cr;
-      }
-    }
-
     map = imap;
   }
   return map;
 }
 
+static GList *_get_interpolated_warps(const dt_iop_module_t *self,
+                                      const dt_dev_pixelpipe_iop_t *piece,
+                                      const float scale)
+{
+  const dt_iop_liquify_data_t *const d = piece->data;
+
+  // copy params
+  dt_iop_liquify_params_t copy_params;
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
+
+  distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
+
+  return interpolate_paths(&copy_params);
+}
+
 static void _build_global_distortion_map(const dt_iop_module_t *self,
                                          const dt_dev_pixelpipe_iop_t *piece,
                                          const float scale,
@@ -1181,13 +1231,7 @@ static void _build_global_distortion_map(const dt_iop_module_t *self,
                                          const gboolean inverted,
                                          float complex **map)
 {
-  // copy params
-  dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, piece->data, sizeof(dt_iop_liquify_params_t));
-
-  distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
-
-  GList *interpolated = interpolate_paths(&copy_params);
+  GList *interpolated = _get_interpolated_warps(self, piece, scale);
   GSList *interpolated_in_roi = _get_map_extent(roi, interpolated, map_extent);
 
   if(map)
@@ -1197,6 +1241,221 @@ static void _build_global_distortion_map(const dt_iop_module_t *self,
   g_list_free_full(interpolated, free);
 }
 
+// the extent a stamp may write to, apply_round_stamp() rounds the
+// center while compute_round_stamp_extent() truncates it
+static void _get_stamp_bounds(cairo_rectangle_int_t *const restrict r,
+                              const dt_liquify_warp_t *const restrict warp)
+{
+  compute_round_stamp_extent(r, warp);
+  r->x -= 1;
+  r->y -= 1;
+  r->width += 2;
+  r->height += 2;
+}
+
+static inline gboolean _rects_overlap(const cairo_rectangle_int_t *a,
+                                      const cairo_rectangle_int_t *b)
+{
+  return a->x < b->x + b->width && b->x < a->x + a->width
+    && a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static void _rect_union(cairo_rectangle_int_t *const restrict a,
+                        const cairo_rectangle_int_t *const restrict b)
+{
+  if(a->width <= 0 || a->height <= 0)
+  {
+    *a = *b;
+    return;
+  }
+  const int x_last = MAX(a->x + a->width, b->x + b->width);
+  const int y_last = MAX(a->y + a->height, b->y + b->height);
+  a->x = MIN(a->x, b->x);
+  a->y = MIN(a->y, b->y);
+  a->width = x_last - a->x;
+  a->height = y_last - a->y;
+}
+
+static void _free_map_cache(dt_liquify_map_cache_t *cache)
+{
+  dt_free_align((void *) cache->map);
+  dt_free_align((void *) cache->imap);
+  free(cache->warps);
+  memset(cache, 0, sizeof(dt_liquify_map_cache_t));
+}
+
+/*
+  Redraws rect of the map. All warps touching rect are stamped, in the
+  same order as for a full rebuild, into a scratch map big enough to
+  hold them entirely, so the result is the same as rebuilding the map.
+
+  Returns FALSE if out of memory, the map is left unchanged then.
+*/
+
+static gboolean _redraw_map_region(float complex *const map,
+                                   const cairo_rectangle_int_t *map_extent,
+                                   const dt_liquify_warp_t *warps,
+                                   const int n_warps,
+                                   const cairo_rectangle_int_t *rect)
+{
+  cairo_rectangle_int_t extent = { 0, 0, 0, 0 };
+  for(int k = 0; k < n_warps; k++)
+  {
+    cairo_rectangle_int_t r;
+    _get_stamp_bounds(&r, &warps[k]);
+    if(_rects_overlap(&r, rect)) _rect_union(&extent, &r);
+  }
+  _rect_union(&extent, rect);
+
+  const size_t mapsize = (size_t)extent.width * extent.height;
+  float complex *scratch = dt_alloc_align_type(float complex, mapsize);
+  if(!scratch)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[liquify] out of memory, distortion map not updated");
+    return FALSE;
+  }
+  memset(scratch, 0, sizeof(float complex) * mapsize);
+
+  for(int k = 0; k < n_warps; k++)
+  {
+    cairo_rectangle_int_t r;
+    _get_stamp_bounds(&r, &warps[k]);
+    if(_rects_overlap(&r, rect)) apply_round_stamp(&warps[k], scratch, &extent);
+  }
+
+  for(int y = rect->y; y < rect->y + rect->height; y++)
+    memcpy(map + (size_t)(y - map_extent->y) * map_extent->width + rect->x - map_extent->x,
+           scratch + (size_t)(y - extent.y) * extent.width + rect->x - extent.x,
+           sizeof(float complex) * rect->width);
+
+  dt_free_align((void *) scratch);
+  return TRUE;
+}
+
+/*
+  Brings the cached map up to date with the interpolated warps.
+
+  Warps that are equal at the start and at the end of the old and new
+  list did not change, only the area covered by the others in either
+  list needs to be redrawn. Moving a node thus redraws the stamps of
+  its path segments only.
+
+  Returns FALSE if the map is too big to be kept around or out of
+  memory, the caller then builds a map for its points only.
+*/
+
+static gboolean _update_map_cache(dt_liquify_map_cache_t *cache,
+                                  GList *interpolated,
+                                  const float scale)
+{
+  const int n_warps = g_list_length(interpolated);
+  dt_liquify_warp_t *warps = malloc(sizeof(dt_liquify_warp_t) * MAX(n_warps, 1));
+  if(!warps)
+  {
+    _free_map_cache(cache);
+    return FALSE;
+  }
+  cairo_rectangle_int_t extent = { 0, 0, 0, 0 };
+  int k = 0;
+  for(const GList *l = interpolated; l; l = g_list_next(l), k++)
+  {
+    warps[k] = *((dt_liquify_warp_t *) l->data);
+    cairo_rectangle_int_t r;
+    _get_stamp_bounds(&r, &warps[k]);
+    _rect_union(&extent, &r);
+  }
+
+  if((size_t)extent.width * extent.height > CACHE_MAX_PIXELS)
+  {
+    free(warps);
+    _free_map_cache(cache);
+    return FALSE;
+  }
+
+  if(cache->warps
+     && cache->scale == scale
+     && cache->n_warps == n_warps
+     && !memcmp(cache->warps, warps, sizeof(dt_liquify_warp_t) * n_warps))
+  {
+    free(warps);
+    return TRUE;
+  }
+
+  const gboolean same_extent = cache->map
+    && cache->scale == scale
+    && cache->extent.x == extent.x && cache->extent.y == extent.y
+    && cache->extent.width == extent.width && cache->extent.height == extent.height;
+
+  cairo_rectangle_int_t dirty = { 0, 0, 0, 0 };
+  if(same_extent)
+  {
+    const int n_common = MIN(cache->n_warps, n_warps);
+    int head = 0;
+    while(head < n_common
+          && !memcmp(&cache->warps[head], &warps[head], sizeof(dt_liquify_warp_t)))
+      head++;
+    int tail = 0;
+    while(tail < n_common - head
+          && !memcmp(&cache->warps[cache->n_warps - 1 - tail],
+                     &warps[n_warps - 1 - tail], sizeof(dt_liquify_warp_t)))
+      tail++;
+
+    cairo_rectangle_int_t r;
+    for(int i = head; i < cache->n_warps - tail; i++)
+    {
+      _get_stamp_bounds(&r, &cache->warps[i]);
+      _rect_union(&dirty, &r);
+    }
+    for(int i = head; i < n_warps - tail; i++)
+    {
+      _get_stamp_bounds(&r, &warps[i]);
+      _rect_union(&dirty, &r);
+    }
+  }
+
+  const size_t mapsize = (size_t)extent.width * extent.height;
+  if(same_extent && (size_t)dirty.width * dirty.height <= mapsize / 2)
+  {
+    if(dirty.width > 0 && dirty.height > 0
+       && !_redraw_map_region(cache->map, &cache->extent, warps, n_warps, &dirty))
+    {
+      free(warps);
+      _free_map_cache(cache);
+      return FALSE;
+    }
+
+    dt_print(DT_DEBUG_PERF, "[liquify] redrew %dx%d of the %dx%d distortion map",
+             dirty.width, dirty.height, extent.width, extent.height);
+  }
+  else
+  {
+    dt_free_align((void *) cache->map);
+    cache->map = NULL;
+    if(mapsize)
+    {
+      cache->map = dt_alloc_align_type(float complex, mapsize);
+      if(!cache->map)
+      {
+        free(warps);
+        _free_map_cache(cache);
+        return FALSE;
+      }
+      memset(cache->map, 0, sizeof(float complex) * mapsize);
+      for(int i = 0; i < n_warps; i++)
+        apply_round_stamp(&warps[i], cache->map, &extent);
+    }
+  }
+
+  dt_free_align((void *) cache->imap);
+  cache->imap = NULL;
+  free(cache->warps);
+  cache->warps = warps;
+  cache->n_warps = n_warps;
+  cache->scale = scale;
+  cache->extent = extent;
+  return TRUE;
+}
+
 void modify_roi_in(dt_iop_module_t *self,
                    dt_dev_pixelpipe_iop_t *piece,
                    const dt_iop_roi_t *roi_out,
@@ -1244,6 +1503,41 @@ void modify_roi_in(dt_iop_module_t *self,
   cairo_region_destroy(roi_in_region);
 }
 
+static void _displace_points(float *const restrict points,
+                             const size_t points_count,
+                             const float scale,
+                             const float complex *const map,
+                             const cairo_rectangle_int_t *extent)
+{
+  const int map_size =  extent->width * extent->height;
+  const int x_last = extent->x + extent->width;
+  const int y_last = extent->y + extent->height;
+
+  // apply distortion to all points (this is a simple displacement
+  // given by a vector at this same point in the map)
+  DT_OMP_FOR(if(points_count > 100))
+  for(size_t i = 0; i < points_count; i++)
+  {
+    float *px = &points[i*2];
+    float *py = &points[i*2+1];
+    const float x = *px * scale;
+    const float y = *py * scale;
+    const int map_offset = ((int)(x - 0.5) - extent->x) + ((int)(y - 0.5) - extent->y) * extent->width;
+
+    if(x >= extent->x
+       && x < x_last
+       && y >= extent->y
+       && y < y_last
+       && map_offset >= 0
+       && map_offset < map_size)
+    {
+      const float complex dist = map[map_offset] / scale;
+      *px += crealf(dist);
+      *py += cimagf(dist);
+    }
+  }
+}
+
 static gboolean _distort_xtransform(const dt_iop_module_t *self,
                                     const dt_dev_pixelpipe_iop_t *piece,
                                     float *const restrict points,
@@ -1252,6 +1546,33 @@ static gboolean _distort_xtransform(const dt_iop_module_t *self,
 {
   const float scale = piece->iscale;
 
+  if(points_count == 0) return TRUE;
+
+  dt_iop_liquify_data_t *const d = piece->data;
+  GList *interpolated = _get_interpolated_warps(self, piece, scale);
+
+  dt_pthread_mutex_lock(&d->lock);
+  dt_liquify_map_cache_t *const cache = &d->cache;
+  if(_update_map_cache(cache, interpolated, scale))
+  {
+    if(inverted && cache->map && !cache->imap)
+      cache->imap = _invert_distortion_map(cache->map, &cache->extent);
+
+    // without any warps there is no map, as below. If only the inverted
+    // one could not be allocated try a map of the points' extent.
+    const float complex *const map = inverted ? cache->imap : cache->map;
+    if(map || !cache->map)
+    {
+      if(map)
+        _displace_points(points, points_count, scale, map, &cache->extent);
+      dt_pthread_mutex_unlock(&d->lock);
+      g_list_free_full(interpolated, free);
+      return map != NULL;
+    }
+  }
+  dt_pthread_mutex_unlock(&d->lock);
+  g_list_free_full(interpolated, free);
+
   // compute the extent of all points (all computations are done in RAW coordinate)
   float xmin = FLT_MAX, xmax = FLT_MIN, ymin = FLT_MAX, ymax = FLT_MIN;
 
@@ -1288,33 +1609,7 @@ static gboolean _distort_xtransform(const dt_iop_module_t *self,
 
     if(map == NULL) return FALSE;
 
-    const int map_size =  extent.width * extent.height;
-    const int x_last = extent.x + extent.width;
-    const int y_last = extent.y + extent.height;
-
-    // apply distortion to all points (this is a simple displacement
-    // given by a vector at this same point in the map)
-    DT_OMP_FOR(if(points_count > 100))
-    for(size_t i = 0; i < points_count; i++)
-    {
-      float *px = &points[i*2];
-      float *py = &points[i*2+1];
-      const float x = *px * scale;
-      const float y = *py * scale;
-      const int map_offset = ((int)(x - 0.5) - extent.x) + ((int)(y - 0.5) - extent.y) * extent.width;
-
-      if(x >= extent.x
-         && x < x_last
-         && y >= extent.y
-         && y < y_last
-         && map_offset >= 0
-         && map_offset < map_size)
-      {
-        const float complex dist = map[map_offset] / scale;
-        *px += crealf(dist);
-        *py += cimagf(dist);
-      }
-    }
+    _displace_points(points, points_count, scale, map, &extent);
 
     dt_free_align((void *) map);
   }
@@ -1601,6 +1896,37 @@ void cleanup_global(dt_iop_module_so_t *self)
   self->data = NULL;
 }
 
+void init_pipe(dt_iop_module_t *self,
+               dt_dev_pixelpipe_t *pipe,
+               dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = calloc(1, sizeof(dt_iop_liquify_data_t));
+  dt_pthread_mutex_init(&d->lock, NULL);
+  piece->data = d;
+}
+
+void cleanup_pipe(dt_iop_module_t *self,
+                  dt_dev_pixelpipe_t *pipe,
+                  dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+  _free_map_cache(&d->cache);
+  dt_pthread_mutex_destroy(&d->lock);
+  free(piece->data);
+  piece->data = NULL;
+}
+
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *p1,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+
+  // the cached maps check themselves against the warps when used
+  memcpy(&d->params, p1, sizeof(dt_iop_liquify_params_t));
+}
+
 // calculate the dot product of 2 vectors.
 
 static float cdot(const float complex p0, const float complex p1)
@@ -1734,7 +2060,7 @@ static GList *interpolate_paths(dt_iop_liquify_params_t *p)
       {
         dt_liquify_warp_t *w = malloc(sizeof(dt_liquify_warp_t));
         *w = *warp2;
-        l = g_list_append(l, w);
+        l = g_list_prepend(l, w);
       }
       continue;
     }
@@ -1754,7 +2080,7 @@ static GList *interpolate_paths(dt_iop_liquify_params_t *p)
         mix_warps(w, warp1, warp2, pt, t);
         w->status = DT_LIQUIFY_STATUS_INTERPOLATED;
         arc_length += cabsf(w->radius - w->point) * STAMP_RELOCATION;
-        l = g_list_append(l, w);
+        l = g_list_prepend(l, w);
       }
       continue;
     }
@@ -1781,13 +2107,13 @@ static GList *interpolate_paths(dt_iop_liquify_params_t *p)
         mix_warps(w, warp1, warp2, pt, t);
         w->status = DT_LIQUIFY_STATUS_INTERPOLATED;
         arc_length += cabsf(w->radius - w->point) * STAMP_RELOCATION;
-        l = g_list_append(l, w);
+        l = g_list_prepend(l, w);
       }
       free((void *) buffer);
       continue;
     }
   }
-  return l;
+  return g_list_reverse(l);
 }
 
 #define FG_COLOR     set_source_rgba(cr, fg_color)
@@ -37,6 +37,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <sys/stat.h>
 #if defined (_WIN32)
 #include "win/getdelim.h"
 #include "win/scandir.h"
@@ -99,9 +100,23 @@ typedef enum dt_lut3d_cols_t
 
 const char invalid_filepath_prefix[] = "INVALID >> ";
 
+// number of parsed luts no pipe is using anymore that are kept around for reuse
+#define DT_IOP_LUT3D_CACHE_UNUSED 4
+
+// a parsed lut, shared read-only by all the pipes using the same file
+typedef struct dt_iop_lut3d_cache_t
+{
+  gchar *key;     // full path of the lut file or name of the compressed lut
+  int64_t mtime;  // modification time of the file when it was parsed
+  float *clut;    // cube lut pointer
+  uint16_t level; // cube_size
+  int users;      // number of pipes holding this lut
+} dt_iop_lut3d_cache_t;
+
 typedef struct dt_iop_lut3d_data_t
 {
   dt_iop_lut3d_params_t params;
+  dt_iop_lut3d_cache_t *lut; // reference into the global lut cache
   float *clut;  // cube lut pointer
   uint16_t level; // cube_size
 } dt_iop_lut3d_data_t;
@@ -112,6 +127,8 @@ typedef struct dt_iop_lut3d_global_data_t
   int kernel_lut3d_trilinear;
   int kernel_lut3d_pyramid;
   int kernel_lut3d_none;
+  dt_pthread_mutex_t lut_lock;
+  GList *luts; // dt_iop_lut3d_cache_t, most recently used first
 } dt_iop_lut3d_global_data_t;
 
 #ifdef HAVE_GMIC
@@ -293,98 +310,110 @@ static void _correct_pixel_trilinear(const float *const in,
  }
 }
 
+// number of pixels for which the grid coordinates and weights are computed in one go before the
+// lut is looked up, so that the arithmetic part of the interpolation can be vectorized
+#define LUT3D_BLOCK 16
+
 // from OpenColorIO
 // https://github.com/imageworks/OpenColorIO/blob/master/src/OpenColorIO/ops/Lut3D/Lut3DOp.cpp
+//
+// The cube cell is split into six tetrahedra, all of them sharing the P000-P111 diagonal. Walking
+// from P000 along the axis with the largest delta, then along the one with the second largest
+// delta ends up at P111 and gives the two remaining vertices. Selecting those (and sorting the
+// deltas) with conditional moves instead of branches lets the weights of a whole block of pixels
+// be computed in SIMD registers, only the lut lookups remain scalar.
 static void _correct_pixel_tetrahedral(const float *const in,
                                        float *const out,
                                        const size_t pixel_nb,
                                        const float *const restrict clut,
                                        const uint16_t level)
 {
+  const int level_minus_2 = (level - 2);
   const size_t level2 = level * level;
-  const size_t level1_stride = 3 * level;
-  const size_t level2_stride = 3 * level2;
-  const size_t level12_stride = 3 * (level + level2);
+  const int stride_r = 3;                     // P000 -> P100
+  const int stride_g = 3 * level;             // P000 -> P010
+  const int stride_b = 3 * level2;            // P000 -> P001
+  const size_t stride_rgb = stride_r + stride_g + stride_b; // P000 -> P111
   const float flevel_1 = (float)(level - 1);
+  const size_t nblocks = (pixel_nb + LUT3D_BLOCK - 1) / LUT3D_BLOCK;
 
   DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  for(size_t blk = 0; blk < nblocks; blk++)
   {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
-
-    dt_aligned_pixel_t rgbi;
-    dt_aligned_pixel_t rgbd;
-    for_each_channel(c)
-      rgbd[c] = CLIP(input[c]) * flevel_1;
-
-    for_each_channel(c)
+    const size_t start = blk * LUT3D_BLOCK;
+    const int npix = MIN(LUT3D_BLOCK, (int)(pixel_nb - start));
+    const float *const input = in + 4 * start;
+    float *const output = out + 4 * start;
+
+    DT_ALIGNED_ARRAY size_t index[LUT3D_BLOCK];
+    DT_ALIGNED_ARRAY int offset1[LUT3D_BLOCK];
+    DT_ALIGNED_ARRAY int offset2[LUT3D_BLOCK];
+    DT_ALIGNED_ARRAY float w0[LUT3D_BLOCK];
+    DT_ALIGNED_ARRAY float w1[LUT3D_BLOCK];
+    DT_ALIGNED_ARRAY float w2[LUT3D_BLOCK];
+    DT_ALIGNED_ARRAY float w3[LUT3D_BLOCK];
+
+    DT_OMP_SIMD()
+    for(int j = 0; j < npix; j++)
     {
-      rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
-      rgbd[c] = rgbd[c] - rgbi[c]; // delta red/green/blue
+      const float r = CLIP(input[4*j]) * flevel_1;
+      const float g = CLIP(input[4*j+1]) * flevel_1;
+      const float b = CLIP(input[4*j+2]) * flevel_1;
+      const int ri = CLAMP((int)r, 0, level_minus_2);
+      const int gi = CLAMP((int)g, 0, level_minus_2);
+      const int bi = CLAMP((int)b, 0, level_minus_2);
+      const float dr = r - ri; // delta red/green/blue
+      const float dg = g - gi;
+      const float db = b - bi;
+
+      // same comparisons (and handling of ties) as the nested branches of the OpenColorIO
+      // code, the six cases are
+      //   dr > dg > db, dr > db >= dg, db >= dr > dg, db > dg >= dr, dg >= db > dr, dg >= dr >= db
+      const gboolean r_gt_g = dr > dg;
+      const gboolean g_gt_b = dg > db;
+      const gboolean r_gt_b = dr > db;
+      const gboolean b_gt_g = db > dg;
+      const gboolean b_gt_r = db > dr;
+
+      // largest delta and the axis it belongs to
+      const gboolean first_r = r_gt_g & (g_gt_b | r_gt_b);
+      const gboolean first_b = r_gt_g ? !(g_gt_b | r_gt_b) : b_gt_g;
+      const float d1 = first_r ? dr : (first_b ? db : dg);
+      const int o1 = first_r ? stride_r : (first_b ? stride_b : stride_g);
+
+      // middle delta and the axis it belongs to
+      const gboolean second_g = r_gt_g ? g_gt_b : b_gt_g;
+      const gboolean second_b = !second_g & (r_gt_g ? r_gt_b : b_gt_r);
+      const float d2 = second_g ? dg : (second_b ? db : dr);
+      const int o2 = second_g ? stride_g : (second_b ? stride_b : stride_r);
+
+      // smallest delta
+      const float d3 = r_gt_g ? (g_gt_b ? db : dg) : ((b_gt_g | b_gt_r) ? dr : db);
+
+      index[j] = (ri + gi * level + bi * level2) * 3; // P000
+      offset1[j] = o1;
+      offset2[j] = o1 + o2;
+      w0[j] = 1 - d1;
+      w1[j] = d1 - d2;
+      w2[j] = d2 - d3;
+      w3[j] = d3;
     }
 
-  // indexes of P000 to P111 in clut
-    const size_t color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
-    const size_t i000 = color * 3;                     // P000
-    const size_t i100 = i000 + 3;                      // P100
-    const size_t i010 = i000 + level1_stride;          // P010
-    const size_t i110 = i010 + 3;                      // P110
-    const size_t i001 = i000 + level2_stride;          // P001
-    const size_t i101 = i001 + 3;                      // P101
-    const size_t i011 = i000 + level12_stride;         // P011
-    const size_t i111 = i011 + 3;                      // P111
-
-    if(rgbd[0] > rgbd[1])
+    for(int j = 0; j < npix; j++)
     {
-      if(rgbd[1] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[1] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[1])*clut[i100+c]
-                      + (rgbd[1]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
-      else if(rgbd[0] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[2] >= rgbd[1]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[2])*clut[i100+c]
-                      + (rgbd[2]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[2] >= rgbd[0] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[0])*clut[i001+c]
-                      + (rgbd[0]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
+      const float *const p000 = clut + index[j];
+      const float *const p1 = p000 + offset1[j];
+      const float *const p2 = p000 + offset2[j];
+      const float *const p111 = p000 + stride_rgb;
+      dt_aligned_pixel_t res;
+
+      for(int c = 0; c < 3; c++)
+        res[c] = w0[j] * p000[c] + w1[j] * p1[c] + w2[j] * p2[c] + w3[j] * p111[c];
+      res[3] = input[4*j+3];
+      // not using non-temporal writes here, as those are substantially slower when in==out....
+      // (which is the case when performing a colorspace conversion)
+      copy_pixel(output + 4*j, res);
     }
-    else
-    {
-      if(rgbd[2] > rgbd[1])
-      {
-        // rgbd[2] > rgbd[1] >= rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[1])*clut[i001+c]
-                      + (rgbd[1]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else if(rgbd[2] > rgbd[0])
-      {
-        // rgbd[1] >= rgbd[2] > rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[2])*clut[i010+c]
-                      + (rgbd[2]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[1] >= rgbd[0] >= rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[0])*clut[i010+c]
-                      + (rgbd[0]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
-    }
-    // not using non-temporal writes here, as those are substantially slower when in==out....
-    // (which is the case when performing a colorspace conversion)
   }
 }
 
@@ -1133,8 +1162,9 @@ void filepath_set_unix_separator(char *filepath)
 void init_global(dt_iop_module_so_t *self)
 {
   const int program = 28; // rgbcurve.cl, from programs.conf
-  dt_iop_lut3d_global_data_t *gd = malloc(sizeof(dt_iop_lut3d_global_data_t));
+  dt_iop_lut3d_global_data_t *gd = calloc(1, sizeof(dt_iop_lut3d_global_data_t));
   self->data = gd;
+  dt_pthread_mutex_init(&gd->lut_lock, NULL);
   gd->kernel_lut3d_tetrahedral = dt_opencl_create_kernel(program, "lut3d_tetrahedral");
   gd->kernel_lut3d_trilinear = dt_opencl_create_kernel(program, "lut3d_trilinear");
   gd->kernel_lut3d_pyramid = dt_opencl_create_kernel(program, "lut3d_pyramid");
@@ -1156,6 +1186,15 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_lut3d_trilinear);
   dt_opencl_free_kernel(gd->kernel_lut3d_pyramid);
   dt_opencl_free_kernel(gd->kernel_lut3d_none);
+  for(GList *l = gd->luts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_cache_t *lut = l->data;
+    g_free(lut->key);
+    dt_free_align(lut->clut);
+    free(lut);
+  }
+  g_list_free(gd->luts);
+  dt_pthread_mutex_destroy(&gd->lut_lock);
   free(self->data);
   self->data = NULL;
 }
@@ -1198,6 +1237,109 @@ static int _calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
   return level;
 }
 
+// the key under which the lut of the given params is cached, NULL when there is nothing to load.
+// a lut file is identified by its full path and modification time so that an edited file is
+// parsed again, a compressed lut by its name and its keypoints.
+static gchar *_lut_cache_key(const dt_iop_lut3d_params_t *const p, int64_t *mtime)
+{
+  *mtime = 0;
+  if(!p->filepath[0]) return NULL;
+#ifdef HAVE_GMIC
+  if(p->nb_keypoints)
+  {
+    const size_t size = MIN((size_t)p->nb_keypoints * 2 * 3, sizeof(p->c_clut));
+    const dt_hash_t hash = dt_hash(DT_INITHASH, p->c_clut, size);
+    return g_strdup_printf("gmz:%s:%" PRIu64, p->lutname, hash);
+  }
+#endif // HAVE_GMIC
+  gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
+  gchar *fullpath = lutfolder[0] ? g_build_filename(lutfolder, p->filepath, NULL) : NULL;
+  g_free(lutfolder);
+  struct stat statbuf;
+  if(fullpath && !stat(fullpath, &statbuf))
+    *mtime = (int64_t)statbuf.st_mtime;
+  return fullpath;
+}
+
+// drop the luts nobody uses beyond the most recently used ones, called with the lock held
+static void _lut_cache_trim(dt_iop_lut3d_global_data_t *gd)
+{
+  int unused = 0;
+  GList *l = gd->luts;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    dt_iop_lut3d_cache_t *lut = l->data;
+    if(lut->users == 0 && ++unused > DT_IOP_LUT3D_CACHE_UNUSED)
+    {
+      g_free(lut->key);
+      dt_free_align(lut->clut);
+      free(lut);
+      gd->luts = g_list_delete_link(gd->luts, l);
+    }
+    l = next;
+  }
+}
+
+// returns the parsed lut for the given params, reading the file only if no pipe has it already.
+// the caller holds a reference until _lut_release()
+static dt_iop_lut3d_cache_t *_lut_acquire(dt_iop_lut3d_global_data_t *gd,
+                                          dt_iop_lut3d_params_t *const p)
+{
+  int64_t mtime = 0;
+  gchar *key = _lut_cache_key(p, &mtime);
+  if(!key) return NULL;
+
+  dt_pthread_mutex_lock(&gd->lut_lock);
+  for(GList *l = gd->luts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_cache_t *lut = l->data;
+    if(lut->mtime == mtime && !strcmp(lut->key, key))
+    {
+      lut->users++;
+      gd->luts = g_list_remove_link(gd->luts, l);
+      gd->luts = g_list_concat(l, gd->luts);
+      dt_pthread_mutex_unlock(&gd->lut_lock);
+      dt_print(DT_DEBUG_PERF, "[lut3d] reusing parsed LUT %s", key);
+      g_free(key);
+      return lut;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->lut_lock);
+
+  // parse outside of the lock, the worst that can happen is two pipes parsing the same file
+  float *clut = NULL;
+  const uint16_t level = _calculate_clut(p, &clut);
+  if(!level)
+  {
+    dt_free_align(clut);
+    g_free(key);
+    return NULL;
+  }
+
+  dt_iop_lut3d_cache_t *lut = malloc(sizeof(dt_iop_lut3d_cache_t));
+  lut->key = key;
+  lut->mtime = mtime;
+  lut->clut = clut;
+  lut->level = level;
+  lut->users = 1;
+
+  dt_pthread_mutex_lock(&gd->lut_lock);
+  gd->luts = g_list_prepend(gd->luts, lut);
+  _lut_cache_trim(gd);
+  dt_pthread_mutex_unlock(&gd->lut_lock);
+  return lut;
+}
+
+static void _lut_release(dt_iop_lut3d_global_data_t *gd, dt_iop_lut3d_cache_t *lut)
+{
+  if(!lut) return;
+  dt_pthread_mutex_lock(&gd->lut_lock);
+  lut->users--;
+  _lut_cache_trim(gd);
+  dt_pthread_mutex_unlock(&gd->lut_lock);
+}
+
 #ifdef HAVE_GMIC
 static gboolean _list_match_string(GtkTreeModel *model,
                                    GtkTreePath *path,
@@ -1372,14 +1514,12 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   dt_iop_lut3d_data_t *d = piece->data;
 
   if(strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
-  { // new clut file
-    if(d->clut)
-    { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
-    }
-    d->level = _calculate_clut(p, &d->clut);
+  { // new clut file, release the current clut if any
+    dt_iop_lut3d_global_data_t *gd = self->global_data;
+    _lut_release(gd, d->lut);
+    d->lut = _lut_acquire(gd, p);
+    d->clut = d->lut ? d->lut->clut : NULL;
+    d->level = d->lut ? d->lut->level : 0;
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1389,6 +1529,7 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
   piece->data = malloc(sizeof(dt_iop_lut3d_data_t));
   dt_iop_lut3d_data_t *d = piece->data;
   memcpy(&d->params, self->default_params, sizeof(dt_iop_lut3d_params_t));
+  d->lut = NULL;
   d->clut = NULL;
   d->level = 0;
   d->params.filepath[0] = '\0';
@@ -1396,9 +1537,9 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  dt_iop_lut3d_data_t *d = piece->data;;
-  if(d->clut)
-    dt_free_align(d->clut);
+  dt_iop_lut3d_data_t *d = piece->data;
+  _lut_release(self->global_data, d->lut);
+  d->lut = NULL;
   d->clut = NULL;
   d->level = 0;
   free(piece->data);
@@ -3555,7 +3555,8 @@ static void _retouch_heal(float *const in,
 
   // heal it
   dt_heal(img_src, img_dest, mask_scaled,
-          roi_mask_scaled->width, roi_mask_scaled->height, 4, max_iter);
+          roi_mask_scaled->width, roi_mask_scaled->height, 4, max_iter,
+          DT_HEAL_SOLVER_MULTIGRID);
 
   // copy healed (temp) image to destination image
   rt_copy_image_masked(img_dest, in, roi_in, mask_scaled, roi_mask_scaled, opacity);
@@ -4323,7 +4324,8 @@ static cl_int _retouch_heal_cl(const int devid,
   if(hp)
   {
     err = dt_heal_cl(hp, dev_src, dev_dest, mask_scaled,
-                     roi_mask_scaled->width, roi_mask_scaled->height, max_iter);
+                     roi_mask_scaled->width, roi_mask_scaled->height, max_iter,
+                     DT_HEAL_SOLVER_MULTIGRID);
     dt_heal_free_cl(hp);
 
     dt_opencl_release_mem_object(dev_src);
@@ -17,6 +17,7 @@
 */
 
 #include "bauhaus/bauhaus.h"
+#include "common/curve_baker.h"
 #include "common/custom_primaries.h"
 #include "common/math.h"
 #include "common/matrices.h"
@@ -171,6 +172,7 @@ typedef struct dt_iop_sigmoid_data_t
   float rotation[3];
   float purity;
   dt_iop_sigmoid_base_primaries_t base_primaries;
+  dt_baked_curve_t curve;
 } dt_iop_sigmoid_data_t;
 
 typedef struct dt_iop_sigmoid_gui_data_t
@@ -209,7 +211,8 @@ const char **description(dt_iop_module_t *self)
 
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING
+    | IOP_FLAGS_EXACT_LOCAL;
 }
 
 int default_group()
@@ -315,6 +318,22 @@ static inline float _generalized_loglogistic_sigmoid(const float value,
   return dt_isnan(paper_response) ? magnitude : paper_response;
 }
 
+static float _baked_sigmoid(const float value, const void *const data)
+{
+  const dt_iop_sigmoid_data_t *module_data = data;
+  return _generalized_loglogistic_sigmoid(value, module_data->white_target, module_data->paper_exposure,
+                                          module_data->film_fog, module_data->film_power,
+                                          module_data->paper_power);
+}
+
+// the tabulated curve if it could be baked within tolerance, the analytic one otherwise
+static inline float _sigmoid_curve(const dt_iop_sigmoid_data_t *const module_data, const float value)
+{
+  return dt_baked_curve_valid(&module_data->curve)
+    ? dt_baked_curve_eval(&module_data->curve, value)
+    : _baked_sigmoid(value, module_data);
+}
+
 void commit_params(dt_iop_module_t *self,
                    dt_iop_params_t *p1,
                    dt_dev_pixelpipe_t *pipe,
@@ -389,6 +408,11 @@ void commit_params(dt_iop_module_t *self,
   module_data->rotation[1] = params->green_rotation;
   module_data->rotation[2] = params->blue_rotation;
   module_data->base_primaries = params->base_primaries;
+
+  // scene values from 2^-16 to 2^10, brighter ones are rare and fall back to the analytic curve
+  dt_baked_curve_cleanup(&module_data->curve);
+  dt_baked_curve_init(&module_data->curve, _baked_sigmoid, module_data, 0x1.0p-16f, 0x1.0p10f,
+                      DT_CURVE_BAKER_TOLERANCE);
 }
 
 static void _calculate_adjusted_primaries(const dt_iop_sigmoid_data_t *const module_data,
@@ -576,10 +600,6 @@ void process_loglogistic_rgb_ratio(const dt_dev_pixelpipe_iop_t *piece,
 
   const float white_target = module_data->white_target;
   const float black_target = module_data->black_target;
-  const float paper_exp = module_data->paper_exposure;
-  const float film_fog = module_data->film_fog;
-  const float contrast_power = module_data->film_power;
-  const float skew_power = module_data->paper_power;
 
   DT_OMP_FOR()
   for(size_t k = 0; k < 4 * npixels; k += 4)
@@ -594,8 +614,7 @@ void process_loglogistic_rgb_ratio(const dt_dev_pixelpipe_iop_t *piece,
 
     // Preserve color ratios by applying the tone curve on a luma estimate and then scale the RGB tripplet uniformly
     const float luma = (pix_in_strict_positive[0] + pix_in_strict_positive[1] + pix_in_strict_positive[2]) / 3.0f;
-    const float mapped_luma
-        = _generalized_loglogistic_sigmoid(luma, white_target, paper_exp, film_fog, contrast_power, skew_power);
+    const float mapped_luma = _sigmoid_curve(module_data, luma);
 
     if(luma > 1e-9)
     {
@@ -712,11 +731,6 @@ void process_loglogistic_per_channel(dt_develop_t *dev,
   float *const out = (float *)ovoid;
   const size_t npixels = (size_t)roi_in->width * roi_in->height;
 
-  const float white_target = module_data->white_target;
-  const float paper_exp = module_data->paper_exposure;
-  const float film_fog = module_data->film_fog;
-  const float contrast_power = module_data->film_power;
-  const float skew_power = module_data->paper_power;
   const float hue_preservation = module_data->hue_preservation;
 
   const dt_iop_order_iccprofile_info_t *pipe_work_profile = dt_ioppr_get_pipe_work_profile_info(piece->pipe);
@@ -743,8 +757,7 @@ void process_loglogistic_per_channel(dt_develop_t *dev,
 
     for_each_channel(c, aligned(rendering_RGB, per_channel))
     {
-      per_channel[c] = _generalized_loglogistic_sigmoid(rendering_RGB[c], white_target, paper_exp, film_fog,
-                                                        contrast_power, skew_power);
+      per_channel[c] = _sigmoid_curve(module_data, rendering_RGB[c]);
     }
 
     // Hue correction by scaling the middle value relative to the max and min values.
@@ -870,6 +883,14 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
   piece->data = calloc(1, sizeof(dt_iop_sigmoid_data_t));
 }
 
+void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_sigmoid_data_t *module_data = piece->data;
+  dt_baked_curve_cleanup(&module_data->curve);
+  free(piece->data);
+  piece->data = NULL;
+}
+
 void gui_changed(dt_iop_module_t *self, GtkWidget *w, void *previous)
 {
   const dt_iop_sigmoid_gui_data_t *g = self->gui_data;
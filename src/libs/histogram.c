@@ -258,6 +258,9 @@ static void _lib_histogram_process_histogram(dt_lib_histogram_t *const d,
 
   histogram_params.roi = roi;
   histogram_params.bins_count = HISTOGRAM_BINS;
+  histogram_params.sample_step =
+    dt_histogram_sample_step(roi->width - roi->crop_x - roi->crop_right,
+                             roi->height - roi->crop_y - roi->crop_bottom);
 
   // FIXME: for point sample, calculate whole graph and the point
   // sample values, draw these on top of the graph
@@ -0,0 +1,187 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the automatic perspective correction in iop/ashift.c at an increasing
+ * number of threads: the line detection in horizontal bands against LSD on the whole
+ * image, and the simplex fits from several start points. The image is the one of the
+ * unit tests, straight bars on a noisy background, with their number and length
+ * following the image size.
+ *
+ * usage: bench_ashift [width] [height]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "iop/ashift.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+static double *_make_image(const int width, const int height)
+{
+  double *img = malloc(sizeof(double) * width * height);
+  if(!img) return NULL;
+
+  unsigned int seed = 1;
+  for(size_t k = 0; k < (size_t)width * height; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    img[k] = 100.0 + 10.0 * ((seed >> 8) & 0xff) / 255.0;
+  }
+  const double zoom = width / 1200.0;
+  const int edges = lround(40.0 * width * height / (1200.0 * 900.0));
+  srand(5);
+  for(int e = 0; e < edges; e++)
+  {
+    const double x0 = rand() % width;
+    const double y0 = rand() % height;
+    const double angle = (rand() % 360) * M_PI / 180.0;
+    const double length = zoom * (50 + rand() % 800);
+    const double dx = cos(angle);
+    const double dy = sin(angle);
+    for(int t = 0; t <= length; t++)
+      for(int d = 0; d < 6 * zoom; d++)
+      {
+        const int x = lround(x0 + dx * t - dy * d);
+        const int y = lround(y0 + dy * t + dx * d);
+        if(x >= 0 && x < width && y >= 0 && y < height) img[(size_t)y * width + x] = 200.0;
+      }
+  }
+  return img;
+}
+
+static void _set_threads(const int threads)
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = threads;
+  omp_set_num_threads(threads);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const size_t npixels = (size_t)width * height;
+
+  double *img = _make_image(width, height);
+  double *copy = malloc(sizeof(double) * npixels);
+  float *rgba = dt_alloc_align_float(4 * npixels);
+  dt_iop_ashift_gui_data_t *g = calloc(1, sizeof(dt_iop_ashift_gui_data_t));
+  if(!img || !copy || !rgba || !g)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  // the scale line_detect() uses for this size
+  const double scale = MIN(LSD_SCALE, sqrt((double)LSD_MAX_PIXELS / npixels));
+
+  // the lines to fit, found the way the module does
+  for(size_t k = 0; k < npixels; k++)
+    for(int c = 0; c < 4; c++) rgba[4 * k + c] = img[k] / 256.0;
+  if(!line_detect(rgba, width, height, 0, 0, 1.0f, &g->lines, &g->lines_count,
+                  &g->vertical_count, &g->horizontal_count, &g->vertical_weight,
+                  &g->horizontal_weight, ASHIFT_ENHANCE_NONE, FALSE))
+  {
+    fprintf(stderr, "no lines detected\n");
+    return 1;
+  }
+  g->lines_in_width = width;
+  g->lines_in_height = height;
+  g->rotation_range = ROTATION_RANGE_SOFT;
+  g->lensshift_v_range = LENSSHIFT_RANGE_SOFT;
+  g->lensshift_h_range = LENSSHIFT_RANGE_SOFT;
+  g->shear_range = SHEAR_RANGE_SOFT;
+  dt_iop_module_t module = { 0 };
+  module.gui_data = g;
+
+  // LSD on the whole image as before, single threaded
+  double whole = 0.0;
+  int whole_count = 0;
+  for(int run = 0; run < 3; run++)
+  {
+    memcpy(copy, img, sizeof(double) * npixels);
+    const double start = dt_get_wtime();
+    double *lines = LineSegmentDetection(&whole_count, copy, width, height,
+                                         scale, LSD_SIGMA_SCALE, LSD_QUANT,
+                                         LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                         LSD_N_BINS, 0.0, NULL, NULL, NULL);
+    const double time = dt_get_wtime() - start;
+    if(run == 0 || time < whole) whole = time;
+    free(lines);
+  }
+  printf("%dx%d at scale %.2f, whole image: %.3fs, %d segments\n", width, height, scale, whole, whole_count);
+
+  // the scaling across cores: 1, 2, 4, ... threads up to all of them, the best of 3 runs each
+#ifdef _OPENMP
+  const int procs = omp_get_num_procs();
+#else
+  const int procs = 1;
+#endif
+  double single_detect = 0.0, single_fit = 0.0;
+  for(int threads = 1; threads <= procs; threads = threads < procs && 2 * threads > procs ? procs : 2 * threads)
+  {
+    _set_threads(threads);
+    double detect = 0.0, fit = 0.0;
+    int count = 0;
+    dt_iop_ashift_nmsresult_t result = NMS_SUCCESS;
+    dt_iop_ashift_params_t p = { 0 };
+    for(int run = 0; run < 3; run++)
+    {
+      memcpy(copy, img, sizeof(double) * npixels);
+      double start = dt_get_wtime();
+      double *lines = _detect_lines(copy, width, height, scale, &count);
+      double time = dt_get_wtime() - start;
+      if(run == 0 || time < detect) detect = time;
+      free(lines);
+
+      // the generic lens model from the neutral parameters
+      memset(&p, 0, sizeof(p));
+      p.mode = ASHIFT_MODE_GENERIC;
+      start = dt_get_wtime();
+      result = nmsfit(&module, &p, ASHIFT_FIT_BOTH_SHEAR);
+      time = dt_get_wtime() - start;
+      if(run == 0 || time < fit) fit = time;
+    }
+    if(threads == 1)
+    {
+      single_detect = detect;
+      single_fit = fit;
+    }
+    printf("%d threads: bands %.3fs, speedup %.2f, %d segments; %d simplex fits %.3fs, speedup %.2f, %s"
+           " (rotation %.2f, lens shift %.3f %.3f, shear %.3f)\n",
+           threads, detect, single_detect / detect, count, NMS_STARTS, fit, single_fit / fit,
+           result == NMS_SUCCESS ? "fitted" : "not fitted", p.rotation, p.lensshift_v, p.lensshift_h, p.shear);
+  }
+
+  free(g->lines);
+  free(g);
+  dt_free_align(rgba);
+  free(copy);
+  free(img);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
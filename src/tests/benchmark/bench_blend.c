@@ -0,0 +1,177 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the parametric blending in develop/blends/blendif_*.c for the Lab, RGB
+ * display and RGB scene families: the separate passes filling the mask, generating it
+ * and blending with it against the fused pass doing all of it row by row
+ *
+ * usage: bench_blend [width] [height]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/darktable.h"
+#include "common/imagebuf.h"
+#include "common/iop_order.h"
+#include "common/iop_profile.h"
+#include "develop/blend.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef void(_make_mask_func)(dt_dev_pixelpipe_iop_t *piece, const float *const a, const float *const b,
+                              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                              float *const mask);
+typedef void(_blend_func)(dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
+                          const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                          const float *const mask, const dt_dev_pixelpipe_display_mask_t request_mask_display);
+typedef gboolean(_fused_func)(dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
+                              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                              const float fill, float *const mask);
+
+typedef struct _family_t
+{
+  const char *name;
+  _make_mask_func *make_mask;
+  _blend_func *blend;
+  _fused_func *fused;
+  uint32_t channels;
+  uint32_t blend_mode;
+  gboolean lab;
+} _family_t;
+
+static const _family_t _families[] = {
+  { "lab", dt_develop_blendif_lab_make_mask, dt_develop_blendif_lab_blend,
+    dt_develop_blendif_lab_make_mask_and_blend, DEVELOP_BLENDIF_Lab_MASK, DEVELOP_BLEND_OVERLAY, TRUE },
+  { "rgb display", dt_develop_blendif_rgb_hsl_make_mask, dt_develop_blendif_rgb_hsl_blend,
+    dt_develop_blendif_rgb_hsl_make_mask_and_blend, DEVELOP_BLENDIF_RGB_MASK, DEVELOP_BLEND_OVERLAY, FALSE },
+  { "rgb scene", dt_develop_blendif_rgb_jzczhz_make_mask, dt_develop_blendif_rgb_jzczhz_blend,
+    dt_develop_blendif_rgb_jzczhz_make_mask_and_blend, DEVELOP_BLENDIF_RGB_MASK, DEVELOP_BLEND_MULTIPLY, FALSE },
+};
+
+// linear Rec709 to XYZ D50 as working profile of the pipe
+static dt_iop_order_iccprofile_info_t _profile = {
+  .type = DT_COLORSPACE_LIN_REC709,
+  .matrix_in = { { 0.4360747f, 0.3850649f, 0.1430804f },
+                 { 0.2225045f, 0.7168786f, 0.0606169f },
+                 { 0.0139322f, 0.0971045f, 0.7141733f } },
+  .matrix_in_transposed = { { 0.4360747f, 0.2225045f, 0.0139322f },
+                            { 0.3850649f, 0.7168786f, 0.0971045f },
+                            { 0.1430804f, 0.0606169f, 0.7141733f } },
+};
+
+static dt_iop_order_entry_t _colorin = { .o.iop_order = 10, .operation = "colorin" };
+static dt_iop_order_entry_t _colorout = { .o.iop_order = 30, .operation = "colorout" };
+
+static void _fill_image(float *const img, const size_t npixels, const gboolean lab, const float phase)
+{
+  for(size_t k = 0; k < npixels; k++)
+    for(int c = 0; c < 4; c++)
+    {
+      const float v = 0.5f + 0.45f * sinf(0.001f * k + phase + c);
+      img[4 * k + c] = c == 3 ? 0.0f : lab ? (c == 0 ? 100.0f * v : 160.0f * v - 80.0f) : v;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const size_t npixels = (size_t)width * height;
+
+  float *in = dt_alloc_align_float(4 * npixels);
+  float *out = dt_alloc_align_float(4 * npixels);
+  float *b = dt_alloc_align_float(4 * npixels);
+  float *mask = dt_alloc_align_float(npixels);
+  if(!in || !out || !b || !mask)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  dt_develop_t dev = { 0 };
+  dev.iop_order_list = g_list_append(g_list_append(NULL, &_colorin), &_colorout);
+  dt_iop_module_t module = { 0 };
+  module.dev = &dev;
+  module.iop_order = 20;
+  dt_dev_pixelpipe_t pipe = { 0 };
+  pipe.work_profile_info = &_profile;
+  dt_develop_blend_params_t d = { 0 };
+  d.mask_mode = DEVELOP_MASK_ENABLED | DEVELOP_MASK_CONDITIONAL;
+  d.mask_combine = DEVELOP_COMBINE_INCL;
+  d.opacity = 80.0f;
+  for(int ch = 0; ch < DEVELOP_BLENDIF_SIZE; ch++)
+  {
+    float *const p = d.blendif_parameters + 4 * ch;
+    p[0] = 0.05f;
+    p[1] = 0.25f;
+    p[2] = 0.7f;
+    p[3] = 0.95f;
+  }
+  dt_dev_pixelpipe_iop_t piece = { .module = &module, .pipe = &pipe, .blendop_data = &d, .colors = 4 };
+  const dt_iop_roi_t roi = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  const float fill = 0.0f;
+
+  for(size_t f = 0; f < sizeof(_families) / sizeof(_families[0]); f++)
+  {
+    const _family_t *const family = _families + f;
+    d.blendif = family->channels;
+    d.blend_mode = family->blend_mode;
+    _fill_image(in, npixels, family->lab, 0.0f);
+    _fill_image(out, npixels, family->lab, 1.0f);
+
+    for(int run = 0; run < 3; run++)
+    {
+      dt_iop_image_copy_by_size(b, out, width, height, 4);
+      double start = dt_get_wtime();
+      dt_iop_image_fill(mask, fill, width, height, 1);
+      family->make_mask(&piece, in, b, &roi, &roi, mask);
+      family->blend(&piece, in, b, &roi, &roi, mask, DT_DEV_PIXELPIPE_DISPLAY_NONE);
+      const double separate = dt_get_wtime() - start;
+
+      dt_iop_image_copy_by_size(b, out, width, height, 4);
+      start = dt_get_wtime();
+      const gboolean done = family->fused(&piece, in, b, &roi, &roi, fill, mask);
+      const double fused = dt_get_wtime() - start;
+
+      printf("%s %dx%d: separate %.4fs, fused %.4fs%s\n", family->name, width, height, separate, fused,
+             done ? "" : " (not fused)");
+    }
+  }
+
+  g_list_free(dev.iop_order_list);
+  dt_free_align(in);
+  dt_free_align(out);
+  dt_free_align(b);
+  dt_free_align(mask);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
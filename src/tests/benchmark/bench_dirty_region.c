@@ -0,0 +1,160 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the dirty region reprocessing in develop/pixelpipe_hb.c. A local edit
+ * changes a square of the edited module's output, the pointwise modules following it
+ * are either processed fully or only within the dirty region as done by the pipe:
+ * compare the edited output, copy the last output and process and patch the region.
+ * The modules are stand-ins with the per pixel work of a matrix conversion (colorin,
+ * channelmixerrgb, colorout) and of a tone mapper (sigmoid, colorbalancergb).
+ *
+ * usage: bench_dirty_region [width] [height] [edit size]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/darktable.h"
+#include "common/imagebuf.h"
+#include "develop/pixelpipe_hb.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define BPP (4 * sizeof(float))
+#define MODULES 5
+
+static void _matrix(const float *const in, float *const out, const size_t npixels)
+{
+  const dt_colormatrix_t m = { { 0.80f, 0.15f, 0.05f, 0.0f },
+                               { 0.10f, 0.85f, 0.05f, 0.0f },
+                               { 0.02f, 0.08f, 0.90f, 0.0f } };
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    for(int r = 0; r < 3; r++)
+      out[4 * k + r] = m[r][0] * in[4 * k] + m[r][1] * in[4 * k + 1] + m[r][2] * in[4 * k + 2];
+}
+
+static void _tone(const float *const in, float *const out, const size_t npixels)
+{
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+    for(int c = 0; c < 3; c++)
+    {
+      const float x = powf(fmaxf(in[4 * k + c], 0.0f), 1.5f);
+      out[4 * k + c] = x / (x + 0.18f);
+    }
+}
+
+static void _process(const int module, const float *const in, float *const out, const size_t npixels)
+{
+  // colorin, channelmixerrgb, colorbalancergb, sigmoid, colorout
+  if(module == 2 || module == 3)
+    _tone(in, out, npixels);
+  else
+    _matrix(in, out, npixels);
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const int edit = argc > 3 ? atoi(argv[3]) : 200;
+  const size_t npixels = (size_t)width * height;
+
+  // the last and the new output of the edited module and of all modules following it
+  float *prev[MODULES + 1];
+  float *next[MODULES + 1];
+  float *sub_in = dt_alloc_align_float(4 * (size_t)edit * edit);
+  float *sub_out = dt_alloc_align_float(4 * (size_t)edit * edit);
+  gboolean failed = !sub_in || !sub_out;
+  for(int m = 0; m <= MODULES; m++)
+  {
+    prev[m] = dt_alloc_align_float(4 * npixels);
+    next[m] = dt_alloc_align_float(4 * npixels);
+    failed |= !prev[m] || !next[m];
+  }
+  if(failed)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  for(size_t k = 0; k < 4 * npixels; k++)
+    prev[0][k] = 0.5f + 0.4f * sinf(0.001f * k);
+  for(int m = 0; m < MODULES; m++)
+    _process(m, prev[m], prev[m + 1], npixels);
+
+  // the edit moved a spot
+  dt_iop_image_copy_by_size(next[0], prev[0], width, height, 4);
+  const int x0 = width / 3, y0 = height / 3;
+  for(int y = y0; y < y0 + edit; y++)
+    for(int x = x0; x < x0 + edit; x++)
+      next[0][4 * ((size_t)y * width + x)] += 0.1f;
+
+  for(int run = 0; run < 3; run++)
+  {
+    double start = dt_get_wtime();
+    for(int m = 0; m < MODULES; m++)
+      _process(m, next[m], next[m + 1], npixels);
+    const double full = dt_get_wtime() - start;
+
+    start = dt_get_wtime();
+    dt_dev_dirty_region_t dirty;
+    dt_dev_dirty_region_diff((uint8_t *)next[0], (uint8_t *)prev[0], width, height, BPP, &dirty);
+    const double diff = dt_get_wtime() - start;
+    for(int m = 0; m < MODULES; m++)
+    {
+      dt_dev_dirty_region_t out_dirty, region;
+      dt_dev_dirty_region_local(&dirty, 0, width, height, &out_dirty, &region);
+      dt_dev_dirty_region_copy((uint8_t *)sub_in, region.width, 0, 0,
+                               (uint8_t *)next[m], width, region.x, region.y,
+                               region.width, region.height, BPP);
+      _process(m, sub_in, sub_out, (size_t)region.width * region.height);
+      dt_iop_image_copy_by_size(next[m + 1], prev[m + 1], width, height, 4);
+      dt_dev_dirty_region_copy((uint8_t *)next[m + 1], width, out_dirty.x, out_dirty.y,
+                               (uint8_t *)sub_out, region.width,
+                               out_dirty.x - region.x, out_dirty.y - region.y,
+                               out_dirty.width, out_dirty.height, BPP);
+      dirty = out_dirty;
+    }
+    const double region = dt_get_wtime() - start;
+
+    printf("%dx%d, %d modules, edit %dx%d: full %.4fs, dirty region %.4fs (compare %.4fs)\n",
+           width, height, MODULES, edit, edit, full, region, diff);
+  }
+
+  for(int m = 0; m <= MODULES; m++)
+  {
+    dt_free_align(prev[m]);
+    dt_free_align(next[m]);
+  }
+  dt_free_align(sub_in);
+  dt_free_align(sub_out);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
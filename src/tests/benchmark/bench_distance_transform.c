@@ -0,0 +1,84 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the euclidean distance transform in common/distance_transform.c at an
+ * increasing number of threads
+ *
+ * usage: bench_distance_transform [width] [height]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/darktable.h"
+#include "common/distance_transform.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+int main(int argc, char *argv[])
+{
+  const size_t width = argc > 1 ? atoi(argv[1]) : 6000;
+  const size_t height = argc > 2 ? atoi(argv[2]) : 4000;
+  float *out = dt_alloc_align_float(width * height);
+  if(!out)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  // the scaling across cores: 1, 2, 4, ... threads up to all of them, the best of 3 runs each
+#ifdef _OPENMP
+  const int procs = omp_get_num_procs();
+#else
+  const int procs = 1;
+#endif
+  double single = 0.0;
+  for(int threads = 1; threads <= procs; threads = threads < procs && 2 * threads > procs ? procs : 2 * threads)
+  {
+#ifdef _OPENMP
+    darktable.num_openmp_threads = threads;
+    omp_set_num_threads(threads);
+#endif
+    double best = 0.0;
+    float max_distance = 0.0f;
+    for(int run = 0; run < 3; run++)
+    {
+      // sparse seeds
+      for(size_t i = 0; i < width * height; i++)
+        out[i] = (i % 7919 == 0) ? 0.0f : DT_DISTANCE_TRANSFORM_MAX;
+
+      const double start = dt_get_wtime();
+      max_distance = dt_image_distance_transform(NULL, out, width, height, 0.0f, DT_DISTANCE_TRANSFORM_NONE);
+      const double time = dt_get_wtime() - start;
+      if(run == 0 || time < best) best = time;
+    }
+    if(threads == 1) single = best;
+    printf("distance transform %zux%zu, %d threads: %.3fs, speedup %.2f, max distance %.1f\n",
+           width, height, threads, best, single / best, max_distance);
+  }
+
+  dt_free_align(out);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
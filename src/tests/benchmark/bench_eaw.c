@@ -0,0 +1,132 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the denoising wavelets in common/eaw.c, the fused scales of
+ * denoiseprofile against separate decomposition and synthesis passes
+ *
+ * usage: bench_eaw [width] [height] [scales]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/darktable.h"
+#include "common/eaw.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+static void _threshold(dt_aligned_pixel_t thrs,
+                       const dt_aligned_pixel_t sum_y2,
+                       const size_t npixels)
+{
+  for_four_channels(c)
+    thrs[c] = 0.5f * sqrtf(sum_y2[c] / npixels);
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const int scales = argc > 3 ? atoi(argv[3]) : 5;
+  const size_t npixels = (size_t)width * height;
+  const size_t nfloats = 4 * npixels;
+  const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
+  float *img = dt_alloc_align_float(nfloats);
+  float *detail = dt_alloc_align_float(nfloats);
+  float *ref = dt_alloc_align_float(nfloats);
+  float *res = dt_alloc_align_float(nfloats);
+  float *a = dt_alloc_align_float(nfloats);
+  float *b = dt_alloc_align_float(nfloats);
+  if(!img || !detail || !ref || !res || !a || !b)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  unsigned int seed = 11;
+  for(size_t k = 0; k < nfloats; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    img[k] = (float)(k % (4 * width)) / (4 * width) + (float)(seed >> 8) / (float)(1 << 24);
+  }
+
+  for(int run = 0; run < 3; run++)
+  {
+    // separate passes with a stored detail band
+    double start = dt_get_wtime();
+    memcpy(a, img, sizeof(float) * nfloats);
+    memset(ref, 0, sizeof(float) * nfloats);
+    float *buf1 = a, *buf2 = b;
+    for(int scale = 0; scale < scales; scale++)
+    {
+      dt_aligned_pixel_t sum_y2, thrs;
+      eaw_dn_decompose(buf2, buf1, detail, sum_y2, scale, 1.0f, width, height);
+      _threshold(thrs, sum_y2, npixels);
+      eaw_synthesize(ref, ref, detail, thrs, boost, width, height);
+      float *t = buf1;
+      buf1 = buf2;
+      buf2 = t;
+    }
+    for(size_t k = 0; k < nfloats; k++)
+      ref[k] += buf1[k];
+    const double t_separate = dt_get_wtime() - start;
+
+    // fused scales
+    start = dt_get_wtime();
+    memcpy(a, img, sizeof(float) * nfloats);
+    buf1 = a;
+    buf2 = b;
+    dt_aligned_pixel_t thrs = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for(int scale = 0; scale < scales; scale++)
+    {
+      dt_aligned_pixel_t sum_y2;
+      eaw_dn_decompose_and_synthesize(buf2, buf1, res, thrs, boost, sum_y2, scale, 1.0f, width, height);
+      _threshold(thrs, sum_y2, npixels);
+      float *t = buf1;
+      buf1 = buf2;
+      buf2 = t;
+    }
+    eaw_dn_synthesize_residue(res, buf2, buf1, thrs, boost, scales - 1, width, height);
+    const double t_fused = dt_get_wtime() - start;
+
+    float max_err = 0.0f;
+    for(size_t k = 0; k < nfloats; k++)
+      max_err = fmaxf(max_err, fabsf(res[k] - ref[k]));
+    printf("denoising wavelets %dx%d, %d scales: separate %.3fs, fused %.3fs, max difference %g\n",
+           width, height, scales, t_separate, t_fused, max_err);
+  }
+
+  dt_free_align(img);
+  dt_free_align(detail);
+  dt_free_align(ref);
+  dt_free_align(res);
+  dt_free_align(a);
+  dt_free_align(b);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
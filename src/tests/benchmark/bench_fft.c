@@ -0,0 +1,183 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the tile FFT in common/fft.c, an overlap-save convolution
+ * with a 9x9 gaussian as done by capture sharpening against the spatial one
+ *
+ * usage: bench_fft [width] [height]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/darktable.h"
+#include "common/fft.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define SIZE 128
+#define RADIUS 4
+
+static void _spatial(const float *const img,
+                     float *const out,
+                     const float *const coeffs,
+                     const int width,
+                     const int height)
+{
+  DT_OMP_FOR()
+  for(int row = 0; row < height; row++)
+    for(int col = 0; col < width; col++)
+    {
+      float val = 0.0f;
+      for(int y = -RADIUS; y <= RADIUS; y++)
+        for(int x = -RADIUS; x <= RADIUS; x++)
+        {
+          const int r = row + y;
+          const int c = col + x;
+          if(r >= 0 && r < height && c >= 0 && c < width)
+            val += coeffs[ABS(y) * (RADIUS + 1) + ABS(x)] * img[(size_t)r * width + c];
+        }
+      out[(size_t)row * width + col] = val;
+    }
+}
+
+// two real tiles per complex transform, one pair per thread
+static void _overlap_save(const dt_fft_t *const fft,
+                          const float *const img,
+                          float *const out,
+                          const float *const psf,
+                          const int width,
+                          const int height)
+{
+  const int valid = SIZE - 2 * RADIUS;
+  const size_t nn = (size_t)SIZE * SIZE;
+  const int tiles_x = (width + valid - 1) / valid;
+  const int tiles = tiles_x * ((height + valid - 1) / valid);
+  size_t padded;
+  float *const zbuf = dt_alloc_perthread_float(2 * nn, &padded);
+  if(!zbuf) return;
+
+  DT_OMP_FOR()
+  for(int first = 0; first < tiles; first += 2)
+  {
+    float *const z = dt_get_perthread(zbuf, padded);
+    for(int t = 0; t < 2; t++)
+    {
+      const int x0 = ((first + t) % tiles_x) * valid - RADIUS;
+      const int y0 = ((first + t) / tiles_x) * valid - RADIUS;
+      for(int row = 0; row < SIZE; row++)
+        for(int col = 0; col < SIZE; col++)
+        {
+          const int r = y0 + row;
+          const int c = x0 + col;
+          z[t * nn + row * SIZE + col] = first + t < tiles && r >= 0 && r < height && c >= 0 && c < width
+                                         ? img[(size_t)r * width + c]
+                                         : 0.0f;
+        }
+    }
+    dt_fft_2d(fft, z, FALSE);
+    for(size_t k = 0; k < nn; k++)
+    {
+      z[k] *= psf[k];
+      z[k + nn] *= psf[k];
+    }
+    dt_fft_2d(fft, z, TRUE);
+    for(int t = 0; t < 2 && first + t < tiles; t++)
+    {
+      const int x0 = ((first + t) % tiles_x) * valid;
+      const int y0 = ((first + t) / tiles_x) * valid;
+      for(int row = y0; row < MIN(y0 + valid, height); row++)
+        for(int col = x0; col < MIN(x0 + valid, width); col++)
+          out[(size_t)row * width + col] = z[t * nn + (row - y0 + RADIUS) * SIZE + col - x0 + RADIUS];
+    }
+  }
+  dt_free_align(zbuf);
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const size_t nn = (size_t)SIZE * SIZE;
+  dt_fft_t *fft = dt_fft_new(SIZE);
+  float *img = dt_alloc_align_float((size_t)width * height);
+  float *ref = dt_alloc_align_float((size_t)width * height);
+  float *res = dt_alloc_align_float((size_t)width * height);
+  float *psf = dt_alloc_align_float(nn);
+  float *scratch = dt_alloc_align_float(2 * nn);
+  if(!fft || !img || !ref || !res || !psf || !scratch)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  unsigned int seed = 7;
+  for(size_t k = 0; k < (size_t)width * height; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    img[k] = (float)(seed >> 8) / (float)(1 << 24);
+  }
+
+  // the gaussian of capture sharpening's largest kernel
+  float coeffs[(RADIUS + 1) * (RADIUS + 1)];
+  const float sigma = 1.6f;
+  float sum = 0.0f;
+  for(int y = -RADIUS; y <= RADIUS; y++)
+    for(int x = -RADIUS; x <= RADIUS; x++)
+      sum += expf(-(x * x + y * y) / (2.0f * sigma * sigma));
+  for(int y = 0; y <= RADIUS; y++)
+    for(int x = 0; x <= RADIUS; x++)
+      coeffs[y * (RADIUS + 1) + x] = expf(-(x * x + y * y) / (2.0f * sigma * sigma)) / sum;
+  dt_fft_symmetric_kernel(fft, coeffs, RADIUS, RADIUS + 1, psf, scratch);
+
+  for(int run = 0; run < 3; run++)
+  {
+    double start = dt_get_wtime();
+    _spatial(img, ref, coeffs, width, height);
+    const double t_spatial = dt_get_wtime() - start;
+
+    start = dt_get_wtime();
+    _overlap_save(fft, img, res, psf, width, height);
+    const double t_fft = dt_get_wtime() - start;
+
+    float max_err = 0.0f;
+    for(size_t k = 0; k < (size_t)width * height; k++)
+      max_err = fmaxf(max_err, fabsf(res[k] - ref[k]));
+    printf("%dx%d convolution: spatial %.3fs, fft %.3fs on %d tiles, max difference %g\n",
+           width, height, t_spatial, t_fft, SIZE, max_err);
+  }
+
+  dt_free_align(img);
+  dt_free_align(ref);
+  dt_free_align(res);
+  dt_free_align(psf);
+  dt_free_align(scratch);
+  dt_fft_free(fft);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
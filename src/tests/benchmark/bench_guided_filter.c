@@ -0,0 +1,106 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of mask feathering with the guided filter in common/guided_filter.c,
+ * the fast downsampled filter against the full resolution one for the windows
+ * and subsampling used by blend.c
+ *
+ * usage: bench_guided_filter [width] [height]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/darktable.h"
+#include "common/guided_filter.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const size_t npixels = (size_t)width * height;
+  float *guide = dt_alloc_align_float(4 * npixels);
+  float *mask = dt_alloc_align_float(npixels);
+  float *full = dt_alloc_align_float(npixels);
+  float *fast = dt_alloc_align_float(npixels);
+  if(!guide || !mask || !full || !fast)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  // a bright disc on a textured background and a slightly offset hard mask
+  unsigned int seed = 1;
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      const size_t k = (size_t)y * width + x;
+      const float dx = x - width / 2, dy = y - height / 2;
+      seed = seed * 1103515245u + 12345u;
+      const float noise = 0.01f * (seed >> 16) / 65536.0f;
+      for(int c = 0; c < 3; c++)
+        guide[4 * k + c] = (sqrtf(dx * dx + dy * dy) < 0.3f * height ? 0.7f : 0.2f)
+                           + 0.05f * c + 0.02f * sinf(0.1f * x + c) + noise;
+      guide[4 * k + 3] = 0.0f;
+      mask[k] = sqrtf((dx - 10) * (dx - 10) + (dy + 5) * (dy + 5)) < 0.28f * height ? 1.0f : 0.0f;
+    }
+
+  // feathering of rgb masks as done by blend.c
+  const float sqrt_eps = 0.5f;
+  const float guide_weight = 10.0f;
+  const int windows[] = { 16, 40, 64, 128, 256 };
+  for(int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+  {
+    const int w = windows[i];
+    const int subsample = MIN(w / 8, 8);
+    for(int run = 0; run < 3; run++)
+    {
+      double start = dt_get_wtime();
+      guided_filter(guide, mask, full, width, height, 4, w, sqrt_eps, guide_weight, 0.0f, 1.0f);
+      const double t_full = dt_get_wtime() - start;
+
+      start = dt_get_wtime();
+      fast_guided_filter(guide, mask, fast, width, height, 4, w, sqrt_eps, guide_weight, 0.0f, 1.0f, subsample);
+      const double t_fast = dt_get_wtime() - start;
+
+      double sum = 0.0;
+      for(size_t k = 0; k < npixels; k++) sum += fabsf(full[k] - fast[k]);
+      printf("guided filter %dx%d w=%d subsample %d: full %.3fs, fast %.3fs, mean difference %.4f\n",
+             width, height, w, subsample, t_full, t_fast, sum / npixels);
+    }
+  }
+
+  dt_free_align(guide);
+  dt_free_align(mask);
+  dt_free_align(full);
+  dt_free_align(fast);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,116 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the solvers of the heal tool in common/heal.c: time and
+ * final residual of SOR and multigrid for a round spot
+ *
+ * usage: bench_heal [size] [max_iter]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "common/darktable.h"
+#include "common/heal.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// sum of the squared residuals of the laplace equation on the masked pixels of dest - src
+static double _residual(const float *const src, const float *const dest,
+                        const float *const mask, const int size)
+{
+  double err = 0.0;
+  for(int y = 1; y < size - 1; y++)
+    for(int x = 1; x < size - 1; x++)
+    {
+      if(mask[(size_t)y * size + x] == 0.0f) continue;
+      for(int c = 0; c < 3; c++)
+      {
+#define D(xx, yy) (dest[4 * ((size_t)(yy) * size + (xx)) + c] - src[4 * ((size_t)(yy) * size + (xx)) + c])
+        const double r = 4.0 * D(x, y) - D(x - 1, y) - D(x + 1, y) - D(x, y - 1) - D(x, y + 1);
+#undef D
+        err += r * r;
+      }
+    }
+  return err;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int size = argc > 1 ? atoi(argv[1]) : 1000;
+  const int max_iter = argc > 2 ? atoi(argv[2]) : 2000;
+  if(size < 16 || max_iter < 1)
+  {
+    fprintf(stderr, "usage: %s [size >= 16] [max_iter]\n", argv[0]);
+    return 1;
+  }
+
+  const size_t npixels = (size_t)size * size;
+  float *mask = dt_calloc_align_float(npixels);
+  float *src = dt_alloc_align_float(4 * npixels);
+  float *init = dt_alloc_align_float(4 * npixels);
+  float *dest = dt_alloc_align_float(4 * npixels);
+  if(!mask || !src || !init || !dest)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  for(int y = 0; y < size; y++)
+    for(int x = 0; x < size; x++)
+    {
+      const float r = sqrtf((x - size / 2) * (x - size / 2) + (y - size / 2) * (y - size / 2));
+      mask[(size_t)y * size + x] = r < 0.4f * size ? 1.0f : 0.0f;
+      const size_t k = 4 * ((size_t)y * size + x);
+      for(int c = 0; c < 4; c++)
+      {
+        src[k + c] = 0.3f + 0.2f * sinf(0.05f * x + c) * cosf(0.031f * y);
+        init[k + c] = 0.5f + 0.1f * sinf(0.013f * (c + 1) * x) + 0.05f * cosf(0.02f * y + 0.01f * x);
+      }
+    }
+
+  const char *names[] = { "SOR", "multigrid" };
+  const dt_heal_solver_t solvers[] = { DT_HEAL_SOLVER_SOR, DT_HEAL_SOLVER_MULTIGRID };
+  for(int s = 0; s < 2; s++)
+  {
+    memcpy(dest, init, sizeof(float) * 4 * npixels);
+    const double start = dt_get_wtime();
+    dt_heal(src, dest, mask, size, size, 4, max_iter, solvers[s]);
+    const double time = dt_get_wtime() - start;
+    printf("heal %dx%d %-9s %8.3fs, residual %g\n", size, size, names[s], time,
+           _residual(src, dest, mask, size));
+  }
+
+  dt_free_align(mask);
+  dt_free_align(src);
+  dt_free_align(init);
+  dt_free_align(dest);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,210 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the tetrahedral interpolation of the lut 3D module in iop/lut3d.c with
+ * 33³ and 65³ luts, the block-wise version of the module against the former version
+ * with one branch per tetrahedron
+ *
+ * usage: bench_lut3d [width] [height]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "iop/lut3d.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// the interpolation before it was done block-wise
+static void _branched_tetrahedral(const float *const in,
+                                  float *const out,
+                                  const size_t pixel_nb,
+                                  const float *const restrict clut,
+                                  const uint16_t level)
+{
+  const size_t level2 = level * level;
+  const size_t level1_stride = 3 * level;
+  const size_t level2_stride = 3 * level2;
+  const size_t level12_stride = 3 * (level + level2);
+  const float flevel_1 = (float)(level - 1);
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  {
+    const float *const input = in + k;
+    float *const output = ((float *const)out) + k;
+
+    dt_aligned_pixel_t rgbi;
+    dt_aligned_pixel_t rgbd;
+    for_each_channel(c)
+      rgbd[c] = CLIP(input[c]) * flevel_1;
+
+    for_each_channel(c)
+    {
+      rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
+      rgbd[c] = rgbd[c] - rgbi[c]; // delta red/green/blue
+    }
+
+  // indexes of P000 to P111 in clut
+    const size_t color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
+    const size_t i000 = color * 3;                     // P000
+    const size_t i100 = i000 + 3;                      // P100
+    const size_t i010 = i000 + level1_stride;          // P010
+    const size_t i110 = i010 + 3;                      // P110
+    const size_t i001 = i000 + level2_stride;          // P001
+    const size_t i101 = i001 + 3;                      // P101
+    const size_t i011 = i000 + level12_stride;         // P011
+    const size_t i111 = i011 + 3;                      // P111
+
+    if(rgbd[0] > rgbd[1])
+    {
+      if(rgbd[1] > rgbd[2])
+      {
+        // rgbd[0] > rgbd[1] > rgbd[2]
+        for_each_channel(c, aligned(output))
+          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[1])*clut[i100+c]
+                      + (rgbd[1]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
+      }
+      else if(rgbd[0] > rgbd[2])
+      {
+        // rgbd[0] > rgbd[2] >= rgbd[1]
+        for_each_channel(c, aligned(output))
+          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[2])*clut[i100+c]
+                      + (rgbd[2]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
+      }
+      else
+      {
+        // rgbd[2] >= rgbd[0] > rgbd[2]
+        for_each_channel(c, aligned(output))
+          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[0])*clut[i001+c]
+                      + (rgbd[0]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
+      }
+    }
+    else
+    {
+      if(rgbd[2] > rgbd[1])
+      {
+        // rgbd[2] > rgbd[1] >= rgbd[0]
+        for_each_channel(c, aligned(output))
+          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[1])*clut[i001+c]
+                      + (rgbd[1]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
+      }
+      else if(rgbd[2] > rgbd[0])
+      {
+        // rgbd[1] >= rgbd[2] > rgbd[0]
+        for_each_channel(c, aligned(output))
+          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[2])*clut[i010+c]
+                      + (rgbd[2]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
+      }
+      else
+      {
+        // rgbd[1] >= rgbd[0] >= rgbd[2]
+        for_each_channel(c, aligned(output))
+          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[0])*clut[i010+c]
+                      + (rgbd[0]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
+      }
+    }
+    // not using non-temporal writes here, as those are substantially slower when in==out....
+    // (which is the case when performing a colorspace conversion)
+  }
+}
+
+// a lut with some curvature, padded as the branched version reads a fourth channel
+static float *_make_clut(const uint16_t level)
+{
+  const size_t size = (size_t)level * level * level;
+  float *clut = dt_calloc_align_float(3 * size + 1);
+  if(!clut) return NULL;
+  for(size_t k = 0; k < size; k++)
+  {
+    const float r = (float)(k % level) / (level - 1);
+    const float g = (float)((k / level) % level) / (level - 1);
+    const float b = (float)(k / ((size_t)level * level)) / (level - 1);
+    clut[3*k]   = sqrtf(r) * (0.9f + 0.1f * b);
+    clut[3*k+1] = g * g + 0.05f * r;
+    clut[3*k+2] = 0.5f * (b + r * g);
+  }
+  return clut;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const size_t npixels = (size_t)width * height;
+  float *in = dt_alloc_align_float(4 * npixels);
+  float *out = dt_alloc_align_float(4 * npixels);
+  float *clut33 = _make_clut(33);
+  float *clut65 = _make_clut(65);
+  if(!in || !out || !clut33 || !clut65)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  // smooth gradients with some noise like a photo, the tetrahedron changes from pixel to pixel
+  unsigned int seed = 42;
+  for(int row = 0; row < height; row++)
+    for(int col = 0; col < width; col++)
+    {
+      float *px = in + 4 * ((size_t)row * width + col);
+      float noise[3];
+      for(int c = 0; c < 3; c++)
+      {
+        seed = seed * 1103515245u + 12345u;
+        noise[c] = 0.02f * ((float)(seed >> 8) / (float)(1 << 24) - 0.5f);
+      }
+      px[0] = 0.5f + 0.45f * sinf(0.0011f * col + 0.0007f * row) + noise[0];
+      px[1] = 0.5f + 0.45f * sinf(0.0009f * row + 1.0f) + noise[1];
+      px[2] = 0.5f + 0.45f * cosf(0.0013f * (col - row)) + noise[2];
+      px[3] = 1.0f;
+    }
+
+  const uint16_t levels[2] = { 33, 65 };
+  const float *cluts[2] = { clut33, clut65 };
+  for(int l = 0; l < 2; l++)
+    for(int run = 0; run < 3; run++)
+    {
+      double start = dt_get_wtime();
+      _branched_tetrahedral(in, out, npixels, cluts[l], levels[l]);
+      const double branched = dt_get_wtime() - start;
+
+      start = dt_get_wtime();
+      _correct_pixel_tetrahedral(in, out, npixels, cluts[l], levels[l]);
+      const double blocks = dt_get_wtime() - start;
+
+      printf("%dx%d, lut %d³: branched %.4fs, blocks %.4fs\n", width, height, levels[l], branched, blocks);
+    }
+
+  dt_free_align(in);
+  dt_free_align(out);
+  dt_free_align(clut33);
+  dt_free_align(clut65);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,130 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the random dither noise, the counter based Philox generator
+ * of develop/noise_generator.h against the TEA chain along each row of
+ * common/tea.h
+ *
+ * usage: bench_noise [width] [height]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common/darktable.h"
+#include "common/tea.h"
+#include "develop/noise_generator.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define SEED 0xa341316cu
+
+static void _dither_tea(const float *const in,
+                        float *const out,
+                        const int width,
+                        const int height,
+                        const float dither)
+{
+  unsigned int *const tea_states = alloc_tea_states(dt_get_num_threads());
+
+  DT_OMP_PRAGMA(parallel default(firstprivate))
+  {
+    unsigned int *const tea_state = get_tea_state(tea_states, dt_get_thread_num());
+    DT_OMP_PRAGMA(for schedule(static))
+    for(int j = 0; j < height; j++)
+    {
+      const size_t k = (size_t)4 * width * j;
+      tea_state[0] = j * height;
+      for(int i = 0; i < width; i++)
+      {
+        encrypt_tea(tea_state);
+        const float dith = dither * tpdf(tea_state[0]);
+        for_each_channel(c)
+          out[k + 4 * i + c] = CLIP(in[k + 4 * i + c] + dith);
+      }
+    }
+  }
+  free_tea_states(tea_states);
+}
+
+static void _dither_philox(const float *const in,
+                           float *const out,
+                           const int width,
+                           const int height,
+                           const float dither)
+{
+  DT_OMP_FOR()
+  for(int j = 0; j < height; j++)
+  {
+    const size_t k = (size_t)4 * width * j;
+    for(int i = 0; i < width; i++)
+    {
+      const float dith = dither * tpdf((uint32_t)(philox2x32(i, j, SEED) >> 32));
+      for_each_channel(c)
+        out[k + 4 * i + c] = CLIP(in[k + 4 * i + c] + dith);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const size_t nfloats = (size_t)4 * width * height;
+  const float dither = 1.0f / 256.0f;
+  float *in = dt_alloc_align_float(nfloats);
+  float *out = dt_alloc_align_float(nfloats);
+  if(!in || !out)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  for(size_t k = 0; k < nfloats; k++)
+    in[k] = (float)(k % (4 * width)) / (4 * width);
+
+  for(int run = 0; run < 3; run++)
+  {
+    double start = dt_get_wtime();
+    _dither_tea(in, out, width, height, dither);
+    const double t_tea = dt_get_wtime() - start;
+
+    start = dt_get_wtime();
+    _dither_philox(in, out, width, height, dither);
+    const double t_philox = dt_get_wtime() - start;
+
+    printf("random dither %dx%d: tea %.3fs, philox %.3fs\n", width, height, t_tea, t_philox);
+  }
+
+  dt_free_align(in);
+  dt_free_align(out);
+  return 0;
+}
+
+#undef SEED
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
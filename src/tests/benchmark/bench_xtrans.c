@@ -0,0 +1,99 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * benchmark of the Markesteijn X-Trans demosaicer in iop/demosaicing/xtrans.c
+ * with one and three passes
+ *
+ * usage: bench_xtrans [width] [height]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// xtrans.c is part of the demosaic module
+#include "iop/demosaic.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// amaze is C++ and not needed here
+void amaze_demosaic(const float *const in,
+                    float *out,
+                    const int width,
+                    const int height,
+                    const uint32_t filters,
+                    const float procmin)
+{
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+  const int width = argc > 1 ? atoi(argv[1]) : 6000;
+  const int height = argc > 2 ? atoi(argv[2]) : 4000;
+  const size_t npixels = (size_t)width * height;
+  static const uint8_t xtrans[6][6] = { { 1, 1, 0, 1, 1, 2 },
+                                        { 1, 1, 2, 1, 1, 0 },
+                                        { 2, 0, 1, 0, 2, 1 },
+                                        { 1, 1, 2, 1, 1, 0 },
+                                        { 1, 1, 0, 1, 1, 2 },
+                                        { 0, 2, 1, 2, 0, 1 } };
+  float *in = dt_alloc_align_float(npixels);
+  float *out = dt_alloc_align_float(4 * npixels);
+  if(!in || !out)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  unsigned int seed = 11;
+  for(int row = 0; row < height; row++)
+    for(int col = 0; col < width; col++)
+    {
+      seed = seed * 1103515245u + 12345u;
+      in[(size_t)row * width + col] = 0.5f + 0.4f * sinf(col * 0.01f) * cosf(row * 0.007f)
+                                      + 0.1f * (float)(seed >> 8) / (float)(1 << 24);
+    }
+
+  for(int run = 0; run < 3; run++)
+  {
+    double start = dt_get_wtime();
+    xtrans_markesteijn_interpolate(out, in, width, height, xtrans, 1);
+    const double t_one = dt_get_wtime() - start;
+
+    start = dt_get_wtime();
+    xtrans_markesteijn_interpolate(out, in, width, height, xtrans, 3);
+    const double t_three = dt_get_wtime() - start;
+
+    printf("markesteijn %dx%d: 1 pass %.3fs (%.1f Mpix/s), 3 passes %.3fs (%.1f Mpix/s)\n",
+           width, height, t_one, 1e-6 * npixels / t_one, t_three, 1e-6 * npixels / t_three);
+  }
+
+  dt_free_align(in);
+  dt_free_align(out);
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,121 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the euclidean distance transform in common/distance_transform.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/distance_transform.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// odd sizes so the last column tile is a partial one
+#define WIDTH 203
+#define HEIGHT 117
+#define SEEDS 40
+
+/*
+ * HELPERS
+ */
+
+static float _brute_force(const uint32_t *const seeds, const int x, const int y)
+{
+  float best = DT_DISTANCE_TRANSFORM_MAX;
+  for(int j = 0; j < HEIGHT; j++)
+    for(int i = 0; i < WIDTH; i++)
+      if(seeds[j * WIDTH + i])
+        best = fminf(best, sqrtf((float)((x - i) * (x - i) + (y - j) * (y - j))));
+  return best;
+}
+
+// nonzero at the seeds: single pixels and a rectangle
+static uint32_t *_make_seeds(void)
+{
+  uint32_t *seeds = dt_calloc_aligned(sizeof(uint32_t) * WIDTH * HEIGHT);
+  srand(42);
+  for(int k = 0; k < SEEDS; k++)
+    seeds[(rand() % HEIGHT) * WIDTH + rand() % WIDTH] = k + 1;
+  // and a larger area
+  for(int y = 50; y < 70; y++)
+    for(int x = 20; x < 60; x++)
+      seeds[y * WIDTH + x] = SEEDS + 1;
+  return seeds;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_distance_transform(void **state)
+{
+  uint32_t *seeds = _make_seeds();
+  float *src = dt_alloc_align_float(WIDTH * HEIGHT);
+  float *out = dt_alloc_align_float(WIDTH * HEIGHT);
+  for(int i = 0; i < WIDTH * HEIGHT; i++)
+    src[i] = seeds[i] ? 0.0f : 1.0f;
+
+  const float max_distance = dt_image_distance_transform(src, out, WIDTH, HEIGHT, 0.5f,
+                                                         DT_DISTANCE_TRANSFORM_MASK);
+  float max_brute = 0.0f;
+  for(int y = 0; y < HEIGHT; y++)
+    for(int x = 0; x < WIDTH; x++)
+    {
+      const float d = _brute_force(seeds, x, y);
+      assert_float_equal(out[y * WIDTH + x], d, 1e-3f * d + 1e-4f);
+      max_brute = fmaxf(max_brute, d);
+    }
+  assert_float_equal(max_distance, max_brute, 1e-3f * max_brute);
+
+  dt_free_align(seeds);
+  dt_free_align(src);
+  dt_free_align(out);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_distance_transform),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
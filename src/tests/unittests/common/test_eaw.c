@@ -0,0 +1,152 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the denoising wavelets in common/eaw.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/eaw.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 301
+#define HEIGHT 187
+#define SCALES 5
+
+/*
+ * HELPERS
+ */
+
+static void _make_image(float *const img)
+{
+  unsigned int seed = 11;
+  for(size_t k = 0; k < (size_t)4 * WIDTH * HEIGHT; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    // a gradient with noise
+    img[k] = (float)(k % (4 * WIDTH)) / (4 * WIDTH) + (float)(seed >> 8) / (float)(1 << 24);
+  }
+}
+
+static void _threshold(dt_aligned_pixel_t thrs,
+                       const dt_aligned_pixel_t sum_y2)
+{
+  for_four_channels(c)
+    thrs[c] = 0.5f * sqrtf(sum_y2[c] / ((float)WIDTH * HEIGHT));
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// decomposing with stored detail bands and synthesizing them separately
+// gives the same result as the fused scales of denoiseprofile
+static void test_eaw_dn_fused(void **state)
+{
+  const size_t nfloats = (size_t)4 * WIDTH * HEIGHT;
+  const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
+  float *img = dt_alloc_align_float(nfloats);
+  float *detail = dt_alloc_align_float(nfloats);
+  float *ref = dt_alloc_align_float(nfloats);
+  float *res = dt_alloc_align_float(nfloats);
+  float *a = dt_alloc_align_float(nfloats);
+  float *b = dt_alloc_align_float(nfloats);
+  _make_image(img);
+
+  // reference: separate passes
+  memcpy(a, img, sizeof(float) * nfloats);
+  memset(ref, 0, sizeof(float) * nfloats);
+  float *buf1 = a, *buf2 = b;
+  dt_aligned_pixel_t ref_sum[SCALES];
+  for(int scale = 0; scale < SCALES; scale++)
+  {
+    dt_aligned_pixel_t thrs;
+    eaw_dn_decompose(buf2, buf1, detail, ref_sum[scale], scale, 1.0f, WIDTH, HEIGHT);
+    _threshold(thrs, ref_sum[scale]);
+    eaw_synthesize(ref, ref, detail, thrs, boost, WIDTH, HEIGHT);
+    float *t = buf1;
+    buf1 = buf2;
+    buf2 = t;
+  }
+  for(size_t k = 0; k < nfloats; k++)
+    ref[k] += buf1[k];
+
+  // fused: no detail bands and no cleared accumulator
+  memcpy(a, img, sizeof(float) * nfloats);
+  buf1 = a;
+  buf2 = b;
+  dt_aligned_pixel_t thrs = { 0.0f, 0.0f, 0.0f, 0.0f };
+  for(int scale = 0; scale < SCALES; scale++)
+  {
+    dt_aligned_pixel_t sum_y2;
+    eaw_dn_decompose_and_synthesize(buf2, buf1, res, thrs, boost, sum_y2, scale, 1.0f, WIDTH, HEIGHT);
+    for(int c = 0; c < 3; c++)
+      assert_float_equal(sum_y2[c], ref_sum[scale][c], 1e-6f * ref_sum[scale][c]);
+    _threshold(thrs, sum_y2);
+    float *t = buf1;
+    buf1 = buf2;
+    buf2 = t;
+  }
+  eaw_dn_synthesize_residue(res, buf2, buf1, thrs, boost, SCALES - 1, WIDTH, HEIGHT);
+
+  float max_err = 0.0f;
+  for(size_t k = 0; k < nfloats; k++)
+    max_err = fmaxf(max_err, fabsf(res[k] - ref[k]));
+  assert_true(max_err < 1e-6f);
+
+  dt_free_align(img);
+  dt_free_align(detail);
+  dt_free_align(ref);
+  dt_free_align(res);
+  dt_free_align(a);
+  dt_free_align(b);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_eaw_dn_fused),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
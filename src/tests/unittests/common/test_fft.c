@@ -0,0 +1,211 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the tile FFT in common/fft.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/fft.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 700
+#define HEIGHT 500
+#define SIZE 128
+#define RADIUS 4
+
+/*
+ * HELPERS
+ */
+
+static void _make_image(float *const img)
+{
+  unsigned int seed = 7;
+  for(size_t k = 0; k < (size_t)WIDTH * HEIGHT; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    img[k] = (float)(seed >> 8) / (float)(1 << 24);
+  }
+}
+
+// a truncated gaussian quadrant as used by capture sharpening
+static void _make_kernel(float *const coeffs, const float sigma)
+{
+  float sum = 0.0f;
+  for(int y = -RADIUS; y <= RADIUS; y++)
+    for(int x = -RADIUS; x <= RADIUS; x++)
+      sum += expf(-(x * x + y * y) / (2.0f * sigma * sigma));
+  for(int y = 0; y <= RADIUS; y++)
+    for(int x = 0; x <= RADIUS; x++)
+      coeffs[y * (RADIUS + 1) + x] = expf(-(x * x + y * y) / (2.0f * sigma * sigma)) / sum;
+}
+
+// spatial reference, zero outside of the image
+static float _convolve_pixel(const float *const img,
+                             const float *const coeffs,
+                             const int row,
+                             const int col)
+{
+  float val = 0.0f;
+  for(int y = -RADIUS; y <= RADIUS; y++)
+    for(int x = -RADIUS; x <= RADIUS; x++)
+    {
+      const int r = row + y;
+      const int c = col + x;
+      if(r >= 0 && r < HEIGHT && c >= 0 && c < WIDTH)
+        val += coeffs[ABS(y) * (RADIUS + 1) + ABS(x)] * img[(size_t)r * WIDTH + c];
+    }
+  return val;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// forward and inverse transform reproduce the data
+static void test_fft_roundtrip(void **state)
+{
+  dt_fft_t *fft = dt_fft_new(SIZE);
+  assert_non_null(fft);
+  assert_null(dt_fft_new(100));
+
+  const size_t nn = (size_t)SIZE * SIZE;
+  float *data = dt_alloc_align_float(2 * nn);
+  float *orig = dt_alloc_align_float(2 * nn);
+  unsigned int seed = 3;
+  for(size_t k = 0; k < 2 * nn; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    orig[k] = data[k] = (float)(seed >> 8) / (float)(1 << 24) - 0.5f;
+  }
+
+  dt_fft_2d(fft, data, FALSE);
+  // the DC term is the sum
+  double sum = 0.0;
+  for(size_t k = 0; k < nn; k++) sum += orig[k];
+  assert_float_equal(data[0], sum, 1e-2);
+
+  dt_fft_2d(fft, data, TRUE);
+  for(size_t k = 0; k < 2 * nn; k++)
+    assert_float_equal(data[k], orig[k], 1e-5f);
+
+  dt_free_align(data);
+  dt_free_align(orig);
+  dt_fft_free(fft);
+}
+
+// overlap-save with two real tiles per complex transform is the spatial convolution,
+// this is the scheme of the capture sharpening fft backend
+static void test_fft_overlap_save(void **state)
+{
+  const int valid = SIZE - 2 * RADIUS;
+  const size_t nn = (size_t)SIZE * SIZE;
+  dt_fft_t *fft = dt_fft_new(SIZE);
+  float *img = dt_alloc_align_float((size_t)WIDTH * HEIGHT);
+  float *res = dt_alloc_align_float((size_t)WIDTH * HEIGHT);
+  float *psf = dt_alloc_align_float(nn);
+  float *z = dt_alloc_align_float(2 * nn);
+  float coeffs[(RADIUS + 1) * (RADIUS + 1)];
+  assert_non_null(fft);
+
+  _make_image(img);
+  _make_kernel(coeffs, 1.6f);
+  dt_fft_symmetric_kernel(fft, coeffs, RADIUS, RADIUS + 1, psf, z);
+
+  const int tiles_x = (WIDTH + valid - 1) / valid;
+  const int tiles = tiles_x * ((HEIGHT + valid - 1) / valid);
+  for(int first = 0; first < tiles; first += 2)
+  {
+    for(int t = 0; t < 2; t++)
+    {
+      const int x0 = ((first + t) % tiles_x) * valid - RADIUS;
+      const int y0 = ((first + t) / tiles_x) * valid - RADIUS;
+      for(int row = 0; row < SIZE; row++)
+        for(int col = 0; col < SIZE; col++)
+        {
+          const int r = y0 + row;
+          const int c = x0 + col;
+          z[t * nn + row * SIZE + col] = first + t < tiles && r >= 0 && r < HEIGHT && c >= 0 && c < WIDTH
+                                         ? img[(size_t)r * WIDTH + c]
+                                         : 0.0f;
+        }
+    }
+    dt_fft_2d(fft, z, FALSE);
+    for(size_t k = 0; k < nn; k++)
+    {
+      z[k] *= psf[k];
+      z[k + nn] *= psf[k];
+    }
+    dt_fft_2d(fft, z, TRUE);
+    for(int t = 0; t < 2 && first + t < tiles; t++)
+    {
+      const int x0 = ((first + t) % tiles_x) * valid;
+      const int y0 = ((first + t) / tiles_x) * valid;
+      for(int row = y0; row < MIN(y0 + valid, HEIGHT); row++)
+        for(int col = x0; col < MIN(x0 + valid, WIDTH); col++)
+          res[(size_t)row * WIDTH + col] = z[t * nn + (row - y0 + RADIUS) * SIZE + col - x0 + RADIUS];
+    }
+  }
+
+  float max_err = 0.0f;
+  for(int row = 0; row < HEIGHT; row++)
+    for(int col = 0; col < WIDTH; col++)
+      max_err = fmaxf(max_err, fabsf(res[(size_t)row * WIDTH + col] - _convolve_pixel(img, coeffs, row, col)));
+  assert_true(max_err < 1e-5f);
+
+  dt_free_align(img);
+  dt_free_align(res);
+  dt_free_align(psf);
+  dt_free_align(z);
+  dt_fft_free(fft);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_fft_roundtrip),
+    cmocka_unit_test(test_fft_overlap_save),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,154 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the fast guided filter in common/guided_filter.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/guided_filter.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 1200
+#define HEIGHT 800
+
+// parameters as used for feathering rgb masks
+#define SQRT_EPS 0.5f
+#define GUIDE_WEIGHT 10.0f
+
+/*
+ * HELPERS
+ */
+
+// a bright disc on a textured background as guide and a slightly offset hard mask, as
+// we get it from a parametric mask that doesn't follow the edge exactly
+static void _make_images(float *const guide, float *const mask)
+{
+  unsigned int seed = 1;
+  for(int y = 0; y < HEIGHT; y++)
+    for(int x = 0; x < WIDTH; x++)
+    {
+      const size_t k = (size_t)y * WIDTH + x;
+      const float r = sqrtf((x - WIDTH / 2) * (x - WIDTH / 2) + (y - HEIGHT / 2) * (y - HEIGHT / 2));
+      seed = seed * 1103515245u + 12345u;
+      const float noise = 0.01f * (seed >> 16) / 65536.0f;
+      for(int c = 0; c < 3; c++)
+        guide[4 * k + c] = (r < 0.3f * HEIGHT ? 0.7f : 0.2f) + 0.05f * c + 0.02f * sinf(0.1f * x + c) + noise;
+      guide[4 * k + 3] = 0.0f;
+      const float rm = sqrtf((x - WIDTH / 2 - 10) * (x - WIDTH / 2 - 10) + (y - HEIGHT / 2 + 5) * (y - HEIGHT / 2 + 5));
+      mask[k] = rm < 0.28f * HEIGHT ? 1.0f : 0.0f;
+    }
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// without subsampling the fast variant is the regular guided filter
+static void test_guided_filter_identity(void **state)
+{
+  const size_t npixels = (size_t)WIDTH * HEIGHT;
+  float *guide = dt_alloc_align_float(4 * npixels);
+  float *mask = dt_alloc_align_float(npixels);
+  float *full = dt_alloc_align_float(npixels);
+  float *fast = dt_alloc_align_float(npixels);
+  _make_images(guide, mask);
+
+  guided_filter(guide, mask, full, WIDTH, HEIGHT, 4, 8, SQRT_EPS, GUIDE_WEIGHT, 0.0f, 1.0f);
+  fast_guided_filter(guide, mask, fast, WIDTH, HEIGHT, 4, 8, SQRT_EPS, GUIDE_WEIGHT, 0.0f, 1.0f, 1);
+  for(size_t k = 0; k < npixels; k++)
+    assert_float_equal(full[k], fast[k], 0.0f);
+
+  dt_free_align(guide);
+  dt_free_align(mask);
+  dt_free_align(full);
+  dt_free_align(fast);
+}
+
+// the downsampled filter must be visually equivalent for the windows and subsampling
+// used for feathering
+static void test_guided_filter_fast(void **state)
+{
+  const int windows[] = { 16, 40, 64, 128 };
+  const size_t npixels = (size_t)WIDTH * HEIGHT;
+  float *guide = dt_alloc_align_float(4 * npixels);
+  float *mask = dt_alloc_align_float(npixels);
+  float *full = dt_alloc_align_float(npixels);
+  float *fast = dt_alloc_align_float(npixels);
+  _make_images(guide, mask);
+
+  for(int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+  {
+    const int w = windows[i];
+    const int subsample = MIN(w / 8, 8);
+
+    guided_filter(guide, mask, full, WIDTH, HEIGHT, 4, w, SQRT_EPS, GUIDE_WEIGHT, 0.0f, 1.0f);
+    fast_guided_filter(guide, mask, fast, WIDTH, HEIGHT, 4, w, SQRT_EPS, GUIDE_WEIGHT, 0.0f, 1.0f, subsample);
+
+    double sum = 0.0, worst = 0.0;
+    for(size_t k = 0; k < npixels; k++)
+    {
+      const double diff = fabs(full[k] - fast[k]);
+      sum += diff;
+      worst = fmax(worst, diff);
+    }
+    // differences of a mask below 1/255 on average and below 0.1 at the edges are not visible
+    assert_true(sum / npixels < 1.0 / 255.0);
+    assert_true(worst < 0.1);
+  }
+
+  dt_free_align(guide);
+  dt_free_align(mask);
+  dt_free_align(full);
+  dt_free_align(fast);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_guided_filter_identity),
+    cmocka_unit_test(test_guided_filter_fast),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
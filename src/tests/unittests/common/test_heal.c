@@ -0,0 +1,178 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the solvers of the heal tool in common/heal.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/heal.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define SIZE 400
+#define MAX_ITER 2000
+
+/*
+ * HELPERS
+ */
+
+// round spot in the middle of the image, not touching the borders
+static float *_make_mask(const int size)
+{
+  float *mask = dt_calloc_align_float((size_t)size * size);
+  for(int y = 0; y < size; y++)
+    for(int x = 0; x < size; x++)
+    {
+      const float r = sqrtf((x - size / 2) * (x - size / 2) + (y - size / 2) * (y - size / 2));
+      mask[(size_t)y * size + x] = r < 0.4f * size ? 1.0f : 0.0f;
+    }
+  return mask;
+}
+
+// sum of the squared residuals of the laplace equation on the masked pixels of dest - src
+static double _residual(const float *const src, const float *const dest,
+                        const float *const mask, const int size)
+{
+  double err = 0.0;
+  for(int y = 1; y < size - 1; y++)
+    for(int x = 1; x < size - 1; x++)
+    {
+      if(mask[(size_t)y * size + x] == 0.0f) continue;
+      for(int c = 0; c < 3; c++)
+      {
+#define D(xx, yy) (dest[4 * ((size_t)(yy) * size + (xx)) + c] - src[4 * ((size_t)(yy) * size + (xx)) + c])
+        const double r = 4.0 * D(x, y) - D(x - 1, y) - D(x + 1, y) - D(x, y - 1) - D(x, y + 1);
+#undef D
+        err += r * r;
+      }
+    }
+  return err;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// a linear ramp is harmonic, both solvers have to reconstruct it from the border of the spot
+static void test_heal_linear(void **state)
+{
+  const dt_heal_solver_t solvers[] = { DT_HEAL_SOLVER_SOR, DT_HEAL_SOLVER_MULTIGRID };
+  const size_t npixels = (size_t)SIZE * SIZE;
+  float *mask = _make_mask(SIZE);
+  float *src = dt_calloc_align_float(4 * npixels);
+  float *dest = dt_alloc_align_float(4 * npixels);
+
+  for(int s = 0; s < 2; s++)
+  {
+    for(int y = 0; y < SIZE; y++)
+      for(int x = 0; x < SIZE; x++)
+      {
+        const size_t k = (size_t)y * SIZE + x;
+        for(int c = 0; c < 4; c++)
+          dest[4 * k + c] = mask[k] != 0.0f ? 1.0f : 0.2f + 0.001f * x + 0.0005f * (c + 1) * y;
+      }
+
+    dt_heal(src, dest, mask, SIZE, SIZE, 4, MAX_ITER, solvers[s]);
+
+    for(int y = 0; y < SIZE; y++)
+      for(int x = 0; x < SIZE; x++)
+      {
+        const size_t k = (size_t)y * SIZE + x;
+        for(int c = 0; c < 3; c++)
+          assert_float_equal(dest[4 * k + c], 0.2f + 0.001f * x + 0.0005f * (c + 1) * y, 2e-3f);
+      }
+  }
+
+  dt_free_align(mask);
+  dt_free_align(src);
+  dt_free_align(dest);
+}
+
+// both solvers converge to the same solution
+static void test_heal_solvers(void **state)
+{
+  const size_t npixels = (size_t)SIZE * SIZE;
+  float *mask = _make_mask(SIZE);
+  float *src = dt_alloc_align_float(4 * npixels);
+  float *sor = dt_alloc_align_float(4 * npixels);
+  float *mg = dt_alloc_align_float(4 * npixels);
+
+  for(int y = 0; y < SIZE; y++)
+    for(int x = 0; x < SIZE; x++)
+    {
+      const size_t k = 4 * ((size_t)y * SIZE + x);
+      for(int c = 0; c < 4; c++)
+      {
+        src[k + c] = 0.3f + 0.2f * sinf(0.05f * x + c) * cosf(0.031f * y);
+        sor[k + c] = mg[k + c] = 0.5f + 0.1f * sinf(0.013f * (c + 1) * x)
+                                 + 0.05f * cosf(0.02f * y + 0.01f * x);
+      }
+    }
+
+  dt_heal(src, sor, mask, SIZE, SIZE, 4, MAX_ITER, DT_HEAL_SOLVER_SOR);
+  dt_heal(src, mg, mask, SIZE, SIZE, 4, MAX_ITER, DT_HEAL_SOLVER_MULTIGRID);
+
+  const double r_mg = _residual(src, mg, mask, SIZE);
+
+  // the solvers stop once the residual drops below (0.1 of an 8 bit step)^2, allow for
+  // rounding differences between their residual and the one computed here
+  const double epsilon = 0.1 / 255.0;
+  assert_true(r_mg < 2.0 * epsilon * epsilon);
+  for(size_t k = 0; k < 4 * npixels; k++)
+    if(k % 4 != 3) assert_float_equal(sor[k], mg[k], 1e-3f);
+
+  dt_free_align(mask);
+  dt_free_align(src);
+  dt_free_align(sor);
+  dt_free_align(mg);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_heal_linear),
+    cmocka_unit_test(test_heal_solvers),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,162 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the sampled lcms transforms in common/icc_lut.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/icc_lut.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define NPIXELS 100000
+
+/*
+ * HELPERS
+ */
+
+// Lab pixels inside of the sRGB gamut away from black, where the sRGB curve is steepest
+static float *_make_Lab(cmsHTRANSFORM to_Lab, const size_t npixels)
+{
+  float *rgb = dt_alloc_align_float(4 * npixels);
+  float *Lab = dt_alloc_align_float(4 * npixels);
+  unsigned int seed = 42;
+  for(size_t k = 0; k < 4 * npixels; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    rgb[k] = 0.05f + 0.9f * (float)(seed >> 8) / (float)(1 << 24);
+  }
+  cmsDoTransform(to_Lab, rgb, Lab, npixels);
+  for(size_t k = 0; k < npixels; k++) Lab[4 * k + 3] = 0.5f;
+  dt_free_align(rgb);
+  return Lab;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// the interpolated transform stays close to lcms
+static void test_icc_lut_srgb(void **state)
+{
+  cmsHPROFILE srgb = cmsCreate_sRGBProfile();
+  cmsHPROFILE lab = cmsCreateLab4Profile(NULL);
+  cmsHTRANSFORM xform = cmsCreateTransform(lab, TYPE_LabA_FLT, srgb, TYPE_RGBA_FLT,
+                                           INTENT_PERCEPTUAL, 0);
+  cmsHTRANSFORM to_Lab = cmsCreateTransform(srgb, TYPE_RGBA_FLT, lab, TYPE_LabA_FLT,
+                                            INTENT_PERCEPTUAL, 0);
+  assert_non_null(xform);
+  assert_non_null(to_Lab);
+
+  // no profile and no hash, neither the accuracy report nor the disk cache
+  dt_icc_lut_t *lut = dt_icc_lut_new(xform, NULL, DT_INVALID_HASH, DT_ICC_LUT_SIZE);
+  assert_non_null(lut);
+  assert_int_equal(lut->size, DT_ICC_LUT_SIZE);
+
+  float *Lab = _make_Lab(to_Lab, NPIXELS);
+  float *ref = dt_alloc_align_float(4 * NPIXELS);
+  float *res = dt_alloc_align_float(4 * NPIXELS);
+
+  cmsDoTransform(xform, Lab, ref, NPIXELS);
+  dt_icc_lut_apply_Lab(lut, Lab, res, NPIXELS);
+
+  float max_err = 0.0f;
+  for(size_t k = 0; k < NPIXELS; k++)
+  {
+    for(int c = 0; c < 3; c++)
+      max_err = fmaxf(max_err, fabsf(ref[4 * k + c] - res[4 * k + c]));
+    assert_float_equal(res[4 * k + 3], 0.5f, 0.0f);
+  }
+  // less than half of an 8 bit step
+  assert_true(max_err < 0.5f / 255.0f);
+
+  dt_free_align(Lab);
+  dt_free_align(ref);
+  dt_free_align(res);
+  dt_icc_lut_free(lut);
+  cmsDeleteTransform(xform);
+  cmsDeleteTransform(to_Lab);
+  cmsCloseProfile(srgb);
+  cmsCloseProfile(lab);
+}
+
+// grid points are reproduced exactly
+static void test_icc_lut_nodes(void **state)
+{
+  cmsHPROFILE srgb = cmsCreate_sRGBProfile();
+  cmsHPROFILE lab = cmsCreateLab4Profile(NULL);
+  cmsHTRANSFORM xform = cmsCreateTransform(lab, TYPE_LabA_FLT, srgb, TYPE_RGBA_FLT,
+                                           INTENT_PERCEPTUAL, 0);
+  dt_icc_lut_t *lut = dt_icc_lut_new(xform, NULL, DT_INVALID_HASH, 9);
+  assert_non_null(lut);
+
+  const float nodes[][4] = { { 0.0f, -128.0f, -128.0f, 1.0f },
+                             { 50.0f, 0.0f, 0.0f, 1.0f },
+                             { 100.0f, 128.0f, 128.0f, 1.0f },
+                             { 62.5f, -32.0f, 96.0f, 1.0f } };
+  for(int n = 0; n < 4; n++)
+  {
+    float ref[4], res[4];
+    cmsDoTransform(xform, nodes[n], ref, 1);
+    dt_icc_lut_apply_Lab(lut, nodes[n], res, 1);
+    for(int c = 0; c < 3; c++) assert_float_equal(res[c], ref[c], 1e-5f);
+  }
+
+  dt_icc_lut_free(lut);
+  cmsDeleteTransform(xform);
+  cmsCloseProfile(srgb);
+  cmsCloseProfile(lab);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  // used to split the lcms transforms across threads
+  darktable.num_openmp_threads = 1;
+
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_icc_lut_nodes),
+    cmocka_unit_test(test_icc_lut_srgb),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
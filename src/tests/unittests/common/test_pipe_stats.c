@@ -0,0 +1,220 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the approximate statistics in common/pipe_stats.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/pipe_stats.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 3000
+#define HEIGHT 2000
+#define SAMPLES (1 << 16)
+#define DELTA 1e-3f
+
+/*
+ * HELPERS
+ */
+
+// smooth gradients with a bright corner and some noise, so the upper
+// quantiles come from a small part of the image
+static void _make_image(float *const img)
+{
+  unsigned int seed = 11;
+  for(int row = 0; row < HEIGHT; row++)
+    for(int col = 0; col < WIDTH; col++)
+    {
+      seed = seed * 1103515245u + 12345u;
+      const float x = (float)col / WIDTH;
+      const float y = (float)row / HEIGHT;
+      img[(size_t)row * WIDTH + col] = 0.3f * x + 0.2f * sinf(6.0f * y)
+                                       + expf(-20.0f * (x * x + y * y))
+                                       + 0.05f * (float)(seed >> 8) / (float)(1 << 24);
+    }
+}
+
+// fraction of values below v
+static double _rank(const float *const values, const size_t n, const float v)
+{
+  size_t below = 0;
+  for(size_t k = 0; k < n; k++) below += values[k] < v;
+  return (double)below / n;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// the samples are distinct pixels of the image, all of them if it's small
+static void test_pipe_stats_sample(void **state)
+{
+  size_t *idx = malloc(sizeof(size_t) * SAMPLES);
+  const size_t n = dt_pipe_stats_sample(WIDTH, HEIGHT, SAMPLES, idx);
+  assert_true(n <= SAMPLES && n > SAMPLES * 0.95);
+
+  uint8_t *hit = calloc((size_t)WIDTH * HEIGHT, 1);
+  for(size_t k = 0; k < n; k++)
+  {
+    assert_true(idx[k] < (size_t)WIDTH * HEIGHT);
+    assert_int_equal(hit[idx[k]], 0);
+    hit[idx[k]] = 1;
+  }
+  free(hit);
+
+  // reproducible
+  size_t *idx2 = malloc(sizeof(size_t) * SAMPLES);
+  assert_int_equal(dt_pipe_stats_sample(WIDTH, HEIGHT, SAMPLES, idx2), n);
+  assert_memory_equal(idx, idx2, sizeof(size_t) * n);
+
+  assert_int_equal(dt_pipe_stats_sample(200, 100, SAMPLES, idx), 200 * 100);
+  for(size_t k = 0; k < 200 * 100; k++) assert_int_equal(idx[k], k);
+
+  // very thin images and few samples stay within idx
+  const int sizes[][2] = { { 1, 1000000 }, { 1000000, 1 }, { 7, 300000 }, { WIDTH, HEIGHT } };
+  const size_t counts[] = { 1, 2, 3, 1000 };
+  for(int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    for(int j = 0; j < sizeof(counts) / sizeof(counts[0]); j++)
+    {
+      const int width = sizes[i][0];
+      const int height = sizes[i][1];
+      const size_t m = dt_pipe_stats_sample(width, height, counts[j], idx);
+      assert_in_range(m, 1, counts[j]);
+      for(size_t k = 0; k < m; k++)
+        assert_true(idx[k] < (size_t)width * height);
+    }
+  assert_int_equal(dt_pipe_stats_sample(1, 1000000, 0, idx), 0);
+
+  free(idx);
+  free(idx2);
+}
+
+// quantiles of the samples are within the documented rank error of the full
+// image quantiles, as is the mean of the values above a quantile
+static void test_pipe_stats_quantiles(void **state)
+{
+  const size_t size = (size_t)WIDTH * HEIGHT;
+  float *img = dt_alloc_align_float(size);
+  float *full = dt_alloc_align_float(size);
+  float *values = dt_alloc_align_float(SAMPLES);
+  size_t *idx = malloc(sizeof(size_t) * SAMPLES);
+  _make_image(img);
+
+  const size_t n = dt_pipe_stats_sample(WIDTH, HEIGHT, SAMPLES, idx);
+  const float eps = dt_pipe_stats_rank_error(n, DELTA);
+  assert_true(eps < 0.01f);
+
+  const float qs[] = { 0.05f, 0.5f, 0.9f, 0.95f, 0.99f };
+  for(int i = 0; i < sizeof(qs) / sizeof(qs[0]); i++)
+  {
+    for(size_t k = 0; k < n; k++) values[k] = img[idx[k]];
+    const float approx = dt_pipe_stats_quantile(values, n, qs[i]);
+    const double rank = _rank(img, size, approx);
+    assert_true(fabs(rank - qs[i]) <= eps);
+  }
+
+  // mean of the upper 5%, as the ambient light estimates of haze removal
+  for(size_t k = 0; k < n; k++) values[k] = img[idx[k]];
+  const float approx_crit = dt_pipe_stats_quantile(values, n, 0.95f);
+  memcpy(full, img, sizeof(float) * size);
+  const float exact_crit = dt_pipe_stats_quantile(full, size, 0.95f);
+  double approx_mean = 0.0, exact_mean = 0.0;
+  size_t approx_n = 0, exact_n = 0;
+  for(size_t k = 0; k < n; k++)
+    if(img[idx[k]] >= approx_crit)
+    {
+      approx_mean += img[idx[k]];
+      approx_n++;
+    }
+  for(size_t k = 0; k < size; k++)
+    if(img[k] >= exact_crit)
+    {
+      exact_mean += img[k];
+      exact_n++;
+    }
+  approx_mean /= approx_n;
+  exact_mean /= exact_n;
+  assert_float_equal(approx_mean, exact_mean, 0.01 * exact_mean);
+
+  dt_free_align(img);
+  dt_free_align(full);
+  dt_free_align(values);
+  free(idx);
+}
+
+// entries are found by key, the least recently used ones are dropped
+static void test_pipe_stats_cache(void **state)
+{
+  dt_pipe_stats_cache_t cache;
+  dt_pipe_stats_cache_init(&cache);
+  float values[2];
+
+  assert_false(dt_pipe_stats_cache_get(&cache, 1, values, 2));
+  for(int k = 1; k <= 20; k++)
+  {
+    const float v[2] = { k, -k };
+    dt_pipe_stats_cache_put(&cache, k, v, 2);
+    // keep the first one in use
+    assert_true(dt_pipe_stats_cache_get(&cache, 1, values, 2));
+    assert_float_equal(values[0], 1.0f, 0.0f);
+  }
+  assert_true(dt_pipe_stats_cache_get(&cache, 20, values, 2));
+  assert_float_equal(values[0], 20.0f, 0.0f);
+  assert_float_equal(values[1], -20.0f, 0.0f);
+  assert_false(dt_pipe_stats_cache_get(&cache, 2, values, 2));
+  assert_false(dt_pipe_stats_cache_get(&cache, DT_INVALID_HASH, values, 2));
+
+  dt_pipe_stats_cache_cleanup(&cache);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_pipe_stats_sample),
+    cmocka_unit_test(test_pipe_stats_quantiles),
+    cmocka_unit_test(test_pipe_stats_cache),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,519 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the à-trous wavelets processed in cache-sized stripes
+ * in common/dwt.c, common/eaw.c and common/bspline.h. Every scale is compared
+ * with a plain serial implementation of the former full image passes.
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/math.h"
+#include "control/control.h"
+#include "common/bspline.h"
+#include "common/dwt.h"
+#include "common/eaw.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 301
+#define HEIGHT 187
+#define SCALES 5
+// the eaw and B-spline kernels might be contracted differently by the compiler
+#define EPSILON 1e-6f
+
+typedef struct _layers_t
+{
+  float *layer[SCALES + 3];
+} _layers_t;
+
+static const float _bspline[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+
+/*
+ * HELPERS
+ */
+
+static float *_make_image(const int ch)
+{
+  const size_t nfloats = (size_t)ch * WIDTH * HEIGHT;
+  float *img = dt_alloc_align_float(nfloats);
+  unsigned int seed = 17;
+  for(size_t k = 0; k < nfloats; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    const size_t x = (k / ch) % WIDTH;
+    const size_t y = (k / ch) / WIDTH;
+    // a gradient with edges and noise
+    img[k] = (float)x / WIDTH + ((x / 40 + y / 30) % 2 ? 0.3f : 0.0f)
+             + 0.1f * (float)(seed >> 8) / (float)(1 << 24);
+  }
+  return img;
+}
+
+static float *_copy(const float *const img, const int ch)
+{
+  float *copy = dt_alloc_align_float((size_t)ch * WIDTH * HEIGHT);
+  memcpy(copy, img, sizeof(float) * ch * WIDTH * HEIGHT);
+  return copy;
+}
+
+static void _assert_near(const float *const a, const float *const b, const size_t n, const float eps)
+{
+  for(size_t k = 0; k < n; k++)
+    assert_float_equal(a[k], b[k], eps * MAX(1.0f, fabsf(b[k])));
+}
+
+static void _set_threads(const int threads)
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = threads;
+  omp_set_num_threads(threads);
+#endif
+}
+
+static int _max_threads(void)
+{
+#ifdef _OPENMP
+  return MAX(omp_get_num_procs(), 4);
+#else
+  return 1;
+#endif
+}
+
+static void _store_layer(float *layer, dwt_params_t *const p, const int scale)
+{
+  _layers_t *layers = p->user_data;
+  memcpy(layers->layer[scale], layer, sizeof(float) * 4 * p->width * p->height);
+}
+
+// the former full image passes of a dwt scale, 'in' is left with the details and 'out' gets the
+// coarse image
+static void _ref_dwt_scale(float *const out, float *const in, const int lev)
+{
+  const int vscale = MIN(1 << lev, HEIGHT - 1);
+  for(int row = 0; row < HEIGHT; row++)
+  {
+    const int above = abs(row - vscale);
+    const int below = row + vscale < HEIGHT ? row + vscale : 2 * (HEIGHT - 1) - (row + vscale);
+    for(int k = 0; k < 4 * WIDTH; k++)
+      out[4 * row * WIDTH + k] = 2.f * in[4 * row * WIDTH + k] + in[4 * above * WIDTH + k]
+                                 + in[4 * below * WIDTH + k];
+  }
+
+  const int hscale = MIN(1 << lev, WIDTH);
+  float *temp = dt_alloc_align_float(4 * WIDTH);
+  for(int row = 0; row < HEIGHT; row++)
+  {
+    float *coarse = out + 4 * row * WIDTH;
+    float *details = in + 4 * row * WIDTH;
+    for(int col = 0; col < WIDTH; col++)
+    {
+      const int left = abs(col - hscale);
+      const int right = col < WIDTH - hscale ? col + hscale : 2 * WIDTH - 2 - (col + hscale);
+      for(int c = 0; c < 4; c++)
+      {
+        const float hat = (2.f * coarse[4 * col + c] + coarse[4 * left + c] + coarse[4 * right + c]) / 16.f;
+        temp[4 * col + c] = hat;
+        details[4 * col + c] -= hat;
+      }
+    }
+    memcpy(coarse, temp, sizeof(float) * 4 * WIDTH);
+  }
+  dt_free_align(temp);
+}
+
+// the former single channel denoise passes of all bands
+static void _ref_dwt_denoise(float *const img, const float *const noise)
+{
+  float *accum = dt_calloc_align_float((size_t)WIDTH * HEIGHT);
+  float *coarse = dt_alloc_align_float((size_t)WIDTH * HEIGHT);
+  for(int lev = 0; lev < SCALES; lev++)
+  {
+    const int vscale = MIN(1 << lev, HEIGHT);
+    for(int row = 0; row < HEIGHT; row++)
+    {
+      const int above = abs(row - vscale);
+      const int below = row + vscale < HEIGHT ? row + vscale : 2 * (HEIGHT - 1) - (row + vscale);
+      for(int col = 0; col < WIDTH; col++)
+        coarse[row * WIDTH + col] = 2.f * img[row * WIDTH + col] + img[above * WIDTH + col]
+                                    + img[below * WIDTH + col];
+    }
+
+    const int hscale = MIN(1 << lev, WIDTH);
+    for(int row = 0; row < HEIGHT; row++)
+    {
+      const float *c = coarse + row * WIDTH;
+      float *details = img + row * WIDTH;
+      float *acc = accum + row * WIDTH;
+      for(int col = 0; col < WIDTH; col++)
+      {
+        const int left = abs(col - hscale);
+        const int right = col < WIDTH - hscale ? col + hscale : 2 * WIDTH - 2 - (col + hscale);
+        const float hat = (2.f * c[col] + c[left] + c[right]) / 16.f;
+        const float diff = details[col] - hat;
+        details[col] = hat;
+        acc[col] += MAX(diff - noise[lev], 0.0f) + MIN(diff + noise[lev], 0.0f);
+      }
+      if(lev == SCALES - 1)
+        for(int col = 0; col < WIDTH; col++)
+          details[col] += acc[col];
+    }
+  }
+  dt_free_align(accum);
+  dt_free_align(coarse);
+}
+
+static inline float _eaw_filter(const int jj, const int ii)
+{
+  return 16.0f * _bspline[jj] * _bspline[ii];
+}
+
+// edge-aware filter of the equalizer, one pixel after the other
+static void _ref_eaw(float *const out,
+                     const float *const in,
+                     float *const accum,
+                     const int scale,
+                     const float sharpen,
+                     const dt_aligned_pixel_t threshold,
+                     const dt_aligned_pixel_t boost)
+{
+  const int mult = 1 << scale;
+  const dt_aligned_pixel_t vsharpen = { -0.5f * sharpen, -sharpen, -sharpen, 0.0f };
+  for(int j = 0; j < HEIGHT; j++)
+    for(int i = 0; i < WIDTH; i++)
+    {
+      const float *px = in + 4 * ((size_t)j * WIDTH + i);
+      dt_aligned_pixel_t sum = { 0.0f }, wgt = { 0.0f };
+      for(int jj = 0; jj < 5; jj++)
+        for(int ii = 0; ii < 5; ii++)
+        {
+          const int y = CLAMP(j + mult * (jj - 2), 0, HEIGHT - 1);
+          const int x = CLAMP(i + mult * (ii - 2), 0, WIDTH - 1);
+          const float *px2 = in + 4 * ((size_t)y * WIDTH + x);
+          dt_aligned_pixel_t d, added, wp;
+          for_four_channels(c) d[c] = (px[c] - px2[c]) * (px[c] - px2[c]);
+          const dt_aligned_pixel_t swapped = { d[0], d[2], d[1], d[3] };
+          for_four_channels(c) added[c] = vsharpen[c] * (d[c] + swapped[c]);
+          dt_vector_exp(added, wp);
+          for_four_channels(c)
+          {
+            const float w = _eaw_filter(jj, ii) * wp[c];
+            wgt[c] += w;
+            sum[c] += w * px2[c];
+          }
+        }
+      for_four_channels(c)
+      {
+        const float coarse = sum[c] / wgt[c];
+        const float det = px[c] - coarse;
+        out[4 * ((size_t)j * WIDTH + i) + c] = coarse;
+        accum[4 * ((size_t)j * WIDTH + i) + c] +=
+          boost[c] * (MIN(det + threshold[c], 0.0f) + MAX(det - threshold[c], 0.0f));
+      }
+    }
+}
+
+// edge-aware filter of denoiseprofile, one pixel after the other
+static void _ref_eaw_dn(float *const out,
+                        const float *const in,
+                        float *const detail,
+                        dt_aligned_pixel_t sum_squared,
+                        const int scale,
+                        const float inv_sigma2)
+{
+  const int mult = 1 << scale;
+  for_four_channels(c) sum_squared[c] = 0.0f;
+  for(int j = 0; j < HEIGHT; j++)
+    for(int i = 0; i < WIDTH; i++)
+    {
+      const float *px = in + 4 * ((size_t)j * WIDTH + i);
+      dt_aligned_pixel_t sum = { 0.0f }, wgt = { 0.0f };
+      for(int jj = 0; jj < 5; jj++)
+        for(int ii = 0; ii < 5; ii++)
+        {
+          const int y = CLAMP(j + mult * (jj - 2), 0, HEIGHT - 1);
+          const int x = CLAMP(i + mult * (ii - 2), 0, WIDTH - 1);
+          const float *px2 = in + 4 * ((size_t)y * WIDTH + x);
+          float dot = 0.0f;
+          for(int c = 0; c < 3; c++) dot += (px[c] - px2[c]) * (px[c] - px2[c]);
+          const float w = _eaw_filter(jj, ii) * fast_mexp2f(MAX(0.0f, dot * inv_sigma2 * 0.02f - 9.0f));
+          for_four_channels(c)
+          {
+            wgt[c] += w;
+            sum[c] += w * px2[c];
+          }
+        }
+      for_four_channels(c)
+      {
+        const float coarse = sum[c] / wgt[c];
+        const float det = px[c] - coarse;
+        out[4 * ((size_t)j * WIDTH + i) + c] = coarse;
+        detail[4 * ((size_t)j * WIDTH + i) + c] = det;
+        sum_squared[c] += det * det;
+      }
+    }
+}
+
+// separable B-spline blur with the borders clamped, the vertical pass first
+static void _ref_bspline(float *const out, const float *const in, const int mult, const gboolean clip)
+{
+  float *temp = dt_alloc_align_float((size_t)4 * WIDTH * HEIGHT);
+  for(int j = 0; j < HEIGHT; j++)
+    for(int i = 0; i < WIDTH; i++)
+      for(int c = 0; c < 4; c++)
+      {
+        float v = 0.0f;
+        for(int k = 0; k < 5; k++)
+          v += _bspline[k] * in[4 * ((size_t)CLAMP(j + mult * (k - 2), 0, HEIGHT - 1) * WIDTH + i) + c];
+        temp[4 * ((size_t)j * WIDTH + i) + c] = clip ? MAX(0.0f, v) : v;
+      }
+  for(int j = 0; j < HEIGHT; j++)
+    for(int i = 0; i < WIDTH; i++)
+      for(int c = 0; c < 4; c++)
+      {
+        float v = 0.0f;
+        for(int k = 0; k < 5; k++)
+          v += _bspline[k] * temp[4 * ((size_t)j * WIDTH + CLAMP(i + mult * (k - 2), 0, WIDTH - 1)) + c];
+        out[4 * ((size_t)j * WIDTH + i) + c] = clip ? MAX(0.0f, v) : v;
+      }
+  dt_free_align(temp);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// every scale, the residual and the recomposed image of dwt_decompose() are bit-exact
+static void test_dwt_decompose(void **state)
+{
+  const size_t nfloats = (size_t)4 * WIDTH * HEIGHT;
+  float *img = _make_image(4);
+
+  // the reference layers: input, details, residual and recomposed image
+  float *ref[SCALES + 3];
+  ref[0] = _copy(img, 4);
+  float *cur = _copy(img, 4);
+  for(int lev = 0; lev < SCALES; lev++)
+  {
+    float *coarse = dt_alloc_align_float(nfloats);
+    _ref_dwt_scale(coarse, cur, lev);
+    ref[lev + 1] = cur;
+    cur = coarse;
+  }
+  ref[SCALES + 1] = cur;
+  ref[SCALES + 2] = dt_calloc_align_float(nfloats);
+  for(int s = 1; s <= SCALES + 1; s++)
+    for(size_t k = 0; k < nfloats; k++)
+      ref[SCALES + 2][k] += ref[s][k];
+
+  const int threads[] = { 1, _max_threads() };
+  for(int t = 0; t < 2; t++)
+  {
+    _set_threads(threads[t]);
+    _layers_t layers;
+    for(int s = 0; s < SCALES + 3; s++)
+      layers.layer[s] = dt_alloc_align_float(nfloats);
+
+    float *out = _copy(img, 4);
+    dwt_params_t *p = dt_dwt_init(out, WIDTH, HEIGHT, 4, SCALES, 0, 0, &layers, 1.0f);
+    dwt_decompose(p, _store_layer);
+    dt_dwt_free(p);
+
+    for(int s = 0; s < SCALES + 3; s++)
+      assert_memory_equal(layers.layer[s], ref[s], sizeof(float) * nfloats);
+    assert_memory_equal(out, ref[SCALES + 2], sizeof(float) * nfloats);
+
+    for(int s = 0; s < SCALES + 3; s++)
+      dt_free_align(layers.layer[s]);
+    dt_free_align(out);
+  }
+
+  for(int s = 0; s < SCALES + 3; s++)
+    dt_free_align(ref[s]);
+  dt_free_align(img);
+}
+
+// the single channel denoise of rawdenoise is bit-exact
+static void test_dwt_denoise(void **state)
+{
+  const float noise[SCALES] = { 0.04f, 0.03f, 0.02f, 0.01f, 0.005f };
+  float *img = _make_image(1);
+  float *ref = _copy(img, 1);
+  _ref_dwt_denoise(ref, noise);
+
+  const int threads[] = { 1, _max_threads() };
+  for(int t = 0; t < 2; t++)
+  {
+    _set_threads(threads[t]);
+    float *out = _copy(img, 1);
+    dwt_denoise(out, WIDTH, HEIGHT, SCALES, noise);
+    assert_memory_equal(out, ref, sizeof(float) * WIDTH * HEIGHT);
+    dt_free_align(out);
+  }
+
+  dt_free_align(ref);
+  dt_free_align(img);
+}
+
+// the equalizer's decomposition and synthesis of all scales
+static void test_eaw_equalizer(void **state)
+{
+  const size_t nfloats = (size_t)4 * WIDTH * HEIGHT;
+  const dt_aligned_pixel_t threshold = { 0.01f, 0.02f, 0.02f, 0.0f };
+  const dt_aligned_pixel_t boost = { 1.5f, 0.8f, 0.8f, 1.0f };
+  float *img = _make_image(4);
+  float *ref_out = dt_alloc_align_float(nfloats);
+  float *ref_accum = dt_calloc_align_float(nfloats);
+  float *out = dt_alloc_align_float(nfloats);
+  float *accum = dt_alloc_align_float(nfloats);
+
+  const int threads[] = { 1, _max_threads() };
+  for(int t = 0; t < 2; t++)
+  {
+    _set_threads(threads[t]);
+    memset(accum, 0, sizeof(float) * nfloats);
+    memset(ref_accum, 0, sizeof(float) * nfloats);
+    for(int scale = 0; scale < SCALES; scale++)
+    {
+      eaw_decompose_and_synthesize(out, img, accum, scale, 0.1f, threshold, boost, WIDTH, HEIGHT);
+      _ref_eaw(ref_out, img, ref_accum, scale, 0.1f, threshold, boost);
+      _assert_near(out, ref_out, nfloats, EPSILON);
+      _assert_near(accum, ref_accum, nfloats, EPSILON);
+    }
+  }
+
+  dt_free_align(img);
+  dt_free_align(ref_out);
+  dt_free_align(ref_accum);
+  dt_free_align(out);
+  dt_free_align(accum);
+}
+
+// the decomposition of denoiseprofile including the sum of squared details
+static void test_eaw_denoiseprofile(void **state)
+{
+  const size_t nfloats = (size_t)4 * WIDTH * HEIGHT;
+  float *img = _make_image(4);
+  float *ref_out = dt_alloc_align_float(nfloats);
+  float *ref_detail = dt_alloc_align_float(nfloats);
+  float *out = dt_alloc_align_float(nfloats);
+  float *detail = dt_alloc_align_float(nfloats);
+
+  const int threads[] = { 1, _max_threads() };
+  for(int t = 0; t < 2; t++)
+  {
+    _set_threads(threads[t]);
+    for(int scale = 0; scale < SCALES; scale++)
+    {
+      dt_aligned_pixel_t sum_squared, ref_sum_squared;
+      eaw_dn_decompose(out, img, detail, sum_squared, scale, 50.0f, WIDTH, HEIGHT);
+      _ref_eaw_dn(ref_out, img, ref_detail, ref_sum_squared, scale, 50.0f);
+      _assert_near(out, ref_out, nfloats, EPSILON);
+      _assert_near(detail, ref_detail, nfloats, EPSILON);
+      // summed up in another order
+      _assert_near(sum_squared, ref_sum_squared, 3, 1e-4f);
+    }
+  }
+
+  dt_free_align(img);
+  dt_free_align(ref_out);
+  dt_free_align(ref_detail);
+  dt_free_align(out);
+  dt_free_align(detail);
+}
+
+// blur and decomposition of diffuse, filmic and the laplacian highlights
+static void test_bspline(void **state)
+{
+  const size_t nfloats = (size_t)4 * WIDTH * HEIGHT;
+  float *img = _make_image(4);
+  // some negative values to be clipped
+  for(size_t k = 0; k < nfloats; k += 7) img[k] -= 0.5f;
+
+  float *ref = dt_alloc_align_float(nfloats);
+  float *out = dt_alloc_align_float(nfloats);
+  float *HF = dt_alloc_align_float(nfloats);
+
+  const int threads[] = { 1, _max_threads() };
+  for(int t = 0; t < 2; t++)
+  {
+    _set_threads(threads[t]);
+    size_t padded_size;
+    float *tempbuf = dt_alloc_perthread_float(4 * WIDTH, &padded_size);
+    for(int scale = 0; scale < SCALES; scale++)
+    {
+      const int mult = 1 << scale;
+      for(int clip = 0; clip < 2; clip++)
+      {
+        blur_2D_Bspline(img, out, tempbuf, padded_size, WIDTH, HEIGHT, mult, clip);
+        _ref_bspline(ref, img, mult, clip);
+        _assert_near(out, ref, nfloats, EPSILON);
+      }
+
+      // the low frequencies are the clipped blur, the high ones the rest
+      decompose_2D_Bspline(img, HF, out, WIDTH, HEIGHT, mult, tempbuf, padded_size);
+      _ref_bspline(ref, img, mult, TRUE);
+      _assert_near(out, ref, nfloats, EPSILON);
+      for(size_t k = 0; k < nfloats; k++) ref[k] = img[k] - ref[k];
+      _assert_near(HF, ref, nfloats, EPSILON);
+    }
+    dt_free_align(tempbuf);
+  }
+
+  dt_free_align(img);
+  dt_free_align(ref);
+  dt_free_align(out);
+  dt_free_align(HF);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_dwt_decompose),
+    cmocka_unit_test(test_dwt_denoise),
+    cmocka_unit_test(test_eaw_equalizer),
+    cmocka_unit_test(test_eaw_denoiseprofile),
+    cmocka_unit_test(test_bspline),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
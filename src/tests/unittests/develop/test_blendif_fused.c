@@ -0,0 +1,293 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the fused parametric mask generation and blending in
+ * develop/blends/blendif_*.c: for every blend mode of the Lab, RGB display and
+ * RGB scene families, the single pass gives the same mask and output as
+ * generating the mask first and blending with it in a second pass. Raw blending
+ * has no fused path.
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/iop_order.h"
+#include "common/iop_profile.h"
+#include "develop/blend.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// the module output, cropped from its input to exercise the roi offsets, with a width
+// which is no multiple of four so that the rows of the mask are not aligned
+#define IN_WIDTH 83
+#define IN_HEIGHT 51
+#define OUT_X 5
+#define OUT_Y 3
+#define OUT_WIDTH 71
+#define OUT_HEIGHT 44
+
+typedef void(_make_mask_func)(dt_dev_pixelpipe_iop_t *piece,
+                              const float *const a,
+                              const float *const b,
+                              const dt_iop_roi_t *const roi_in,
+                              const dt_iop_roi_t *const roi_out,
+                              float *const mask);
+
+typedef void(_blend_func)(dt_dev_pixelpipe_iop_t *piece,
+                          const float *const a,
+                          float *const b,
+                          const dt_iop_roi_t *const roi_in,
+                          const dt_iop_roi_t *const roi_out,
+                          const float *const mask,
+                          const dt_dev_pixelpipe_display_mask_t request_mask_display);
+
+typedef gboolean(_fused_func)(dt_dev_pixelpipe_iop_t *piece,
+                              const float *const a,
+                              float *const b,
+                              const dt_iop_roi_t *const roi_in,
+                              const dt_iop_roi_t *const roi_out,
+                              const float fill,
+                              float *const mask);
+
+typedef struct _family_t
+{
+  _make_mask_func *make_mask;
+  _blend_func *blend;
+  _fused_func *fused;
+  dt_develop_blend_colorspace_t cst;
+  uint32_t channels;         // DEVELOP_BLENDIF_Lab_MASK or DEVELOP_BLENDIF_RGB_MASK
+  gboolean lab;              // the pixels are Lab instead of rgb
+  const uint32_t *modes;
+  size_t nmodes;
+} _family_t;
+
+static const uint32_t _lab_modes[] = {
+  DEVELOP_BLEND_NORMAL2, DEVELOP_BLEND_BOUNDED, DEVELOP_BLEND_LIGHTEN, DEVELOP_BLEND_DARKEN,
+  DEVELOP_BLEND_MULTIPLY, DEVELOP_BLEND_AVERAGE, DEVELOP_BLEND_ADD, DEVELOP_BLEND_SUBTRACT,
+  DEVELOP_BLEND_DIFFERENCE, DEVELOP_BLEND_DIFFERENCE2, DEVELOP_BLEND_SCREEN, DEVELOP_BLEND_OVERLAY,
+  DEVELOP_BLEND_SOFTLIGHT, DEVELOP_BLEND_HARDLIGHT, DEVELOP_BLEND_VIVIDLIGHT, DEVELOP_BLEND_LINEARLIGHT,
+  DEVELOP_BLEND_PINLIGHT, DEVELOP_BLEND_LIGHTNESS, DEVELOP_BLEND_CHROMATICITY, DEVELOP_BLEND_HUE,
+  DEVELOP_BLEND_COLOR, DEVELOP_BLEND_COLORADJUST, DEVELOP_BLEND_LAB_LIGHTNESS, DEVELOP_BLEND_LAB_COLOR,
+  DEVELOP_BLEND_LAB_L, DEVELOP_BLEND_LAB_A, DEVELOP_BLEND_LAB_B
+};
+
+static const uint32_t _rgb_hsl_modes[] = {
+  DEVELOP_BLEND_NORMAL2, DEVELOP_BLEND_BOUNDED, DEVELOP_BLEND_LIGHTEN, DEVELOP_BLEND_DARKEN,
+  DEVELOP_BLEND_MULTIPLY, DEVELOP_BLEND_AVERAGE, DEVELOP_BLEND_ADD, DEVELOP_BLEND_SUBTRACT,
+  DEVELOP_BLEND_DIFFERENCE, DEVELOP_BLEND_DIFFERENCE2, DEVELOP_BLEND_SCREEN, DEVELOP_BLEND_OVERLAY,
+  DEVELOP_BLEND_SOFTLIGHT, DEVELOP_BLEND_HARDLIGHT, DEVELOP_BLEND_VIVIDLIGHT, DEVELOP_BLEND_LINEARLIGHT,
+  DEVELOP_BLEND_PINLIGHT, DEVELOP_BLEND_LIGHTNESS, DEVELOP_BLEND_CHROMATICITY, DEVELOP_BLEND_HUE,
+  DEVELOP_BLEND_COLOR, DEVELOP_BLEND_COLORADJUST, DEVELOP_BLEND_HSV_VALUE, DEVELOP_BLEND_HSV_COLOR,
+  DEVELOP_BLEND_RGB_R, DEVELOP_BLEND_RGB_G, DEVELOP_BLEND_RGB_B
+};
+
+static const uint32_t _rgb_jzczhz_modes[] = {
+  DEVELOP_BLEND_NORMAL2, DEVELOP_BLEND_MULTIPLY, DEVELOP_BLEND_AVERAGE, DEVELOP_BLEND_ADD,
+  DEVELOP_BLEND_SUBTRACT, DEVELOP_BLEND_SUBTRACT_INVERSE, DEVELOP_BLEND_DIFFERENCE, DEVELOP_BLEND_DIFFERENCE2,
+  DEVELOP_BLEND_DIVIDE, DEVELOP_BLEND_DIVIDE_INVERSE, DEVELOP_BLEND_LIGHTNESS, DEVELOP_BLEND_CHROMATICITY,
+  DEVELOP_BLEND_RGB_R, DEVELOP_BLEND_RGB_G, DEVELOP_BLEND_RGB_B, DEVELOP_BLEND_GEOMETRIC_MEAN,
+  DEVELOP_BLEND_HARMONIC_MEAN
+};
+
+// linear Rec709 to XYZ D50 as working profile of the pipe
+static dt_iop_order_iccprofile_info_t _profile = {
+  .type = DT_COLORSPACE_LIN_REC709,
+  .matrix_in = { { 0.4360747f, 0.3850649f, 0.1430804f },
+                 { 0.2225045f, 0.7168786f, 0.0606169f },
+                 { 0.0139322f, 0.0971045f, 0.7141733f } },
+  .matrix_in_transposed = { { 0.4360747f, 0.2225045f, 0.0139322f },
+                            { 0.3850649f, 0.7168786f, 0.0971045f },
+                            { 0.1430804f, 0.0606169f, 0.7141733f } },
+};
+
+// the blending module sits between colorin and colorout
+static dt_iop_order_entry_t _colorin = { .o.iop_order = 10, .operation = "colorin" };
+static dt_iop_order_entry_t _colorout = { .o.iop_order = 30, .operation = "colorout" };
+
+/*
+ * HELPERS
+ */
+
+static float *_make_image(const int width, const int height, const gboolean lab, unsigned int seed)
+{
+  float *img = dt_alloc_align_float((size_t)4 * width * height);
+  for(size_t k = 0; k < (size_t)width * height; k++)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      seed = seed * 1103515245u + 12345u;
+      const float v = (float)(seed >> 8) / (float)(1 << 24);
+      img[4 * k + c] = lab ? (c == 0 ? 100.0f * v : 160.0f * v - 80.0f) : 1.2f * v;
+    }
+    img[4 * k + 3] = 0.0f;
+  }
+  return img;
+}
+
+// a parametric mask on every channel of the family with ramps on the gray or L
+// channels and the red or a input, the output one inverted. The other channels let
+// everything through, with an inclusive combine mode inverting all of them they
+// select nothing instead so that the mask still has some spread.
+static void _set_params(dt_develop_blend_params_t *const d,
+                        const _family_t *const family,
+                        const uint32_t mask_combine)
+{
+  const float ramps[3][4] = { { 0.1f, 0.4f, 0.7f, 0.95f },
+                              { 0.2f, 0.45f, 0.8f, 0.9f },
+                              { 0.6f, 0.8f, 1.0f, 1.0f } };
+  const float all[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+  const float none[4] = { 10.0f, 10.0f, 10.0f, 10.0f };
+
+  memset(d, 0, sizeof(dt_develop_blend_params_t));
+  d->mask_mode = DEVELOP_MASK_ENABLED | DEVELOP_MASK_CONDITIONAL;
+  d->mask_combine = mask_combine;
+  d->blend_cst = family->cst;
+  d->opacity = 80.0f;
+  d->blend_parameter = 0.5f;
+  d->blendif = family->channels | (1u << DEVELOP_BLENDIF_GRAY_out) << 16;
+  for(int ch = 0; ch < DEVELOP_BLENDIF_SIZE; ch++)
+    memcpy(d->blendif_parameters + 4 * ch, (mask_combine & DEVELOP_COMBINE_INCL) ? none : all, sizeof(all));
+  memcpy(d->blendif_parameters + 4 * DEVELOP_BLENDIF_GRAY_in, ramps[0], sizeof(ramps[0]));
+  memcpy(d->blendif_parameters + 4 * DEVELOP_BLENDIF_RED_in, ramps[1], sizeof(ramps[1]));
+  memcpy(d->blendif_parameters + 4 * DEVELOP_BLENDIF_GRAY_out, ramps[2], sizeof(ramps[2]));
+}
+
+static void _check_family(const _family_t *const family)
+{
+  const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = IN_WIDTH, .height = IN_HEIGHT, .scale = 1.0f };
+  const dt_iop_roi_t roi_out = { .x = OUT_X, .y = OUT_Y, .width = OUT_WIDTH, .height = OUT_HEIGHT, .scale = 1.0f };
+  const size_t osize = (size_t)4 * OUT_WIDTH * OUT_HEIGHT;
+  const size_t msize = (size_t)OUT_WIDTH * OUT_HEIGHT;
+
+  dt_develop_t *dev = calloc(1, sizeof(dt_develop_t));
+  dev->iop_order_list = g_list_append(g_list_append(NULL, &_colorin), &_colorout);
+  dt_iop_module_t *module = calloc(1, sizeof(dt_iop_module_t));
+  module->dev = dev;
+  module->iop_order = 20;
+  dt_dev_pixelpipe_t *pipe = calloc(1, sizeof(dt_dev_pixelpipe_t));
+  pipe->work_profile_info = &_profile;
+  pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_NONE;
+  dt_develop_blend_params_t d;
+  dt_dev_pixelpipe_iop_t piece = { .module = module, .pipe = pipe, .blendop_data = &d, .colors = 4 };
+
+  float *in = _make_image(IN_WIDTH, IN_HEIGHT, family->lab, 3);
+  float *out = _make_image(OUT_WIDTH, OUT_HEIGHT, family->lab, 7);
+  float *ref = dt_alloc_align_float(osize);
+  float *fused = dt_alloc_align_float(osize);
+  float *ref_mask = dt_alloc_align_float(msize);
+  float *fused_mask = dt_alloc_align_float(msize);
+
+  for(size_t m = 0; m < family->nmodes; m++)
+    for(int reverse = 0; reverse < 2; reverse++)
+      for(uint32_t combine = 0; combine < 4; combine++)
+      {
+        _set_params(&d, family,
+                    (combine & 1 ? DEVELOP_COMBINE_INCL : 0) | (combine & 2 ? DEVELOP_COMBINE_INV : 0));
+        d.blend_mode = family->modes[m] | (reverse ? DEVELOP_BLEND_REVERSE : 0);
+        const float fill = (d.mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f;
+
+        // the separate passes of dt_develop_blend_process()
+        memcpy(ref, out, sizeof(float) * osize);
+        dt_iop_image_fill(ref_mask, fill, OUT_WIDTH, OUT_HEIGHT, 1);
+        family->make_mask(&piece, in, ref, &roi_in, &roi_out, ref_mask);
+        family->blend(&piece, in, ref, &roi_in, &roi_out, ref_mask, DT_DEV_PIXELPIPE_DISPLAY_NONE);
+
+        memcpy(fused, out, sizeof(float) * osize);
+        assert_true(family->fused(&piece, in, fused, &roi_in, &roi_out, fill, fused_mask));
+
+        assert_memory_equal(fused_mask, ref_mask, sizeof(float) * msize);
+        assert_memory_equal(fused, ref, sizeof(float) * osize);
+      }
+
+  dt_free_align(in);
+  dt_free_align(out);
+  dt_free_align(ref);
+  dt_free_align(fused);
+  dt_free_align(ref_mask);
+  dt_free_align(fused_mask);
+  g_list_free(dev->iop_order_list);
+  free(dev);
+  free(module);
+  free(pipe);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_fused_lab(void **state)
+{
+  const _family_t family = { dt_develop_blendif_lab_make_mask, dt_develop_blendif_lab_blend,
+                             dt_develop_blendif_lab_make_mask_and_blend, DEVELOP_BLEND_CS_LAB,
+                             DEVELOP_BLENDIF_Lab_MASK, TRUE, _lab_modes, sizeof(_lab_modes) / sizeof(_lab_modes[0]) };
+  _check_family(&family);
+}
+
+static void test_fused_rgb_hsl(void **state)
+{
+  const _family_t family = { dt_develop_blendif_rgb_hsl_make_mask, dt_develop_blendif_rgb_hsl_blend,
+                             dt_develop_blendif_rgb_hsl_make_mask_and_blend, DEVELOP_BLEND_CS_RGB_DISPLAY,
+                             DEVELOP_BLENDIF_RGB_MASK, FALSE, _rgb_hsl_modes, sizeof(_rgb_hsl_modes) / sizeof(_rgb_hsl_modes[0]) };
+  _check_family(&family);
+}
+
+static void test_fused_rgb_jzczhz(void **state)
+{
+  const _family_t family = { dt_develop_blendif_rgb_jzczhz_make_mask, dt_develop_blendif_rgb_jzczhz_blend,
+                             dt_develop_blendif_rgb_jzczhz_make_mask_and_blend, DEVELOP_BLEND_CS_RGB_SCENE,
+                             DEVELOP_BLENDIF_RGB_MASK, FALSE, _rgb_jzczhz_modes,
+                             sizeof(_rgb_jzczhz_modes) / sizeof(_rgb_jzczhz_modes[0]) };
+  _check_family(&family);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_fused_lab),
+    cmocka_unit_test(test_fused_rgb_hsl),
+    cmocka_unit_test(test_fused_rgb_jzczhz),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
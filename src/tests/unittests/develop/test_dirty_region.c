@@ -0,0 +1,224 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the dirty region reprocessing of develop/pixelpipe_hb.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "develop/pixelpipe_hb.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 211
+#define HEIGHT 157
+#define BPP (4 * sizeof(float))
+// radius of the local filter, its tiling overlap
+#define RADIUS 3
+
+/*
+ * HELPERS
+ */
+
+// stands in for a module with IOP_FLAGS_EXACT_LOCAL: a box blur clamped at the borders of its
+// roi followed by a gain depending on the absolute position, so a wrong roi offset shows
+static void _process(const float *const in,
+                     float *const out,
+                     const int x0,
+                     const int y0,
+                     const int width,
+                     const int height)
+{
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      dt_aligned_pixel_t sum = { 0.0f };
+      for(int j = -RADIUS; j <= RADIUS; j++)
+        for(int i = -RADIUS; i <= RADIUS; i++)
+        {
+          const size_t k = 4 * ((size_t)CLAMP(y + j, 0, height - 1) * width + CLAMP(x + i, 0, width - 1));
+          for_four_channels(c) sum[c] += in[k + c];
+        }
+      const float gain = 1.0f + 0.001f * (x0 + x) - 0.002f * (y0 + y);
+      for_four_channels(c)
+        out[4 * ((size_t)y * width + x) + c] = gain * sum[c] / ((2 * RADIUS + 1) * (2 * RADIUS + 1));
+    }
+}
+
+static float *_make_image(void)
+{
+  float *img = dt_alloc_align_float(4 * WIDTH * HEIGHT);
+  srand(5);
+  for(size_t k = 0; k < 4 * WIDTH * HEIGHT; k++)
+    img[k] = (float)rand() / RAND_MAX;
+  return img;
+}
+
+static void _change(float *const img, const int x0, const int y0, const int width, const int height)
+{
+  for(int y = y0; y < y0 + height; y++)
+    for(int x = x0; x < x0 + width; x++)
+      img[4 * ((size_t)y * WIDTH + x) + 1] += 0.25f;
+}
+
+// reprocess an edit of the input the way the pipe does and compare with the full render
+static void _check_edit(const int x0, const int y0, const int width, const int height)
+{
+  float *img = _make_image();
+  float *prev = dt_alloc_align_float(4 * WIDTH * HEIGHT);
+  _process(img, prev, 0, 0, WIDTH, HEIGHT);
+
+  float *edited = dt_alloc_align_float(4 * WIDTH * HEIGHT);
+  memcpy(edited, img, BPP * WIDTH * HEIGHT);
+  _change(edited, x0, y0, width, height);
+  float *full = dt_alloc_align_float(4 * WIDTH * HEIGHT);
+  _process(edited, full, 0, 0, WIDTH, HEIGHT);
+
+  // the changed input region as found by the edited module
+  dt_dev_dirty_region_t in_dirty;
+  dt_dev_dirty_region_diff((uint8_t *)edited, (uint8_t *)img, WIDTH, HEIGHT, BPP, &in_dirty);
+  assert_true(in_dirty.valid);
+  assert_int_equal(in_dirty.x, x0);
+  assert_int_equal(in_dirty.y, y0);
+  assert_int_equal(in_dirty.width, width);
+  assert_int_equal(in_dirty.height, height);
+
+  dt_dev_dirty_region_t dirty, region;
+  assert_true(dt_dev_dirty_region_local(&in_dirty, RADIUS, WIDTH, HEIGHT, &dirty, &region));
+
+  // the full render changed within the dirty region only
+  dt_dev_dirty_region_t changed;
+  dt_dev_dirty_region_diff((uint8_t *)full, (uint8_t *)prev, WIDTH, HEIGHT, BPP, &changed);
+  assert_in_range(changed.x, dirty.x, dirty.x + dirty.width);
+  assert_in_range(changed.y, dirty.y, dirty.y + dirty.height);
+  assert_in_range(changed.x + changed.width, dirty.x, dirty.x + dirty.width);
+  assert_in_range(changed.y + changed.height, dirty.y, dirty.y + dirty.height);
+
+  // process the region only and put the dirty part into the previous output
+  float *sub_in = dt_alloc_align_float(4 * region.width * region.height);
+  float *sub_out = dt_alloc_align_float(4 * region.width * region.height);
+  dt_dev_dirty_region_copy((uint8_t *)sub_in, region.width, 0, 0,
+                           (uint8_t *)edited, WIDTH, region.x, region.y,
+                           region.width, region.height, BPP);
+  _process(sub_in, sub_out, region.x, region.y, region.width, region.height);
+  dt_dev_dirty_region_copy((uint8_t *)prev, WIDTH, dirty.x, dirty.y,
+                           (uint8_t *)sub_out, region.width, dirty.x - region.x, dirty.y - region.y,
+                           dirty.width, dirty.height, BPP);
+
+  assert_memory_equal(prev, full, BPP * WIDTH * HEIGHT);
+
+  dt_free_align(img);
+  dt_free_align(prev);
+  dt_free_align(edited);
+  dt_free_align(full);
+  dt_free_align(sub_in);
+  dt_free_align(sub_out);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_dirty_region_grow(void **state)
+{
+  dt_dev_dirty_region_t dirty = { .valid = TRUE, .x = 2, .y = 10, .width = 5, .height = 3 };
+  dt_dev_dirty_region_grow(&dirty, 4, 20, 15);
+  assert_int_equal(dirty.x, 0);
+  assert_int_equal(dirty.y, 6);
+  assert_int_equal(dirty.width, 11);
+  assert_int_equal(dirty.height, 9);
+
+  // nothing changed stays nothing
+  dirty = (dt_dev_dirty_region_t){ .valid = TRUE };
+  dt_dev_dirty_region_grow(&dirty, 4, 20, 15);
+  assert_int_equal(dirty.width, 0);
+  assert_int_equal(dirty.height, 0);
+}
+
+// processing the dirty region gives exactly the full render, inside and at the borders
+static void test_dirty_region_render(void **state)
+{
+  _check_edit(60, 40, 9, 7);
+  _check_edit(0, 0, 5, 4);
+  _check_edit(WIDTH - 3, HEIGHT - 8, 3, 8);
+  _check_edit(100, 70, 1, 1);
+}
+
+static void test_dirty_region_unchanged(void **state)
+{
+  float *img = _make_image();
+  dt_dev_dirty_region_t dirty;
+  dt_dev_dirty_region_diff((uint8_t *)img, (uint8_t *)img, WIDTH, HEIGHT, BPP, &dirty);
+  assert_true(dirty.valid);
+  assert_int_equal(dirty.width, 0);
+  assert_int_equal(dirty.height, 0);
+
+  dt_dev_dirty_region_t out, region;
+  assert_true(dt_dev_dirty_region_local(&dirty, RADIUS, WIDTH, HEIGHT, &out, &region));
+  assert_int_equal(region.width, 0);
+  dt_free_align(img);
+}
+
+// a large change is processed completely
+static void test_dirty_region_large(void **state)
+{
+  const dt_dev_dirty_region_t in_dirty = { .valid = TRUE, .x = 10, .y = 10,
+                                           .width = WIDTH / 2, .height = HEIGHT - 20 };
+  dt_dev_dirty_region_t dirty, region;
+  assert_false(dt_dev_dirty_region_local(&in_dirty, RADIUS, WIDTH, HEIGHT, &dirty, &region));
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_dirty_region_grow),
+    cmocka_unit_test(test_dirty_region_render),
+    cmocka_unit_test(test_dirty_region_unchanged),
+    cmocka_unit_test(test_dirty_region_large),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
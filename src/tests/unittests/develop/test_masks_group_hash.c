@@ -0,0 +1,141 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the hash of a mask group used as key of the raster
+ * cache in develop/masks/masks.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "develop/masks.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define GROUP_ID 100
+#define CIRCLE_ID 101
+
+/*
+ * HELPERS
+ */
+
+static dt_masks_form_t *_circle(const float x, const float y)
+{
+  dt_masks_form_t *form = calloc(1, sizeof(dt_masks_form_t));
+  form->type = DT_MASKS_CIRCLE;
+  form->functions = &dt_masks_functions_circle;
+  form->formid = CIRCLE_ID;
+  dt_masks_point_circle_t *circle = calloc(1, sizeof(dt_masks_point_circle_t));
+  circle->center[0] = x;
+  circle->center[1] = y;
+  circle->radius = 0.1f;
+  circle->border = 0.05f;
+  form->points = g_list_append(NULL, circle);
+  return form;
+}
+
+static dt_masks_form_t *_group(void)
+{
+  dt_masks_form_t *form = calloc(1, sizeof(dt_masks_form_t));
+  form->type = DT_MASKS_GROUP;
+  form->functions = &dt_masks_functions_group;
+  form->formid = GROUP_ID;
+  dt_masks_point_group_t *member = calloc(1, sizeof(dt_masks_point_group_t));
+  member->formid = CIRCLE_ID;
+  member->parentid = GROUP_ID;
+  member->state = DT_MASKS_STATE_USE;
+  member->opacity = 1.0f;
+  form->points = g_list_append(NULL, member);
+  return form;
+}
+
+// the forms of a pipe, a group holding a circle
+static GList *_forms(const float x, const float y)
+{
+  GList *forms = g_list_append(NULL, _group());
+  return g_list_append(forms, _circle(x, y));
+}
+
+static void _free_forms(GList *forms)
+{
+  g_list_free_full(forms, (void (*)(void *))dt_masks_free_form);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// the children of a group are taken from the given forms, not from the develop module
+static void test_group_hash_forms(void **state)
+{
+  darktable.develop = NULL;
+
+  GList *forms = _forms(0.5f, 0.5f);
+  GList *same = _forms(0.5f, 0.5f);
+  GList *moved = _forms(0.6f, 0.5f);
+
+  const dt_hash_t hash = dt_masks_group_hash_ext(DT_INITHASH, forms,
+                                                 dt_masks_get_from_id_ext(forms, GROUP_ID));
+  assert_true(hash == dt_masks_group_hash_ext(DT_INITHASH, same,
+                                              dt_masks_get_from_id_ext(same, GROUP_ID)));
+
+  // the group itself is unchanged, only its child moved
+  assert_false(hash == dt_masks_group_hash_ext(DT_INITHASH, moved,
+                                               dt_masks_get_from_id_ext(moved, GROUP_ID)));
+
+  // a child missing from the forms doesn't count
+  GList *orphan = g_list_append(NULL, _group());
+  assert_false(hash == dt_masks_group_hash_ext(DT_INITHASH, orphan, orphan->data));
+
+  _free_forms(forms);
+  _free_forms(same);
+  _free_forms(moved);
+  _free_forms(orphan);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_group_hash_forms),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,346 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the rasterization of path and brush masks in
+ * develop/masks/rasterize.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/math.h"
+#include "develop/masks.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 2000
+#define HEIGHT 1500
+#define NB_POINTS 8000
+
+/*
+ * HELPERS
+ */
+
+// the edge-flag polygon fill formerly used by the path masks, the scanline
+// fill has to give exactly the same pixels
+static void _reference_fill(float *const buffer, const int width, const int height,
+                            const float *const points, const int count)
+{
+  float xlast = points[(count - 1) * 2];
+  float ylast = points[(count - 1) * 2 + 1];
+  for(int i = 0; i < count; i++)
+  {
+    float xstart = xlast, ystart = ylast;
+    float xend = xlast = points[i * 2];
+    float yend = ylast = points[i * 2 + 1];
+    if(ystart > yend)
+    {
+      float tmp;
+      tmp = ystart, ystart = yend, yend = tmp;
+      tmp = xstart, xstart = xend, xend = tmp;
+    }
+    const float m = (xstart - xend) / (ystart - yend);
+    for(int yy = (int)ceilf(ystart); (float)yy < yend; yy++)
+    {
+      const float xcross = xstart + m * (yy - ystart);
+      int xx = floorf(xcross);
+      if((float)xx + 0.5f <= xcross) xx++;
+      if(xx < 0 || xx >= width || yy < 0 || yy >= height) continue;
+      const size_t index = (size_t)yy * width + xx;
+      buffer[index] = 1.0f - buffer[index];
+    }
+  }
+  for(int yy = 0; yy < height; yy++)
+  {
+    int state = 0;
+    for(int xx = 0; xx < width; xx++)
+    {
+      const size_t index = (size_t)yy * width + xx;
+      if(buffer[index] > 0.5f) state = !state;
+      if(state) buffer[index] = 1.0f;
+    }
+  }
+}
+
+// the falloff rays drawn one after the other as done by the roi path masks
+// before, the parallel drawing has to give exactly the same pixels
+static void _reference_falloff(float *const buffer, const int bw, const int bh,
+                               const int *p0, const int *p1)
+{
+  const int l = sqrtf(sqf(p1[0] - p0[0]) + sqf(p1[1] - p0[1])) + 1;
+  const float lx = p1[0] - p0[0];
+  const float ly = p1[1] - p0[1];
+  const int dx = lx < 0 ? -1 : 1;
+  const int dy = ly < 0 ? -1 : 1;
+  for(int i = 0; i < l; i++)
+  {
+    const int x = (int)((float)i * lx / (float)l) + p0[0];
+    const int y = (int)((float)i * ly / (float)l) + p0[1];
+    const float op = 1.0f - (float)i / (float)l;
+    if(x >= 0 && x < bw && y >= 0 && y < bh)
+      buffer[(size_t)y * bw + x] = MAX(buffer[(size_t)y * bw + x], op);
+    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+      buffer[(size_t)y * bw + x + dx] = MAX(buffer[(size_t)y * bw + x + dx], op);
+    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+      buffer[(size_t)(y + dy) * bw + x] = MAX(buffer[(size_t)(y + dy) * bw + x], op);
+  }
+}
+
+// the falloff segment of the full brush masks, with hardness and density
+static void _reference_brush_falloff(float *const buffer, const int bw,
+                                     const int *p0, const int *p1,
+                                     const float hardness, const float density)
+{
+  const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
+  const int solid = (int)l * hardness;
+  const int soft = l - solid;
+  const float lx = p1[0] - p0[0];
+  const float ly = p1[1] - p0[1];
+  for(int i = 0; i < l; i++)
+  {
+    const int x = (int)((float)i * lx / (float)l) + p0[0];
+    const int y = (int)((float)i * ly / (float)l) + p0[1];
+    const float op = density * ((i <= solid) ? 1.0f : 1.0 - (float)(i - solid) / (float)soft);
+    buffer[y * bw + x] = MAX(buffer[y * bw + x], op);
+    if(x > 0) buffer[y * bw + x - 1] = MAX(buffer[y * bw + x - 1], op);
+    if(y > 0) buffer[(y - 1) * bw + x] = MAX(buffer[(y - 1) * bw + x], op);
+  }
+}
+
+// a wobbly closed path as produced by _path_get_pts_border(), with the border
+// points at a varying distance outside of it
+static void _make_path(float *const points, float *const border, const int count,
+                       const float cx, const float cy, const float radius)
+{
+  for(int i = 0; i < count; i++)
+  {
+    const float t = 2.0f * M_PI * i / count;
+    const float r = radius * (1.0f + 0.25f * sinf(5.0f * t) + 0.06f * cosf(13.0f * t));
+    const float t2 = 2.0f * M_PI * (i + 1) / count;
+    const float r2 = radius * (1.0f + 0.25f * sinf(5.0f * t2) + 0.06f * cosf(13.0f * t2));
+    const float x = cx + r * cosf(t);
+    const float y = cy + r * sinf(t);
+    float tx = cx + r2 * cosf(t2) - x;
+    float ty = cy + r2 * sinf(t2) - y;
+    const float tl = sqrtf(tx * tx + ty * ty);
+    tx /= tl;
+    ty /= tl;
+    const float feather = 0.2f * radius * (1.0f + 0.4f * sinf(3.0f * t));
+    points[2 * i] = x;
+    points[2 * i + 1] = y;
+    border[2 * i] = x + ty * feather;
+    border[2 * i + 1] = y - tx * feather;
+  }
+}
+
+static int _count_differences(const float *const a, const float *const b, const size_t n)
+{
+  int diff = 0;
+  for(size_t k = 0; k < n; k++) diff += a[k] != b[k];
+  return diff;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_fill_square(void **state)
+{
+  float *buffer = dt_calloc_align_float((size_t)100 * 100);
+  const float square[] = { 10.0f, 20.0f, 60.0f, 20.0f, 60.0f, 50.0f, 10.0f, 50.0f };
+  assert_true(dt_masks_fill_polygon(buffer, 100, 100, square, 4, 99));
+
+  for(int y = 0; y < 100; y++)
+    for(int x = 0; x < 100; x++)
+    {
+      const gboolean inside = x >= 10 && x <= 60 && y >= 20 && y < 50;
+      assert_float_equal(buffer[y * 100 + x], inside ? 1.0f : 0.0f, 0.0f);
+    }
+  dt_free_align(buffer);
+}
+
+static void test_fill_polygon(void **state)
+{
+  const size_t npixels = (size_t)WIDTH * HEIGHT;
+  float *points = dt_alloc_align_float(2 * NB_POINTS);
+  float *border = dt_alloc_align_float(2 * NB_POINTS);
+  float *ref = dt_calloc_align_float(npixels);
+  float *out = dt_calloc_align_float(npixels);
+
+  // shape fully inside and shape crossing the left and lower buffer edges
+  const float centers[][3] = { { WIDTH / 2, HEIGHT / 2, 500.0f },
+                               { 150.0f, HEIGHT - 200.0f, 600.0f } };
+  for(int k = 0; k < 2; k++)
+  {
+    _make_path(points, border, NB_POINTS, centers[k][0], centers[k][1], centers[k][2]);
+    memset(ref, 0, sizeof(float) * npixels);
+    memset(out, 0, sizeof(float) * npixels);
+
+    _reference_fill(ref, WIDTH, HEIGHT, points, NB_POINTS);
+    assert_true(dt_masks_fill_polygon(out, WIDTH, HEIGHT, points, NB_POINTS, WIDTH - 1));
+    assert_int_equal(_count_differences(ref, out, npixels), 0);
+  }
+
+  dt_free_align(points);
+  dt_free_align(border);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+static void test_falloff_profile(void **state)
+{
+  float *buffer = dt_calloc_align_float((size_t)64 * 64);
+  // 41 steps over 40 pixels, the first 21 of them solid
+  const dt_masks_falloff_ray_t ray = { .x0 = 10, .y0 = 32, .x1 = 50, .y1 = 32, .dx = -1, .dy = -1,
+                                       .hardness = 0.5f, .density = 0.8f };
+  assert_true(dt_masks_falloff_rays(buffer, 64, 64, &ray, 1));
+
+  // full density up to hardness of the length, then fading out linearly,
+  // x = 45 is step 36
+  assert_float_equal(buffer[32 * 64 + 10], 0.8f, 1e-6f);
+  assert_float_equal(buffer[32 * 64 + 29], 0.8f, 1e-6f);
+  assert_float_equal(buffer[32 * 64 + 45], 0.8f * 5.0f / 21.0f, 1e-6f);
+  assert_float_equal(buffer[32 * 64 + 50], 0.0f, 0.0f);
+  // the neighbours at dx and dy
+  assert_float_equal(buffer[32 * 64 + 9], 0.8f, 1e-6f);
+  assert_float_equal(buffer[31 * 64 + 45], 0.8f * 5.0f / 21.0f, 1e-6f);
+  assert_float_equal(buffer[33 * 64 + 45], 0.0f, 0.0f);
+
+  // existing values are kept where they are larger
+  for(int k = 0; k < 64 * 64; k++) buffer[k] = 0.5f;
+  assert_true(dt_masks_falloff_rays(buffer, 64, 64, &ray, 1));
+  assert_float_equal(buffer[32 * 64 + 10], 0.8f, 1e-6f);
+  assert_float_equal(buffer[32 * 64 + 45], 0.5f, 0.0f);
+
+  dt_free_align(buffer);
+}
+
+static void test_falloff_path(void **state)
+{
+  const size_t npixels = (size_t)WIDTH * HEIGHT;
+  float *points = dt_alloc_align_float(2 * NB_POINTS);
+  float *border = dt_alloc_align_float(2 * NB_POINTS);
+  float *ref = dt_calloc_align_float(npixels);
+  float *out = dt_calloc_align_float(npixels);
+  dt_masks_falloff_ray_t *rays = dt_alloc_aligned(sizeof(dt_masks_falloff_ray_t) * NB_POINTS);
+
+  // shape fully inside and shape crossing the left and lower buffer edges
+  const float centers[][3] = { { WIDTH / 2, HEIGHT / 2, 500.0f },
+                               { 150.0f, HEIGHT - 200.0f, 600.0f } };
+  for(int k = 0; k < 2; k++)
+  {
+    _make_path(points, border, NB_POINTS, centers[k][0], centers[k][1], centers[k][2]);
+    memset(ref, 0, sizeof(float) * npixels);
+    memset(out, 0, sizeof(float) * npixels);
+
+    for(int i = 0; i < NB_POINTS; i++)
+    {
+      const int p0[] = { floorf(points[2 * i] + 0.5f), ceilf(points[2 * i + 1]) };
+      const int p1[] = { border[2 * i], border[2 * i + 1] };
+      _reference_falloff(ref, WIDTH, HEIGHT, p0, p1);
+
+      const dt_masks_falloff_ray_t r = { .x0 = p0[0], .y0 = p0[1], .x1 = p1[0], .y1 = p1[1],
+                                         .dx = p1[0] >= p0[0] ? 1 : -1,
+                                         .dy = p1[1] >= p0[1] ? 1 : -1,
+                                         .hardness = 0.0f, .density = 1.0f };
+      rays[i] = r;
+    }
+    assert_true(dt_masks_falloff_rays(out, WIDTH, HEIGHT, rays, NB_POINTS));
+    assert_int_equal(_count_differences(ref, out, npixels), 0);
+  }
+
+  dt_free_align(rays);
+  dt_free_align(points);
+  dt_free_align(border);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+static void test_falloff_brush(void **state)
+{
+  const size_t npixels = (size_t)WIDTH * HEIGHT;
+  float *points = dt_alloc_align_float(2 * NB_POINTS);
+  float *border = dt_alloc_align_float(2 * NB_POINTS);
+  float *ref = dt_calloc_align_float(npixels);
+  float *out = dt_calloc_align_float(npixels);
+  dt_masks_falloff_ray_t *rays = dt_alloc_aligned(sizeof(dt_masks_falloff_ray_t) * NB_POINTS);
+
+  // the buffer of the full brush masks holds all of the shape
+  _make_path(points, border, NB_POINTS, WIDTH / 2, HEIGHT / 2, 500.0f);
+  for(int i = 0; i < NB_POINTS; i++)
+  {
+    const int p0[] = { points[2 * i], points[2 * i + 1] };
+    const int p1[] = { border[2 * i], border[2 * i + 1] };
+    const float hardness = 0.5f + 0.4f * sinf(0.01f * i);
+    const float density = 0.75f + 0.25f * cosf(0.003f * i);
+    _reference_brush_falloff(ref, WIDTH, p0, p1, hardness, density);
+
+    const dt_masks_falloff_ray_t r = { .x0 = p0[0], .y0 = p0[1], .x1 = p1[0], .y1 = p1[1],
+                                       .dx = -1, .dy = -1,
+                                       .hardness = hardness, .density = density };
+    rays[i] = r;
+  }
+  assert_true(dt_masks_falloff_rays(out, WIDTH, HEIGHT, rays, NB_POINTS));
+  assert_int_equal(_count_differences(ref, out, npixels), 0);
+
+  dt_free_align(rays);
+  dt_free_align(points);
+  dt_free_align(border);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#endif
+
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_fill_square),
+    cmocka_unit_test(test_fill_polygon),
+    cmocka_unit_test(test_falloff_profile),
+    cmocka_unit_test(test_falloff_path),
+    cmocka_unit_test(test_falloff_brush),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,107 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the counter based generator in
+ * develop/noise_generator.h
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "develop/noise_generator.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 1000
+#define HEIGHT 1000
+#define SEED 1337
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// known answers of Philox 2x32-10 from the Random123 distribution
+static void test_philox_known_answers(void **state)
+{
+  assert_int_equal(philox2x32(0u, 0u, 0u), 0xff1dae596cd10df2ull);
+  assert_int_equal(philox2x32(0xffffffffu, 0xffffffffu, 0xffffffffu), 0x2c3f628bab4fd7adull);
+  assert_int_equal(philox2x32(0x243f6a88u, 0x85a308d3u, 0x13198a2eu), 0xdd7ce038f62a4c12ull);
+}
+
+// uniform in [0, 1) with the moments of the uniform distribution, and
+// neighbouring pixels are uncorrelated
+static void test_philox_uniform(void **state)
+{
+  double sum = 0.0, sum2 = 0.0, cov_x = 0.0, cov_y = 0.0;
+  for(uint32_t y = 0; y < HEIGHT; y++)
+    for(uint32_t x = 0; x < WIDTH; x++)
+    {
+      const float u = philox_uniform(x, y, SEED);
+      assert_true(u >= 0.0f && u < 1.0f);
+      sum += u;
+      sum2 += u * u;
+      cov_x += (u - 0.5) * (philox_uniform(x + 1, y, SEED) - 0.5);
+      cov_y += (u - 0.5) * (philox_uniform(x, y + 1, SEED) - 0.5);
+    }
+  const double n = (double)WIDTH * HEIGHT;
+  const double mean = sum / n;
+  const double var = sum2 / n - mean * mean;
+  assert_float_equal(mean, 0.5, 1e-3);
+  assert_float_equal(var, 1.0 / 12.0, 1e-3);
+  assert_true(fabs(cov_x / n / var) < 5e-3);
+  assert_true(fabs(cov_y / n / var) < 5e-3);
+
+  // another key gives another sequence
+  int same = 0;
+  for(uint32_t x = 0; x < WIDTH; x++)
+    same += philox_uniform(x, 0, SEED) == philox_uniform(x, 0, SEED + 1);
+  assert_true(same < 5);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_philox_known_answers),
+    cmocka_unit_test(test_philox_uniform),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
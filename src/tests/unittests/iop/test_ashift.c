@@ -0,0 +1,213 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the line detection in horizontal bands of the module
+ * iop/ashift.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/ashift.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// three bands at full scale
+#define WIDTH 1200
+#define HEIGHT 900
+#define EDGES 40
+// segments shorter than this are not compared, they are noise
+#define MIN_LENGTH 20.0
+
+/*
+ * HELPERS
+ */
+
+// a noisy background with straight bright bars of random position, direction and length
+static double *_make_image(void)
+{
+  double *img = malloc(sizeof(double) * WIDTH * HEIGHT);
+  unsigned int seed = 1;
+  for(size_t k = 0; k < (size_t)WIDTH * HEIGHT; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    img[k] = 100.0 + 10.0 * ((seed >> 8) & 0xff) / 255.0;
+  }
+  srand(5);
+  for(int e = 0; e < EDGES; e++)
+  {
+    const double x0 = rand() % WIDTH;
+    const double y0 = rand() % HEIGHT;
+    const double angle = (rand() % 360) * M_PI / 180.0;
+    const double length = 50 + rand() % 800;
+    const double dx = cos(angle);
+    const double dy = sin(angle);
+    for(int t = 0; t <= length; t++)
+      for(int d = 0; d < 6; d++)
+      {
+        const int x = lround(x0 + dx * t - dy * d);
+        const int y = lround(y0 + dy * t + dx * d);
+        if(x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT) img[(size_t)y * WIDTH + x] = 200.0;
+      }
+  }
+  return img;
+}
+
+// number of segments of a at least MIN_LENGTH long with a segment of b at about the same place
+static int _matched(const double *a, const int na, const double *b, const int nb, int *nlong)
+{
+  int matched = 0;
+  *nlong = 0;
+  for(int i = 0; i < na; i++)
+  {
+    const double *s = a + 7 * i;
+    const double length = hypot(s[2] - s[0], s[3] - s[1]);
+    if(length < MIN_LENGTH) continue;
+
+    (*nlong)++;
+    for(int j = 0; j < nb; j++)
+    {
+      const double *r = b + 7 * j;
+      const double d1 = hypot(s[0] - r[0], s[1] - r[1]) + hypot(s[2] - r[2], s[3] - r[3]);
+      const double d2 = hypot(s[0] - r[2], s[1] - r[3]) + hypot(s[2] - r[0], s[3] - r[1]);
+      if(MIN(d1, d2) < 0.02 * length + 4.0)
+      {
+        matched++;
+        break;
+      }
+    }
+  }
+  return matched;
+}
+
+// compare the band detection with LSD on the whole image, min_ratio of the long
+// segments found by either need to be found by the other one
+static void _compare_with_whole(const double scale, const double min_ratio)
+{
+  double *img = _make_image();
+  double *copy = malloc(sizeof(double) * WIDTH * HEIGHT);
+  memcpy(copy, img, sizeof(double) * WIDTH * HEIGHT);
+
+  int n_whole = 0;
+  double *whole = LineSegmentDetection(&n_whole, copy, WIDTH, HEIGHT,
+                                       scale, LSD_SIGMA_SCALE, LSD_QUANT,
+                                       LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                       LSD_N_BINS, 0.0, NULL, NULL, NULL);
+  int n_bands = 0;
+  double *bands = _detect_lines(img, WIDTH, HEIGHT, scale, &n_bands);
+  assert_non_null(whole);
+  assert_non_null(bands);
+
+  int long_whole = 0, long_bands = 0;
+  const int matched_whole = _matched(whole, n_whole, bands, n_bands, &long_whole);
+  const int matched_bands = _matched(bands, n_bands, whole, n_whole, &long_bands);
+  TR_DEBUG("scale %.2f: %d of %d and %d of %d long segments matched",
+           scale, matched_whole, long_whole, matched_bands, long_bands);
+  assert_true(long_whole > EDGES);
+  assert_true(matched_whole >= min_ratio * long_whole);
+  assert_true(matched_bands >= min_ratio * long_bands);
+
+  free(whole);
+  free(bands);
+  free(img);
+  free(copy);
+}
+
+static void _set_threads(const int threads)
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = threads;
+  omp_set_num_threads(threads);
+#endif
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// without scaling and at the integer steps of the sampler the bands find
+// the same segments as the whole image
+static void test_detect_lines_exact(void **state)
+{
+  _compare_with_whole(1.0, 1.0);
+  _compare_with_whole(0.6, 1.0);
+}
+
+// at the default scale the sampling grid differs, ends of segments close
+// to band borders may differ
+static void test_detect_lines_default(void **state)
+{
+  _compare_with_whole(LSD_SCALE, 0.95);
+}
+
+// the bands only depend on the image, not on the number of threads
+static void test_detect_lines_threads(void **state)
+{
+  double *img = _make_image();
+  _set_threads(1);
+  int n_ref = 0;
+  double *ref = _detect_lines(img, WIDTH, HEIGHT, LSD_SCALE, &n_ref);
+
+#ifdef _OPENMP
+  _set_threads(MAX(omp_get_num_procs(), 4));
+#endif
+  int n = 0;
+  double *lines = _detect_lines(img, WIDTH, HEIGHT, LSD_SCALE, &n);
+  assert_int_equal(n, n_ref);
+  assert_memory_equal(lines, ref, sizeof(double) * 7 * n);
+
+  free(ref);
+  free(lines);
+  free(img);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_detect_lines_exact),
+    cmocka_unit_test(test_detect_lines_default),
+    cmocka_unit_test(test_detect_lines_threads),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
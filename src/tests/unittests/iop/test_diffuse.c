@@ -0,0 +1,237 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the convergence stop of the diffuse or sharpen
+ * module in iop/diffuse.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/diffuse.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 512
+#define HEIGHT 384
+
+// tiles of the untiled image, overlapping by more than the diffusion reaches
+#define TILES_X 2
+#define TILES_Y 2
+#define OVERLAP 128
+
+/*
+ * HELPERS
+ */
+
+// smooth colours with some noise and a few edges
+static float *_make_image(const size_t width, const size_t height, const float zoom)
+{
+  float *img = dt_alloc_align_float(width * height * 4);
+  for(size_t i = 0; i < height; i++)
+    for(size_t j = 0; j < width; j++)
+    {
+      const float x = j * zoom;
+      const float y = i * zoom;
+      const float edge = ((int)(x / 64.f) + (int)(y / 48.f)) % 2 ? 0.3f : 0.f;
+      for(int c = 0; c < 4; c++)
+        img[(i * width + j) * 4 + c] = 0.2f + edge + 0.1f * c
+                                       + 0.15f * sinf(x * 0.05f + c) * cosf(y * 0.03f);
+    }
+  return img;
+}
+
+// a blur settling within the iterations
+static dt_iop_diffuse_params_t _params(void)
+{
+  dt_iop_diffuse_params_t p = { 0 };
+  p.iterations = 50;
+  p.radius = 8;
+  p.radius_center = 0;
+  p.sharpness = 0.f;
+  p.regularization = 1.f;
+  p.variance_threshold = 0.f;
+  p.anisotropy_first = 1.f;
+  p.anisotropy_second = 1.f;
+  p.anisotropy_third = 1.f;
+  p.anisotropy_fourth = 1.f;
+  p.first = 0.25f;
+  p.second = 0.25f;
+  p.third = 0.25f;
+  p.fourth = 0.25f;
+  p.convergence = 0.003f;
+  return p;
+}
+
+// diffuse the image tile by tile the way the tiling of the pixelpipe does
+static void _diffuse_tiled(const dt_iop_diffuse_data_t *const data,
+                           const float *const in,
+                           float *const out,
+                           const float zoom)
+{
+  const size_t tile_w = WIDTH / TILES_X;
+  const size_t tile_h = HEIGHT / TILES_Y;
+  for(size_t ty = 0; ty < TILES_Y; ty++)
+    for(size_t tx = 0; tx < TILES_X; tx++)
+    {
+      const size_t x0 = tx * tile_w > OVERLAP ? tx * tile_w - OVERLAP : 0;
+      const size_t y0 = ty * tile_h > OVERLAP ? ty * tile_h - OVERLAP : 0;
+      const size_t x1 = MIN((tx + 1) * tile_w + OVERLAP, WIDTH);
+      const size_t y1 = MIN((ty + 1) * tile_h + OVERLAP, HEIGHT);
+      const size_t w = x1 - x0;
+      const size_t h = y1 - y0;
+
+      float *tile_in = dt_alloc_align_float(w * h * 4);
+      float *tile_out = dt_alloc_align_float(w * h * 4);
+      for(size_t i = 0; i < h; i++)
+        memcpy(tile_in + i * w * 4, in + ((y0 + i) * WIDTH + x0) * 4, sizeof(float) * w * 4);
+
+      int done = 0;
+      assert_true(_diffuse_image(data, tile_in, tile_out, w, h, zoom, _iterations(data), 0.f, &done));
+      assert_int_equal(done, _iterations(data));
+
+      for(size_t i = ty * tile_h; i < (ty + 1) * tile_h; i++)
+        memcpy(out + (i * WIDTH + tx * tile_w) * 4, tile_out + ((i - y0) * w + tx * tile_w - x0) * 4,
+               sizeof(float) * tile_w * 4);
+
+      dt_free_align(tile_in);
+      dt_free_align(tile_out);
+    }
+}
+
+static void _set_threads(const int threads)
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = threads;
+  omp_set_num_threads(threads);
+#endif
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// the iterations come from the params only
+static void test_iterations(void **state)
+{
+  dt_iop_diffuse_params_t p = _params();
+
+  // not measured yet, all iterations
+  assert_int_equal(_iterations(&p), 50);
+
+  p.converged_iterations = 7;
+  assert_int_equal(_iterations(&p), 7);
+
+  // never more than asked for
+  p.converged_iterations = 80;
+  assert_int_equal(_iterations(&p), 50);
+
+  // no convergence stop, the measured count is ignored
+  p.converged_iterations = 7;
+  p.convergence = 0.f;
+  assert_int_equal(_iterations(&p), 50);
+
+  // at least one iteration
+  p.iterations = 0;
+  assert_int_equal(_iterations(&p), 1);
+}
+
+// with the convergence stop a tiled run gives bitwise the untiled result
+static void test_tiled_untiled(void **state)
+{
+  const size_t size = (size_t)WIDTH * HEIGHT * 4;
+  float *in = _make_image(WIDTH, HEIGHT, 1.f);
+  float *whole = dt_alloc_align_float(size);
+  float *tiled = dt_alloc_align_float(size);
+
+  // small enough to stay within the overlap
+  dt_iop_diffuse_params_t p = _params();
+  p.radius = 2;
+  p.converged_iterations = 3;
+
+  int done = 0;
+  assert_true(_diffuse_image(&p, in, whole, WIDTH, HEIGHT, 1.f, _iterations(&p), 0.f, &done));
+  assert_int_equal(done, p.converged_iterations);
+
+  _diffuse_tiled(&p, in, tiled, 1.f);
+  assert_memory_equal(tiled, whole, sizeof(float) * size);
+
+  dt_free_align(in);
+  dt_free_align(whole);
+  dt_free_align(tiled);
+}
+
+// the measure is taken at a fixed size, it doesn't depend on the size of the
+// input nor on the number of threads
+static void test_measure_convergence(void **state)
+{
+  const dt_iop_diffuse_params_t p = _params();
+
+  // the same image at full size and at half size like a preview
+  float *full = _make_image(2 * WIDTH, 2 * HEIGHT, 1.f);
+  float *half = _make_image(WIDTH, HEIGHT, 2.f);
+
+  _set_threads(1);
+  const int converged = _measure_convergence(&p, full, 2 * WIDTH, 2 * HEIGHT, 1.f);
+  assert_true(converged > 1 && converged < p.iterations);
+
+#ifdef _OPENMP
+  _set_threads(MAX(omp_get_num_procs(), 4));
+#endif
+  assert_int_equal(_measure_convergence(&p, full, 2 * WIDTH, 2 * HEIGHT, 1.f), converged);
+  assert_int_equal(_measure_convergence(&p, half, WIDTH, HEIGHT, 2.f), converged);
+
+  dt_free_align(full);
+  dt_free_align(half);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_iterations),
+    cmocka_unit_test(test_tiled_untiled),
+    cmocka_unit_test(test_measure_convergence),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -503,6 +503,67 @@ static void test_linear_saturation(void **state)
   testimg_free(ti);
 }
 
+static void test_baked_curves(void **state)
+{
+  dt_iop_filmicrgb_params_t p = {
+    .grey_point_source = 18.45f, .black_point_source = -8.0f, .white_point_source = 4.0f,
+    .reconstruct_threshold = 0.0f, .reconstruct_feather = 3.0f,
+    .grey_point_target = 18.45f, .black_point_target = 0.01517634f, .white_point_target = 100.0f,
+    .output_power = 4.0f, .latitude = 0.01f, .contrast = 1.0f, .saturation = 0.0f, .balance = 0.0f,
+    .preserve_color = DT_FILMIC_METHOD_POWER_NORM, .version = DT_FILMIC_COLORSCIENCE_V5,
+    .auto_hardness = TRUE, .custom_grey = FALSE,
+    .shadows = DT_FILMIC_CURVE_POLY_4, .highlights = DT_FILMIC_CURVE_POLY_4,
+    .spline_version = DT_FILMIC_SPLINE_VERSION_V3
+  };
+  dt_iop_filmicrgb_data_t *d = dt_calloc1_align_type(dt_iop_filmicrgb_data_t);
+  dt_dev_pixelpipe_iop_t piece = { .data = d };
+  commit_params(NULL, (dt_iop_params_t *)&p, NULL, &piece);
+
+  assert_true(dt_baked_curve_valid(&d->curve_rgb));
+  assert_true(dt_baked_curve_valid(&d->curve_norm));
+
+  // the same data without the tables takes the analytic path
+  dt_iop_filmicrgb_data_t *analytic = dt_calloc1_align_type(dt_iop_filmicrgb_data_t);
+  *analytic = *d;
+  analytic->curve_rgb.table = NULL;
+  analytic->curve_norm.table = NULL;
+
+  const float display_white = powf(d->spline.y[4], d->output_power);
+  const float display_black = powf(d->spline.y[0], d->output_power);
+  const float norm_min = exp_tonemapping_v2(0.f, d->grey_source, d->black_source, d->dynamic_range);
+  const float norm_max = exp_tonemapping_v2(1.f, d->grey_source, d->black_source, d->dynamic_range);
+
+  float max_err = 0.0f;
+  float last = 0.0f;
+  for(float ev = -20.0f; ev <= 10.0f; ev += 1.0f / 64.0f)
+  {
+    const float x = exp2f(ev);
+    const dt_aligned_pixel_t pix_in = { x, 0.5f * x, 0.25f * x, 1.0f };
+    dt_aligned_pixel_t baked, reference;
+
+    RGB_tone_mapping_v4(pix_in, baked, d, d->spline, display_black, display_white);
+    RGB_tone_mapping_v4(pix_in, reference, analytic, analytic->spline, display_black, display_white);
+    for(int c = 0; c < 3; c++)
+      max_err = fmaxf(max_err, fabsf(baked[c] - reference[c]));
+
+    // baked curves stay monotonic
+    assert_true(baked[0] >= last);
+    last = baked[0];
+
+    norm_tone_mapping_v4(pix_in, baked, DT_FILMIC_METHOD_MAX_RGB, NULL, d, d->spline,
+                         norm_min, norm_max, display_black, display_white);
+    norm_tone_mapping_v4(pix_in, reference, DT_FILMIC_METHOD_MAX_RGB, NULL, analytic, analytic->spline,
+                         norm_min, norm_max, display_black, display_white);
+    for(int c = 0; c < 3; c++)
+      max_err = fmaxf(max_err, fabsf(baked[c] - reference[c]));
+  }
+  TR_DEBUG("baked curves max error %e", max_err);
+  assert_true(max_err <= DT_CURVE_BAKER_TOLERANCE);
+
+  cleanup_pipe(NULL, NULL, &piece);
+  dt_free_align(analytic);
+}
+
 /*
  * MAIN FUNCTION
  */
@@ -517,7 +578,8 @@ int main(int argc, char* argv[])
     cmocka_unit_test(test_log_tonemapping_v2),
     cmocka_unit_test(test_filmic_spline),
     cmocka_unit_test(test_filmic_desaturate_v1),
-    cmocka_unit_test(test_linear_saturation)
+    cmocka_unit_test(test_linear_saturation),
+    cmocka_unit_test(test_baked_curves)
   };
 
   TR_DEBUG("epsilon = %e", E);
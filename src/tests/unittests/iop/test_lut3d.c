@@ -0,0 +1,239 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the module iop/lut3d.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/lut3d.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// epsilon for floating point comparison
+#define E 1e-6f
+
+#define NB_PIXELS (256 * 256)
+
+/*
+ * HELPERS
+ */
+
+// straightforward per-pixel tetrahedral interpolation with one branch per tetrahedron, the
+// block-wise implementation of the module has to give the same results
+static void _reference_tetrahedral(const float *const in, float *const out,
+                                   const size_t pixel_nb, const float *const clut,
+                                   const uint16_t level)
+{
+  const size_t level2 = level * level;
+  const float flevel_1 = (float)(level - 1);
+
+  for(size_t k = 0; k < pixel_nb; k++)
+  {
+    const float *const input = in + 4 * k;
+    float *const output = out + 4 * k;
+    float rgbd[3];
+    int rgbi[3];
+    for(int c = 0; c < 3; c++)
+    {
+      rgbd[c] = CLIP(input[c]) * flevel_1;
+      rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
+      rgbd[c] -= rgbi[c];
+    }
+    const float r = rgbd[0], g = rgbd[1], b = rgbd[2];
+
+    const size_t i000 = (rgbi[0] + rgbi[1] * level + rgbi[2] * level2) * 3;
+    const size_t i100 = i000 + 3;
+    const size_t i010 = i000 + 3 * level;
+    const size_t i110 = i010 + 3;
+    const size_t i001 = i000 + 3 * level2;
+    const size_t i101 = i001 + 3;
+    const size_t i011 = i010 + 3 * level2;
+    const size_t i111 = i011 + 3;
+
+    for(int c = 0; c < 3; c++)
+    {
+      if(r > g)
+      {
+        if(g > b)
+          output[c] = (1-r)*clut[i000+c] + (r-g)*clut[i100+c] + (g-b)*clut[i110+c] + b*clut[i111+c];
+        else if(r > b)
+          output[c] = (1-r)*clut[i000+c] + (r-b)*clut[i100+c] + (b-g)*clut[i101+c] + g*clut[i111+c];
+        else
+          output[c] = (1-b)*clut[i000+c] + (b-r)*clut[i001+c] + (r-g)*clut[i101+c] + g*clut[i111+c];
+      }
+      else
+      {
+        if(b > g)
+          output[c] = (1-b)*clut[i000+c] + (b-g)*clut[i001+c] + (g-r)*clut[i011+c] + r*clut[i111+c];
+        else if(b > r)
+          output[c] = (1-g)*clut[i000+c] + (g-b)*clut[i010+c] + (b-r)*clut[i011+c] + r*clut[i111+c];
+        else
+          output[c] = (1-g)*clut[i000+c] + (g-r)*clut[i010+c] + (r-b)*clut[i110+c] + b*clut[i111+c];
+      }
+    }
+    output[3] = input[3];
+  }
+}
+
+// a lut with some curvature so that every vertex of the tetrahedra matters
+static float *_make_clut(const uint16_t level)
+{
+  const size_t size = (size_t)level * level * level;
+  float *clut = dt_alloc_align_float(3 * size);
+  for(size_t k = 0; k < size; k++)
+  {
+    const float r = (float)(k % level) / (level - 1);
+    const float g = (float)((k / level) % level) / (level - 1);
+    const float b = (float)(k / ((size_t)level * level)) / (level - 1);
+    clut[3*k]   = sqrtf(r) * (0.9f + 0.1f * b);
+    clut[3*k+1] = g * g + 0.05f * r;
+    clut[3*k+2] = 0.5f * (b + r * g);
+  }
+  return clut;
+}
+
+// random input including out of gamut values and pixels sitting exactly on the grid or with
+// equal deltas on several channels, which exercise the tie-breaking between tetrahedra
+static float *_make_input(const uint16_t level)
+{
+  float *in = dt_alloc_align_float(4 * NB_PIXELS);
+  srand(42);
+  for(size_t k = 0; k < NB_PIXELS; k++)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      float v = 1.4f * rand() / RAND_MAX - 0.2f;
+      if(rand() % 4 == 0)
+        v = (float)(rand() % level) / (level - 1);
+      if(c > 0 && rand() % 3 == 0)
+        v = in[4*k + c - 1];
+      in[4*k + c] = v;
+    }
+    in[4*k + 3] = (float)rand() / RAND_MAX;
+  }
+  return in;
+}
+
+static void _check_tetrahedral(const uint16_t level)
+{
+  float *clut = _make_clut(level);
+  float *in = _make_input(level);
+  float *ref = dt_alloc_align_float(4 * NB_PIXELS);
+  float *out = dt_alloc_align_float(4 * NB_PIXELS);
+
+  _reference_tetrahedral(in, ref, NB_PIXELS, clut, level);
+  _correct_pixel_tetrahedral(in, out, NB_PIXELS, clut, level);
+  for(size_t k = 0; k < 4 * NB_PIXELS; k++)
+    assert_float_equal(out[k], ref[k], E);
+
+  // in place, as used after the conversion to the lut colorspace
+  _correct_pixel_tetrahedral(in, in, NB_PIXELS, clut, level);
+  for(size_t k = 0; k < 4 * NB_PIXELS; k++)
+    assert_float_equal(in[k], ref[k], E);
+
+  dt_free_align(clut);
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_name(void **state)
+{
+  assert_string_equal(name(), "LUT 3D");
+}
+
+static void test_tetrahedral_identity(void **state)
+{
+  const uint16_t level = 17;
+  const size_t size = (size_t)level * level * level;
+  float *clut = dt_alloc_align_float(3 * size);
+  for(size_t k = 0; k < size; k++)
+  {
+    clut[3*k]   = (float)(k % level) / (level - 1);
+    clut[3*k+1] = (float)((k / level) % level) / (level - 1);
+    clut[3*k+2] = (float)(k / ((size_t)level * level)) / (level - 1);
+  }
+
+  float *in = _make_input(level);
+  float *out = dt_alloc_align_float(4 * NB_PIXELS);
+  _correct_pixel_tetrahedral(in, out, NB_PIXELS, clut, level);
+  for(size_t k = 0; k < NB_PIXELS; k++)
+  {
+    for(int c = 0; c < 3; c++)
+      assert_float_equal(out[4*k + c], CLIP(in[4*k + c]), 1e-5f);
+    assert_float_equal(out[4*k + 3], in[4*k + 3], E);
+  }
+
+  dt_free_align(clut);
+  dt_free_align(in);
+  dt_free_align(out);
+}
+
+static void test_tetrahedral_33(void **state)
+{
+  _check_tetrahedral(33);
+}
+
+static void test_tetrahedral_65(void **state)
+{
+  _check_tetrahedral(65);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_name),
+    cmocka_unit_test(test_tetrahedral_identity),
+    cmocka_unit_test(test_tetrahedral_33),
+    cmocka_unit_test(test_tetrahedral_65)
+  };
+
+  TR_DEBUG("epsilon = %e", E);
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,270 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the segmentation of the highlights module in
+ * iop/hlreconstruct/segmentation.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/highlights.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// odd sizes and more than one block of rows
+#define WIDTH 301
+#define HEIGHT 203
+// as used by segbased.c
+#define BORDER (HL_BORDER + 1)
+#define SLOTS 100000
+
+/*
+ * HELPERS
+ */
+
+// clipped blobs of various sizes plus scattered single locations
+static void _make_plane(uint32_t *const data, const unsigned int seed)
+{
+  srand(seed);
+  for(int k = 0; k < 60; k++)
+  {
+    const int cx = rand() % WIDTH;
+    const int cy = rand() % HEIGHT;
+    const int r = 1 + rand() % 12;
+    for(int y = MAX(BORDER, cy - r); y < MIN(HEIGHT - BORDER, cy + r); y++)
+      for(int x = MAX(BORDER, cx - r); x < MIN(WIDTH - BORDER, cx + r); x++)
+        if((x - cx) * (x - cx) + (y - cy) * (y - cy) < r * r)
+          data[(size_t)y * WIDTH + x] = 1;
+  }
+  for(int y = BORDER; y < HEIGHT - BORDER; y++)
+    for(int x = BORDER; x < WIDTH - BORDER; x++)
+      if(rand() % 40 == 0)
+        data[(size_t)y * WIDTH + x] = 1;
+}
+
+// the labelling of the former flood fill: 4-connected segments of the locations holding 1
+// inside the border, id's given in scan order of a segment's first location starting at 2,
+// segments with less than 4 locations are not labelled. Returns the next free id.
+static int _reference_labels(const uint32_t *const data, int *const labels, int *const sizes)
+{
+  int *stack = malloc(sizeof(int) * WIDTH * HEIGHT);
+  int *visited = calloc(WIDTH * HEIGHT, sizeof(int));
+  memset(labels, 0, sizeof(int) * WIDTH * HEIGHT);
+  int id = 2;
+  for(int row = BORDER; row < HEIGHT - BORDER; row++)
+    for(int col = BORDER; col < WIDTH - BORDER; col++)
+    {
+      const int start = row * WIDTH + col;
+      if(data[start] != 1 || visited[start]) continue;
+
+      int pos = 0;
+      int cnt = 0;
+      stack[pos++] = start;
+      visited[start] = id;
+      while(pos)
+      {
+        const int i = stack[--pos];
+        const int x = i % WIDTH;
+        const int y = i / WIDTH;
+        cnt++;
+        const int neighbours[4] = { i - 1, i + 1, i - WIDTH, i + WIDTH };
+        const gboolean inside[4] = { x > BORDER, x < WIDTH - BORDER - 1,
+                                     y > BORDER, y < HEIGHT - BORDER - 1 };
+        for(int k = 0; k < 4; k++)
+          if(inside[k] && data[neighbours[k]] == 1 && !visited[neighbours[k]])
+          {
+            visited[neighbours[k]] = id;
+            stack[pos++] = neighbours[k];
+          }
+      }
+      if(cnt > 3)
+      {
+        for(int i = start; i < WIDTH * (HEIGHT - BORDER); i++)
+          if(visited[i] == id) labels[i] = id;
+        sizes[id] = cnt;
+        id++;
+      }
+      else
+      {
+        // keep them visited but out of the way of the next id
+        for(int i = start; i < WIDTH * (HEIGHT - BORDER); i++)
+          if(visited[i] == id) visited[i] = -1;
+      }
+    }
+  free(stack);
+  free(visited);
+  return id;
+}
+
+static void _set_threads(const int threads)
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = threads;
+  omp_set_num_threads(threads);
+#endif
+}
+
+static int _max_threads(void)
+{
+#ifdef _OPENMP
+  return omp_get_num_procs();
+#else
+  return 1;
+#endif
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+// segment id's and sizes are those of the former flood fill, the rectangles hold the segments
+static void test_segmentize_reference(void **state)
+{
+  _set_threads(_max_threads());
+  dt_iop_segmentation_t seg;
+  assert_false(dt_segmentation_init_struct(&seg, WIDTH, HEIGHT, BORDER, SLOTS));
+  _make_plane(seg.data, 1);
+
+  int *labels = malloc(sizeof(int) * WIDTH * HEIGHT);
+  int *sizes = calloc(SLOTS, sizeof(int));
+  const int nr = _reference_labels(seg.data, labels, sizes);
+
+  dt_segmentize_plane(&seg);
+  assert_int_equal(seg.nr, nr);
+  assert_true(nr > 20);
+
+  for(int y = 0; y < HEIGHT; y++)
+    for(int x = 0; x < WIDTH; x++)
+    {
+      const size_t i = (size_t)y * WIDTH + x;
+      const uint32_t id = seg.data[i] & DT_SEG_ID_MASK ? 0 : seg.data[i];
+      if(labels[i])
+      {
+        assert_int_equal(id, labels[i]);
+        assert_in_range(x, seg.xmin[id], seg.xmax[id]);
+        assert_in_range(y, seg.ymin[id], seg.ymax[id]);
+      }
+      else
+        assert_true(id < 2);
+    }
+  for(int id = 2; id < nr; id++)
+    assert_int_equal(seg.size[id], sizes[id]);
+
+  free(labels);
+  free(sizes);
+  dt_segmentation_free_struct(&seg);
+}
+
+// the whole result does not depend on the number of threads, also when the planes are
+// segmentized together as done by segbased.c
+static void test_segmentize_threads(void **state)
+{
+  dt_iop_segmentation_t ref[HL_RGB_PLANES];
+  dt_iop_segmentation_t seg[HL_RGB_PLANES];
+  const size_t bsize = sizeof(uint32_t) * WIDTH * HEIGHT;
+  for(int p = 0; p < HL_RGB_PLANES; p++)
+  {
+    assert_false(dt_segmentation_init_struct(&ref[p], WIDTH, HEIGHT, BORDER, SLOTS));
+    assert_false(dt_segmentation_init_struct(&seg[p], WIDTH, HEIGHT, BORDER, SLOTS));
+    _make_plane(ref[p].data, 7 + p);
+  }
+  uint32_t *input = dt_alloc_aligned(HL_RGB_PLANES * bsize);
+  for(int p = 0; p < HL_RGB_PLANES; p++)
+    memcpy(input + p * WIDTH * HEIGHT, ref[p].data, bsize);
+
+  _set_threads(1);
+  for(int p = 0; p < HL_RGB_PLANES; p++)
+    dt_segmentize_plane(&ref[p]);
+
+  const int threads[] = { 2, 3, 4, 8 };
+  for(int k = 0; k < sizeof(threads) / sizeof(threads[0]); k++)
+  {
+    const int nthreads = MIN(threads[k], _max_threads());
+    _set_threads(nthreads);
+    TR_DEBUG("%d threads", nthreads);
+    for(int together = 0; together < 2; together++)
+    {
+      for(int p = 0; p < HL_RGB_PLANES; p++)
+      {
+        memcpy(seg[p].data, input + p * WIDTH * HEIGHT, bsize);
+        seg[p].nr = 2;
+      }
+
+      if(together)
+        dt_segmentize_planes(seg, HL_RGB_PLANES);
+      else
+        for(int p = 0; p < HL_RGB_PLANES; p++)
+          dt_segmentize_plane(&seg[p]);
+
+      for(int p = 0; p < HL_RGB_PLANES; p++)
+      {
+        assert_int_equal(seg[p].nr, ref[p].nr);
+        assert_memory_equal(seg[p].data, ref[p].data, bsize);
+        const size_t n = sizeof(int) * ref[p].nr;
+        assert_memory_equal(seg[p].size, ref[p].size, n);
+        assert_memory_equal(seg[p].xmin, ref[p].xmin, n);
+        assert_memory_equal(seg[p].xmax, ref[p].xmax, n);
+        assert_memory_equal(seg[p].ymin, ref[p].ymin, n);
+        assert_memory_equal(seg[p].ymax, ref[p].ymax, n);
+      }
+    }
+  }
+
+  dt_free_align(input);
+  for(int p = 0; p < HL_RGB_PLANES; p++)
+  {
+    dt_segmentation_free_struct(&ref[p]);
+    dt_segmentation_free_struct(&seg[p]);
+  }
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char *argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_segmentize_reference),
+    cmocka_unit_test(test_segmentize_threads),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
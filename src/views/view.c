@@ -1803,11 +1803,14 @@ void dt_view_paint_surface(cairo_t *cr,
   const double trans_x = (offset_x - zoom_x) * processed_width * buf_scale - 0.5 * buf_width;
   const double trans_y = (offset_y - zoom_y) * processed_height * buf_scale - 0.5 * buf_height;
 
+  // a low resolution progressive backbuf is scaled up, the full resolution one
+  // is on its way, don't request another run for it
   if(pp->output_imgid == dev->image_storage.id
      && (port->pipe->output_imgid != dev->image_storage.id
-         || fabsf(backbuf_scale / buf_scale - 1.0f) > .09f
-         || floor(maxw / 2 / back_scale) - 1 > MIN(- trans_x, trans_x + buf_width)
-         || floor(maxh / 2 / back_scale) - 1 > MIN(- trans_y, trans_y + buf_height))
+         || (!port->pipe->backbuf_coarse
+             && (fabsf(backbuf_scale / buf_scale - 1.0f) > .09f
+                 || floor(maxw / 2 / back_scale) - 1 > MIN(- trans_x, trans_x + buf_width)
+                 || floor(maxh / 2 / back_scale) - 1 > MIN(- trans_y, trans_y + buf_height))))
      && (port == &dev->full || port == &dev->preview2))
   {
     port->pipe->changed |= DT_DEV_PIPE_ZOOMED;